@@ -0,0 +1,11 @@
+#version 150
+// ^ Change this to version 130 if you have compatibility issues
+
+// The color writes are masked off while this shader is used
+
+out vec4 out_Col;
+
+void main()
+{
+    out_Col = vec4(1.f);
+}
@@ -0,0 +1,18 @@
+#version 150
+// ^ Change this to version 130 if you have compatibility issues
+
+// Only writes depth: used for the occlusion culling pre-pass
+// and the section bounding boxes tested against it
+
+uniform mat4 u_Model;
+uniform mat4 u_ViewProj;
+
+in vec4 vs_Pos;
+
+void main()
+{
+    vec4 modelposition = u_Model * vs_Pos;
+
+    //built-in things to pass down the pipeline
+    gl_Position = u_ViewProj * modelposition;
+}
@@ -14,6 +14,8 @@
 uniform vec4 u_Color; // The color with which to render this instance of geometry.
 uniform sampler2D u_Texture;
 uniform int u_Time;
+uniform sampler3D u_Noise; // the fbm below, baked into a texture that repeats every world unit
+uniform int u_BakedNoise; // 1 if u_Noise is ready & selected
 
 // These are the interpolated values out of the rasterizer, so you can't know
 // their specific values without knowing the vertices that contributed to them
@@ -72,12 +74,19 @@ float fbm(vec3 p) {
     return sum;
 }
 
+float noise(vec3 p) {
+    if (u_BakedNoise != 0) {
+        return texture(u_Noise, p).r;
+    }
+    return fbm(p);
+}
+
 void main()
 {
     // Material base color (before shading)
 
         vec4 diffuseColor = texture(u_Texture, fs_UV);
-        diffuseColor = diffuseColor * (0.5 * fbm(fs_Pos.xyz) + 0.5);
+        diffuseColor = diffuseColor * (0.5 * noise(fs_Pos.xyz) + 0.5);
 
         // Calculate the diffuse term for Lambert shading
         float diffuseTerm = dot(normalize(fs_Nor), normalize(fs_LightVec));
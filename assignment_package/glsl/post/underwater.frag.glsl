@@ -3,6 +3,8 @@
 uniform vec4 u_Color; // The color with which to render this instance of geometry.
 uniform sampler2D u_Texture;
 uniform int u_Time;
+uniform sampler3D u_Noise; // the fbm below, baked into a texture that repeats every world unit
+uniform int u_BakedNoise; // 1 if u_Noise is ready & selected
 
 // These are the interpolated values out of the rasterizer, so you can't know
 // their specific values without knowing the vertices that contributed to them
@@ -61,11 +63,18 @@ float fbm(vec3 p) {
     return sum;
 }
 
+float noise(vec3 p) {
+    if (u_BakedNoise != 0) {
+        return texture(u_Noise, p).r;
+    }
+    return fbm(p);
+}
+
 void main()
 {
     //background texture
     vec4 texture_color  = texture(u_Texture, fs_UV);
-    texture_color       = texture_color * (0.5 * fbm(fs_Pos.xyz) + 0.5);
+    texture_color       = texture_color * (0.5 * noise(fs_Pos.xyz) + 0.5);
 
     vec4 water_color = vec4(0.192156862745098, 0.6627450980392157, 0.9333333333333333, 1.0);
 
@@ -26,7 +26,8 @@ FORMS += forms/mainwindow.ui \
 
 RESOURCES += glsl.qrc \
     sounds.qrc \
-    texture.qrc
+    texture.qrc \
+    tests.qrc
 
 *-clang*|*-g++* {
     message("Enabling additional warnings")
@@ -54,6 +55,14 @@ address_sanitizer {
     QMAKE_LFLAGS += -fsanitize=address
 }
 
+# glGetError stalls until the GPU has caught up, so the checks after each
+# draw (OpenGLContext::printGLErrorLog) are only compiled in with:
+#     qmake CONFIG+=gl_debug
+gl_debug {
+    message("Enabling GL error checks")
+    DEFINES += GL_DEBUG_CHECKS
+}
+
 HEADERS +=
 
 SOURCES +=
@@ -0,0 +1,704 @@
+#include "benchmark.h"
+#include "scene/terrain.h"
+#include "scene/noise.h"
+#include "scene/player.h"
+#include "scene/npcs/steve.h"
+#include "scene/npcs/sheep.h"
+#include "scene/npcupdater.h"
+#include "scene/npcstore.h"
+#include "scene/pathfinder.h"
+#include "scene/pathservice.h"
+#include "scene/flowfield.h"
+#include "scene/entityindex.h"
+#include "scene/lsystems.h"
+#include "scene/text.h"
+#include "scene/seededrandom.h"
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <map>
+
+
+// the benchmarked world: the 2 x 2 zones [-64, 64) x [-64, 64)
+static const int WORLD_MIN = -64;
+static const int WORLD_SIZE = 128;
+
+// the y of the highest block of the column, 0 if there's none
+static int surfaceHeight(const Terrain &terrain, int x, int z)
+{
+    for (int y = 255; y > 0; y--) {
+        if (terrain.getBlockAt(x, y, z) != EMPTY) {
+            return y;
+        }
+    }
+    return 0;
+}
+
+// a random coordinate in [min, min + size)
+static int randomCoord(int min, int size)
+{
+    return min + static_cast<int>(SeededRandom::next() % size);
+}
+
+
+BenchmarkResult::BenchmarkResult()
+    : name(), ops(0), reps(0), median(0.0), mean(0.0), stddev(0.0), min(0.0)
+{}
+
+
+Benchmark::Benchmark(OpenGLContext *context, int warmupReps, int reps)
+    : mp_context(context), m_warmupReps(warmupReps), m_reps(std::max(reps, 1)),
+      m_results(), m_filter(), m_sink(0)
+{}
+
+/**
+ * @brief Benchmark::measure
+ *  Run body m_warmupReps times untimed (caches, allocator & branch predictors),
+ *  then m_reps times timed & add the ns / op of the timed runs to m_results
+ * @param name
+ * @param ops : the operations one call of body runs
+ * @param body
+ */
+void Benchmark::measure(const std::string &name, long long ops, const std::function<long long()> &body)
+{
+    if (!m_filter.empty() && name.find(m_filter) == std::string::npos) {
+        return;
+    }
+
+    for (int i = 0; i < m_warmupReps; i++) {
+        m_sink = m_sink + body();
+    }
+
+    std::vector<double> nsPerOp;
+    for (int i = 0; i < m_reps; i++) {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        long long result = body();
+        std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+        m_sink = m_sink + result;
+        double ns = std::chrono::duration<double, std::nano>(end - start).count();
+        nsPerOp.push_back(ns / ops);
+    }
+
+    BenchmarkResult result;
+    result.name = name;
+    result.ops = ops;
+    result.reps = m_reps;
+
+    std::sort(nsPerOp.begin(), nsPerOp.end());
+    int n = static_cast<int>(nsPerOp.size());
+    result.median = n % 2 == 1 ? nsPerOp[n / 2] : 0.5 * (nsPerOp[n / 2 - 1] + nsPerOp[n / 2]);
+    result.min = nsPerOp.front();
+    for (double v : nsPerOp) {
+        result.mean += v;
+    }
+    result.mean /= n;
+    for (double v : nsPerOp) {
+        result.stddev += (v - result.mean) * (v - result.mean);
+    }
+    result.stddev = n > 1 ? std::sqrt(result.stddev / (n - 1)) : 0.0;
+
+    std::printf("%-32s %12.1f ns/op  mean %12.1f  stddev %5.1f%%  min %12.1f  (%lld ops x %d)\n",
+                name.c_str(), result.median, result.mean,
+                result.mean > 0.0 ? 100.0 * result.stddev / result.mean : 0.0,
+                result.min, ops, m_reps);
+    std::fflush(stdout);
+    m_results.push_back(result);
+}
+
+/**
+ * @brief Benchmark::run
+ *  Generate the world, then run the benchmarks on it.
+ *  The random inputs (positions, rays, path ends) come from fixed seeds.
+ * @param filter : only run the benchmarks whose name contains it
+ */
+void Benchmark::run(const QString &filter)
+{
+    m_filter = filter.toStdString();
+    m_results.clear();
+
+    // fill the zones on this thread, nothing is meshed or uploaded (only navigated)
+    Terrain terrain(mp_context);
+    std::unordered_set<Chunk*> filledChunks;
+    QMutex filledChunksLock;
+    for (int xCorner = WORLD_MIN; xCorner < WORLD_MIN + WORLD_SIZE; xCorner += 64) {
+        for (int zCorner = WORLD_MIN; zCorner < WORLD_MIN + WORLD_SIZE; zCorner += 64) {
+            std::unordered_map<int64_t, Chunk*> chunks;
+            for (int x = xCorner; x < xCorner + 64; x += 16) {
+                for (int z = zCorner; z < zCorner + 64; z += 16) {
+                    chunks[toKey(x, z)] = terrain.instantiateChunkAt(x, z);
+                }
+            }
+            FillBlocksWorker worker(xCorner, zCorner, chunks, &filledChunks, &filledChunksLock);
+            worker.run();
+        }
+    }
+    // the navigation layers the VBOWorkers would build
+    for (Chunk *chunk : filledChunks) {
+        chunk->setNavGrid(chunk->generateNavGrid());
+    }
+
+    Noise noise;
+    measure("noise.getHeight", 64 * 64, [&noise]() {
+        long long sum = 0;
+        for (int x = 0; x < 64; x++) {
+            for (int z = 0; z < 64; z++) {
+                sum += noise.getHeight(x, z);
+            }
+        }
+        return sum;
+    });
+    measure("noise.getCaveHeight", 16 * 16 * 16, [&noise]() {
+        float sum = 0.f;
+        for (int x = 0; x < 16; x++) {
+            for (int y = 0; y < 16; y++) {
+                for (int z = 0; z < 16; z++) {
+                    sum += noise.getCaveHeight(x, y, z);
+                }
+            }
+        }
+        return static_cast<long long>(sum);
+    });
+
+    // the chunks in [-32, 32) have all 4 neighbors filled
+    std::vector<Chunk*> meshedChunks;
+    for (int x = -32; x < 32; x += 16) {
+        for (int z = -32; z < 32; z += 16) {
+            meshedChunks.push_back(terrain.getChunkAt(x, z).get());
+        }
+    }
+    // the copies are taken with the world lock held, so they stall the simulation
+    std::vector<uPtr<ChunkBlocks>> meshedBlocks(meshedChunks.size());
+    measure("chunk.copyBlocks", meshedChunks.size(), [&meshedChunks, &meshedBlocks]() {
+        long long solid = 0;
+        for (size_t i = 0; i < meshedChunks.size(); i++) {
+            meshedBlocks[i] = meshedChunks[i]->copyBlocks();
+            solid += meshedBlocks[i]->borders[0][0] != EMPTY;
+        }
+        return solid;
+    });
+    measure("chunk.generateVBOdata", meshedChunks.size(), [&meshedChunks, &meshedBlocks]() {
+        long long indices = 0;
+        for (size_t i = 0; i < meshedChunks.size(); i++) {
+            ChunkVBOdata vbo = meshedChunks[i]->generateVBOdata(*meshedBlocks[i]);
+            indices += vbo.indices.size() + vbo.transparentIndices.size();
+        }
+        return indices;
+    });
+
+    // one chunk column after another, as the meshing & the fill workers walk them
+    measure("terrain.getBlockAt.sequential", 16 * 256 * 16, [&terrain]() {
+        long long solid = 0;
+        for (int x = 0; x < 16; x++) {
+            for (int z = 0; z < 16; z++) {
+                for (int y = 0; y < 256; y++) {
+                    solid += terrain.getBlockAt(x, y, z) != EMPTY;
+                }
+            }
+        }
+        return solid;
+    });
+
+    SeededRandom::seed(40);
+    std::vector<glm::ivec3> randomBlocks;
+    for (int i = 0; i < 1 << 16; i++) {
+        randomBlocks.push_back(glm::ivec3(randomCoord(WORLD_MIN, WORLD_SIZE), randomCoord(0, 256),
+                                          randomCoord(WORLD_MIN, WORLD_SIZE)));
+    }
+    measure("terrain.getBlockAt.random", randomBlocks.size(), [&terrain, &randomBlocks]() {
+        long long solid = 0;
+        for (const glm::ivec3 &p : randomBlocks) {
+            solid += terrain.getBlockAt(p.x, p.y, p.z) != EMPTY;
+        }
+        return solid;
+    });
+
+    // outside of the world: getBlockAt throws, hasBlockAt catches
+    std::vector<glm::vec3> missedBlocks;
+    for (int i = 0; i < 1 << 10; i++) {
+        missedBlocks.push_back(glm::vec3(randomCoord(1024, 1024), randomCoord(0, 256), randomCoord(1024, 1024)));
+    }
+    measure("terrain.hasBlockAt.miss", missedBlocks.size(), [&terrain, &missedBlocks]() {
+        long long found = 0;
+        for (const glm::vec3 &p : missedBlocks) {
+            found += terrain.hasBlockAt(p);
+        }
+        return found;
+    });
+
+    // rays from the eyes of someone standing on the surface, as long as the player's reach
+    std::vector<Ray> rays;
+    for (int i = 0; i < 1 << 12; i++) {
+        int x = randomCoord(-32, 64);
+        int z = randomCoord(-32, 64);
+        glm::vec3 origin(x + 0.5f, surfaceHeight(terrain, x, z) + 2.5f, z + 0.5f);
+        glm::vec3 dir(SeededRandom::next01() - 0.5f, SeededRandom::next01() - 0.75f, SeededRandom::next01() - 0.5f);
+        rays.push_back(Ray(origin, dir, 3.f));
+    }
+    measure("terrain.raycast", rays.size(), [&terrain, &rays]() {
+        long long hits = 0;
+        for (const Ray &ray : rays) {
+            hits += terrain.raycast(ray.origin, ray.direction, ray.maxDist).hit;
+        }
+        return hits;
+    });
+    std::vector<RayHit> rayHits;
+    measure("terrain.raycastBatch", rays.size(), [&terrain, &rays, &rayHits]() {
+        terrain.raycastBatch(rays, &rayHits);
+        long long hits = 0;
+        for (const RayHit &hit : rayHits) {
+            hits += hit.hit;
+        }
+        return hits;
+    });
+
+    // long rays through the sky & the caves, where the empty sections are skipped
+    std::vector<Ray> longRays;
+    for (int i = 0; i < 1 << 10; i++) {
+        glm::vec3 origin(randomCoord(-16, 32) + 0.5f, randomCoord(0, 256) + 0.5f, randomCoord(-16, 32) + 0.5f);
+        glm::vec3 dir(SeededRandom::next01() - 0.5f, SeededRandom::next01() - 0.5f, SeededRandom::next01() - 0.5f);
+        longRays.push_back(Ray(origin, dir, 40.f));
+    }
+    measure("terrain.raycast.long", longRays.size(), [&terrain, &longRays]() {
+        long long hits = 0;
+        for (const Ray &ray : longRays) {
+            hits += terrain.raycast(ray.origin, ray.direction, ray.maxDist).hit;
+        }
+        return hits;
+    });
+
+    glm::vec3 spawn(0.5f, surfaceHeight(terrain, 0, 0) + 1.f, 0.5f);
+    Player player(spawn, terrain);
+    Steve steve(mp_context, spawn + glm::vec3(0.f, 2.f, 0.f), terrain, player, STEVE);
+
+    // a second of walking forward, the collisions make up most of a tick
+    player.toggleFlightMode();
+    measure("player.tick", 60, [&player, spawn]() {
+        player.setPos(spawn);
+        InputBundle inputs;
+        inputs.wPressed = true;
+        for (int i = 0; i < 60; i++) {
+            player.tick(1.f / 60.f, inputs);
+        }
+        return static_cast<long long>(player.mcr_position.x);
+    });
+
+    // a second of walking (& falling), from wherever the previous repetition stopped
+    measure("npc.tryMove", 60, [&steve]() {
+        for (int i = 0; i < 60; i++) {
+            steve.tryMove(1.f / 60.f);
+        }
+        return static_cast<long long>(steve.mcr_position.x);
+    });
+
+    // the path ends are a few blocks apart, like an npc walking to its next goal
+    std::vector<std::pair<glm::vec3, glm::vec3>> pathEnds;
+    for (int i = 0; i < 32; i++) {
+        int x = randomCoord(-32, 64);
+        int z = randomCoord(-32, 64);
+        int targetX = x + randomCoord(-12, 24);
+        int targetZ = z + randomCoord(-12, 24);
+        pathEnds.push_back(std::make_pair(glm::vec3(x + 0.5f, surfaceHeight(terrain, x, z) + 1.f, z + 0.5f),
+                                          glm::vec3(targetX + 0.5f, surfaceHeight(terrain, targetX, targetZ) + 1.f,
+                                                    targetZ + 0.5f)));
+    }
+    PathFinder pathFinder(5, terrain);
+    measure("pathfinder.searchPathToward", pathEnds.size(), [&pathFinder, &pathEnds]() {
+        // the same random path choices every repetition
+        SeededRandom::seed(46);
+        long long actions = 0;
+        for (const std::pair<glm::vec3, glm::vec3> &ends : pathEnds) {
+            actions += pathFinder.searchPathToward(ends.first, ends.second).size();
+        }
+        return actions;
+    });
+
+    // the same searches per node popped (1e9 / ns per op: expansions per second)
+    SeededRandom::seed(46);
+    long long expansions = 0;
+    for (const std::pair<glm::vec3, glm::vec3> &ends : pathEnds) {
+        pathFinder.searchPathToward(ends.first, ends.second);
+        expansions += pathFinder.getLastExpansions();
+    }
+    measure("pathfinder.expansion", glm::max(expansions, 1LL), [&pathFinder, &pathEnds]() {
+        SeededRandom::seed(46);
+        long long actions = 0;
+        for (const std::pair<glm::vec3, glm::vec3> &ends : pathEnds) {
+            actions += pathFinder.searchPathToward(ends.first, ends.second).size();
+        }
+        return actions;
+    });
+
+    // the sheep of MyGL::setupNPCs replanning toward each of their goals
+    std::vector<glm::vec3> sheepGoals = {glm::vec3(-145, 137, -227),
+                                         glm::vec3(-72, 148, -294),
+                                         glm::vec3(0, 139, -48),
+                                         glm::vec3(32, 138, 32)};
+    std::vector<glm::vec3> sheepStarts;
+    for (int i = 0; i < 6; i++) {
+        for (int z : {32, 45}) {
+            int x = 50 + static_cast<int>(i * 1.5f);
+            sheepStarts.push_back(glm::vec3(x + 0.5f, surfaceHeight(terrain, x, z) + 1.f, z + 0.5f));
+        }
+    }
+    measure("pathfinder.sheepGoals", sheepStarts.size() * sheepGoals.size(),
+            [&pathFinder, &sheepStarts, &sheepGoals]() {
+        SeededRandom::seed(46);
+        long long actions = 0;
+        for (const glm::vec3 &start : sheepStarts) {
+            for (const glm::vec3 &goal : sheepGoals) {
+                actions += pathFinder.searchPathToward(start, goal).size();
+            }
+        }
+        return actions;
+    });
+
+    // the sheep stepping to the end of each plan until they reach a goal (or give up),
+    // with & without the portal routes: ns & expansions (A* nodes + portals) per goal reached
+    std::vector<glm::vec3> walkGoals = {glm::vec3(0, 139, -48), glm::vec3(32, 138, 32)};
+    auto walkToGoals = [&pathFinder, &sheepStarts, &walkGoals](bool routes, long long *out_expansions) {
+        SeededRandom::seed(46);
+        long long reached = 0;
+        for (const glm::vec3 &start : sheepStarts) {
+            for (const glm::vec3 &goal : walkGoals) {
+                glm::vec3 pos = start;
+                for (int plan = 0; plan < 64; plan++) {
+                    if (glm::length(glm::vec2(goal.x - pos.x, goal.z - pos.z)) <= 2.f) {
+                        reached++;
+                        break;
+                    }
+                    std::queue<NPCAction> actions = routes ? pathFinder.searchRouteToward(pos, goal)
+                                                           : pathFinder.searchPathToward(pos, goal);
+                    *out_expansions += pathFinder.getLastExpansions() + pathFinder.getLastRouteExpansions();
+                    if (actions.empty()) {
+                        break;
+                    }
+                    pos = actions.back().dest + glm::vec3(0.5f, 0.f, 0.5f);
+                }
+            }
+        }
+        return reached;
+    };
+    for (bool routes : {false, true}) {
+        std::string name = routes ? "pathfinder.walkToGoal.route" : "pathfinder.walkToGoal.local";
+        if (!m_filter.empty() && name.find(m_filter) == std::string::npos) {
+            continue;
+        }
+        long long expansions = 0;
+        long long reached = walkToGoals(routes, &expansions);
+        std::printf("%-32s %lld / %d goals reached, %lld expansions per goal reached\n", name.c_str(), reached,
+                    static_cast<int>(sheepStarts.size() * walkGoals.size()), expansions / glm::max(reached, 1LL));
+        measure(name, glm::max(reached, 1LL), [&walkToGoals, routes]() {
+            long long expansions = 0;
+            return walkToGoals(routes, &expansions) + expansions;
+        });
+    }
+
+    // a crowd of NPCs heading to one goal: its flow field, then one step lookup per NPC & step,
+    // against one A* plan per NPC
+    glm::ivec3 crowdGoal(32, 138, 32);
+    std::vector<glm::vec3> crowd;
+    for (int i = 0; i < 1000; i++) {
+        int x = randomCoord(-8, 72);
+        int z = randomCoord(-8, 72);
+        crowd.push_back(glm::vec3(x + 0.5f, surfaceHeight(terrain, x, z) + 1.f, z + 0.5f));
+    }
+    FlowField field;
+    measure("flowfield.build", 1, [&field, &terrain, crowdGoal]() {
+        field.build(terrain, crowdGoal);
+        return static_cast<long long>(field.getCost(crowdGoal));
+    });
+    field.build(terrain, crowdGoal);
+    int inReach = 0;
+    for (const glm::vec3 &pos : crowd) {
+        glm::ivec3 cell;
+        inReach += field.findCell(pos, &cell) ? 1 : 0;
+    }
+    std::printf("%-32s %d / %d NPCs in reach of the field\n", "flowfield.crowd", inReach,
+                static_cast<int>(crowd.size()));
+    measure("flowfield.crowd", crowd.size(), [&field, &crowd, &pathFinder]() {
+        long long steps = 0;
+        for (const glm::vec3 &pos : crowd) {
+            glm::ivec3 cell;
+            glm::ivec3 next;
+            if (!field.findCell(pos, &cell)) {
+                continue;
+            }
+            for (int i = 0; i < pathFinder.getRadius() && field.getNextCell(cell, &next); i++) {
+                cell = next;
+                steps++;
+            }
+        }
+        return steps;
+    });
+    measure("pathfinder.crowd", crowd.size(), [&pathFinder, &crowd, crowdGoal]() {
+        SeededRandom::seed(46);
+        long long actions = 0;
+        for (const glm::vec3 &pos : crowd) {
+            actions += pathFinder.searchPathToward(pos, glm::vec3(crowdGoal)).size();
+        }
+        return actions;
+    });
+
+    // 10k entities (NPC-sized boxes) spread over 512 x 512 blocks: the queries of the index
+    // against going through every entity
+    EntityIndex entities;
+    std::vector<AABB> entityBoxes;
+    std::vector<int> entityHandles;
+    for (int i = 0; i < 10000; i++) {
+        glm::vec3 feet(randomCoord(-256, 512) + SeededRandom::next01(), randomCoord(128, 32),
+                       randomCoord(-256, 512) + SeededRandom::next01());
+        entityBoxes.push_back(AABB(feet - glm::vec3(0.5f, 0.f, 0.5f), feet + glm::vec3(0.5f, 2.f, 0.5f)));
+        entityHandles.push_back(entities.insert(nullptr, entityBoxes.back()));
+    }
+    std::vector<glm::vec3> queryPoints;
+    for (int i = 0; i < 1000; i++) {
+        queryPoints.push_back(glm::vec3(randomCoord(-256, 512), randomCoord(128, 32), randomCoord(-256, 512)));
+    }
+    std::vector<int> found;
+    measure("entityindex.queryRadius", queryPoints.size(), [&entities, &queryPoints, &found]() {
+        long long n = 0;
+        for (const glm::vec3 &p : queryPoints) {
+            entities.queryRadius(p, 8.f, &found);
+            n += found.size();
+        }
+        return n;
+    });
+    measure("entityindex.linearRadius", queryPoints.size(), [&entityBoxes, &queryPoints]() {
+        long long n = 0;
+        for (const glm::vec3 &p : queryPoints) {
+            for (const AABB &box : entityBoxes) {
+                n += glm::length(p - glm::clamp(p, box.min, box.max)) <= 8.f ? 1 : 0;
+            }
+        }
+        return n;
+    });
+    measure("entityindex.queryNearest", queryPoints.size(), [&entities, &queryPoints, &found]() {
+        long long n = 0;
+        for (const glm::vec3 &p : queryPoints) {
+            entities.queryNearest(p, 8, 64.f, &found);
+            n += found.size();
+        }
+        return n;
+    });
+    // every entity takes a step (of a few crossing into other cells)
+    measure("entityindex.update", entityHandles.size(), [&entities, &entityBoxes, &entityHandles]() {
+        for (unsigned int i = 0; i < entityHandles.size(); i++) {
+            glm::vec3 step(i % 2 == 0 ? 0.1f : -0.1f, 0.f, 0.05f);
+            entityBoxes[i] = AABB(entityBoxes[i].min + step, entityBoxes[i].max + step);
+            entities.update(entityHandles[i], entityBoxes[i]);
+        }
+        return static_cast<long long>(entities.size());
+    });
+
+    // 512 sheep walking between 4 goals, a second of simulation steps (the path searches,
+    // the ticks on 1 to 8 threads & their commits), from wherever the previous repetition stopped
+    std::vector<glm::vec3> sheepWalkGoals;
+    for (glm::ivec2 goal : {glm::ivec2(-40, -40), glm::ivec2(40, -40), glm::ivec2(40, 40), glm::ivec2(-40, 40)}) {
+        sheepWalkGoals.push_back(glm::vec3(goal.x + 0.5f, surfaceHeight(terrain, goal.x, goal.y) + 1.f, goal.y + 0.5f));
+    }
+    PathService pathService;
+    EntityIndex &npcEntities = terrain.getEntityIndex();
+    std::vector<uPtr<NPC>> sheep;
+    std::vector<int> sheepHandles;
+    for (int i = 0; i < 512; i++) {
+        int x = randomCoord(-48, 96);
+        int z = randomCoord(-48, 96);
+        std::vector<glm::vec3> goals = sheepWalkGoals;
+        std::rotate(goals.begin(), goals.begin() + i % goals.size(), goals.end());
+        sheep.push_back(mkU<Sheep>(mp_context, glm::vec3(x + 0.5f, surfaceHeight(terrain, x, z) + 2.f, z + 0.5f),
+                                   terrain, player, SHEEP, goals, glm::vec3(1.f, 0.f, 1.f), 2.f, 2.f, 5));
+        sheep.back()->initSceneGraph();
+        sheep.back()->setPathService(&pathService);
+        sheepHandles.push_back(npcEntities.insert(sheep.back().get(), sheep.back()->getBoundingBox()));
+    }
+    NPCUpdater npcUpdater;
+    SeededRandom::seed(46);
+    for (int threads : {1, 2, 4, 8}) {
+        npcUpdater.setMaxThreads(threads);
+        std::string name = "npc.update.threads" + std::to_string(threads);
+        measure(name, 60 * sheep.size(), [&npcUpdater, &pathService, &sheep, &sheepHandles, &npcEntities]() {
+            for (int i = 0; i < 60; i++) {
+                pathService.collect();
+                npcUpdater.tickAll(sheep, 1.f / 60.f);
+                for (unsigned int j = 0; j < sheep.size(); j++) {
+                    npcEntities.update(sheepHandles[j], sheep[j]->getBoundingBox());
+                }
+                pathService.dispatch();
+            }
+            return static_cast<long long>(sheep.front()->mcr_position.x) + npcUpdater.getBatchSize();
+        });
+    }
+    pathService.clear();
+    for (int handle : sheepHandles) {
+        npcEntities.remove(handle);
+    }
+
+    // the same walk for 1k & 10k sheep as rows of an NPCStore (their steps along the flow fields
+    // of the goals, their moves & their limbs), a second of ticks, against npc.update.threads1
+    NPCStore store(terrain);
+    int sheepArchetype = store.addArchetype(sheep.front()->getArchetype());
+    std::vector<int> sheepRoutes;
+    for (unsigned int i = 0; i < sheepWalkGoals.size(); i++) {
+        std::vector<glm::vec3> goals = sheepWalkGoals;
+        std::rotate(goals.begin(), goals.begin() + i, goals.end());
+        sheepRoutes.push_back(store.addRoute(goals));
+    }
+    for (int nSheep : {1000, 10000}) {
+        store.clear();
+        for (int i = 0; i < nSheep; i++) {
+            int x = randomCoord(-48, 96);
+            int z = randomCoord(-48, 96);
+            store.spawn(sheepArchetype, sheepRoutes[i % sheepRoutes.size()],
+                        glm::vec3(x + 0.5f, surfaceHeight(terrain, x, z) + 2.f, z + 0.5f));
+        }
+        std::string name = "npcstore.tick." + std::to_string(nSheep / 1000) + "k";
+        measure(name, 60LL * nSheep, [&store]() {
+            for (int i = 0; i < 60; i++) {
+                store.tick(1.f / 60.f);
+            }
+            return static_cast<long long>(store.getPosition(0).x);
+        });
+    }
+
+    // rebuilding the navigation layer of a meshed chunk
+    uPtr<ChunkBlocks> navBlocks = terrain.findChunkAt(0, 0)->copyBlocks();
+    measure("navgrid.build", 1, [&navBlocks]() {
+        return static_cast<long long>(Chunk::generateNavGrid(*navBlocks)->getColumn(0, 0).standable[2]);
+    });
+
+    // the trees drawn by the fill workers
+    measure("lsystem.generatePath", 64, []() {
+        long long length = 0;
+        for (int i = 0; i < 64; i++) {
+            Tree tree(glm::vec2(0.5f, 0.5f), 0.3f);
+            tree.generatePath(2, "FX", 1);
+            length += tree.path.size();
+        }
+        return length;
+    });
+
+    // a screen of debug text, tessellate empties it again
+    Text text(mp_context, 1280.f, 720.f);
+    text.loadUVCoordFromText(":/textures/text_info.txt");
+    std::vector<HUDVertex> textVertices;
+    measure("text.addText", 256, [&text, &textVertices]() {
+        for (int i = 0; i < 256; i++) {
+            text.addText("x: 123.45 y: 140.00 z: -67.89", glm::vec2(-0.95f, 0.95f - i * 0.007f), 0.04f);
+        }
+        textVertices.clear();
+        text.tessellate(textVertices);
+        return static_cast<long long>(textVertices.size());
+    });
+}
+
+const std::vector<BenchmarkResult>& Benchmark::getResults() const
+{
+    return m_results;
+}
+
+/**
+ * @brief Benchmark::writeJSON
+ *  {"benchmarks":[{"name":..,"ops":..,"reps":..,"median_ns":..,"mean_ns":..,"stddev_ns":..,"min_ns":..}]}
+ *  All the times are ns / op. A saved file is the baseline of a later run.
+ * @param path
+ * @return
+ */
+bool Benchmark::writeJSON(const QString &path) const
+{
+    QJsonArray benchmarks;
+    for (const BenchmarkResult &result : m_results) {
+        QJsonObject benchmark;
+        benchmark.insert("name", QString::fromStdString(result.name));
+        benchmark.insert("ops", result.ops);
+        benchmark.insert("reps", result.reps);
+        benchmark.insert("median_ns", result.median);
+        benchmark.insert("mean_ns", result.mean);
+        benchmark.insert("stddev_ns", result.stddev);
+        benchmark.insert("min_ns", result.min);
+        benchmarks.append(benchmark);
+    }
+    QJsonObject root;
+    root.insert("benchmarks", benchmarks);
+
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        return false;
+    }
+    file.write(QJsonDocument(root).toJson(QJsonDocument::Indented));
+    file.close();
+    return true;
+}
+
+bool Benchmark::readJSON(const QString &path, std::vector<BenchmarkResult> &out)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    QJsonParseError error;
+    QJsonDocument doc = QJsonDocument::fromJson(file.readAll(), &error);
+    file.close();
+    if (error.error != QJsonParseError::NoError || !doc.isObject()) {
+        return false;
+    }
+
+    out.clear();
+    for (const QJsonValue &value : doc.object()["benchmarks"].toArray()) {
+        QJsonObject benchmark = value.toObject();
+        BenchmarkResult result;
+        result.name = benchmark["name"].toString().toStdString();
+        result.ops = benchmark["ops"].toInteger();
+        result.reps = benchmark["reps"].toInt();
+        result.median = benchmark["median_ns"].toDouble();
+        result.mean = benchmark["mean_ns"].toDouble();
+        result.stddev = benchmark["stddev_ns"].toDouble();
+        result.min = benchmark["min_ns"].toDouble();
+        out.push_back(result);
+    }
+    return true;
+}
+
+/**
+ * @brief Benchmark::compare
+ *  Compare the medians, they move less with the odd slow repetition than the means.
+ *  The benchmarks missing from either side are listed but don't count.
+ * @param results
+ * @param baseline
+ * @param threshold
+ * @return the number of regressions
+ */
+int Benchmark::compare(const std::vector<BenchmarkResult> &results,
+                       const std::vector<BenchmarkResult> &baseline,
+                       double threshold)
+{
+    std::map<std::string, const BenchmarkResult*> baselineByName;
+    for (const BenchmarkResult &result : baseline) {
+        baselineByName[result.name] = &result;
+    }
+
+    int regressions = 0;
+    std::printf("\n%-32s %12s %12s %8s\n", "benchmark", "baseline", "now", "change");
+    for (const BenchmarkResult &result : results) {
+        auto it = baselineByName.find(result.name);
+        if (it == baselineByName.end() || it->second->median <= 0.0) {
+            std::printf("%-32s %12s %12.1f\n", result.name.c_str(), "-", result.median);
+            continue;
+        }
+        double change = result.median / it->second->median - 1.0;
+        bool regressed = change > threshold;
+        regressions += regressed;
+        std::printf("%-32s %12.1f %12.1f %+7.1f%%%s\n", result.name.c_str(), it->second->median,
+                    result.median, 100.0 * change, regressed ? "  REGRESSION" : "");
+        baselineByName.erase(it);
+    }
+    for (const auto &p : baselineByName) {
+        std::printf("%-32s %12.1f %12s\n", p.first.c_str(), p.second->median, "-");
+    }
+    std::printf("%d regression(s) over %.0f%%\n", regressions, 100.0 * threshold);
+    return regressions;
+}
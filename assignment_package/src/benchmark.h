@@ -0,0 +1,60 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#pragma once
+
+#include "openglcontext.h"
+#include <QString>
+#include <functional>
+#include <string>
+#include <vector>
+
+// The ns per operation of one benchmark, over its timed repetitions
+struct BenchmarkResult
+{
+    std::string name;
+    // operations per repetition
+    long long ops;
+    int reps;
+    double median, mean, stddev, min;
+
+    BenchmarkResult();
+};
+
+// Microbenchmarks of the engine hot paths: noise, meshing, block lookups, raycasts, collisions,
+// path finding, NPC updates, L-systems & text. They run on a few zones generated at startup,
+// the same blocks every run (the fill workers seed their random numbers per chunk).
+// Every benchmark runs warm-up repetitions, then timed ones, & reports ns / op.
+class Benchmark
+{
+private:
+    OpenGLContext *mp_context;
+    int m_warmupReps;
+    int m_reps;
+    std::vector<BenchmarkResult> m_results;
+    // only run the benchmarks whose name contains it
+    std::string m_filter;
+    // the benchmarked calls feed their results in, so the compiler can't drop them
+    volatile long long m_sink;
+
+    // body runs ops operations & returns something computed from them
+    void measure(const std::string &name, long long ops, const std::function<long long()> &body);
+
+public:
+    Benchmark(OpenGLContext *context, int warmupReps = 2, int reps = 10);
+
+    // print each result as it's measured
+    void run(const QString &filter = QString());
+    const std::vector<BenchmarkResult>& getResults() const;
+
+    bool writeJSON(const QString &path) const;
+    static bool readJSON(const QString &path, std::vector<BenchmarkResult> &out);
+
+    // print the benchmarks whose median ns / op grew by more than threshold
+    // (0.05: 5%) over baseline & return how many
+    static int compare(const std::vector<BenchmarkResult> &results,
+                       const std::vector<BenchmarkResult> &baseline,
+                       double threshold = 0.05);
+};
+
+#endif // BENCHMARK_H
@@ -11,15 +11,28 @@ Drawable::~Drawable()
 {}
 
 
+/**
+ * @brief deleteBufferIf
+ *  Delete buf only if it was generated, and reset its name
+ */
+static void deleteBufferIf(OpenGLContext *context, bool generated, GLuint &buf)
+{
+    if (generated) {
+        context->glDeleteBuffers(1, &buf);
+    }
+    buf = 0;
+}
+
 void Drawable::destroyVBOdata()
 {
-    mp_context->glDeleteBuffers(1, &m_bufIdx);
-    mp_context->glDeleteBuffers(1, &m_bufPos);
-    mp_context->glDeleteBuffers(1, &m_bufNor);
-    mp_context->glDeleteBuffers(1, &m_bufCol);
-    mp_context->glDeleteBuffers(1, &m_bufUV);
-    mp_context->glDeleteBuffers(1, &m_bufTransparentData);
-    mp_context->glDeleteBuffers(1, &m_bufTransparentIdx);
+    deleteBufferIf(mp_context, m_idxGenerated, m_bufIdx);
+    deleteBufferIf(mp_context, m_posGenerated, m_bufPos);
+    deleteBufferIf(mp_context, m_norGenerated, m_bufNor);
+    deleteBufferIf(mp_context, m_colGenerated, m_bufCol);
+    deleteBufferIf(mp_context, m_uvGenerated, m_bufUV);
+    deleteBufferIf(mp_context, m_transparentDataGenerated, m_bufTransparentData);
+    deleteBufferIf(mp_context, m_transparentIdxGenerated, m_bufTransparentIdx);
+    m_bufCapacities.clear();
     m_idxGenerated = m_posGenerated = m_norGenerated = m_colGenerated = m_uvGenerated = false;
     m_transparentDataGenerated = m_transparentIdxGenerated = false;
     m_count = -1;
@@ -49,6 +62,10 @@ int Drawable::transparentElemCount()
 
 void Drawable::generateIdx()
 {
+    // re-creating the VBO data reuses the existing buffer
+    if (m_idxGenerated) {
+        return;
+    }
     m_idxGenerated = true;
     // Create a VBO on our GPU and store its handle in bufIdx
     mp_context->glGenBuffers(1, &m_bufIdx);
@@ -56,6 +73,10 @@ void Drawable::generateIdx()
 
 void Drawable::generateTransparentIdx()
 {
+    // re-creating the VBO data reuses the existing buffer
+    if (m_transparentIdxGenerated) {
+        return;
+    }
     m_transparentIdxGenerated = true;
     // Create a VBO on our GPU and store its handle in bufTransparentIdx
     mp_context->glGenBuffers(1, &m_bufTransparentIdx);
@@ -63,6 +84,10 @@ void Drawable::generateTransparentIdx()
 
 void Drawable::generatePos()
 {
+    // re-creating the VBO data reuses the existing buffer
+    if (m_posGenerated) {
+        return;
+    }
     m_posGenerated = true;
     // Create a VBO on our GPU and store its handle in bufPos
     mp_context->glGenBuffers(1, &m_bufPos);
@@ -71,6 +96,10 @@ void Drawable::generatePos()
 // for transparent vbo
 void Drawable::generateTransparentData()
 {
+    // re-creating the VBO data reuses the existing buffer
+    if (m_transparentDataGenerated) {
+        return;
+    }
     m_transparentDataGenerated = true;
     // Create a VBO on our GPU and store transparent data in bufTransparentData
     mp_context->glGenBuffers(1, &m_bufTransparentData);
@@ -78,6 +107,10 @@ void Drawable::generateTransparentData()
 
 void Drawable::generateNor()
 {
+    // re-creating the VBO data reuses the existing buffer
+    if (m_norGenerated) {
+        return;
+    }
     m_norGenerated = true;
     // Create a VBO on our GPU and store its handle in bufNor
     mp_context->glGenBuffers(1, &m_bufNor);
@@ -85,6 +118,10 @@ void Drawable::generateNor()
 
 void Drawable::generateCol()
 {
+    // re-creating the VBO data reuses the existing buffer
+    if (m_colGenerated) {
+        return;
+    }
     m_colGenerated = true;
     // Create a VBO on our GPU and store its handle in bufCol
     mp_context->glGenBuffers(1, &m_bufCol);
@@ -92,11 +129,43 @@ void Drawable::generateCol()
 
 void Drawable::generateUV()
 {
+    // re-creating the VBO data reuses the existing buffer
+    if (m_uvGenerated) {
+        return;
+    }
     m_uvGenerated = true;
     // Create a VBO on our GPU and store its handle in bufCol
     mp_context->glGenBuffers(1, &m_bufUV);
 }
 
+/**
+ * @brief Drawable::bufferData
+ *  Upload data into buf. If buf's data store already holds size bytes
+ *  the store is reused with glBufferSubData, so re-creating the VBO data
+ *  (e.g. a chunk re-meshed after a block change) doesn't reallocate GPU memory.
+ *  A store that has to grow is re-specified as GL_DYNAMIC_DRAW since its data changes.
+ * @param target
+ * @param buf
+ * @param size : in bytes
+ * @param data
+ */
+void Drawable::bufferData(GLenum target, GLuint buf, GLsizeiptr size, const void *data)
+{
+    mp_context->glBindBuffer(target, buf);
+
+    auto it = m_bufCapacities.find(buf);
+    if (it != m_bufCapacities.end() && it->second >= size) {
+        if (size > 0) {
+            mp_context->glBufferSubData(target, 0, size, data);
+        }
+        return;
+    }
+
+    bool regrow = it != m_bufCapacities.end();
+    mp_context->glBufferData(target, size, data, regrow ? GL_DYNAMIC_DRAW : GL_STATIC_DRAW);
+    m_bufCapacities[buf] = size;
+}
+
 bool Drawable::bindIdx()
 {
     if(m_idxGenerated) {
@@ -164,6 +233,9 @@ int InstancedDrawable::instanceCount() const {
 }
 
 void InstancedDrawable::generateOffsetBuf() {
+    if (m_offsetGenerated) {
+        return;
+    }
     m_offsetGenerated = true;
     mp_context->glGenBuffers(1, &m_bufPosOffset);
 }
@@ -179,12 +251,14 @@ bool InstancedDrawable::bindOffsetBuf() {
 void InstancedDrawable::clearOffsetBuf() {
     if(m_offsetGenerated) {
         mp_context->glDeleteBuffers(1, &m_bufPosOffset);
+        m_bufCapacities.erase(m_bufPosOffset);
         m_offsetGenerated = false;
     }
 }
 void InstancedDrawable::clearColorBuf() {
     if(m_colGenerated) {
         mp_context->glDeleteBuffers(1, &m_bufCol);
+        m_bufCapacities.erase(m_bufCol);
         m_colGenerated = false;
     }
 }
@@ -1,6 +1,7 @@
 #pragma once
 #include <openglcontext.h>
 #include <glm_includes.h>
+#include <unordered_map>
 
 //This defines a class which can be rendered by our shader program.
 //Make any geometry a subclass of ShaderProgram::Drawable in order to render it with the ShaderProgram class.
@@ -28,6 +29,10 @@ protected:
     bool m_transparentDataGenerated;
     bool m_transparentIdxGenerated;
 
+    // the size of each buffer's data store, so re-creating the VBO data
+    // can reuse the store when the new data fits
+    std::unordered_map<GLuint, GLsizeiptr> m_bufCapacities;
+
     OpenGLContext* mp_context; // Since Qt's OpenGL support is done through classes like QOpenGLFunctions_3_2_Core,
                           // we need to pass our OpenGL context to the Drawable in order to call GL functions
                           // from within this class.
@@ -56,6 +61,10 @@ public:
     void generateTransparentData();
     void generateTransparentIdx();
 
+    // Bind buf to target and upload size bytes of data into it.
+    // Uses glBufferSubData when buf's data store is big enough, glBufferData otherwise.
+    void bufferData(GLenum target, GLuint buf, GLsizeiptr size, const void *data);
+
     bool bindIdx();
     bool bindPos();
     bool bindNor();
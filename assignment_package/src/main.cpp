@@ -1,8 +1,12 @@
 #include <mainwindow.h>
+#include "benchmark.h"
+#include "selftest.h"
 
 #include <QApplication>
+#include <QCommandLineParser>
 #include <QSurfaceFormat>
 #include <QDebug>
+#include <cstring>
 
 void debugFormatVersion()
 {
@@ -21,8 +25,76 @@ void debugFormatVersion()
 
 int main(int argc, char *argv[])
 {
+    // a replay renders without a window (e.g. Mesa's llvmpipe on a build machine),
+    // the benchmarks & self tests don't render at all,
+    // the platform must be chosen before the QApplication exists
+    for (int i = 1; i < argc; i++) {
+        if ((std::strcmp(argv[i], "--replay") == 0 || std::strcmp(argv[i], "--bench") == 0
+             || std::strcmp(argv[i], "--selftest") == 0)
+                && !qEnvironmentVariableIsSet("QT_QPA_PLATFORM")) {
+            qputenv("QT_QPA_PLATFORM", "offscreen");
+        }
+    }
+
     QApplication a(argc, argv);
 
+    // --record session.bin : log the inputs of this session
+    // --replay session.bin [--replay-csv steps.csv] : replay it headless & print the timings
+    // --bench [--bench-json bench.json] [--bench-baseline old.json] [--bench-filter name] :
+    //     run the microbenchmarks, exit with 1 if one is over 5% slower than in old.json
+    // --selftest [--selftest-filter name] : run the self tests, exit with 1 if one fails
+    QCommandLineParser parser;
+    QCommandLineOption recordOption("record", "Write the inputs of the session to <file>.", "file");
+    QCommandLineOption replayOption("replay", "Replay the inputs logged in <file> offscreen, then quit.", "file");
+    QCommandLineOption replayCSVOption("replay-csv", "Write the time & checksum of every replayed step to <file>.",
+                                       "file", "replay.csv");
+    QCommandLineOption benchOption("bench", "Run the microbenchmarks, then quit.");
+    QCommandLineOption benchJSONOption("bench-json", "Write the benchmark results to <file>.",
+                                       "file", "bench.json");
+    QCommandLineOption benchBaselineOption("bench-baseline", "Flag the benchmarks over 5% slower than in <file>.",
+                                           "file");
+    QCommandLineOption benchFilterOption("bench-filter", "Only run the benchmarks whose name contains <name>.",
+                                         "name");
+    QCommandLineOption selfTestOption("selftest", "Run the self tests, then quit.");
+    QCommandLineOption selfTestFilterOption("selftest-filter", "Only run the self tests whose name contains <name>.",
+                                            "name");
+    parser.addHelpOption();
+    parser.addOption(recordOption);
+    parser.addOption(replayOption);
+    parser.addOption(replayCSVOption);
+    parser.addOption(benchOption);
+    parser.addOption(benchJSONOption);
+    parser.addOption(benchBaselineOption);
+    parser.addOption(benchFilterOption);
+    parser.addOption(selfTestOption);
+    parser.addOption(selfTestFilterOption);
+    parser.process(a);
+
+    if (parser.isSet(benchOption)) {
+        // never shown, the drawables only keep it
+        OpenGLContext context(nullptr);
+        Benchmark benchmark(&context);
+        benchmark.run(parser.value(benchFilterOption));
+        if (!benchmark.writeJSON(parser.value(benchJSONOption))) {
+            printf("Could not write %s\n", qPrintable(parser.value(benchJSONOption)));
+        }
+        if (parser.isSet(benchBaselineOption)) {
+            std::vector<BenchmarkResult> baseline;
+            if (!Benchmark::readJSON(parser.value(benchBaselineOption), baseline)) {
+                printf("Could not read the baseline %s\n", qPrintable(parser.value(benchBaselineOption)));
+                return 1;
+            }
+            return Benchmark::compare(benchmark.getResults(), baseline) > 0 ? 1 : 0;
+        }
+        return 0;
+    }
+
+    if (parser.isSet(selfTestOption)) {
+        OpenGLContext context(nullptr);
+        SelfTest selfTest(&context);
+        return selfTest.run(parser.value(selfTestFilterOption)) > 0 ? 1 : 0;
+    }
+
     // Set OpenGL 4.0 and, optionally, 4-sample multisampling
     QSurfaceFormat format;
     format.setVersion(4, 0);
@@ -38,6 +110,14 @@ int main(int argc, char *argv[])
     debugFormatVersion();
 
     MainWindow w;
+    if (parser.isSet(replayOption)) {
+        if (!w.replayInputs(parser.value(replayOption), parser.value(replayCSVOption))) {
+            printf("Could not read the input log %s\n", qPrintable(parser.value(replayOption)));
+            return 1;
+        }
+    } else if (parser.isSet(recordOption)) {
+        w.recordInputs(parser.value(recordOption));
+    }
     w.show();
 
     return a.exec();
@@ -18,6 +18,16 @@ MainWindow::MainWindow(QWidget *parent) :
     connect(ui->mygl, SIGNAL(sig_sendPlayerLook(QString)), &playerInfoWindow, SLOT(slot_setLookText(QString)));
     connect(ui->mygl, SIGNAL(sig_sendPlayerChunk(QString)), &playerInfoWindow, SLOT(slot_setChunkText(QString)));
     connect(ui->mygl, SIGNAL(sig_sendPlayerTerrainZone(QString)), &playerInfoWindow, SLOT(slot_setZoneText(QString)));
+    connect(ui->mygl, SIGNAL(sig_sendSimTickTime(QString)), &playerInfoWindow, SLOT(slot_setSimTickText(QString)));
+    connect(ui->mygl, SIGNAL(sig_sendFrameTime(QString)), &playerInfoWindow, SLOT(slot_setFrameTimeText(QString)));
+    connect(ui->mygl, SIGNAL(sig_sendChunkCullStats(QString)), &playerInfoWindow, SLOT(slot_setChunkCullText(QString)));
+    connect(ui->mygl, SIGNAL(sig_sendTerrainSubmitTime(QString)), &playerInfoWindow, SLOT(slot_setTerrainSubmitText(QString)));
+    connect(ui->mygl, SIGNAL(sig_sendGLCallStats(QString)), &playerInfoWindow, SLOT(slot_setGLCallsText(QString)));
+    connect(ui->mygl, SIGNAL(sig_sendBufferStats(QString)), &playerInfoWindow, SLOT(slot_setBufferText(QString)));
+    connect(ui->mygl, SIGNAL(sig_sendOcclusionStats(QString)), &playerInfoWindow, SLOT(slot_setOcclusionText(QString)));
+    connect(ui->mygl, SIGNAL(sig_sendCaveCullStats(QString)), &playerInfoWindow, SLOT(slot_setCaveCullText(QString)));
+    connect(ui->mygl, SIGNAL(sig_sendOverdrawStats(QString)), &playerInfoWindow, SLOT(slot_setOverdrawText(QString)));
+    connect(ui->mygl, SIGNAL(sig_sendMetrics(QString)), &playerInfoWindow, SLOT(slot_setMetricsText(QString)));
 }
 
 MainWindow::~MainWindow()
@@ -25,6 +35,16 @@ MainWindow::~MainWindow()
     delete ui;
 }
 
+void MainWindow::recordInputs(const QString &path)
+{
+    ui->mygl->recordInputs(path);
+}
+
+bool MainWindow::replayInputs(const QString &path, const QString &csvPath)
+{
+    return ui->mygl->replayInputs(path, csvPath);
+}
+
 void MainWindow::on_actionQuit_triggered()
 {
     QApplication::exit();
@@ -19,6 +19,10 @@ public:
     explicit MainWindow(QWidget *parent = 0);
     ~MainWindow();
 
+    // see MyGL::recordInputs & MyGL::replayInputs, call before show()
+    void recordInputs(const QString &path);
+    bool replayInputs(const QString &path, const QString &csvPath);
+
 private slots:
     void on_actionQuit_triggered();
 
@@ -0,0 +1,279 @@
+#include "metrics.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+
+
+// the shard of the calling thread, threads take the shards in turn
+static int threadShard()
+{
+    static std::atomic<int> nextShard(0);
+    static thread_local int shard = nextShard.fetch_add(1, std::memory_order_relaxed) % Counter::SHARDS;
+    return shard;
+}
+
+
+Counter::Counter()
+    : m_shards()
+{
+    for (Shard &shard : m_shards) {
+        shard.value = 0;
+    }
+}
+
+void Counter::add(long long n)
+{
+    m_shards[threadShard()].value.fetch_add(n, std::memory_order_relaxed);
+}
+
+long long Counter::value() const
+{
+    long long sum = 0;
+    for (const Shard &shard : m_shards) {
+        sum += shard.value.load(std::memory_order_relaxed);
+    }
+    return sum;
+}
+
+
+Gauge::Gauge()
+    : m_value(0)
+{}
+
+void Gauge::set(long long v)
+{
+    m_value.store(v, std::memory_order_relaxed);
+}
+
+long long Gauge::value() const
+{
+    return m_value.load(std::memory_order_relaxed);
+}
+
+
+Histogram::Histogram()
+    : m_buckets(), m_count(0), m_sum(0), m_max(0)
+{
+    for (std::atomic<unsigned int> &bucket : m_buckets) {
+        bucket = 0;
+    }
+}
+
+/**
+ * @brief Histogram::bucketOf
+ *  e.g. 0 - 7 -> 0 - 7, 8 -> 8, 15 -> 15, 16 - 17 -> 16, 30 - 31 -> 23
+ * @param v
+ * @return
+ */
+int Histogram::bucketOf(long long v)
+{
+    if (v < SUB_BUCKETS) {
+        return static_cast<int>(std::max(v, 0LL));
+    }
+    // the highest set bit & the SUB_BITS bits below it
+    int exponent = 63 - __builtin_clzll(static_cast<unsigned long long>(v));
+    int mantissa = static_cast<int>((v >> (exponent - SUB_BITS)) & (SUB_BUCKETS - 1));
+    return (exponent - SUB_BITS + 1) * SUB_BUCKETS + mantissa;
+}
+
+long long Histogram::bucketLowerBound(int bucket)
+{
+    if (bucket < SUB_BUCKETS) {
+        return bucket;
+    }
+    int exponent = bucket / SUB_BUCKETS + SUB_BITS - 1;
+    long long mantissa = bucket % SUB_BUCKETS;
+    return (SUB_BUCKETS + mantissa) << (exponent - SUB_BITS);
+}
+
+void Histogram::record(long long v)
+{
+    m_buckets[bucketOf(v)].fetch_add(1, std::memory_order_relaxed);
+    m_count.fetch_add(1, std::memory_order_relaxed);
+    m_sum.fetch_add(v, std::memory_order_relaxed);
+
+    long long prevMax = m_max.load(std::memory_order_relaxed);
+    while (v > prevMax && !m_max.compare_exchange_weak(prevMax, v, std::memory_order_relaxed)) {}
+}
+
+long long Histogram::count() const
+{
+    return m_count.load(std::memory_order_relaxed);
+}
+
+double Histogram::mean() const
+{
+    long long n = count();
+    return n > 0 ? static_cast<double>(m_sum.load(std::memory_order_relaxed)) / n : 0.0;
+}
+
+long long Histogram::max() const
+{
+    return m_max.load(std::memory_order_relaxed);
+}
+
+long long Histogram::percentile(double p) const
+{
+    // the buckets may move on meanwhile, sum them instead of using m_count
+    std::array<unsigned int, BUCKETS> counts;
+    long long total = 0;
+    for (int i = 0; i < BUCKETS; i++) {
+        counts[i] = m_buckets[i].load(std::memory_order_relaxed);
+        total += counts[i];
+    }
+    if (total == 0) {
+        return 0;
+    }
+
+    long long rank = static_cast<long long>(p * (total - 1));
+    long long seen = 0;
+    for (int i = 0; i < BUCKETS; i++) {
+        seen += counts[i];
+        if (seen > rank) {
+            return bucketLowerBound(i);
+        }
+    }
+    return bucketLowerBound(BUCKETS - 1);
+}
+
+
+MetricsRegistry::MetricsRegistry()
+    : m_lock(), m_counters(), m_gauges(), m_histograms(), m_exportFile(), m_export()
+{}
+
+MetricsRegistry& MetricsRegistry::global()
+{
+    static MetricsRegistry registry;
+    return registry;
+}
+
+long long MetricsRegistry::now()
+{
+    static const std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - epoch).count();
+}
+
+Counter& MetricsRegistry::counter(const std::string &name)
+{
+    QMutexLocker locker(&m_lock);
+    std::unique_ptr<Counter> &metric = m_counters[name];
+    if (metric == nullptr) {
+        metric.reset(new Counter());
+    }
+    return *metric;
+}
+
+Gauge& MetricsRegistry::gauge(const std::string &name)
+{
+    QMutexLocker locker(&m_lock);
+    std::unique_ptr<Gauge> &metric = m_gauges[name];
+    if (metric == nullptr) {
+        metric.reset(new Gauge());
+    }
+    return *metric;
+}
+
+Histogram& MetricsRegistry::histogram(const std::string &name)
+{
+    QMutexLocker locker(&m_lock);
+    std::unique_ptr<Histogram> &metric = m_histograms[name];
+    if (metric == nullptr) {
+        metric.reset(new Histogram());
+    }
+    return *metric;
+}
+
+/**
+ * @brief MetricsRegistry::getReport
+ *  e.g. "terrain.chunks_meshed 1024", "npc.tick_us n 5000  p50 12  p99 40  max 95"
+ * @return
+ */
+std::vector<std::string> MetricsRegistry::getReport() const
+{
+    QMutexLocker locker(&m_lock);
+    std::vector<std::string> lines;
+    char line[160];
+    for (const auto &p : m_counters) {
+        std::snprintf(line, sizeof(line), "%s %lld", p.first.c_str(), p.second->value());
+        lines.push_back(line);
+    }
+    for (const auto &p : m_gauges) {
+        std::snprintf(line, sizeof(line), "%s %lld", p.first.c_str(), p.second->value());
+        lines.push_back(line);
+    }
+    for (const auto &p : m_histograms) {
+        const Histogram &h = *p.second;
+        std::snprintf(line, sizeof(line), "%s n %lld  p50 %lld  p99 %lld  max %lld", p.first.c_str(),
+                      h.count(), h.percentile(0.5), h.percentile(0.99), h.max());
+        lines.push_back(line);
+    }
+    return lines;
+}
+
+bool MetricsRegistry::startExport(const QString &path)
+{
+    stopExport();
+    QMutexLocker locker(&m_lock);
+    m_exportFile.setFileName(path);
+    if (!m_exportFile.open(QIODevice::WriteOnly | QIODevice::Text)) {
+        return false;
+    }
+    m_export.setDevice(&m_exportFile);
+    return true;
+}
+
+void MetricsRegistry::stopExport()
+{
+    QMutexLocker locker(&m_lock);
+    if (!m_exportFile.isOpen()) {
+        return;
+    }
+    m_export.flush();
+    m_export.setDevice(nullptr);
+    m_exportFile.close();
+}
+
+bool MetricsRegistry::isExporting() const
+{
+    QMutexLocker locker(&m_lock);
+    return m_exportFile.isOpen();
+}
+
+/**
+ * @brief MetricsRegistry::exportLine
+ *  One JSON object on one line:
+ *  {"t_us":..,"counters":{..},"gauges":{..},"histograms":{"name":{"count":..,"mean":..,"p50":..,"p90":..,"p99":..,"max":..}}}
+ *  The counters & histograms are totals since the start.
+ */
+void MetricsRegistry::exportLine()
+{
+    QMutexLocker locker(&m_lock);
+    if (!m_exportFile.isOpen()) {
+        return;
+    }
+
+    m_export << "{\"t_us\":" << now() << ",\"counters\":{";
+    bool first = true;
+    for (const auto &p : m_counters) {
+        m_export << (first ? "" : ",") << "\"" << QString::fromStdString(p.first) << "\":" << p.second->value();
+        first = false;
+    }
+    m_export << "},\"gauges\":{";
+    first = true;
+    for (const auto &p : m_gauges) {
+        m_export << (first ? "" : ",") << "\"" << QString::fromStdString(p.first) << "\":" << p.second->value();
+        first = false;
+    }
+    m_export << "},\"histograms\":{";
+    first = true;
+    for (const auto &p : m_histograms) {
+        const Histogram &h = *p.second;
+        m_export << (first ? "" : ",") << "\"" << QString::fromStdString(p.first) << "\":{"
+                 << "\"count\":" << h.count() << ",\"mean\":" << h.mean()
+                 << ",\"p50\":" << h.percentile(0.5) << ",\"p90\":" << h.percentile(0.9)
+                 << ",\"p99\":" << h.percentile(0.99) << ",\"max\":" << h.max() << "}";
+        first = false;
+    }
+    m_export << "}}\n";
+    m_export.flush();
+}
@@ -0,0 +1,120 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#pragma once
+
+#include <QFile>
+#include <QMutex>
+#include <QTextStream>
+#include <array>
+#include <atomic>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+// A count that only goes up, e.g. chunks meshed.
+// Each thread adds into one of SHARDS cache lines, so workers counting
+// at the same time don't fight over one line; value() sums the shards.
+class Counter
+{
+public:
+    static const int SHARDS = 8;
+
+    Counter();
+
+    void add(long long n = 1);
+    long long value() const;
+
+private:
+    struct alignas(64) Shard
+    {
+        std::atomic<long long> value;
+    };
+    std::array<Shard, SHARDS> m_shards;
+};
+
+// A level that is set, e.g. the queue depth or the bytes of the chunk buffers
+class Gauge
+{
+public:
+    Gauge();
+
+    void set(long long v);
+    long long value() const;
+
+private:
+    std::atomic<long long> m_value;
+};
+
+// The distribution of non-negative values (e.g. µs) in log buckets, HDR-style:
+// values below SUB_BUCKETS are exact, every higher power of two is split
+// into SUB_BUCKETS linear buckets, so a bucket is at most 12.5% wide.
+// record() is two relaxed atomic adds (& a max update), from any thread.
+class Histogram
+{
+public:
+    static const int SUB_BITS = 3;
+    static const int SUB_BUCKETS = 1 << SUB_BITS;
+    static const int BUCKETS = (64 - SUB_BITS) * SUB_BUCKETS;
+
+    Histogram();
+
+    void record(long long v);
+
+    long long count() const;
+    double mean() const;
+    long long max() const;
+    // the lower bound of the bucket holding the p-th (0 - 1) value
+    long long percentile(double p) const;
+
+    static int bucketOf(long long v);
+    static long long bucketLowerBound(int bucket);
+
+private:
+    std::array<std::atomic<unsigned int>, BUCKETS> m_buckets;
+    std::atomic<long long> m_count;
+    std::atomic<long long> m_sum;
+    std::atomic<long long> m_max;
+};
+
+// The named metrics of the whole program, from any thread.
+// The metrics are created on first use & never removed, so callers keep
+// the reference, e.g.
+//     static Counter &meshed = MetricsRegistry::global().counter("terrain.chunks_meshed");
+// Names are "<subsystem>.<metric>[_unit]".
+class MetricsRegistry
+{
+public:
+    static MetricsRegistry& global();
+    // microseconds on a clock shared by all the threads
+    static long long now();
+
+    Counter& counter(const std::string &name);
+    Gauge& gauge(const std::string &name);
+    Histogram& histogram(const std::string &name);
+
+    // one line per metric, for PlayerInfo
+    std::vector<std::string> getReport() const;
+
+    // append one JSON object per exportLine() to path
+    bool startExport(const QString &path);
+    void stopExport();
+    bool isExporting() const;
+    void exportLine();
+
+private:
+    MetricsRegistry();
+
+    // guards the maps (not the metrics, which are atomic) & the export file
+    mutable QMutex m_lock;
+    std::map<std::string, std::unique_ptr<Counter>> m_counters;
+    std::map<std::string, std::unique_ptr<Gauge>> m_gauges;
+    std::map<std::string, std::unique_ptr<Histogram>> m_histograms;
+
+    QFile m_exportFile;
+    QTextStream m_export;
+};
+
+
+#endif // METRICS_H
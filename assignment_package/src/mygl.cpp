@@ -3,11 +3,15 @@
 
 #include "scene/npcs/zombiedragon.h"
 #include "scene/npcs/lama.h"
+#include "tracer.h"
+#include "metrics.h"
+#include "scene/seededrandom.h"
 #include <glm_includes.h>
 #include <iostream>
 #include <QApplication>
 #include <QKeyEvent>
 #include <QDateTime>
+#include <QElapsedTimer>
 #include <QFile>
 #include <QSoundEffect>
 #include <algorithm>
@@ -21,13 +25,23 @@ MyGL::MyGL(QWidget *parent)
     : OpenGLContext(parent),
       m_worldAxes(this),
       m_progLambert(this), m_progFlat(this),
-      m_progUnderwater(this), m_progLava(this), m_progNoOp(this), m_progInventoryWidgetOnHand(this), m_progInventoryItemOnHand(this), m_progInventoryWidgetInContainer(this),
-      m_progInventoryItemInContainer(this), m_progGrabbedItem(this), m_progText(this),
-      m_quad(this), m_progNPC(this), m_frameBuffer(this, this->width(), this->height(), this->devicePixelRatio()),
+      m_progUnderwater(this), m_progLava(this), m_progNoOp(this), m_progHUD(this),
+      m_quad(this), m_hud(this), hudContainerWidgetLayer(-1), hudContainerItemsLayer(-1), hudGrabbedItemLayer(-1),
+      m_progNPC(this), m_frameBuffer(this, this->width(), this->height(), this->devicePixelRatio()),
+      m_progDepth(this), m_occlusion(this),
       m_terrain(this), m_player(glm::vec3(48.f, 200.f, 48.f), m_terrain),
-      m_player_model(this, glm::vec3(60.f, 145.f, 35.f), m_terrain, m_player, STEVE), frameCount(0),
-      prevFrameTime(QDateTime::currentMSecsSinceEpoch()), mouseCursorMode(false), textureAll(this), inventoryWidgetOnHandTexture(this), inventoryWidgetInContainerTexture(this),
-      textureFont(this), prevExpandTime(QDateTime::currentMSecsSinceEpoch())
+      m_player_model(this, glm::vec3(60.f, 145.f, 35.f), m_terrain, m_player, STEVE),
+      m_npcs(), m_herd(m_terrain), m_herdModels(), m_simulation(nullptr), frameCount(0),
+      avgFrameTime(0.f), drawnChunks(0), culledChunks(0), sectionsInFrustum(0), occludedSections(0), unreachableSections(0), overdrawQuery(0), overdrawQueryPending(false), overdraw(0.f),
+      terrainSubmitTime(0.f), avgTerrainSubmitTime(0.f), terrainDrawCalls(0), lastFrameGLCalls(),
+      m_profiler(this), profOpaqueTerrain(-1), profOcclusion(-1), profTransparentTerrain(-1), profPlayerModel(-1),
+      profNPCs(-1), profPostProcess(-1), profHUD(-1), profExpand(-1), profThreadResults(-1),
+      profilerText(nullptr), hudProfilerLayer(-1), showProfiler(false), profilerReport(),
+      mouseCursorMode(false), textureAll(this), inventoryWidgetOnHandTexture(this), inventoryWidgetInContainerTexture(this),
+      textureFont(this), m_noiseTexture(this), bakedNoise(true), prevExpandTime(QDateTime::currentMSecsSinceEpoch()),
+      prevMetricsTime(QDateTime::currentMSecsSinceEpoch()),
+      m_playerCommands(), m_recorder(), recordPath(), m_replay(), replaying(false),
+      replayCSV(), replayOut(), replaySimTimes(), replayFrameTimes(), replayStep(0), lastFrameTime(0.f)
 {
 
     // Connect the timer to a function so that when the timer ticks the function is executed
@@ -36,6 +50,23 @@ MyGL::MyGL(QWidget *parent)
     m_timer.start(16);
     setFocusPolicy(Qt::ClickFocus);
     m_inputs = InputBundle();
+
+    // the passes of paintGL are timed on the GPU too, they run one after another
+    profOpaqueTerrain = m_profiler.addScope("opaque terrain", true);
+    profOcclusion = m_profiler.addScope("occlusion", true);
+    profTransparentTerrain = m_profiler.addScope("transp. terrain", true);
+    profPlayerModel = m_profiler.addScope("player model", true);
+    profNPCs = m_profiler.addScope("NPCs", true);
+    profPostProcess = m_profiler.addScope("post-process", true);
+    profHUD = m_profiler.addScope("HUD", true);
+    profExpand = m_profiler.addScope("tick: expand", false);
+    profThreadResults = m_profiler.addScope("tick: VBO upload", false);
+
+    // MC_TRACE=1 traces from the launch, to see the initial terrain load
+    Tracer::setThreadName("GUI");
+    if (qEnvironmentVariableIsSet("MC_TRACE")) {
+        Tracer::start();
+    }
     setMouseTracking(true); // MyGL will track the mouse's movements even if a mouse button is not pressed
 //    setCursor(Qt::BlankCursor); // Make the cursor invisible
     setCursor(Qt::CrossCursor);
@@ -72,17 +103,30 @@ MyGL::MyGL(QWidget *parent)
 
     initWidget();
     initText();
+    initHUD();
 
 }
 
 MyGL::~MyGL() {
+    // stop the simulation before the world it ticks is destroyed
+    if (m_simulation != nullptr) {
+        m_simulation->stop();
+    }
+    m_recorder.close();
+    if (Tracer::isEnabled()) {
+        Tracer::stop();
+        Tracer::writeJSON("trace.json");
+    }
     makeCurrent();
     glDeleteVertexArrays(1, &vao);
     m_quad.destroyVBOdata();
-    inventoryWidgetOnHand->destroyVBOdata();
-    inventoryItemsOnHand->destroyVBOdata();
-    textOnScreen->destroyVBOdata();
+    m_hud.destroyVBOdata();
+    m_profiler.destroy();
+    MetricsRegistry::global().stopExport();
     m_frameBuffer.destroy();
+    m_occlusion.destroy();
+    m_noiseTexture.destroy();
+    glDeleteQueries(1, &overdrawQuery);
     m_worldAxes.destroyVBOdata();
 }
 
@@ -96,6 +140,7 @@ void MyGL::initializeGL()
     // Create an OpenGL context using Qt's QOpenGLFunctions_3_2_Core class
     // If you were programming in a non-Qt context you might use GLEW (GL Extension Wrangler)instead
     initializeOpenGLFunctions();
+    resolveDrawFunctions();
     // Print out some information about the current OpenGL context
     debugContextVersion();
 
@@ -122,6 +167,10 @@ void MyGL::initializeGL()
 
     // Initiailize frame buffer
     m_frameBuffer.create();
+    m_occlusion.resize(this->width() * this->devicePixelRatio(), this->height() * this->devicePixelRatio());
+    m_occlusion.create();
+    // counts the fragments written by the opaque terrain
+    glGenQueries(1, &overdrawQuery);
 
     // Create and set up the diffuse shader
     m_progLambert.create(":/glsl/lambert.vert.glsl", ":/glsl/lambert.frag.glsl");
@@ -132,16 +181,18 @@ void MyGL::initializeGL()
     m_progUnderwater.create(":/glsl/post/overlay.vert.glsl", ":/glsl/post/underwater.frag.glsl");
     m_progLava.create(":/glsl/post/overlay.vert.glsl", ":/glsl/post/lava.frag.glsl");
     m_progNoOp.create(":/glsl/post/overlay.vert.glsl", ":/glsl/post/overlay.frag.glsl");
-    m_progInventoryWidgetOnHand.create(":/glsl/post/texture.vert.glsl", ":/glsl/post/texture.frag.glsl");
-    m_progInventoryItemOnHand.create(":/glsl/post/texture.vert.glsl", ":/glsl/post/texture.frag.glsl");
-    m_progInventoryWidgetInContainer.create(":/glsl/post/texture.vert.glsl", ":/glsl/post/texture.frag.glsl");
-    m_progInventoryItemInContainer.create(":/glsl/post/texture.vert.glsl", ":/glsl/post/texture.frag.glsl");
-    m_progGrabbedItem.create(":/glsl/post/texture.vert.glsl", ":/glsl/post/texture.frag.glsl");
-    m_progText.create(":/glsl/post/texture.vert.glsl", ":/glsl/post/texture.frag.glsl");
+    m_progHUD.create(":/glsl/post/texture.vert.glsl", ":/glsl/post/texture.frag.glsl");
+    // the occluder depth pre-pass
+    m_progDepth.create(":/glsl/depth.vert.glsl", ":/glsl/depth.frag.glsl");
 
 
     m_progNPC.create(":/glsl/lambert.vert.glsl", ":/glsl/npc.frag.glsl");
 
+    // the noise is computed per fragment until the baked texture is uploaded
+    m_progLambert.setNoiseTexture(NOISE_TEXTURE_SLOT);
+    m_progUnderwater.setNoiseTexture(NOISE_TEXTURE_SLOT);
+    m_noiseTexture.startBaking();
+
     m_quad.createVBOdata();
 
     createNPCTextures();
@@ -156,6 +207,12 @@ void MyGL::initializeGL()
         npc->createVBOdata();
         npc->initSceneGraph();
     }
+    for (const uPtr<NPC> &model : m_herdModels)
+    {
+        model->createVBOdata();
+        model->initSceneGraph();
+    }
+    setupHerd();
 
     ////////////////////////////////////////////////////////////////////////////////////
     /// loading texture map from png
@@ -182,6 +239,7 @@ void MyGL::initializeGL()
     // text on the screen (slot = 3)
     createTexture(textureFont, ":/textures/ascii.png", 3);
     textOnScreen->loadUVCoordFromText(":/textures/text_info.txt");
+    profilerText->loadUVCoordFromText(":/textures/text_info.txt");
 
     ////////////////////////////////////////////////////////////////////////////////////
 
@@ -198,13 +256,41 @@ void MyGL::initializeGL()
 
     // m_terrain.CreateTestScene();
     // m_terrain.CreateTestGrassScene();
+
+    // start the simulation thread (the NPC scene graphs must exist by now)
+    m_simulation = mkU<Simulation>(m_terrain, m_player, m_player_model, m_npcs, m_herd,
+                                   &m_inputs, &m_playerCommands, &m_inputsLock, &m_worldLock, &m_profiler);
+    if (replaying) {
+        // replayTick runs the steps on this thread
+        m_simulation->setSeed(m_replay.getHeader().seed);
+        SeededRandom::seed(m_simulation->getSeed());
+        m_timer.start(0);
+        return;
+    }
+    if (!recordPath.isEmpty()) {
+        InputLogHeader header;
+        header.seed = m_simulation->getSeed();
+        header.width = width();
+        header.height = height();
+        header.timeStep = m_simulation->getTimeStep();
+        if (m_recorder.open(recordPath, header)) {
+            m_simulation->setRecorder(&m_recorder);
+        } else {
+            std::cout << "could not open " << recordPath.toStdString() << std::endl;
+        }
+    }
+    m_simulation->start();
 }
 
 void MyGL::resizeGL(int w, int h) {
     //This code sets the concatenated view and perspective projection matrices used for
     //our scene's camera view.
+    m_worldLock.lock();
     m_player.setCameraWidthHeight(static_cast<unsigned int>(w), static_cast<unsigned int>(h));
     glm::mat4 viewproj = m_player.getCameraViewProj();
+    // the text width depends on the aspect ratio
+    m_player.invalidateHUD();
+    m_worldLock.unlock();
 
     // Upload the view-projection matrix to our shaders (i.e. onto the graphics card)
 
@@ -220,62 +306,217 @@ void MyGL::resizeGL(int w, int h) {
     m_progNoOp.setDimensions(glm::ivec2(w * this->devicePixelRatio(), h * this->devicePixelRatio()));
     m_progUnderwater.setDimensions(glm::ivec2(w * this->devicePixelRatio(), h * this->devicePixelRatio()));
     m_progLava.setDimensions(glm::ivec2(w * this->devicePixelRatio(), h * this->devicePixelRatio()));
-    m_progInventoryWidgetOnHand.setDimensions(glm::ivec2(w * this->devicePixelRatio(), h * this->devicePixelRatio()));
 
     m_frameBuffer.resize(this->width(), this->height(), this->devicePixelRatio());
     m_frameBuffer.destroy();
     m_frameBuffer.create();
+    m_occlusion.resize(w * this->devicePixelRatio(), h * this->devicePixelRatio());
 
     textOnScreen->resizeDimension(this->width(), this->height());
+    profilerText->resizeDimension(this->width(), this->height());
 
     printGLErrorLog();
 }
 
 
 // MyGL's constructor links tick() to a timer that fires 60 times per second.
-// We're treating MyGL as our game engine class, so we're going to perform
-// all per-frame actions here, such as performing physics updates on all
-// entities in the scene.
+// The player / NPC physics run on the simulation thread (see Simulation),
+// so only the GUI-side work is done here: terrain expansion,
+// sending the finished chunk VBOs to the gpu, and the info window.
 void MyGL::tick() {
+    if (replaying) {
+        replayTick();
+        return;
+    }
+    TraceSpan span("tick", "GUI");
     update(); // Calls paintGL() as part of a larger QOpenGLWidget pipeline
-    sendPlayerDataToGUI(); // Updates the info in the secondary window displaying player data
 
-    // call terrain expansion
-    // TODO: use 5 x 5 zones
-    if (!m_terrain.m_initialTerrainLoaded) {
-        m_terrain.loadInitialTerrain(m_player.mcr_position[0], m_player.mcr_position[2], 2);
-        prevExpandTime = QDateTime::currentMSecsSinceEpoch();
+    // Expanding the terrain changes the chunk map, which the simulation reads.
+    // If the simulation is in the middle of a step, try again next tick.
+    if (m_worldLock.tryLock()) {
+        sendPlayerDataToGUI(); // Updates the info in the secondary window displaying player data
+
+        // call terrain expansion
+        // TODO: use 5 x 5 zones
+        if (!m_terrain.m_initialTerrainLoaded) {
+            ProfileScope scope(&m_profiler, profExpand);
+            m_terrain.loadInitialTerrain(m_player.mcr_position[0], m_player.mcr_position[2], 2);
+            prevExpandTime = QDateTime::currentMSecsSinceEpoch();
+        }
+        else if ((QDateTime::currentMSecsSinceEpoch() - prevExpandTime) >= 100)
+        {
+            ProfileScope scope(&m_profiler, profExpand);
+            m_terrain.expand(m_player.mcr_position[0], m_player.mcr_position[2], 2);
+            prevExpandTime = QDateTime::currentMSecsSinceEpoch();
+        }
+        // the workers mesh copies of the blocks, taken while the simulation waits
+        m_terrain.spawnPendingVBOWorkers();
+        m_worldLock.unlock();
     }
-    else if ((QDateTime::currentMSecsSinceEpoch() - prevExpandTime) >= 100)
+    // check & (draw) send to gpu
     {
-        m_terrain.expand(m_player.mcr_position[0], m_player.mcr_position[2], 2);
-        prevExpandTime = QDateTime::currentMSecsSinceEpoch();
+        ProfileScope scope(&m_profiler, profThreadResults);
+        m_terrain.checkThreadResults();
+    }
+
+    if (m_simulation != nullptr) {
+        emit sig_sendSimTickTime(QString::number(m_simulation->getAverageTickTime(), 'f', 2) + " ms");
+    }
+    emit sig_sendFrameTime(QString::number(avgFrameTime, 'f', 2) + " ms"
+                           + (!bakedNoise ? " (fbm noise)" : m_noiseTexture.isReady() ? " (baked noise)" : " (baking noise)"));
+    emit sig_sendChunkCullStats(QString::number(drawnChunks) + " drawn / " + QString::number(culledChunks) + " culled");
+    emit sig_sendTerrainSubmitTime(QString::number(avgTerrainSubmitTime, 'f', 3) + " ms, "
+                                   + QString::number(terrainDrawCalls) + " draw calls"
+                                   + (m_terrain.isMultiDraw() ? " (multi-draw)" : " (per chunk)"));
+    // sent / requested
+    const GLCallCounter &glCalls = lastFrameGLCalls;
+    emit sig_sendGLCallStats(QString::number(glCalls.drawCalls) + " draws, state "
+                             + QString::number(glCalls.stateCalls) + "/"
+                             + QString::number(glCalls.stateCalls + glCalls.skippedStateCalls) + ", unif "
+                             + QString::number(glCalls.uniformUploads) + "/"
+                             + QString::number(glCalls.uniformUploads + glCalls.skippedUniformUploads));
+    emit sig_sendBufferStats(QString::number(getLiveBufferCount()) + " live ("
+                             + QString::number(m_terrain.getPooledBufferCount()) + " pooled)");
+    if (m_occlusion.isEnabled()) {
+        int percent = sectionsInFrustum > 0 ? (100 * occludedSections) / sectionsInFrustum : 0;
+        emit sig_sendOcclusionStats(QString::number(percent) + "% of " + QString::number(sectionsInFrustum)
+                                    + " sections skipped");
+    } else {
+        emit sig_sendOcclusionStats("off (" + QString::number(sectionsInFrustum) + " sections)");
+    }
+    emit sig_sendOverdrawStats(QString::number(overdraw, 'f', 2) + " fragments / pixel"
+                               + (m_terrain.isChunkSorting() ? " (front-to-back)" : " (unsorted)"));
+    if (m_terrain.isCaveCulling()) {
+        emit sig_sendCaveCullStats(QString::number(unreachableSections) + " of " + QString::number(sectionsInFrustum)
+                                   + " sections unreachable");
+    } else {
+        emit sig_sendCaveCullStats("off");
     }
-    // check & (draw) send to gpu
-    m_terrain.checkThreadResults();
 
-    // compute the delta-time
-    long long currFrameTime = QDateTime::currentMSecsSinceEpoch();
-    float deltaTime = (currFrameTime - prevFrameTime) / 1000.f;
+    if ((QDateTime::currentMSecsSinceEpoch() - prevMetricsTime) >= 1000) {
+        MetricsRegistry &metrics = MetricsRegistry::global();
+        QString report;
+        for (const std::string &line : metrics.getReport()) {
+            report += QString::fromStdString(line) + "\n";
+        }
+        emit sig_sendMetrics(report);
+        metrics.exportLine();
+        prevMetricsTime = QDateTime::currentMSecsSinceEpoch();
+    }
+}
 
-    prevFrameTime = currFrameTime;
+void MyGL::recordInputs(const QString &path)
+{
+    recordPath = path;
+}
 
-    drawGrabbedItem();
+bool MyGL::replayInputs(const QString &path, const QString &csvPath)
+{
+    if (!m_replay.open(path)) {
+        return false;
+    }
+    replaying = true;
 
-    // pass delta-time to Player::tick
-    m_player.tick(deltaTime, m_inputs);
-    // steve model
-    m_player_model.tick(deltaTime, m_inputs);
+    // render as many pixels as the recorded session
+    const InputLogHeader &header = m_replay.getHeader();
+    if (header.width > 0 && header.height > 0) {
+        setFixedSize(header.width, header.height);
+    }
 
-    // TODO: pass delta-time to NPC's tick as well
-    if (frameCount > 15.f * 60.f)
-    {
-        for (const uPtr<NPC> &npc : m_npcs)
-        {
-            npc->tick(deltaTime);
+    if (!csvPath.isEmpty()) {
+        replayCSV.setFileName(csvPath);
+        if (replayCSV.open(QIODevice::WriteOnly | QIODevice::Text)) {
+            replayOut.setDevice(&replayCSV);
+            replayOut << "step,sim ms,frame ms,checksum\n";
+        } else {
+            std::cout << "could not open " << csvPath.toStdString() << std::endl;
         }
     }
+    return true;
+}
+
+/**
+ * @brief MyGL::replayTick
+ *  One step of a replay. The terrain is expanded on a step count instead of
+ *  the clock, and its workers are waited for, so every run of the log
+ *  simulates the same world; then the step is run & its frame rendered.
+ */
+void MyGL::replayTick()
+{
+    InputFrame frame;
+    if (!m_replay.next(frame)) {
+        finishReplay();
+        return;
+    }
+
+    // every 100 ms of simulated time, as in a live session
+    int expandSteps = std::max(1, static_cast<int>(0.1f / frame.dT + 0.5f));
+    if (!m_terrain.m_initialTerrainLoaded) {
+        m_terrain.loadInitialTerrain(m_player.mcr_position[0], m_player.mcr_position[2], 2);
+    } else if (replayStep % expandSteps == 0) {
+        m_terrain.expand(m_player.mcr_position[0], m_player.mcr_position[2], 2);
+    }
+    m_terrain.finishPendingWork();
 
+    QElapsedTimer simTimer;
+    simTimer.start();
+    m_simulation->stepWith(frame);
+    float simTime = simTimer.nsecsElapsed() / 1e6f;
+
+    // paintGL now, it sets lastFrameTime
+    repaint();
+
+    replaySimTimes.push_back(simTime);
+    replayFrameTimes.push_back(lastFrameTime);
+    if (replayCSV.isOpen()) {
+        replayOut << replayStep << "," << simTime << "," << lastFrameTime << ","
+                  << QString::number(m_simulation->getChecksum(), 16) << "\n";
+    }
+    replayStep++;
+}
+
+// the p-th (0 - 1) of values, 0 if empty
+static float percentileOf(std::vector<float> values, float p)
+{
+    if (values.empty()) {
+        return 0.f;
+    }
+    unsigned int k = static_cast<unsigned int>(p * (values.size() - 1));
+    std::nth_element(values.begin(), values.begin() + k, values.end());
+    return values[k];
+}
+
+/**
+ * @brief MyGL::finishReplay
+ *  Print the summary of the replay & quit, e.g.
+ *      sim step ms: p50 0.41 p90 0.62 p99 1.30 max 2.05
+ *  Two builds simulated the same if their checksums are equal.
+ */
+void MyGL::finishReplay()
+{
+    m_timer.stop();
+    replaying = false;
+
+    std::cout << "replay: " << replayStep << " steps" << std::endl;
+    const std::vector<float> *times[2] = {&replaySimTimes, &replayFrameTimes};
+    const char *names[2] = {"sim step ms:", "frame ms:   "};
+    for (int i = 0; i < 2; i++) {
+        std::cout << names[i]
+                  << " p50 " << percentileOf(*times[i], 0.5f)
+                  << " p90 " << percentileOf(*times[i], 0.9f)
+                  << " p99 " << percentileOf(*times[i], 0.99f)
+                  << " max " << percentileOf(*times[i], 1.f) << std::endl;
+    }
+    std::cout << std::hex << "checksum: world " << m_simulation->getChecksum()
+              << " blocks " << m_terrain.getBlocksChecksum() << std::dec << std::endl;
+
+    if (replayCSV.isOpen()) {
+        replayOut.flush();
+        replayOut.setDevice(nullptr);
+        replayCSV.close();
+    }
+    QThreadPool::globalInstance()->waitForDone(-1);
+    QApplication::quit();
 }
 
 void MyGL::sendPlayerDataToGUI() const {
@@ -297,31 +538,31 @@ void MyGL::stopWalkingSounds(){
 
 }
 
-void MyGL::playWalkingSounds(){
-    if(m_player.blockTouchingPlayer == GRASS){
+void MyGL::playWalkingSounds(const WorldSnapshot &snapshot){
+    if(snapshot.blockTouchingPlayer == GRASS){
         if(rockWalkingEffect.isPlaying()) rockWalkingEffect.stop();
         if(glassWalkingEffect.isPlaying()) glassWalkingEffect.stop();
-        if(m_player.isWalking()){
+        if(snapshot.playerWalking){
             if(!grassWalkingEffect.isPlaying()) grassWalkingEffect.play();
         }
         else {
             grassWalkingEffect.stop();
         }
     }
-    else if(m_player.blockTouchingPlayer == STONE || m_player.blockTouchingPlayer == DIRT){
+    else if(snapshot.blockTouchingPlayer == STONE || snapshot.blockTouchingPlayer == DIRT){
         if(glassWalkingEffect.isPlaying()) glassWalkingEffect.stop();
         if(grassWalkingEffect.isPlaying()) grassWalkingEffect.stop();
-        if(m_player.isWalking()){
+        if(snapshot.playerWalking){
             if(!rockWalkingEffect.isPlaying()) rockWalkingEffect.play();
         }
         else {
             rockWalkingEffect.stop();
         }
     }
-    else if(m_player.blockTouchingPlayer == DIAMOND){
+    else if(snapshot.blockTouchingPlayer == DIAMOND){
         if(grassWalkingEffect.isPlaying()) grassWalkingEffect.stop();
         if(rockWalkingEffect.isPlaying()) rockWalkingEffect.stop();
-        if(m_player.isWalking()){
+        if(snapshot.playerWalking){
             if(!glassWalkingEffect.isPlaying()) glassWalkingEffect.play();
         }
         else {
@@ -336,7 +577,18 @@ void MyGL::playWalkingSounds(){
 // This function is called whenever update() is called.
 // MyGL's constructor links update() to a timer that fires 60 times per second,
 // so paintGL() called at a rate of 60 frames per second.
+// Everything in the world is drawn from the (interpolated) simulation snapshot.
 void MyGL::paintGL() {
+    TraceSpan span("paintGL", "GUI");
+    QElapsedTimer frameTimer;
+    frameTimer.start();
+
+    // Qt may have touched the GL state since the last frame
+    invalidateGLStateCache();
+    resetGLCallCounter();
+    m_profiler.beginFrame();
+
+    WorldSnapshot snapshot = m_simulation->getInterpolatedSnapshot();
 
     // Clear the screen so that we only see newly drawn images
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
@@ -346,21 +598,74 @@ void MyGL::paintGL() {
     glViewport(0,0,this->width() * this->devicePixelRatio(), this->height() * this->devicePixelRatio());
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-    m_progFlat.setViewProjMatrix(m_player.getCameraViewProj());
-    m_progLambert.setViewProjMatrix(m_player.getCameraViewProj());
-    m_progNPC.setViewProjMatrix(m_player.getCameraViewProj());
+    m_progFlat.setViewProjMatrix(snapshot.viewProj);
+    m_progLambert.setViewProjMatrix(snapshot.viewProj);
+    m_progNPC.setViewProjMatrix(snapshot.viewProj);
 
     m_progLambert.setTime(frameCount);
     m_progLava.setTime(frameCount);
     m_progUnderwater.setTime(frameCount);
     m_progNPC.setTime(frameCount);
 
-    renderTerrain(TerrainDrawType::opaque);
+    bool useBakedNoise = bakedNoise && m_noiseTexture.upload(NOISE_TEXTURE_SLOT);
+    m_progLambert.setBakedNoise(useBakedNoise);
+    m_progUnderwater.setBakedNoise(useBakedNoise);
+
+    // skip the chunk sections outside the camera
+    Frustum frustum(snapshot.viewProj);
+    terrainSubmitTime = 0.f;
+    terrainDrawCalls = 0;
+
+    // the occlusion results of the queries issued last frame
+    if (m_occlusion.isEnabled()) {
+        m_occlusion.collectResults();
+    }
+
+    m_terrain.setViewPosition(snapshot.cameraPos);
+
+    // the fragments that pass the depth test per pixel, 1 would be no overdraw at all
+    // the result is read once the GPU has it, a new query starts after that
+    if (overdrawQueryPending) {
+        GLuint available = 0;
+        glGetQueryObjectuiv(overdrawQuery, GL_QUERY_RESULT_AVAILABLE, &available);
+        if (available) {
+            GLuint samples = 0;
+            glGetQueryObjectuiv(overdrawQuery, GL_QUERY_RESULT, &samples);
+            float pixels = this->width() * this->devicePixelRatio() * this->height() * this->devicePixelRatio();
+            overdraw = samples / std::max(pixels, 1.f);
+            overdrawQueryPending = false;
+        }
+    }
+    bool countFragments = !overdrawQueryPending;
+    if (countFragments) {
+        glBeginQuery(GL_SAMPLES_PASSED, overdrawQuery);
+    }
+    {
+        ProfileScope scope(&m_profiler, profOpaqueTerrain);
+        renderTerrain(TerrainDrawType::opaque, snapshot.playerPos, frustum);
+    }
+    if (countFragments) {
+        glEndQuery(GL_SAMPLES_PASSED);
+        overdrawQueryPending = true;
+    }
+    drawnChunks = m_terrain.getDrawnChunkCount();
+    culledChunks = m_terrain.getCulledChunkCount();
+    sectionsInFrustum = m_terrain.getSectionsInFrustumCount();
+    occludedSections = m_terrain.getOccludedSectionCount();
+    unreachableSections = m_terrain.getUnreachableSectionCount();
+
+    // test the sections against the terrain just drawn, the results are used next frame
+    if (m_occlusion.isEnabled()) {
+        ProfileScope scope(&m_profiler, profOcclusion);
+        m_occlusion.issueQueries(m_terrain, m_progDepth, snapshot.viewProj, snapshot.cameraPos);
+        m_frameBuffer.bindFrameBuffer();
+        glViewport(0,0,this->width() * this->devicePixelRatio(), this->height() * this->devicePixelRatio());
+    }
 
     glDisable(GL_DEPTH_TEST);
 
     m_progFlat.setModelMatrix(glm::mat4());
-    m_progFlat.setViewProjMatrix(m_player.getCameraViewProj());
+    m_progFlat.setViewProjMatrix(snapshot.viewProj);
 
     //m_progFlat.draw(m_worldAxes);
 
@@ -368,16 +673,22 @@ void MyGL::paintGL() {
 
     glEnable(GL_BLEND);
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-    renderTerrain(TerrainDrawType::transparent);
+    {
+        ProfileScope scope(&m_profiler, profTransparentTerrain);
+        renderTerrain(TerrainDrawType::transparent, snapshot.playerPos, frustum);
+    }
     // render steve
-    renderPlayerModel();
+    {
+        ProfileScope scope(&m_profiler, profPlayerModel);
+        renderPlayerModel(snapshot);
+    }
     // render NPCs
-    renderNPCs();
+    {
+        ProfileScope scope(&m_profiler, profNPCs);
+        renderNPCs(snapshot);
+    }
     glDisable(GL_BLEND);
 
-    // Draw Golden Tree (s)
-    m_terrain.drawErdtree(glm::ivec2(32, 48));
-
     glBindFramebuffer(GL_FRAMEBUFFER, this->defaultFramebufferObject());
     glViewport(0,0,this->width() * this->devicePixelRatio(), this->height() * this->devicePixelRatio());
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
@@ -385,13 +696,14 @@ void MyGL::paintGL() {
     m_frameBuffer.bindToTextureSlot(1);
 
     // Post-process Shaders
-    if(m_player.isUnderWater(m_terrain, m_inputs)){
+    m_profiler.beginScope(profPostProcess);
+    if(snapshot.playerUnderWater){
         stopWalkingSounds();
         if(!waterEffect.isPlaying()) waterEffect.play();
         m_progUnderwater.setTexture(m_frameBuffer.getTextureSlot());
         m_progUnderwater.drawOverlay(m_quad);
     }
-    else if(m_player.isUnderLava(m_terrain, m_inputs)){
+    else if(snapshot.playerUnderLava){
         stopWalkingSounds();
         if(!lavaEffect.isPlaying()) lavaEffect.play();
         m_progLava.setTexture(m_frameBuffer.getTextureSlot());
@@ -401,50 +713,50 @@ void MyGL::paintGL() {
         if(waterEffect.isPlaying()) waterEffect.stop();
         if(lavaEffect.isPlaying()) lavaEffect.stop();
 
-        playWalkingSounds();
+        playWalkingSounds(snapshot);
 
         m_progNoOp.setTexture(m_frameBuffer.getTextureSlot());
         m_progNoOp.drawOverlay(m_quad);
     }
+    m_profiler.endScope(profPostProcess);
 
     // draw the widget at last
     glDisable(GL_DEPTH_TEST);
-    // On hand
-    // widget and selected frame
-    renderTexture(inventoryWidgetOnHandTexture, m_progInventoryWidgetOnHand, 2, inventoryWidgetOnHand);
-    // blocks
-    renderTexture(textureAll, m_progInventoryItemOnHand, 0, inventoryItemsOnHand);
-    // In container
-    // TODO: draw the container widget and items in container if the player opens it
-    if (m_player.isOpenContainer()) {
-        renderTexture(inventoryWidgetInContainerTexture, m_progInventoryWidgetInContainer, 4, inventoryWidgetInContainer);
-        renderTexture(textureAll, m_progInventoryItemInContainer, 0, inventoryItemsInContainer);
-        if (m_player.isGrabbing()) {
-            renderTexture(textureAll, m_progGrabbedItem, 0, grabbedItem);
-        }
+    {
+        ProfileScope scope(&m_profiler, profHUD);
+        renderHUD();
     }
-
-    glEnable(GL_BLEND);
-    renderTexture(textureFont, m_progText, 3, textOnScreen.get());
-    glDisable(GL_BLEND);
-
     glEnable(GL_DEPTH_TEST);
 
+    m_profiler.endFrame();
 
     frameCount++;
+    if (replaying) {
+        // time the gpu work of the frame too
+        glFinish();
+    }
+    lastFrameTime = frameTimer.nsecsElapsed() / 1e6f;
+    avgFrameTime = 0.9f * avgFrameTime + 0.1f * lastFrameTime;
+    avgTerrainSubmitTime = 0.9f * avgTerrainSubmitTime + 0.1f * terrainSubmitTime;
+    lastFrameGLCalls = getGLCallCounter();
 }
 
 // TODO: Change this so it renders the nine zones of generated
 // terrain that surround the player (refer to Terrain::m_generatedTerrain
 // for more info)
-void MyGL::renderTerrain(TerrainDrawType drawType) {
+void MyGL::renderTerrain(TerrainDrawType drawType, glm::vec3 playerPos, const Frustum &frustum) {
 
     // bind the texture
     bindTexture(textureAll, m_progLambert, 0);
 
     // only draw the 3 x 3 chunks around the player
-    glm::vec3 pos = m_player.mcr_position;
-    m_terrain.draw(pos[0], pos[2], 2, &m_progLambert, drawType);
+    // Note: this only measures the CPU side, the GPU runs the draws asynchronously
+    QElapsedTimer submitTimer;
+    submitTimer.start();
+    m_terrain.draw(playerPos[0], playerPos[2], 2, &m_progLambert, drawType, &frustum,
+                   m_occlusion.isEnabled() ? &m_occlusion : nullptr);
+    terrainSubmitTime += submitTimer.nsecsElapsed() / 1e6f;
+    terrainDrawCalls += m_terrain.getDrawCallCount();
 }
 
 
@@ -460,19 +772,23 @@ void MyGL::keyPressEvent(QKeyEvent *e) {
     // chain of if statements instead
     // m_inputs = InputBundle();
 
+    // the player is ticked on the simulation thread,
+    // the inputs & commands are handed over to it (the world lock is only taken for the terrain toggles)
+    QMutexLocker inputsLocker(&m_inputsLock);
+
     if (e->key() == Qt::Key_Escape) {
         // clear the thread pool and join the running threads
         QThreadPool::globalInstance()->clear();
         QThreadPool::globalInstance()->waitForDone(-1);
         QApplication::quit();
     } else if (e->key() == Qt::Key_Right) {
-        m_player.rotateOnUpGlobal(-amount);
+        m_playerCommands.push_back(PlayerCommand(PlayerCommand::ROTATE_UP_GLOBAL, glm::vec3(-amount, 0.f, 0.f)));
     } else if (e->key() == Qt::Key_Left) {
-        m_player.rotateOnUpGlobal(amount);
+        m_playerCommands.push_back(PlayerCommand(PlayerCommand::ROTATE_UP_GLOBAL, glm::vec3(amount, 0.f, 0.f)));
     } else if (e->key() == Qt::Key_Up) {
-        m_player.rotateOnRightLocal(-amount);
+        m_playerCommands.push_back(PlayerCommand(PlayerCommand::ROTATE_RIGHT_LOCAL, glm::vec3(-amount, 0.f, 0.f)));
     } else if (e->key() == Qt::Key_Down) {
-        m_player.rotateOnRightLocal(amount);
+        m_playerCommands.push_back(PlayerCommand(PlayerCommand::ROTATE_RIGHT_LOCAL, glm::vec3(amount, 0.f, 0.f)));
     } else if (e->key() == Qt::Key_W) {
         m_inputs.wPressed = true;
     } else if (e->key() == Qt::Key_S) {
@@ -487,14 +803,14 @@ void MyGL::keyPressEvent(QKeyEvent *e) {
         m_inputs.ePressed = true;
     } else if (e->key() == Qt::Key_P) {
         m_inputs.pPressed = true;
-        m_player.fillAllBlocks();
+        m_playerCommands.push_back(PlayerCommand(PlayerCommand::FILL_ALL_BLOCKS));
     } else if (e->key() == Qt::Key_N) {
         m_inputs.nPressed = true;
-        m_player.selectNextBlockOnHand(m_inputs);
+        m_playerCommands.push_back(PlayerCommand(PlayerCommand::SELECT_NEXT_BLOCK));
     } else if (e->key() == Qt::Key_Space) {
         m_inputs.spacePressed = true;
     } else if (e->key() == Qt::Key_F) {
-        m_player.toggleFlightMode();
+        m_playerCommands.push_back(PlayerCommand(PlayerCommand::TOGGLE_FLIGHT));
     } else if (e->key() == Qt::Key_0) {
         m_inputs.numberPressed[0] = true;
     } else if (e->key() == Qt::Key_1) {
@@ -518,14 +834,65 @@ void MyGL::keyPressEvent(QKeyEvent *e) {
     } else if (e->key() == Qt::Key_I) {
         m_inputs.iPressed = true;
     } else if (e->key() == Qt::Key_C) {
-        m_player.switchCameraView();
+        m_playerCommands.push_back(PlayerCommand(PlayerCommand::SWITCH_CAMERA));
     } else if (e->key() == Qt::Key_U) {
-        m_player.setPos(glm::vec3(62.f, 33.f, 270.f));
+        m_playerCommands.push_back(PlayerCommand(PlayerCommand::TELEPORT, glm::vec3(62.f, 33.f, 270.f)));
+    } else if (e->key() == Qt::Key_M) {
+        // compare the terrain submit time of multi-draw & one draw per chunk
+        QMutexLocker worldLocker(&m_worldLock);
+        m_terrain.setMultiDraw(!m_terrain.isMultiDraw());
+    } else if (e->key() == Qt::Key_O) {
+        // compare the frame time with & without occlusion culling
+        m_occlusion.setEnabled(!m_occlusion.isEnabled());
+    } else if (e->key() == Qt::Key_K) {
+        // compare the frame time with & without the cave visibility search
+        QMutexLocker worldLocker(&m_worldLock);
+        m_terrain.setCaveCulling(!m_terrain.isCaveCulling());
+    } else if (e->key() == Qt::Key_Z) {
+        // compare the overdraw with & without sorting the chunks
+        QMutexLocker worldLocker(&m_worldLock);
+        m_terrain.setChunkSorting(!m_terrain.isChunkSorting());
+    } else if (e->key() == Qt::Key_F3) {
+        // the profiler overlay
+        showProfiler = !showProfiler;
+        profilerReport.clear();
+        m_profiler.setEnabled(showProfiler || m_profiler.isRecordingCSV());
+    } else if (e->key() == Qt::Key_F4) {
+        // one row per frame, for offline analysis
+        if (m_profiler.isRecordingCSV()) {
+            m_profiler.stopCSV();
+        } else if (!m_profiler.startCSV("frame_profile.csv")) {
+            std::cout << "could not open frame_profile.csv" << std::endl;
+        }
+        m_profiler.setEnabled(showProfiler || m_profiler.isRecordingCSV());
+    } else if (e->key() == Qt::Key_F5) {
+        // the worker thread timelines, open trace.json in chrome://tracing
+        if (!Tracer::isEnabled()) {
+            Tracer::start();
+        } else {
+            Tracer::stop();
+            if (!Tracer::writeJSON("trace.json")) {
+                std::cout << "could not open trace.json" << std::endl;
+            }
+        }
+    } else if (e->key() == Qt::Key_F6) {
+        // one JSON line of metrics per second
+        MetricsRegistry &metrics = MetricsRegistry::global();
+        if (metrics.isExporting()) {
+            metrics.stopExport();
+        } else if (!metrics.startExport("metrics.jsonl")) {
+            std::cout << "could not open metrics.jsonl" << std::endl;
+        }
+    } else if (e->key() == Qt::Key_B) {
+        // compare the frame time of the baked & the per fragment noise
+        bakedNoise = !bakedNoise;
     }
 }
 
 void MyGL::keyReleaseEvent(QKeyEvent *e)
 {
+    QMutexLocker inputsLocker(&m_inputsLock);
+
     if (e->key() == Qt::Key_W) {
         m_inputs.wPressed = false;
     } else if (e->key() == Qt::Key_S) {
@@ -566,13 +933,14 @@ void MyGL::keyReleaseEvent(QKeyEvent *e)
         m_inputs.numberPressed[9] = false;
     } else if (e->key() == Qt::Key_I) {
         m_inputs.iPressed = false;
-        m_player.toggleContainerMode();
+        m_playerCommands.push_back(PlayerCommand(PlayerCommand::TOGGLE_CONTAINER));
         toggleMouseCursorMode();
     }
 }
 
 void MyGL::mouseMoveEvent(QMouseEvent *e) {
     // TODO
+    QMutexLocker inputsLocker(&m_inputsLock);
     m_inputs.mouseX = e->pos().x();
     m_inputs.mouseY = e->pos().y();
 
@@ -590,16 +958,21 @@ void MyGL::mouseMoveEvent(QMouseEvent *e) {
     if (mouseCursorMode) {
         return;
     }
-    m_player.rotateCameraView(m_inputs);
+    // the offset from the centre, where the camera's screen centre is
+    glm::vec2 offset(m_inputs.mouseX - width() / 2, m_inputs.mouseY - height() / 2);
+    m_playerCommands.push_back(PlayerCommand(PlayerCommand::ROTATE_VIEW, glm::vec3(offset, 0.f)));
     moveMouseToCenter();
 }
 
 void MyGL::mousePressEvent(QMouseEvent *e) {
+    QMutexLocker inputsLocker(&m_inputsLock);
 
     switch (e->button()) {
     case (Qt::LeftButton):
         m_inputs.leftMouseButtonPressed = true;
         // TODO: grab the block item if the player opens the container
+        // the container is the player's, modified under the world lock
+        m_worldLock.lock();
         if (!m_player.isGrabbing() && m_player.isOpenContainer()) {
             glm::vec2 pos = convertPosToNormalizedPos(e);
             if (m_player.setGrabItemPos(pos.x, pos.y)){
@@ -607,6 +980,7 @@ void MyGL::mousePressEvent(QMouseEvent *e) {
                 Block::getUVCoords(grabbedItemType, &grabbedItemUVCoords);
             }
         }
+        m_worldLock.unlock();
         break;
     case (Qt::RightButton):
         m_inputs.rightMouseButtonPressed = true;
@@ -617,16 +991,19 @@ void MyGL::mousePressEvent(QMouseEvent *e) {
 }
 
 void MyGL::mouseReleaseEvent(QMouseEvent *e) {
+    QMutexLocker inputsLocker(&m_inputsLock);
 
     switch (e->button()) {
     case (Qt::LeftButton):
         m_inputs.leftMouseButtonPressed = false;
         // TODO: release the selected block item to a new place (or switch the items)
         // if the player opens the container
+        m_worldLock.lock();
         if (m_player.isGrabbing() && m_player.isOpenContainer()) {
             glm::vec2 pos = convertPosToNormalizedPos(e);
             m_player.releaseGrabItem(pos.x, pos.y);
         }
+        m_worldLock.unlock();
         break;
     case (Qt::RightButton):
         m_inputs.rightMouseButtonPressed = false;
@@ -718,18 +1095,47 @@ void MyGL::bindTexture(Texture& texture, ShaderProgram& shaderProgram, int slot)
 
 
 /**
- * @brief MyGL::renderTexture
- *   render the object only requires the texture map
+ * @brief MyGL::renderHUD
+ *   refill the HUD elements whose content changed, then draw the HUD
  *   called from paintGL
- * @param texture : texture object used in this drawable object
- * @param shaderProgram : shaderProgram of the drawable object
- * @param slot: texture slot
- * @param drawable : pointer to drawable object (for inherited class)
  */
-void MyGL::renderTexture(Texture& texture, ShaderProgram& shaderProgram, int slot, Drawable* d) {
-    d->createVBOdata();
-    bindTexture(texture, shaderProgram, slot);
-    shaderProgram.drawTexture(*d);
+void MyGL::renderHUD() {
+    // The HUD reads the inventory, which the simulation modifies.
+    // Refill it only if the simulation is not in the middle of a step,
+    // otherwise draw the buffers of the last frame again.
+    if (m_worldLock.tryLock()) {
+        if (m_player.needsHUDRedraw()) {
+            m_hud.markAllDirty();
+            m_player.drawHUD();
+        }
+        bool containerOpen = m_player.isOpenContainer();
+        bool grabbing = containerOpen && m_player.isGrabbing();
+        // the grabbed item follows the mouse
+        if (grabbing) {
+            drawGrabbedItem();
+            m_hud.markDirty(hudGrabbedItemLayer);
+        }
+        m_worldLock.unlock();
+
+        m_hud.setLayerVisible(hudContainerWidgetLayer, containerOpen);
+        m_hud.setLayerVisible(hudContainerItemsLayer, containerOpen);
+        m_hud.setLayerVisible(hudGrabbedItemLayer, grabbing);
+    }
+
+    // the profiler overlay is re-tessellated every frame it is shown
+    m_hud.setLayerVisible(hudProfilerLayer, showProfiler);
+    if (showProfiler) {
+        if (profilerReport.empty() || frameCount % 30 == 0) {
+            profilerReport = m_profiler.getReport();
+        }
+        for (unsigned int i = 0; i < profilerReport.size(); i++) {
+            profilerText->addText(profilerReport[i], glm::vec2(-0.98f, 0.96f - 0.045f * i), 0.04f);
+        }
+        m_hud.markDirty(hudProfilerLayer);
+    }
+
+    m_hud.update();
+    m_hud.draw(m_progHUD);
 }
 
 void MyGL::initWidget() {
@@ -774,7 +1180,26 @@ void MyGL::initWidget() {
 void MyGL::initText() {
     textOnScreen = mkU<Text>(this, width(), height());
     m_player.setupText(textOnScreen.get());
+    profilerText = mkU<Text>(this, width(), height());
+
+}
 
+/**
+ * @brief MyGL::initHUD
+ *  the HUD layers, in drawing order (the textures are loaded in initializeGL)
+ */
+void MyGL::initHUD() {
+    // On hand: widget and selected frame, then the blocks
+    m_hud.addLayer(inventoryWidgetOnHand, &inventoryWidgetOnHandTexture, 2, false);
+    m_hud.addLayer(inventoryItemsOnHand, &textureAll, 0, false);
+    // In container
+    hudContainerWidgetLayer = m_hud.addLayer(inventoryWidgetInContainer, &inventoryWidgetInContainerTexture, 4, false);
+    hudContainerItemsLayer = m_hud.addLayer(inventoryItemsInContainer, &textureAll, 0, false);
+    hudGrabbedItemLayer = m_hud.addLayer(grabbedItem, &textureAll, 0, false);
+    // the text is drawn on top of everything
+    m_hud.addLayer(textOnScreen.get(), &textureFont, 3, true);
+    hudProfilerLayer = m_hud.addLayer(profilerText.get(), &textureFont, 3, true);
+    m_hud.setLayerVisible(hudProfilerLayer, false);
 }
 
 void MyGL::toggleMouseCursorMode() {
@@ -868,25 +1293,34 @@ void MyGL::loadNPCTextureUVCoord()
  * @brief MyGL::renderNPCs
  *  The main logics to draw all the NPCs in paintGL().
  *  This helper is called in MyGL::paintGL().
- *  Basically, loop through the m_npcs.
+ *  Basically, loop through the m_npcs, then the rows of m_herd.
  *  For each npc, traverse the scene graph,
  *  set the model matrix based on the node's transformation,
  *  draw the corresponding block.
+ *  The rows of m_herd are drawn with the scene graph of their archetype's model.
  *  Note: the scene graph / the blocks of every NPC must be created.
  */
-void MyGL::renderNPCs()
+void MyGL::renderNPCs(const WorldSnapshot &snapshot)
 {
-    for (const uPtr<NPC> &npc : m_npcs)
-    {
+    auto drawNPC = [this](NPC &npc, const NPCSnapshot &npcSnapshot) {
         // Retrieve the texture map
-        if (npcTextures.find(npc->npcTexture) == npcTextures.end())
+        if (npcTextures.find(npc.npcTexture) == npcTextures.end())
         {
-            continue;
+            return;
         }
         // bind the texture map
-        npcTextures[npc->npcTexture].bind(npcTextures[npc->npcTexture].getSlot());
-        m_progNPC.setTexture(npcTextures[npc->npcTexture].getSlot());
-        npc->draw(&m_progNPC);
+        npcTextures[npc.npcTexture].bind(npcTextures[npc.npcTexture].getSlot());
+        m_progNPC.setTexture(npcTextures[npc.npcTexture].getSlot());
+        npc.draw(&m_progNPC, npcSnapshot);
+    };
+
+    for (unsigned int i = 0; i < m_npcs.size() && i < snapshot.npcs.size(); i++)
+    {
+        drawNPC(*m_npcs[i], snapshot.npcs[i]);
+    }
+    for (unsigned int i = 0; i < snapshot.herd.size(); i++)
+    {
+        drawNPC(*m_herdModels[snapshot.herdArchetypes[i]], snapshot.herd[i]);
     }
 }
 
@@ -894,13 +1328,13 @@ void MyGL::renderNPCs()
  * @brief MyGL::renderPlayerModel
  *  Render Steve
  */
-void MyGL::renderPlayerModel()
+void MyGL::renderPlayerModel(const WorldSnapshot &snapshot)
 {
     if (npcTextures.find(m_player_model.npcTexture) != npcTextures.end())
     {
         npcTextures[m_player_model.npcTexture].bind(npcTextures[m_player_model.npcTexture].getSlot());
         m_progNPC.setTexture(npcTextures[m_player_model.npcTexture].getSlot());
-        m_player_model.draw(&m_progNPC);
+        m_player_model.draw(&m_progNPC, snapshot.playerModel);
     }
 }
 
@@ -922,6 +1356,8 @@ void MyGL::renderPlayerModel()
  *          - the search grid (halfGridSize) of the path finder (A* search)
  *      - other needed params (m_terrain, m_player)
  *  2. Push into the m_npcs list
+ *  The sheep & bears are rows of m_herd instead (see MyGL::setupHerd),
+ *  here only a model of each is made to draw them with.
  */
 void MyGL::setupNPCs()
 {
@@ -950,6 +1386,35 @@ void MyGL::setupNPCs()
     m_npcs.push_back(mkU<ZombieDragon>(this, glm::vec3(253, 245, 636), m_terrain, m_player, ZDRAGON2, glm::vec3(263, 245, 626)));
     m_npcs.push_back(mkU<ZombieDragon>(this, glm::vec3(72, 33, 250), m_terrain, m_player, ZDRAGON3, glm::vec3(62, 33, 270)));
 
+    // the models of the sheep & bears of m_herd, by archetype id
+    m_herdModels.push_back(mkU<Sheep>(this, glm::vec3(0.f), m_terrain, m_player, SHEEP,
+                                      std::vector<glm::vec3>(),
+                                      glm::vec3(1.f, 0.f, 1.f),
+                                      2.f, 2.f,
+                                      5));
+    m_herdModels.push_back(mkU<Sheep>(this, glm::vec3(0.f), m_terrain, m_player, BEAR,
+                                      std::vector<glm::vec3>(),
+                                      glm::vec3(1.f, 0.f, 1.f),
+                                      2.f, 2.f,
+                                      5));
+}
+
+/**
+ * @brief MyGL::setupHerd
+ *  The sheep & bears on the grounds, as rows of m_herd.
+ *  Each walks back & forth along its own order of the goals:
+ *  along the goals' flow fields near them, along a route search further away.
+ *  Note: the scene graphs of m_herdModels must be initialized (see NPC::getArchetype)
+ */
+void MyGL::setupHerd()
+{
+    for (const uPtr<NPC> &model : m_herdModels)
+    {
+        m_herd.addArchetype(model->getArchetype());
+    }
+    int sheepArchetype = 0;
+    int bearArchetype = 1;
+
     // sheep on the grounds
     // moving around
     int nSheeps = 6;
@@ -964,24 +1429,14 @@ void MyGL::setupNPCs()
     for (int i = 0; i < nSheeps; i++)
     {
         std::shuffle(sheepGoals.begin(), sheepGoals.end(), rng);
-        m_npcs.push_back(mkU<Sheep>(this, glm::vec3(50.f + ((float) i) * 1.5f, 145.f, 32.f),
-                                    m_terrain, m_player, SHEEP,
-                                    sheepGoals,
-                                    glm::vec3(1.f, 0.f, 1.f),
-                                    2.f, 2.f,
-                                    5));
+        m_herd.spawn(sheepArchetype, m_herd.addRoute(sheepGoals),
+                     glm::vec3(50.f + ((float) i) * 1.5f, 145.f, 32.f));
     }
 
     for (int i = 0; i < nSheeps; i++)
     {
         std::shuffle(sheepGoals.begin(), sheepGoals.end(), rng);
-        m_npcs.push_back(mkU<Sheep>(this, glm::vec3(50.f + ((float) i) * 1.5f, 144.f, 45.f),
-                                    m_terrain, m_player, BEAR,
-                                    sheepGoals,
-                                    glm::vec3(1.f, 0.f, 1.f),
-                                    2.f, 2.f,
-                                    5));
+        m_herd.spawn(bearArchetype, m_herd.addRoute(sheepGoals),
+                     glm::vec3(50.f + ((float) i) * 1.5f, 144.f, 45.f));
     }
-
-
 }
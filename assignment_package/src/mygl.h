@@ -14,10 +14,17 @@
 #include "scene/widget.h"
 #include "scene/blockinwidget.h"
 #include "scene/text.h"
+#include "scene/hud.h"
+#include "scene/occlusionculler.h"
 #include "scene/npcs/steve.h"
+#include "scene/simulation.h"
 #include "texture.h"
+#include "noisetexture.h"
+#include "profiler.h"
 
+#include <QFile>
 #include <QOpenGLVertexArrayObject>
+#include <QTextStream>
 #include <QOpenGLShaderProgram>
 #include <QApplication>
 #include <smartpointerhelp.h>
@@ -35,12 +42,7 @@ private:
     ShaderProgram m_progUnderwater;
     ShaderProgram m_progLava;
     ShaderProgram m_progNoOp;
-    ShaderProgram m_progInventoryWidgetOnHand;
-    ShaderProgram m_progInventoryItemOnHand;
-    ShaderProgram m_progInventoryWidgetInContainer;
-    ShaderProgram m_progInventoryItemInContainer;
-    ShaderProgram m_progGrabbedItem;
-    ShaderProgram m_progText;
+    ShaderProgram m_progHUD; // draws all the widgets, items & text of the HUD
     Quad m_quad;
     Widget* inventoryWidgetOnHand;
     Widget* inventoryWidgetInContainer;
@@ -49,12 +51,21 @@ private:
     BlockInWidget* grabbedItem;
     std::vector<uPtr<Widget>> widgets;
     uPtr<Text> textOnScreen;
+    // the widgets, items & text in one buffer, re-tessellated only when they change
+    HUD m_hud;
+    int hudContainerWidgetLayer;
+    int hudContainerItemsLayer;
+    int hudGrabbedItemLayer;
 
     // NPC
     ShaderProgram m_progNPC;
 
     FrameBuffer m_frameBuffer;
 
+    // skips the terrain sections hidden behind other terrain (toggled with O)
+    ShaderProgram m_progDepth;
+    OcclusionCuller m_occlusion;
+
     GLuint vao; // A handle for our vertex array object. This will store the VBOs created in our geometry classes.
                 // Don't worry to o much about this. Just know it is necessary in order to render geometry.
 
@@ -64,11 +75,47 @@ private:
     Steve m_player_model;
 
     std::vector<uPtr<NPC>> m_npcs; // A collection of npcs
+    NPCStore m_herd; // the sheep & bears on the grounds, as rows of component arrays
+    std::vector<uPtr<NPC>> m_herdModels; // one NPC per archetype of m_herd (by id), its scene graph draws the rows
+
+    // Runs the player / NPC ticks at a fixed time step on its own thread
+    uPtr<Simulation> m_simulation;
+    QMutex m_worldLock; // held while the player, NPCs or blocks are modified
+    QMutex m_inputsLock; // held while m_inputs or m_playerCommands is read / written
 
     QTimer m_timer; // Timer linked to tick(). Fires approximately 60 times per second.
 
     int frameCount; // the number of processing frame, treated as time in shader
-    long long prevFrameTime; // time in previous frame, for calculating delta-time in player tick funciton
+    float avgFrameTime; // smoothed time (ms) spent in paintGL
+    int drawnChunks; // chunks drawn in the last opaque terrain pass
+    int culledChunks; // chunks skipped by frustum culling in the last opaque terrain pass
+    int sectionsInFrustum; // non-empty sections in the frustum in the last terrain passes
+    int occludedSections; // sections of those skipped by occlusion culling
+    int unreachableSections; // sections of those the camera can't see into (caves behind stone etc.)
+    GLuint overdrawQuery; // GL_SAMPLES_PASSED query around the opaque terrain pass
+    bool overdrawQueryPending; // its result was not read yet
+    float overdraw; // fragments written by the opaque terrain per pixel, from the last result
+    float terrainSubmitTime; // CPU time (ms) spent in Terrain::draw this frame
+    float avgTerrainSubmitTime; // smoothed terrainSubmitTime
+    int terrainDrawCalls; // draw calls issued by Terrain::draw this frame
+    GLCallCounter lastFrameGLCalls; // GL calls made by the last paintGL
+
+    // CPU / GPU time of the passes of paintGL & the phases of tick,
+    // shown on screen with F3 & written to a CSV file with F4
+    Profiler m_profiler;
+    int profOpaqueTerrain;
+    int profOcclusion;
+    int profTransparentTerrain;
+    int profPlayerModel;
+    int profNPCs;
+    int profPostProcess;
+    int profHUD;
+    int profExpand;
+    int profThreadResults;
+    uPtr<Text> profilerText;
+    int hudProfilerLayer;
+    bool showProfiler;
+    std::vector<std::string> profilerReport; // refreshed twice a second, so it can be read
 
     int prevMouseX;
     int prevMouseY;
@@ -79,6 +126,10 @@ private:
     Texture inventoryWidgetOnHandTexture;
     Texture inventoryWidgetInContainerTexture;
     Texture textureFont;
+    // the terrain shading noise, baked on a worker thread at startup
+    NoiseTexture m_noiseTexture;
+    static const int NOISE_TEXTURE_SLOT = 14; // after the NPC textures
+    bool bakedNoise; // sample m_noiseTexture once it is ready instead of computing the fbm per fragment
 
     std::unordered_map<NPCTexture, Texture> npcTextures;
 
@@ -95,16 +146,39 @@ private:
     void createTexture(Texture& texture, const char* img_path, int slot);
     void initWidget();
     void initText();
+    void initHUD();
     void bindTexture(Texture& texture, ShaderProgram& shaderProgram, int slot);
 
     void toggleMouseCursorMode();
 
     void setupNPCs();
-    void renderNPCs();
-    void renderPlayerModel();
+    void setupHerd();
+    void renderNPCs(const WorldSnapshot &snapshot);
+    void renderPlayerModel(const WorldSnapshot &snapshot);
 
 
     long long prevExpandTime;
+    // the metrics are sent to PlayerInfo (& exported) once per second
+    long long prevMetricsTime;
+
+    // the player changes made by the key / mouse events, applied by the next simulation step
+    std::vector<PlayerCommand> m_playerCommands;
+
+    // recordInputs(): the inputs of every simulation step are written to the log
+    InputRecorder m_recorder;
+    QString recordPath;
+    // replayInputs(): replayTick() runs one simulation step with the logged inputs
+    // & renders one frame, as fast as possible, then the app quits
+    InputReplay m_replay;
+    bool replaying;
+    QFile replayCSV;
+    QTextStream replayOut;
+    std::vector<float> replaySimTimes; // ms
+    std::vector<float> replayFrameTimes; // ms, until glFinish returns
+    long long replayStep;
+    float lastFrameTime; // ms
+    void replayTick();
+    void finishReplay();
 
     glm::vec2 convertPosToNormalizedPos(glm::vec2 pixelPos);
     glm::vec2 convertPosToNormalizedPos(QMouseEvent *e);
@@ -138,14 +212,21 @@ public:
 
     // Called from paintGL().
     // Calls Terrain::draw().
-    void renderTerrain(TerrainDrawType drawType);
+    void renderTerrain(TerrainDrawType drawType, glm::vec3 playerPos, const Frustum &frustum);
 
     // Called from paintGL()
-    // Render the shader program with simple texture map
-    void renderTexture(Texture& texture, ShaderProgram& shaderProgram, int slot, Drawable* d);
+    // Refill the HUD elements that changed & draw the HUD
+    void renderHUD();
 
     void stopWalkingSounds();
-    void playWalkingSounds();
+    void playWalkingSounds(const WorldSnapshot &snapshot);
+
+    // call before the widget is shown
+    // write the inputs of the session to path
+    void recordInputs(const QString &path);
+    // replay the session logged at path without input, writing per step
+    // the simulation time, the frame time & the world checksum to csvPath
+    bool replayInputs(const QString &path, const QString &csvPath);
 
 protected:
     // Automatically invoked when the user
@@ -174,6 +255,16 @@ signals:
     void sig_sendPlayerLook(QString) const;
     void sig_sendPlayerChunk(QString) const;
     void sig_sendPlayerTerrainZone(QString) const;
+    void sig_sendSimTickTime(QString) const;
+    void sig_sendFrameTime(QString) const;
+    void sig_sendChunkCullStats(QString) const;
+    void sig_sendTerrainSubmitTime(QString) const;
+    void sig_sendGLCallStats(QString) const;
+    void sig_sendBufferStats(QString) const;
+    void sig_sendOcclusionStats(QString) const;
+    void sig_sendCaveCullStats(QString) const;
+    void sig_sendOverdrawStats(QString) const;
+    void sig_sendMetrics(QString) const;
 };
 
 
@@ -0,0 +1,194 @@
+#include "noisetexture.h"
+#include <QThreadPool>
+#include <algorithm>
+#include <cmath>
+
+
+// the same hash & interpolation as lambert.frag.glsl
+static float random1(float x, float y, float z)
+{
+    float v = std::sin(x * 127.1f + y * 311.7f + z * 191.999f) * 43758.5453f;
+    return v - std::floor(v);
+}
+
+static float mySmoothStep(float a, float b, float t)
+{
+    t = t * t * (3.f - 2.f * t);
+    return a + (b - a) * t;
+}
+
+/**
+ * @brief tiledTriMix
+ *  cubicTriMix of lambert.frag.glsl with the lattice wrapped every period cells
+ * @param px, py, pz : position in lattice cells
+ * @param period : int, the lattice cells per world unit
+ * @return
+ */
+static float tiledTriMix(float px, float py, float pz, int period)
+{
+    int cell[3] = {static_cast<int>(std::floor(px)), static_cast<int>(std::floor(py)), static_cast<int>(std::floor(pz))};
+    float fx = px - cell[0];
+    float fy = py - cell[1];
+    float fz = pz - cell[2];
+
+    // corner (i, j, k) of the cell, wrapped
+    float c[2][2][2];
+    for (int i = 0; i < 2; i++) {
+        for (int j = 0; j < 2; j++) {
+            for (int k = 0; k < 2; k++) {
+                c[i][j][k] = random1(static_cast<float>((cell[0] + i) % period),
+                                     static_cast<float>((cell[1] + j) % period),
+                                     static_cast<float>((cell[2] + k) % period));
+            }
+        }
+    }
+
+    float mixLoBack = mySmoothStep(c[0][0][0], c[1][0][0], fx);
+    float mixHiBack = mySmoothStep(c[0][1][0], c[1][1][0], fx);
+    float mixLoFront = mySmoothStep(c[0][0][1], c[1][0][1], fx);
+    float mixHiFront = mySmoothStep(c[0][1][1], c[1][1][1], fx);
+
+    float mixLo = mySmoothStep(mixLoBack, mixLoFront, fz);
+    float mixHi = mySmoothStep(mixHiBack, mixHiFront, fz);
+
+    return mySmoothStep(mixLo, mixHi, fy);
+}
+
+void NoiseTexture::bake(std::vector<unsigned char> &texels)
+{
+    texels.resize(SIZE * SIZE * SIZE);
+
+    for (int z = 0; z < SIZE; z++) {
+        for (int y = 0; y < SIZE; y++) {
+            for (int x = 0; x < SIZE; x++) {
+                // the texel centre in the unit cube
+                float p[3] = {(x + 0.5f) / SIZE, (y + 0.5f) / SIZE, (z + 0.5f) / SIZE};
+
+                // the 8 octaves of fbm(), from frequency 4
+                float amp = 0.5f;
+                int freq = 4;
+                float sum = 0.f;
+                for (int i = 0; i < 8; i++) {
+                    if (freq <= SIZE) {
+                        sum += tiledTriMix(p[0] * freq, p[1] * freq, p[2] * freq, freq) * amp;
+                    } else {
+                        // finer than a texel, use the mean of the noise
+                        sum += 0.5f * amp;
+                    }
+                    amp *= 0.5f;
+                    freq *= 2;
+                }
+
+                texels[x + SIZE * (y + SIZE * z)] = static_cast<unsigned char>(std::min(255.f, sum * 256.f));
+            }
+        }
+    }
+}
+
+
+NoiseTexture::NoiseTexture(OpenGLContext *context)
+    : context(context), m_textureHandle(0), m_result(nullptr), m_uploaded(false), slot(-1)
+{}
+
+NoiseTexture::~NoiseTexture()
+{}
+
+void NoiseTexture::startBaking()
+{
+    if (m_result != nullptr) {
+        return;
+    }
+    m_result = std::make_shared<NoiseBakeResult>();
+    QThreadPool::globalInstance()->start(new NoiseBakeWorker(m_result));
+}
+
+/**
+ * @brief NoiseTexture::upload
+ *  Check (without waiting) whether the worker is done, and if so
+ *  send the texels to the gpu. Call once per frame until it returns true.
+ * @param texSlot
+ * @return true if the texture is ready to be sampled
+ */
+bool NoiseTexture::upload(int texSlot)
+{
+    if (m_uploaded) {
+        return true;
+    }
+    if (m_result == nullptr) {
+        return false;
+    }
+    {
+        QMutexLocker locker(&m_result->lock);
+        if (!m_result->done) {
+            return false;
+        }
+    }
+
+    slot = texSlot;
+    context->glGenTextures(1, &m_textureHandle);
+    context->glActiveTexture(GL_TEXTURE0 + texSlot);
+    context->glBindTexture(GL_TEXTURE_3D, m_textureHandle);
+
+    // repeat every world unit, mipmapped for the far away terrain
+    context->glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    context->glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    context->glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    context->glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    context->glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_REPEAT);
+
+    // rows of SIZE bytes are not 4-byte aligned in general
+    context->glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    context->glTexImage3D(GL_TEXTURE_3D, 0, GL_R8, SIZE, SIZE, SIZE, 0,
+                          GL_RED, GL_UNSIGNED_BYTE, m_result->texels.data());
+    context->glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    context->glGenerateMipmap(GL_TEXTURE_3D);
+    context->printGLErrorLog();
+
+    // the texels live on the gpu now
+    m_result.reset();
+    m_uploaded = true;
+    return true;
+}
+
+bool NoiseTexture::isReady() const
+{
+    return m_uploaded;
+}
+
+void NoiseTexture::bind(int texSlot)
+{
+    context->glActiveTexture(GL_TEXTURE0 + texSlot);
+    context->glBindTexture(GL_TEXTURE_3D, m_textureHandle);
+}
+
+int NoiseTexture::getSlot() const
+{
+    return slot;
+}
+
+void NoiseTexture::destroy()
+{
+    if (m_uploaded) {
+        context->glDeleteTextures(1, &m_textureHandle);
+        m_uploaded = false;
+    }
+    m_result.reset();
+}
+
+
+NoiseBakeWorker::NoiseBakeWorker(std::shared_ptr<NoiseBakeResult> result)
+    : result(result)
+{}
+
+/**
+ * @brief NoiseBakeWorker::run
+ */
+void NoiseBakeWorker::run()
+{
+    std::vector<unsigned char> texels;
+    NoiseTexture::bake(texels);
+
+    QMutexLocker locker(&result->lock);
+    result->texels.swap(texels);
+    result->done = true;
+}
@@ -0,0 +1,70 @@
+#ifndef NOISETEXTURE_H
+#define NOISETEXTURE_H
+
+#pragma once
+
+#include <openglcontext.h>
+#include <QMutex>
+#include <QRunnable>
+#include <memory>
+#include <vector>
+
+// The texels of a NoiseTexture, written by the NoiseBakeWorker
+// (shared, so a worker that outlives the texture still writes into valid memory)
+struct NoiseBakeResult
+{
+    std::vector<unsigned char> texels;
+    bool done;
+    QMutex lock;
+
+    NoiseBakeResult()
+        : texels(), done(false), lock()
+    {}
+};
+
+// The fbm of lambert.frag.glsl (8 octaves of value noise, 60+ sin per fragment)
+// baked into a SIZE^3 GL_TEXTURE_3D that tiles every world unit.
+// The lattice of each octave wraps around the unit cube, so the texture repeats
+// seamlessly. The octaves finer than one texel are replaced by their mean.
+class NoiseTexture
+{
+public:
+    // texels per side
+    static const int SIZE = 64;
+
+    NoiseTexture(OpenGLContext *context);
+    ~NoiseTexture();
+
+    // bake the texels on the global QThreadPool
+    void startBaking();
+    // upload the texels to texSlot once they are baked, true if the texture is ready
+    bool upload(int texSlot);
+    bool isReady() const;
+    void bind(int texSlot);
+    int getSlot() const;
+    void destroy();
+
+    // SIZE^3 texels, x fastest, the fbm mapped to 0 - 255
+    static void bake(std::vector<unsigned char> &texels);
+
+private:
+    OpenGLContext *context;
+    GLuint m_textureHandle;
+    std::shared_ptr<NoiseBakeResult> m_result;
+    bool m_uploaded;
+    int slot;
+};
+
+class NoiseBakeWorker : public QRunnable
+{
+private:
+    std::shared_ptr<NoiseBakeResult> result;
+
+public:
+    NoiseBakeWorker(std::shared_ptr<NoiseBakeResult> result);
+
+    void run() override;
+};
+
+
+#endif // NOISETEXTURE_H
@@ -8,12 +8,231 @@
 
 
 OpenGLContext::OpenGLContext(QWidget *parent)
-    : QOpenGLWidget(parent)
+    : QOpenGLWidget(parent),
+      mp_drawElementsBaseVertex(nullptr), mp_multiDrawElementsBaseVertex(nullptr),
+      m_currProgram(UNKNOWN_STATE), m_boundArrayBuffer(UNKNOWN_STATE), m_boundElementBuffer(UNKNOWN_STATE),
+      m_boundVAO(UNKNOWN_STATE), m_enabledAttribs(0), m_enabledAttribsKnown(false),
+      m_glCallCounter(), m_liveBuffers(0)
 {}
 
 OpenGLContext::~OpenGLContext()
 {}
 
+void OpenGLContext::resolveDrawFunctions()
+{
+    QOpenGLContext *ctx = context();
+    mp_drawElementsBaseVertex = reinterpret_cast<DrawElementsBaseVertexFunc>(
+                ctx->getProcAddress("glDrawElementsBaseVertex"));
+    mp_multiDrawElementsBaseVertex = reinterpret_cast<MultiDrawElementsBaseVertexFunc>(
+                ctx->getProcAddress("glMultiDrawElementsBaseVertex"));
+
+    if (mp_drawElementsBaseVertex == nullptr) {
+        std::cerr << "ERROR: glDrawElementsBaseVertex is not available (OpenGL 3.2 is required)" << std::endl;
+        QApplication::exit();
+    }
+    if (mp_multiDrawElementsBaseVertex == nullptr) {
+        std::cerr << "WARNING: glMultiDrawElementsBaseVertex is not available, "
+                     "the terrain will be drawn with one draw call per chunk" << std::endl;
+    }
+}
+
+void OpenGLContext::drawElementsBaseVertex(GLenum mode, GLsizei count, GLenum type, const void *indices, GLint baseVertex)
+{
+    mp_drawElementsBaseVertex(mode, count, type, indices, baseVertex);
+    m_glCallCounter.drawCalls++;
+}
+
+void OpenGLContext::multiDrawElementsBaseVertex(GLenum mode, const GLsizei *count, GLenum type,
+                                                const void *const *indices, GLsizei drawCount, const GLint *baseVertex)
+{
+    if (mp_multiDrawElementsBaseVertex != nullptr) {
+        mp_multiDrawElementsBaseVertex(mode, count, type, indices, drawCount, baseVertex);
+        m_glCallCounter.drawCalls++;
+        return;
+    }
+    for (GLsizei i = 0; i < drawCount; i++) {
+        mp_drawElementsBaseVertex(mode, count[i], type, indices[i], baseVertex[i]);
+    }
+    m_glCallCounter.drawCalls += drawCount;
+}
+
+void OpenGLContext::glUseProgram(GLuint program)
+{
+    if (program == m_currProgram) {
+        m_glCallCounter.skippedStateCalls++;
+        return;
+    }
+    QOpenGLExtraFunctions::glUseProgram(program);
+    m_currProgram = program;
+    m_glCallCounter.stateCalls++;
+}
+
+/**
+ * @brief OpenGLContext::glBindBuffer
+ *  Only GL_ARRAY_BUFFER & GL_ELEMENT_ARRAY_BUFFER are cached,
+ *  the other targets (e.g. GL_COPY_READ_BUFFER) are always sent to GL.
+ * @param target
+ * @param buffer
+ */
+void OpenGLContext::glBindBuffer(GLenum target, GLuint buffer)
+{
+    GLuint *bound = target == GL_ARRAY_BUFFER ? &m_boundArrayBuffer :
+                    target == GL_ELEMENT_ARRAY_BUFFER ? &m_boundElementBuffer :
+                    nullptr;
+    if (bound != nullptr && *bound == buffer) {
+        m_glCallCounter.skippedStateCalls++;
+        return;
+    }
+    QOpenGLExtraFunctions::glBindBuffer(target, buffer);
+    if (bound != nullptr) {
+        *bound = buffer;
+    }
+    m_glCallCounter.stateCalls++;
+}
+
+void OpenGLContext::glGenBuffers(GLsizei n, GLuint *buffers)
+{
+    QOpenGLExtraFunctions::glGenBuffers(n, buffers);
+    m_liveBuffers += n;
+}
+
+/**
+ * @brief OpenGLContext::glDeleteBuffers
+ *  GL unbinds a buffer when it is deleted, the cache has to do the same
+ *  (otherwise a new buffer reusing the name would be seen as bound)
+ * @param n
+ * @param buffers
+ */
+void OpenGLContext::glDeleteBuffers(GLsizei n, const GLuint *buffers)
+{
+    for (GLsizei i = 0; i < n; i++) {
+        // GL silently ignores 0
+        if (buffers[i] != 0) {
+            m_liveBuffers--;
+        }
+        if (buffers[i] == m_boundArrayBuffer) {
+            m_boundArrayBuffer = 0;
+        }
+        if (buffers[i] == m_boundElementBuffer) {
+            m_boundElementBuffer = 0;
+        }
+    }
+    QOpenGLExtraFunctions::glDeleteBuffers(n, buffers);
+    m_glCallCounter.stateCalls++;
+}
+
+void OpenGLContext::glBindVertexArray(GLuint array)
+{
+    if (array == m_boundVAO) {
+        m_glCallCounter.skippedStateCalls++;
+        return;
+    }
+    QOpenGLExtraFunctions::glBindVertexArray(array);
+    m_boundVAO = array;
+    // the index buffer & the enabled attributes belong to the VAO
+    m_boundElementBuffer = UNKNOWN_STATE;
+    m_enabledAttribsKnown = false;
+    m_glCallCounter.stateCalls++;
+}
+
+void OpenGLContext::glEnableVertexAttribArray(GLuint index)
+{
+    if (m_enabledAttribsKnown && index < 32 && (m_enabledAttribs >> index) & 1u) {
+        m_glCallCounter.skippedStateCalls++;
+        return;
+    }
+    QOpenGLExtraFunctions::glEnableVertexAttribArray(index);
+    if (index < 32) {
+        m_enabledAttribs |= 1u << index;
+    }
+    m_glCallCounter.stateCalls++;
+}
+
+void OpenGLContext::glDisableVertexAttribArray(GLuint index)
+{
+    if (m_enabledAttribsKnown && index < 32 && !((m_enabledAttribs >> index) & 1u)) {
+        m_glCallCounter.skippedStateCalls++;
+        return;
+    }
+    QOpenGLExtraFunctions::glDisableVertexAttribArray(index);
+    if (index < 32) {
+        m_enabledAttribs &= ~(1u << index);
+    }
+    m_glCallCounter.stateCalls++;
+}
+
+/**
+ * @brief OpenGLContext::setVertexAttribArrays
+ *  The draw functions of ShaderProgram call this instead of
+ *  enabling their attributes before the draw & disabling them after,
+ *  so consecutive draws with the same layout make no calls at all.
+ * @param attribs : bit i set to enable attribute array i
+ */
+void OpenGLContext::setVertexAttribArrays(GLuint attribs)
+{
+    // GL guarantees at least 16 vertex attributes
+    for (GLuint i = 0; i < 16; i++) {
+        bool enable = (attribs >> i) & 1u;
+        bool enabled = (m_enabledAttribs >> i) & 1u;
+        if (m_enabledAttribsKnown && enable == enabled) {
+            continue;
+        }
+        if (enable) {
+            QOpenGLExtraFunctions::glEnableVertexAttribArray(i);
+        } else {
+            QOpenGLExtraFunctions::glDisableVertexAttribArray(i);
+        }
+        m_glCallCounter.stateCalls++;
+    }
+    m_enabledAttribs = attribs;
+    m_enabledAttribsKnown = true;
+}
+
+void OpenGLContext::invalidateGLStateCache()
+{
+    m_currProgram = UNKNOWN_STATE;
+    m_boundArrayBuffer = UNKNOWN_STATE;
+    m_boundElementBuffer = UNKNOWN_STATE;
+    m_boundVAO = UNKNOWN_STATE;
+    m_enabledAttribsKnown = false;
+}
+
+void OpenGLContext::glDrawElements(GLenum mode, GLsizei count, GLenum type, const void *indices)
+{
+    QOpenGLExtraFunctions::glDrawElements(mode, count, type, indices);
+    m_glCallCounter.drawCalls++;
+}
+
+void OpenGLContext::glDrawElementsInstanced(GLenum mode, GLsizei count, GLenum type, const void *indices, GLsizei instanceCount)
+{
+    QOpenGLExtraFunctions::glDrawElementsInstanced(mode, count, type, indices, instanceCount);
+    m_glCallCounter.drawCalls++;
+}
+
+void OpenGLContext::countUniformUpload(bool skipped)
+{
+    if (skipped) {
+        m_glCallCounter.skippedUniformUploads++;
+    } else {
+        m_glCallCounter.uniformUploads++;
+    }
+}
+
+const GLCallCounter& OpenGLContext::getGLCallCounter() const
+{
+    return m_glCallCounter;
+}
+
+void OpenGLContext::resetGLCallCounter()
+{
+    m_glCallCounter = GLCallCounter();
+}
+
+int OpenGLContext::getLiveBufferCount() const
+{
+    return m_liveBuffers;
+}
+
 inline const char *glGS(GLenum e)
 {
     return reinterpret_cast<const char *>(glGetString(e));
@@ -69,8 +288,14 @@ void OpenGLContext::debugContextVersion()
     }
 }
 
+/**
+ * @brief OpenGLContext::printGLErrorLog
+ *  glGetError waits for the GPU to catch up with every call made before it,
+ *  so the check only runs when built with CONFIG+=gl_debug (see the .pro file)
+ */
 void OpenGLContext::printGLErrorLog()
 {
+#ifdef GL_DEBUG_CHECKS
     GLenum error = glGetError();
     if (error != GL_NO_ERROR) {
         std::cerr << "OpenGL error " << error << ": ";
@@ -89,6 +314,7 @@ void OpenGLContext::printGLErrorLog()
         throw;
 #endif
     }
+#endif
 }
 
 void OpenGLContext::printLinkInfoLog(int prog)
@@ -5,15 +5,89 @@
 #include <QOpenGLExtraFunctions>
 
 
+// The base-vertex draws (GL 3.2) are not part of QOpenGLExtraFunctions,
+// they are resolved from the context in resolveDrawFunctions()
+typedef void (QOPENGLF_APIENTRYP DrawElementsBaseVertexFunc)(GLenum mode, GLsizei count, GLenum type,
+                                                               const void *indices, GLint baseVertex);
+typedef void (QOPENGLF_APIENTRYP MultiDrawElementsBaseVertexFunc)(GLenum mode, const GLsizei *count, GLenum type,
+                                                                    const void *const *indices, GLsizei drawCount,
+                                                                    const GLint *baseVertex);
+
+// The GL calls made since the last OpenGLContext::resetGLCallCounter()
+struct GLCallCounter
+{
+    int stateCalls;           // program / buffer / vertex attribute calls sent to GL
+    int skippedStateCalls;    // the same calls, skipped because GL was already in that state
+    int uniformUploads;
+    int skippedUniformUploads;
+    int drawCalls;
+
+    GLCallCounter()
+        : stateCalls(0), skippedStateCalls(0), uniformUploads(0), skippedUniformUploads(0), drawCalls(0)
+    {}
+};
+
+// Note: glUseProgram, glBindBuffer, glGenBuffers, glDeleteBuffers, glBindVertexArray and
+// gl(Enable/Disable)VertexAttribArray below hide the QOpenGLExtraFunctions ones,
+// so every call made through the context goes through the state cache.
 class OpenGLContext
     : public QOpenGLWidget,
       public QOpenGLExtraFunctions
 {
+private:
+    DrawElementsBaseVertexFunc mp_drawElementsBaseVertex;
+    MultiDrawElementsBaseVertexFunc mp_multiDrawElementsBaseVertex;
+
+    // GL state cache
+    // a value of UNKNOWN_STATE forces the next call through
+    static const GLuint UNKNOWN_STATE = 0xFFFFFFFF;
+    GLuint m_currProgram;
+    GLuint m_boundArrayBuffer;
+    GLuint m_boundElementBuffer; // per VAO
+    GLuint m_boundVAO;
+    GLuint m_enabledAttribs; // bit i set if attribute array i is enabled, per VAO
+    bool m_enabledAttribsKnown;
+
+    GLCallCounter m_glCallCounter;
+    // buffers generated & not yet deleted, a steady increase means a leak
+    int m_liveBuffers;
 
 public:
     OpenGLContext(QWidget *parent);
     ~OpenGLContext();
 
+    // call after initializeOpenGLFunctions()
+    void resolveDrawFunctions();
+    // glDrawElementsBaseVertex
+    void drawElementsBaseVertex(GLenum mode, GLsizei count, GLenum type, const void *indices, GLint baseVertex);
+    // glMultiDrawElementsBaseVertex, falls back to one glDrawElementsBaseVertex per draw if unavailable
+    void multiDrawElementsBaseVertex(GLenum mode, const GLsizei *count, GLenum type,
+                                     const void *const *indices, GLsizei drawCount, const GLint *baseVertex);
+
+    // the state cached on the CPU side
+    void glUseProgram(GLuint program);
+    void glBindBuffer(GLenum target, GLuint buffer);
+    void glGenBuffers(GLsizei n, GLuint *buffers);
+    void glDeleteBuffers(GLsizei n, const GLuint *buffers);
+    void glBindVertexArray(GLuint array);
+    void glEnableVertexAttribArray(GLuint index);
+    void glDisableVertexAttribArray(GLuint index);
+    // enable exactly the attribute arrays whose bits are set in attribs (first 16 attributes)
+    void setVertexAttribArrays(GLuint attribs);
+    // forget the cached state, e.g. after code outside this class changed GL state
+    void invalidateGLStateCache();
+
+    // counted draws
+    void glDrawElements(GLenum mode, GLsizei count, GLenum type, const void *indices);
+    void glDrawElementsInstanced(GLenum mode, GLsizei count, GLenum type, const void *indices, GLsizei instanceCount);
+
+    // instrumentation
+    // uniform uploads are made by the ShaderPrograms, they report them here
+    void countUniformUpload(bool skipped);
+    const GLCallCounter& getGLCallCounter() const;
+    void resetGLCallCounter();
+    int getLiveBufferCount() const;
+
     void debugContextVersion();
     void printGLErrorLog();
     void printLinkInfoLog(int prog);
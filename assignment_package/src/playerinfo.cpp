@@ -36,3 +36,42 @@ void PlayerInfo::slot_setZoneText(QString s) {
     ui->zoneLabel->setText(s);
 }
 
+void PlayerInfo::slot_setSimTickText(QString s) {
+    ui->simTickLabel->setText(s);
+}
+
+void PlayerInfo::slot_setFrameTimeText(QString s) {
+    ui->frameTimeLabel->setText(s);
+}
+
+void PlayerInfo::slot_setChunkCullText(QString s) {
+    ui->chunkCullLabel->setText(s);
+}
+
+void PlayerInfo::slot_setTerrainSubmitText(QString s) {
+    ui->terrainSubmitLabel->setText(s);
+}
+
+void PlayerInfo::slot_setGLCallsText(QString s) {
+    ui->glCallsLabel->setText(s);
+}
+
+void PlayerInfo::slot_setBufferText(QString s) {
+    ui->bufferLabel->setText(s);
+}
+
+void PlayerInfo::slot_setOcclusionText(QString s) {
+    ui->occlusionLabel->setText(s);
+}
+
+void PlayerInfo::slot_setCaveCullText(QString s) {
+    ui->caveCullLabel->setText(s);
+}
+
+void PlayerInfo::slot_setOverdrawText(QString s) {
+    ui->overdrawLabel->setText(s);
+}
+
+void PlayerInfo::slot_setMetricsText(QString s) {
+    ui->metricsLabel->setText(s);
+}
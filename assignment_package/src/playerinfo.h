@@ -20,6 +20,16 @@ public slots:
     void slot_setLookText(QString);
     void slot_setChunkText(QString);
     void slot_setZoneText(QString);
+    void slot_setSimTickText(QString);
+    void slot_setFrameTimeText(QString);
+    void slot_setChunkCullText(QString);
+    void slot_setTerrainSubmitText(QString);
+    void slot_setGLCallsText(QString);
+    void slot_setBufferText(QString);
+    void slot_setOcclusionText(QString);
+    void slot_setCaveCullText(QString);
+    void slot_setOverdrawText(QString);
+    void slot_setMetricsText(QString);
 
 private:
     Ui::PlayerInfo *ui;
@@ -0,0 +1,321 @@
+#include "profiler.h"
+#include <algorithm>
+#include <cstdio>
+
+
+void Profiler::Samples::push(float v)
+{
+    if (static_cast<int>(values.size()) < HISTORY) {
+        values.push_back(v);
+        return;
+    }
+    values[next] = v;
+    next = (next + 1) % HISTORY;
+}
+
+float Profiler::Samples::average() const
+{
+    if (values.empty()) {
+        return 0.f;
+    }
+    float sum = 0.f;
+    for (float v : values) {
+        sum += v;
+    }
+    return sum / values.size();
+}
+
+float Profiler::Samples::percentile99() const
+{
+    if (values.empty()) {
+        return 0.f;
+    }
+    std::vector<float> sorted = values;
+    unsigned int k = static_cast<unsigned int>(0.99f * (sorted.size() - 1));
+    std::nth_element(sorted.begin(), sorted.begin() + k, sorted.end());
+    return sorted[k];
+}
+
+
+Profiler::Profiler(OpenGLContext *context)
+    : mp_context(context), m_clock(), m_scopes(), m_frame(0), m_enabled(false),
+      m_gpuBusy(false), m_queriesCreated(false), m_lock(),
+      m_csvFile(), m_csv(), m_pendingRows()
+{
+    m_clock.start();
+}
+
+Profiler::~Profiler()
+{
+    stopCSV();
+}
+
+int Profiler::addScope(const std::string &name, bool gpu)
+{
+    Scope scope;
+    scope.name = name;
+    scope.gpu = gpu;
+    scope.cpuStart = -1;
+    scope.cpuFrameTotal = 0.f;
+    scope.queries.fill(0);
+    scope.issued.fill(false);
+    scope.issuedFrame.fill(-1);
+    scope.gpuActive = false;
+    m_scopes.push_back(scope);
+    return static_cast<int>(m_scopes.size()) - 1;
+}
+
+/**
+ * @brief Profiler::createQueries
+ *  The queries are created in the first profiled frame, when the GL context is current
+ */
+void Profiler::createQueries()
+{
+    for (Scope &scope : m_scopes) {
+        if (scope.gpu) {
+            mp_context->glGenQueries(GPU_LATENCY, scope.queries.data());
+        }
+    }
+    m_queriesCreated = true;
+}
+
+/**
+ * @brief Profiler::readQueries
+ *  Read the queries of this frame's parity, issued GPU_LATENCY frames ago,
+ *  if the GPU has their results. The times go into the scope's samples
+ *  & the pending CSV row of the frame they were issued in.
+ */
+void Profiler::readQueries()
+{
+    int parity = static_cast<int>(m_frame % GPU_LATENCY);
+    for (unsigned int id = 0; id < m_scopes.size(); id++) {
+        Scope &scope = m_scopes[id];
+        if (!scope.gpu || !scope.issued[parity]) {
+            continue;
+        }
+        GLuint available = 0;
+        mp_context->glGetQueryObjectuiv(scope.queries[parity], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available) {
+            // still busy, this scope is not timed on the GPU this frame
+            continue;
+        }
+        // 32 bits of nanoseconds hold up to 4 s, plenty for one pass
+        GLuint ns = 0;
+        mp_context->glGetQueryObjectuiv(scope.queries[parity], GL_QUERY_RESULT, &ns);
+        scope.issued[parity] = false;
+        float ms = ns / 1e6f;
+        scope.gpuTimes.push(ms);
+
+        for (CSVRow &row : m_pendingRows) {
+            if (row.frame == scope.issuedFrame[parity]) {
+                row.gpu[id] = ms;
+                break;
+            }
+        }
+    }
+}
+
+void Profiler::beginFrame()
+{
+    if (!m_enabled) {
+        return;
+    }
+    if (!m_queriesCreated) {
+        createQueries();
+    }
+    readQueries();
+    flushRows(false);
+}
+
+void Profiler::endFrame()
+{
+    if (!m_enabled) {
+        return;
+    }
+    // the CPU totals cover everything since the last endFrame, e.g. the tick() before this frame
+    {
+        QMutexLocker locker(&m_lock);
+        if (m_csvFile.isOpen()) {
+            CSVRow row;
+            row.frame = m_frame;
+            row.gpu.assign(m_scopes.size(), -1.f);
+            for (const Scope &scope : m_scopes) {
+                row.cpu.push_back(scope.cpuFrameTotal);
+            }
+            m_pendingRows.push_back(row);
+        }
+        for (Scope &scope : m_scopes) {
+            scope.cpuFrameTotal = 0.f;
+        }
+    }
+    m_frame++;
+}
+
+void Profiler::beginScope(int id)
+{
+    if (!m_enabled) {
+        return;
+    }
+    Scope &scope = m_scopes[id];
+    // gpu scopes are only timed on the GUI thread, between beginFrame & endFrame
+    if (scope.gpu && m_queriesCreated && !m_gpuBusy) {
+        int parity = static_cast<int>(m_frame % GPU_LATENCY);
+        if (!scope.issued[parity]) {
+            mp_context->glBeginQuery(GL_TIME_ELAPSED, scope.queries[parity]);
+            scope.gpuActive = true;
+            m_gpuBusy = true;
+        }
+    }
+    scope.cpuStart = m_clock.nsecsElapsed();
+}
+
+void Profiler::endScope(int id)
+{
+    Scope &scope = m_scopes[id];
+    if (!m_enabled || scope.cpuStart < 0) {
+        return;
+    }
+    float ms = (m_clock.nsecsElapsed() - scope.cpuStart) / 1e6f;
+    if (scope.gpuActive) {
+        int parity = static_cast<int>(m_frame % GPU_LATENCY);
+        mp_context->glEndQuery(GL_TIME_ELAPSED);
+        scope.issued[parity] = true;
+        scope.issuedFrame[parity] = m_frame;
+        scope.gpuActive = false;
+        m_gpuBusy = false;
+    }
+
+    scope.cpuStart = -1;
+
+    QMutexLocker locker(&m_lock);
+    scope.cpu.push(ms);
+    scope.cpuFrameTotal += ms;
+}
+
+void Profiler::setEnabled(bool enabled)
+{
+    m_enabled = enabled;
+}
+
+bool Profiler::isEnabled() const
+{
+    return m_enabled;
+}
+
+/**
+ * @brief Profiler::getReport
+ *  e.g. "opaque terrain   cpu 0.41 / 0.93   gpu 2.10 / 3.02" (average / p99, ms)
+ * @return
+ */
+std::vector<std::string> Profiler::getReport()
+{
+    QMutexLocker locker(&m_lock);
+    std::vector<std::string> lines;
+    lines.push_back("ms: avg / p99");
+    for (const Scope &scope : m_scopes) {
+        char line[128];
+        if (scope.gpu) {
+            std::snprintf(line, sizeof(line), "%-16s cpu %5.2f / %5.2f  gpu %5.2f / %5.2f", scope.name.c_str(),
+                          scope.cpu.average(), scope.cpu.percentile99(),
+                          scope.gpuTimes.average(), scope.gpuTimes.percentile99());
+        } else {
+            std::snprintf(line, sizeof(line), "%-16s cpu %5.2f / %5.2f", scope.name.c_str(),
+                          scope.cpu.average(), scope.cpu.percentile99());
+        }
+        lines.push_back(line);
+    }
+    return lines;
+}
+
+bool Profiler::startCSV(const QString &path)
+{
+    stopCSV();
+    m_csvFile.setFileName(path);
+    if (!m_csvFile.open(QIODevice::WriteOnly | QIODevice::Text)) {
+        return false;
+    }
+    m_csv.setDevice(&m_csvFile);
+
+    // header: frame, <scope> cpu ms, <scope> gpu ms, ...
+    m_csv << "frame";
+    for (const Scope &scope : m_scopes) {
+        m_csv << "," << QString::fromStdString(scope.name) << " cpu ms";
+        if (scope.gpu) {
+            m_csv << "," << QString::fromStdString(scope.name) << " gpu ms";
+        }
+    }
+    m_csv << "\n";
+    return true;
+}
+
+void Profiler::stopCSV()
+{
+    if (!m_csvFile.isOpen()) {
+        return;
+    }
+    flushRows(true);
+    m_csv.flush();
+    m_csv.setDevice(nullptr);
+    m_csvFile.close();
+}
+
+bool Profiler::isRecordingCSV() const
+{
+    return m_csvFile.isOpen();
+}
+
+/**
+ * @brief Profiler::flushRows
+ *  Write the rows of the frames whose GPU queries have been read
+ *  (a GPU time that was not available is left empty)
+ * @param all : write every pending row, e.g. when the recording stops
+ */
+void Profiler::flushRows(bool all)
+{
+    while (!m_pendingRows.empty() && (all || m_pendingRows.front().frame <= m_frame - GPU_LATENCY)) {
+        const CSVRow &row = m_pendingRows.front();
+        if (m_csvFile.isOpen()) {
+            m_csv << row.frame;
+            for (unsigned int id = 0; id < m_scopes.size(); id++) {
+                m_csv << "," << row.cpu[id];
+                if (m_scopes[id].gpu) {
+                    m_csv << ",";
+                    if (row.gpu[id] >= 0.f) {
+                        m_csv << row.gpu[id];
+                    }
+                }
+            }
+            m_csv << "\n";
+        }
+        m_pendingRows.pop_front();
+    }
+}
+
+void Profiler::destroy()
+{
+    if (m_queriesCreated) {
+        for (Scope &scope : m_scopes) {
+            if (scope.gpu) {
+                mp_context->glDeleteQueries(GPU_LATENCY, scope.queries.data());
+            }
+        }
+        m_queriesCreated = false;
+    }
+    stopCSV();
+}
+
+
+ProfileScope::ProfileScope(Profiler *profiler, int id)
+    : mp_profiler(profiler), m_id(id)
+{
+    if (mp_profiler != nullptr) {
+        mp_profiler->beginScope(m_id);
+    }
+}
+
+ProfileScope::~ProfileScope()
+{
+    if (mp_profiler != nullptr) {
+        mp_profiler->endScope(m_id);
+    }
+}
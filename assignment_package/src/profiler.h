@@ -0,0 +1,138 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#pragma once
+
+#include <openglcontext.h>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QMutex>
+#include <QTextStream>
+#include <array>
+#include <atomic>
+#include <deque>
+#include <string>
+#include <vector>
+
+// Times named sections ("scopes") of a frame on the CPU and, for the scopes
+// added with gpu = true, on the GPU with GL_TIME_ELAPSED queries.
+// Each GPU scope has two queries used in alternate frames; a query is read
+// two frames after it was issued, when the GPU is normally done with it,
+// so reading never stalls (a query not done yet is skipped for a frame).
+// CPU scopes may be timed from any thread, GPU scopes only on the GUI thread
+// and they must not nest (only one GL_TIME_ELAPSED query can be active).
+// All the scopes must be added before another thread starts using the profiler.
+class Profiler
+{
+public:
+    // samples kept per scope for the average & p99
+    static const int HISTORY = 240;
+    // frames between issuing a GPU query & reading it
+    static const int GPU_LATENCY = 2;
+
+    Profiler(OpenGLContext *context);
+    ~Profiler();
+
+    // returns the id of the scope
+    int addScope(const std::string &name, bool gpu);
+
+    // call at the start & end of paintGL, on the GUI thread
+    void beginFrame();
+    void endFrame();
+
+    void beginScope(int id);
+    void endScope(int id);
+
+    // profile only while enabled (the overlay is shown or a CSV is recorded)
+    void setEnabled(bool enabled);
+    bool isEnabled() const;
+
+    // one line per scope: name, CPU & GPU average / p99 in ms
+    std::vector<std::string> getReport();
+
+    // write one row per frame: the CPU time of every scope in the frame & the GPU time of the GPU scopes
+    bool startCSV(const QString &path);
+    void stopCSV();
+    bool isRecordingCSV() const;
+
+    // delete the GL queries
+    void destroy();
+
+private:
+    struct Samples
+    {
+        std::vector<float> values;
+        int next;
+
+        Samples()
+            : values(), next(0)
+        {}
+
+        void push(float v);
+        float average() const;
+        float percentile99() const;
+    };
+
+    struct Scope
+    {
+        std::string name;
+        bool gpu;
+        qint64 cpuStart; // -1 if the scope was not begun while enabled
+        Samples cpu;
+        Samples gpuTimes;
+        // CPU time (ms) of the scope since the last endFrame, it may run several times
+        float cpuFrameTotal;
+
+        // GL_TIME_ELAPSED queries, one per frame parity
+        std::array<GLuint, GPU_LATENCY> queries;
+        std::array<bool, GPU_LATENCY> issued;
+        std::array<long long, GPU_LATENCY> issuedFrame;
+        bool gpuActive;
+    };
+
+    // the frame of a CSV row & the times of its scopes, -1 if unknown
+    struct CSVRow
+    {
+        long long frame;
+        std::vector<float> cpu;
+        std::vector<float> gpu;
+    };
+
+    OpenGLContext *mp_context;
+    QElapsedTimer m_clock;
+    std::vector<Scope> m_scopes;
+    long long m_frame;
+    std::atomic<bool> m_enabled;
+    // another GPU scope is active
+    bool m_gpuBusy;
+    bool m_queriesCreated;
+    // protects the CPU samples, written by other threads too
+    QMutex m_lock;
+
+    QFile m_csvFile;
+    QTextStream m_csv;
+    // rows waiting for their GPU times
+    std::deque<CSVRow> m_pendingRows;
+
+    void createQueries();
+    // read the GPU queries issued GPU_LATENCY frames ago
+    void readQueries();
+    // write the rows whose GPU times are read
+    void flushRows(bool all);
+};
+
+// Times a scope from its construction to the end of the C++ scope.
+// Does nothing if profiler is null.
+class ProfileScope
+{
+private:
+    Profiler *mp_profiler;
+    int m_id;
+
+public:
+    ProfileScope(Profiler *profiler, int id);
+    ~ProfileScope();
+};
+
+
+#endif // PROFILER_H
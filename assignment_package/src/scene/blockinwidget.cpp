@@ -216,45 +216,18 @@ void BlockInWidget::setWidgetInfo() {
 }
 
 /**
- * @brief Widget::createVBOdata
- *  inherited from Drawable
+ * @brief BlockInWidget::tessellate
+ *  inherited from Widget
  *  for custom data that need to pass to GPU
+ * @param verts
  */
-void BlockInWidget::createVBOdata() {
-
-    std::vector<GLuint> indices;
-    std::vector<GLuint> faceIndices = {0, 1, 2, 0, 2, 3};
-    std::vector<float> buffer_pos;
-    std::vector<float> buffer_uv;
-    int nVert = 0;
+void BlockInWidget::tessellate(std::vector<HUDVertex> &verts) {
 
     for (auto& drawItem : drawItems) {
         for (int i=0; i<4; ++i) {
-           pushVec4ToBuffer(buffer_pos, glm::vec4(drawItem[i], 0.999999f, 1.f));
-           pushVec2ToBuffer(buffer_uv, drawItem[i+4]);
-        }
-
-        // add indices for each face (4 vertices)
-        for (int index : faceIndices) {
-            indices.push_back(nVert + index);
+            verts.push_back(HUDVertex(drawItem[i], drawItem[i+4]));
         }
-        // move the offset for indices
-        nVert += 4;
     }
 
-    m_count = indices.size();
-
-    generateIdx();
-    bindIdx();
-    mp_context->glBufferData(GL_ELEMENT_ARRAY_BUFFER, m_count * sizeof(GLuint), indices.data(), GL_STATIC_DRAW);
-
-    generatePos();
-    bindPos();
-    mp_context->glBufferData(GL_ARRAY_BUFFER, buffer_pos.size() * sizeof(float), buffer_pos.data(), GL_STATIC_DRAW);
-
-    generateUV();
-    mp_context->glBindBuffer(GL_ARRAY_BUFFER, m_bufUV);
-    mp_context->glBufferData(GL_ARRAY_BUFFER, buffer_uv.size() * sizeof(float), buffer_uv.data(), GL_STATIC_DRAW);
-
     drawItems.clear();
 }
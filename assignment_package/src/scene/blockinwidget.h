@@ -19,7 +19,8 @@ public:
     // store 3D blocks
     void storeItemIntoDrawVector(RecRegion* currRegion, int shiftX, int shiftY, std::array<std::array<glm::vec2, 4>, 3>& uvCoords);
     void setWidgetInfo();
-    virtual void createVBOdata();
+    // only the collected items, the widget itself is drawn by another Widget
+    virtual void tessellate(std::vector<HUDVertex> &verts);
 };
 
 #endif // BLOCKINWIDGET_H
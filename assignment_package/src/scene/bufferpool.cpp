@@ -0,0 +1,76 @@
+#include "bufferpool.h"
+
+
+BufferPool::BufferPool(OpenGLContext *context)
+    : mp_context(context), m_buckets(), m_pooledCount(0)
+{}
+
+int BufferPool::bucketIndex(GLsizeiptr size)
+{
+    int index = 0;
+    while ((static_cast<GLsizeiptr>(1) << (MIN_CAPACITY_LOG2 + index)) < size) {
+        index++;
+    }
+    return index;
+}
+
+/**
+ * @brief BufferPool::acquire
+ *  Reuse an idle buffer of size's bucket, or create a new one.
+ * @param target : the buffer is left bound to target
+ * @param size : in bytes
+ * @return buffer
+ */
+BufferPool::Buffer BufferPool::acquire(GLenum target, GLsizeiptr size)
+{
+    int index = bucketIndex(size);
+    Buffer buf;
+    buf.capacity = static_cast<GLsizeiptr>(1) << (MIN_CAPACITY_LOG2 + index);
+
+    if (index < static_cast<int>(m_buckets.size()) && !m_buckets[index].empty()) {
+        buf.name = m_buckets[index].back();
+        m_buckets[index].pop_back();
+        m_pooledCount--;
+        mp_context->glBindBuffer(target, buf.name);
+        return buf;
+    }
+
+    mp_context->glGenBuffers(1, &buf.name);
+    mp_context->glBindBuffer(target, buf.name);
+    mp_context->glBufferData(target, buf.capacity, nullptr, GL_DYNAMIC_DRAW);
+    return buf;
+}
+
+void BufferPool::release(const Buffer &buf)
+{
+    if (buf.name == 0) {
+        return;
+    }
+
+    int index = bucketIndex(buf.capacity);
+    if (index >= static_cast<int>(m_buckets.size())) {
+        m_buckets.resize(index + 1);
+    }
+    if (static_cast<int>(m_buckets[index].size()) >= MAX_PER_BUCKET) {
+        mp_context->glDeleteBuffers(1, &buf.name);
+        return;
+    }
+    m_buckets[index].push_back(buf.name);
+    m_pooledCount++;
+}
+
+void BufferPool::clear()
+{
+    for (std::vector<GLuint> &bucket : m_buckets) {
+        if (!bucket.empty()) {
+            mp_context->glDeleteBuffers(static_cast<GLsizei>(bucket.size()), bucket.data());
+        }
+        bucket.clear();
+    }
+    m_pooledCount = 0;
+}
+
+int BufferPool::getPooledCount() const
+{
+    return m_pooledCount;
+}
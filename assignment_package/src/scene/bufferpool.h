@@ -0,0 +1,44 @@
+#pragma once
+#include <openglcontext.h>
+#include <vector>
+
+// Recycles GL buffers by size, so a buffer that is replaced by a bigger
+// (or packed) one can be handed out again instead of deleted & re-allocated.
+// Capacities are rounded up to a power of two (at least MIN_CAPACITY bytes),
+// each power of two is one bucket of at most MAX_PER_BUCKET idle buffers.
+class BufferPool
+{
+public:
+    struct Buffer
+    {
+        GLuint name;
+        GLsizeiptr capacity; // in bytes
+
+        Buffer()
+            : name(0), capacity(0)
+        {}
+    };
+
+    static const int MIN_CAPACITY_LOG2 = 12; // 4 KB
+    static const int MAX_PER_BUCKET = 2;
+
+private:
+    OpenGLContext *mp_context;
+    // bucket i holds buffers of (1 << (MIN_CAPACITY_LOG2 + i)) bytes
+    std::vector<std::vector<GLuint>> m_buckets;
+    int m_pooledCount;
+
+    static int bucketIndex(GLsizeiptr size);
+
+public:
+    BufferPool(OpenGLContext *context);
+
+    // a buffer of at least size bytes bound to target, its contents are undefined
+    Buffer acquire(GLenum target, GLsizeiptr size);
+    // give the buffer back, it is deleted if its bucket is full
+    void release(const Buffer &buf);
+    // delete all the idle buffers
+    void clear();
+
+    int getPooledCount() const;
+};
@@ -3,13 +3,18 @@
 
 
 
-Chunk::Chunk(OpenGLContext *context)
+Chunk::Chunk(OpenGLContext *context, int x, int z)
     : Drawable(context),
-      m_blocks(),
+      m_blocks(), m_sectionBlockCounts(), m_origin(x, z),
       m_neighbors{{XPOS, nullptr}, {XNEG, nullptr}, {ZPOS, nullptr}, {ZNEG, nullptr}},
-      vboLoaded(false)
+      vboLoaded(false),
+      m_sectionOffsets(), m_transparentSectionOffsets(), m_sectionConnectivity(),
+      m_arenaSlot(), m_transparentArenaSlot(),
+      m_navGrid(nullptr), m_pendingNavGrid(nullptr), m_editCount(0)
 {
     std::fill_n(m_blocks.begin(), 65536, EMPTY);
+    m_sectionBlockCounts.fill(0);
+    m_sectionConnectivity.fill(SectionConnectivity::all());
 }
 
 
@@ -25,7 +30,26 @@ BlockType Chunk::getBlockAt(int x, int y, int z) const {
 
 // Does bounds checking with at()
 void Chunk::setBlockAt(unsigned int x, unsigned int y, unsigned int z, BlockType t) {
-    m_blocks.at(x + 16 * y + 16 * 256 * z) = t;
+    BlockType &block = m_blocks.at(x + 16 * y + 16 * 256 * z);
+    if (block == t) {
+        // e.g. the erdtree redrawn every step, nothing to count or to navigate differently
+        return;
+    }
+    // a grid built from the blocks as they are now is patched below
+    adoptPendingNavGrid();
+
+    m_sectionBlockCounts[y / 16] += (t != EMPTY) - (block != EMPTY);
+    block = t;
+    m_editCount++;
+
+    // the chunks being filled have no navigation layer yet
+    if (m_navGrid != nullptr) {
+        m_navGrid->update(*this, x, y, z);
+    }
+}
+
+bool Chunk::isSectionEmpty(int section) const {
+    return m_sectionBlockCounts[section] == 0;
 }
 
 
@@ -46,8 +70,13 @@ void Chunk::linkNeighbor(uPtr<Chunk> &neighbor, Direction dir) {
 }
 
 
+BlockType ChunkBlocks::getBlockAt(int x, int y, int z) const
+{
+    return blocks[x + 16 * y + 16 * 256 * z];
+}
+
 /**
- * @brief Chunk::getNeighborBlock
+ * @brief ChunkBlocks::getNeighborBlock
  *  Retrieve the neighboring block (along the dirVec)
  *  of the current block location at (x, y, z).
  * @param x
@@ -56,54 +85,68 @@ void Chunk::linkNeighbor(uPtr<Chunk> &neighbor, Direction dir) {
  * @param dirVec
  * @return
  */
-BlockType Chunk::getNeighborBlock(int x, int y, int z, glm::vec4 dirVec) const
+BlockType ChunkBlocks::getNeighborBlock(int x, int y, int z, glm::vec4 dirVec) const
 {
-    // init to empty
-    BlockType block = EMPTY;
-
     // get neighboring block coordiante
     int nx = x + (int) dirVec[0];
     int ny = y + (int) dirVec[1];
     int nz = z + (int) dirVec[2];
 
-    // check boundary at first
     // y = -1 or 256 => ignore, treat as empty (OUT OF THE WORLD)
-    // either x = (-1 or 16) or z = (-1 or 16) => check neighboring chunk
     if (ny == -1 || ny == 256) {
-        // treat it as EMPTY
-        return block;
+        return EMPTY;
     }
-
-    // <neighbor x coord, Direction, neighbor's x block at>
-    std::tuple<int, Direction, int> xBoundaryInfo[2] = {std::make_tuple(-1, XNEG, 15),
-                                                        std::make_tuple(16, XPOS, 0)};
-    for (int i = 0; i < 2; i++) {
-        if (nx == std::get<0>(xBoundaryInfo[i])) {
-            Direction dir = std::get<1>(xBoundaryInfo[i]);
-            // note: each dir is already instantiated in m_neighbors (to nullptr)
-            Chunk *neighborChunk = m_neighbors.at(dir);
-            return neighborChunk != nullptr ? neighborChunk->getBlockAt(std::get<2>(xBoundaryInfo[i]), y, z)
-                                            : block;
-        }
+    // either x = (-1 or 16) or z = (-1 or 16) => the face of the neighboring chunk
+    if (nx == 16) {
+        return borders[0][z + 16 * y];
     }
-
-    // <neighbor z coord, Direction, neighbor's z block at>
-    std::tuple<int, Direction, int> zBoundaryInfo[2] = {std::make_tuple(-1, ZNEG, 15),
-                                                        std::make_tuple(16, ZPOS, 0)};
-    for (int i = 0; i < 2; i++) {
-        if (nz == std::get<0>(zBoundaryInfo[i])) {
-            Direction dir = std::get<1>(zBoundaryInfo[i]);
-            // note: each dir is already instantiated in m_neighbors (to nullptr)
-            Chunk *neighborChunk = m_neighbors.at(dir);
-            return neighborChunk != nullptr ? neighborChunk->getBlockAt(x, y, std::get<2>(zBoundaryInfo[i]))
-                                            : block;
-        }
+    if (nx == -1) {
+        return borders[1][z + 16 * y];
+    }
+    if (nz == 16) {
+        return borders[2][x + 16 * y];
+    }
+    if (nz == -1) {
+        return borders[3][x + 16 * y];
     }
 
     // within the range => check the chunk itself
     return getBlockAt(nx, ny, nz);
 }
 
+/**
+ * @brief Chunk::copyBlocks
+ *  The faces of the neighbors: x 0 of XPOS, x 15 of XNEG, z 0 of ZPOS & z 15 of ZNEG
+ * @return
+ */
+uPtr<ChunkBlocks> Chunk::copyBlocks() const
+{
+    uPtr<ChunkBlocks> copy = mkU<ChunkBlocks>();
+    copy->blocks = m_blocks;
+    copy->editCount = m_editCount;
+
+    const Direction dirs[4] = {XPOS, XNEG, ZPOS, ZNEG};
+    for (int d = 0; d < 4; d++) {
+        const Chunk *neighbor = m_neighbors.at(dirs[d]);
+        std::array<BlockType, 4096> &border = copy->borders[d];
+        if (neighbor == nullptr) {
+            border.fill(EMPTY);
+            continue;
+        }
+        for (int y = 0; y < 256; y++) {
+            for (int i = 0; i < 16; i++) {
+                switch (dirs[d]) {
+                case XPOS: border[i + 16 * y] = neighbor->getBlockAt(0, y, i); break;
+                case XNEG: border[i + 16 * y] = neighbor->getBlockAt(15, y, i); break;
+                case ZPOS: border[i + 16 * y] = neighbor->getBlockAt(i, y, 0); break;
+                default: border[i + 16 * y] = neighbor->getBlockAt(i, y, 15); break;
+                }
+            }
+        }
+    }
+    return copy;
+}
+
 /**
  * @brief Chunk::getNeighbors
  * @return
@@ -148,16 +191,52 @@ void pushVec2ToBuffer(std::vector<float> &buf, const glm::vec2 &vec)
  * @return
  */
 ChunkVBOdata Chunk::generateVBOdata()
+{
+    return generateVBOdata(*copyBlocks());
+}
+
+/**
+ * @brief Chunk::generateVBOdata
+ *  Only reads the copy, so it is safe on the VBO worker threads
+ *  while the blocks of the chunk are edited
+ * @param blocks
+ * @return
+ */
+ChunkVBOdata Chunk::generateVBOdata(const ChunkBlocks &blocks)
 {
     // init
     ChunkVBOdata vbo = ChunkVBOdata((Chunk*)(this));
 
-    generateVBOdataDrawType(vbo, TerrainDrawType::opaque);
-    generateVBOdataDrawType(vbo, TerrainDrawType::transparent);
+    generateVBOdataDrawType(vbo, TerrainDrawType::opaque, blocks);
+    generateVBOdataDrawType(vbo, TerrainDrawType::transparent, blocks);
+    generateSectionConnectivity(vbo, blocks);
 
     return vbo;
 }
 
+/**
+ * @brief Chunk::generateSectionConnectivity
+ *  Find which faces of each 16 x 16 x 16 section can see each other
+ *  through non-opaque blocks (see SectionConnectivity).
+ *  Only the blocks of this chunk are used.
+ * @param vbo, ChunkVBOdata
+ * @param blocks
+ */
+void Chunk::generateSectionConnectivity(ChunkVBOdata &vbo, const ChunkBlocks &blocks) const
+{
+    std::array<bool, SectionConnectivity::CELL_COUNT> opaque;
+    for (int section = 0; section < 16; section++) {
+        for (int z = 0; z < 16; z++) {
+            for (int y = 0; y < 16; y++) {
+                for (int x = 0; x < 16; x++) {
+                    opaque[x + 16 * (y + 16 * z)] = Block::isOpaque(blocks.getBlockAt(x, section * 16 + y, z));
+                }
+            }
+        }
+        vbo.sectionConnectivity[section] = SectionConnectivity::compute(opaque);
+    }
+}
+
 /**
  * @brief Chunk::generateVBOdata
  *  This method generates the needed vertex buffer & index data for this chunk.
@@ -165,9 +244,10 @@ ChunkVBOdata Chunk::generateVBOdata()
  *  All of them are put in a vector<float>.
  * @param vbo, ChunkVBOdata
  * @param drawType, TerrainDrawType
+ * @param blocks
  * @return
  */
-void Chunk::generateVBOdataDrawType(ChunkVBOdata &vbo, TerrainDrawType drawType) {
+void Chunk::generateVBOdataDrawType(ChunkVBOdata &vbo, TerrainDrawType drawType, const ChunkBlocks &blocks) {
 
     // basically, iterate through all the blocks contained in a chunk
     // each chunk : 16 x 256 x 16
@@ -179,25 +259,33 @@ void Chunk::generateVBOdataDrawType(ChunkVBOdata &vbo, TerrainDrawType drawType)
     glm::vec4 out = glm::vec4();
     std::vector<float>* processingBuffer;
     std::vector<GLuint>* processingIndices;
+    std::array<int, 17>* processingSectionOffsets;
 
     switch (drawType) {
     case (TerrainDrawType::opaque):
         processingBuffer = &vbo.buffer;
         processingIndices = &vbo.indices;
+        processingSectionOffsets = &vbo.sectionOffsets;
         break;
     case (TerrainDrawType::transparent):
         processingBuffer = &vbo.transparentBuffer;
         processingIndices = &vbo.transparentIndices;
+        processingSectionOffsets = &vbo.transparentSectionOffsets;
         break;
     }
 
-    for (int x = 0; x < 16; x++) {
-        for (int y = 0; y < 256; y++) {
+    // y is the outer loop, so the indices of each 16-block tall section are contiguous
+    // and the terrain can draw only the sections inside the view frustum
+    for (int y = 0; y < 256; y++) {
+        if (y % 16 == 0) {
+            (*processingSectionOffsets)[y / 16] = static_cast<int>(processingIndices->size());
+        }
+        for (int x = 0; x < 16; x++) {
             for (int z = 0; z < 16; z++) {
 
                 // get each block at (x, y, z) in this chunk
                 // remember, there are 6 faces for a block
-                BlockType blockType = getBlockAt(x, y, z);
+                BlockType blockType = blocks.getBlockAt(x, y, z);
 
                 if (!checkBlockDrawing(drawType, blockType)) {
                     continue;
@@ -208,7 +296,7 @@ void Chunk::generateVBOdataDrawType(ChunkVBOdata &vbo, TerrainDrawType drawType)
                 for (const BlockFace &face : Block::BlockCollection[blockType]) {
 
                     // the neighboring block might be in the neighboring chunk
-                    BlockType neighborBlockType = getNeighborBlock(x, y, z, face.normal);
+                    BlockType neighborBlockType = blocks.getNeighborBlock(x, y, z, face.normal);
 
                     if (!checkBlockFaceDrawing(drawType, neighborBlockType)) {
                         continue;
@@ -217,7 +305,7 @@ void Chunk::generateVBOdataDrawType(ChunkVBOdata &vbo, TerrainDrawType drawType)
                     // add this face
                     for (const VertexData &vert : face.vertices) {
                         // buffer: pos0nor0col0uv0
-                        pushVec4ToBuffer(*processingBuffer, vert.pos + glm::vec4(x, y, z, 0));
+                        pushVec4ToBuffer(*processingBuffer, vert.pos + glm::vec4(m_origin.x + x, y, m_origin.y + z, 0));
                         pushVec4ToBuffer(*processingBuffer, face.normal);
                         pushVec2ToBuffer(*processingBuffer, vert.uv);
                         pushVec2ToBuffer(*processingBuffer, Block::getAnimatableFlag(blockType));
@@ -232,6 +320,7 @@ void Chunk::generateVBOdataDrawType(ChunkVBOdata &vbo, TerrainDrawType drawType)
             }
         }
     }
+    (*processingSectionOffsets)[16] = static_cast<int>(processingIndices->size());
 }
 
 /**
@@ -294,25 +383,24 @@ void Chunk::createVBOdata(ChunkVBOdata &vbo)
     // remember to set m_count
     m_count = vbo.indices.size();
     m_transparentCount = vbo.transparentIndices.size();
+    m_sectionOffsets = vbo.sectionOffsets;
+    m_transparentSectionOffsets = vbo.transparentSectionOffsets;
+    m_sectionConnectivity = vbo.sectionConnectivity;
 
     int bufferSize = vbo.buffer.size();
     int transparentBufferSize = vbo.transparentBuffer.size();
 
     generateIdx();
-    mp_context->glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_bufIdx);
-    mp_context->glBufferData(GL_ELEMENT_ARRAY_BUFFER, m_count * sizeof(GLuint), vbo.indices.data(), GL_STATIC_DRAW);
+    bufferData(GL_ELEMENT_ARRAY_BUFFER, m_bufIdx, m_count * sizeof(GLuint), vbo.indices.data());
 
     generatePos();
-    mp_context->glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_bufPos);
-    mp_context->glBufferData(GL_ELEMENT_ARRAY_BUFFER, bufferSize * sizeof(float), vbo.buffer.data(), GL_STATIC_DRAW);
+    bufferData(GL_ELEMENT_ARRAY_BUFFER, m_bufPos, bufferSize * sizeof(float), vbo.buffer.data());
 
     generateTransparentIdx();
-    mp_context->glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_bufTransparentIdx);
-    mp_context->glBufferData(GL_ELEMENT_ARRAY_BUFFER, m_transparentCount * sizeof(GLuint), vbo.transparentIndices.data(), GL_STATIC_DRAW);
+    bufferData(GL_ELEMENT_ARRAY_BUFFER, m_bufTransparentIdx, m_transparentCount * sizeof(GLuint), vbo.transparentIndices.data());
 
     generateTransparentData();
-    mp_context->glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_bufTransparentData);
-    mp_context->glBufferData(GL_ELEMENT_ARRAY_BUFFER, transparentBufferSize * sizeof(float), vbo.transparentBuffer.data(), GL_STATIC_DRAW);
+    bufferData(GL_ELEMENT_ARRAY_BUFFER, m_bufTransparentData, transparentBufferSize * sizeof(float), vbo.transparentBuffer.data());
 
     // set to vboLoaded to true
     vboLoaded = true;
@@ -321,12 +409,39 @@ void Chunk::createVBOdata(ChunkVBOdata &vbo)
 
 }
 
+/**
+ * @brief Chunk::createVBOdata
+ *  Upload the mesh into the terrain's arenas instead of buffers owned by this chunk,
+ *  so that all the chunks can be drawn with one draw call.
+ * @param vbo : ChunkVBOdata, contains the loaded interleaved vertex data and index data
+ * @param arena : ChunkArena, for the opaque mesh
+ * @param transparentArena : ChunkArena, for the transparent mesh
+ */
+void Chunk::createVBOdata(ChunkVBOdata &vbo, ChunkArena &arena, ChunkArena &transparentArena)
+{
+    // a chunk is re-meshed when one of its blocks changes
+    arena.free(m_arenaSlot);
+    transparentArena.free(m_transparentArenaSlot);
+
+    m_arenaSlot = arena.allocate(vbo.buffer, vbo.indices);
+    m_transparentArenaSlot = transparentArena.allocate(vbo.transparentBuffer, vbo.transparentIndices);
+
+    m_count = vbo.indices.size();
+    m_transparentCount = vbo.transparentIndices.size();
+    m_sectionOffsets = vbo.sectionOffsets;
+    m_transparentSectionOffsets = vbo.transparentSectionOffsets;
+    m_sectionConnectivity = vbo.sectionConnectivity;
+
+    vboLoaded = true;
+}
+
 /**
  * @brief Chunk::createVBOdata
  * Generate the buffer for chunk rendering.
  * Note: each block & each block face are already created in block.h
  * Note: this is used only for MS1. In MS2 & MS3, vbo of each chunk
  * is hold by the terrain. Won't be generated on the fly here.
+ * Note: the positions are already in world space, draw it with an identity model matrix.
  */
 void Chunk::createVBOdata()
 {
@@ -344,6 +459,31 @@ bool Chunk::isVBOLoaded() const
     return vboLoaded;
 }
 
+/**
+ * @brief Chunk::getSectionOffset
+ * @param section : int, 0 - 15 for the sections from the bottom, 16 for the end of the last one
+ * @param drawType : TerrainDrawType
+ * @return the first index of the section
+ */
+int Chunk::getSectionOffset(int section, TerrainDrawType drawType) const
+{
+    if (drawType == TerrainDrawType::transparent) {
+        return m_transparentSectionOffsets[section];
+    }
+    return m_sectionOffsets[section];
+}
+
+
+SectionConnectivity Chunk::getSectionConnectivity(int section) const
+{
+    return m_sectionConnectivity[section];
+}
+
+glm::ivec2 Chunk::getOrigin() const
+{
+    return m_origin;
+}
+
 
 /**
  * @brief Chunk::destroyVBOdata
@@ -354,7 +494,95 @@ void Chunk::destroyVBOdata()
     vboLoaded = false;
 }
 
+/**
+ * @brief Chunk::destroyVBOdata
+ * @param arena
+ * @param transparentArena
+ */
+void Chunk::destroyVBOdata(ChunkArena &arena, ChunkArena &transparentArena)
+{
+    arena.free(m_arenaSlot);
+    transparentArena.free(m_transparentArenaSlot);
+    m_count = -1;
+    m_transparentCount = -1;
+    vboLoaded = false;
+}
 
+/**
+ * @brief Chunk::getArenaSlot
+ * @param drawType
+ * @return the slot of the mesh of drawType
+ */
+const ChunkArenaSlot& Chunk::getArenaSlot(TerrainDrawType drawType) const
+{
+    if (drawType == TerrainDrawType::transparent) {
+        return m_transparentArenaSlot;
+    }
+    return m_arenaSlot;
+}
 
-Chunk::~Chunk(){}
+
+
+/**
+ * @brief Chunk::generateNavGrid
+ * @return
+ */
+uPtr<NavGrid> Chunk::generateNavGrid() const
+{
+    return generateNavGrid(*copyBlocks());
+}
+
+/**
+ * @brief Chunk::generateNavGrid
+ * @param blocks
+ * @return
+ */
+uPtr<NavGrid> Chunk::generateNavGrid(const ChunkBlocks &blocks)
+{
+    uPtr<NavGrid> navGrid = mkU<NavGrid>();
+    navGrid->build(blocks);
+    return navGrid;
+}
+
+/**
+ * @brief Chunk::setNavGrid
+ *  A navigation layer handed over before the previous one was read replaces it
+ * @param navGrid
+ */
+void Chunk::setNavGrid(uPtr<NavGrid> navGrid)
+{
+    delete m_pendingNavGrid.exchange(navGrid.release());
+}
+
+/**
+ * @brief Chunk::adoptPendingNavGrid
+ *  A grid built from blocks edited since misses those edits: it's dropped.
+ *  The current grid was patched by each of them, if there's none yet one is built now
+ */
+void Chunk::adoptPendingNavGrid() const
+{
+    if (m_pendingNavGrid.load(std::memory_order_relaxed) == nullptr) {
+        return;
+    }
+    uPtr<NavGrid> pending(m_pendingNavGrid.exchange(nullptr));
+    if (pending == nullptr) {
+        return;
+    }
+    if (pending->getEditCount() == m_editCount) {
+        m_navGrid = std::move(pending);
+    } else if (m_navGrid == nullptr) {
+        m_navGrid = generateNavGrid();
+    }
+}
+
+const NavGrid* Chunk::getNavGrid() const
+{
+    adoptPendingNavGrid();
+    return m_navGrid.get();
+}
+
+Chunk::~Chunk()
+{
+    delete m_pendingNavGrid.load();
+}
 
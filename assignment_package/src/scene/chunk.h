@@ -4,7 +4,11 @@
 #include "glm_includes.h"
 #include "block.h"
 #include "utils.h"
+#include "chunkarena.h"
+#include "sectiongraph.h"
+#include "navgrid.h"
 #include <array>
+#include <atomic>
 #include <unordered_map>
 #include <cstddef>
 #include <openglcontext.h>
@@ -28,11 +32,39 @@ struct ChunkVBOdata
     // order: pos (vec4) + normal (vec4) + color (vec4) + uv (vec2)
     std::vector<float> transparentBuffer;
 
+    // the first index of each 16 x 16 x 16 section (plus the total count at the end)
+    // the indices of section s are [sectionOffsets[s], sectionOffsets[s + 1])
+    std::array<int, 17> sectionOffsets;
+    std::array<int, 17> transparentSectionOffsets;
+
+    // which faces of each section are linked through non-opaque blocks
+    std::array<SectionConnectivity, 16> sectionConnectivity;
+
     // constructors
     ChunkVBOdata(Chunk* chunk)
         : mp_chunk(chunk), indices(), buffer(),
-          transparentIndices(), transparentBuffer() {}
+          transparentIndices(), transparentBuffer(),
+          sectionOffsets(), transparentSectionOffsets(), sectionConnectivity() {}
+
+};
 
+// A copy of the blocks a chunk's mesh & navigation layer are built from:
+// its own & the faces of its 4 neighbors that touch it (EMPTY where there's no neighbor).
+// Taken with the world lock held (see Terrain::spawnPendingVBOWorkers),
+// so a VBOWorker never reads blocks the simulation is editing.
+struct ChunkBlocks
+{
+    // indexed as in Chunk
+    std::array<BlockType, 65536> blocks;
+    // by neighbor in the order XPOS, XNEG, ZPOS, ZNEG, indexed by i + 16 * y
+    // (i: the z of the block along an x face, its x along a z face)
+    std::array<std::array<BlockType, 4096>, 4> borders;
+    // the chunk's edit count when copied, stamped on the NavGrid built from the copy
+    uint64_t editCount;
+
+    BlockType getBlockAt(int x, int y, int z) const;
+    // the block next to (x, y, z) along dirVec, out of the chunk from the borders
+    BlockType getNeighborBlock(int x, int y, int z, glm::vec4 dirVec) const;
 };
 
 // One Chunk is a 16 x 256 x 16 section of the world,
@@ -47,20 +79,45 @@ class Chunk : public Drawable {
 private:
     // All of the blocks contained within this Chunk
     std::array<BlockType, 65536> m_blocks;
+    // the non-EMPTY blocks of each 16 x 16 x 16 section, kept by setBlockAt
+    std::array<unsigned short, 16> m_sectionBlockCounts;
+    // the world-space (x, z) of the lower-left corner
+    // the vertices are generated in world space, so all the chunks share one model matrix
+    glm::ivec2 m_origin;
     // This Chunk's four neighbors to the north, south, east, and west
     // The third input to this map just lets us use a Direction as
     // a key for this map.
     // These allow us to properly determine
     std::unordered_map<Direction, Chunk*, EnumHash> m_neighbors;
 
-    // get neighboring block
-    BlockType getNeighborBlock(int x, int y, int z, glm::vec4 dirVec) const;
-
     // TODO: a member variable to mark vboLoaded
     bool vboLoaded;
 
+    // the index range of each section in the loaded VBO (see ChunkVBOdata)
+    std::array<int, 17> m_sectionOffsets;
+    std::array<int, 17> m_transparentSectionOffsets;
+    // the connectivity of each section in the loaded VBO, all linked before the first one
+    std::array<SectionConnectivity, 16> m_sectionConnectivity;
+
+    // where the mesh lives in the terrain's ChunkArenas
+    ChunkArenaSlot m_arenaSlot;
+    ChunkArenaSlot m_transparentArenaSlot;
+
+    // the navigation layer of the blocks, nullptr until the chunk is first meshed
+    // a VBOWorker hands a new one over through m_pendingNavGrid,
+    // it replaces m_navGrid on the next read (mutable: swapped in by getNavGrid)
+    // unless the chunk was edited after the worker copied its blocks
+    mutable uPtr<NavGrid> m_navGrid;
+    mutable std::atomic<NavGrid*> m_pendingNavGrid;
+    void adoptPendingNavGrid() const;
+    // the changed blocks so far, guarded by the world lock like the blocks
+    uint64_t m_editCount;
+
+    // flood fill each section, called by generateVBOdata()
+    void generateSectionConnectivity(ChunkVBOdata &vbo, const ChunkBlocks &blocks) const;
+
     // generate the vbo data associate with the block type, called by generateVBOdata()
-    void generateVBOdataDrawType(ChunkVBOdata &vbo, TerrainDrawType drawType);
+    void generateVBOdataDrawType(ChunkVBOdata &vbo, TerrainDrawType drawType, const ChunkBlocks &blocks);
 
     // check if current block needs to be drawn
     bool checkBlockDrawing(TerrainDrawType drawType, BlockType blockType) const ;
@@ -70,21 +127,45 @@ private:
 
 public:
     // constructor as a subclass of Drawable
-    Chunk(OpenGLContext *context);
+    Chunk(OpenGLContext *context, int x, int z);
+    // the world x, z of the block (0, 0, 0) of this chunk
+    glm::ivec2 getOrigin() const;
     BlockType getBlockAt(unsigned int x, unsigned int y, unsigned int z) const;
     BlockType getBlockAt(int x, int y, int z) const;
     void setBlockAt(unsigned int x, unsigned int y, unsigned int z, BlockType t);
+    // whether section (0 - 15, y / 16) holds only EMPTY blocks
+    bool isSectionEmpty(int section) const;
     void linkNeighbor(uPtr<Chunk>& neighbor, Direction dir);
 
     // createVBOData needs to be implemented as a subclass of Drawable
     // since chunk's drawMode is still GL_TRIANGLES, no need to implement drawMode() here.
     virtual void createVBOdata() override;
 
+    // copy the blocks the mesh & the navigation layer are built from
+    // Note: the world lock must be held, as for setBlockAt
+    uPtr<ChunkBlocks> copyBlocks() const;
+
     // this generates the vbo data for further rendering
     ChunkVBOdata generateVBOdata();
+    // the same from a copy of the blocks (any thread)
+    ChunkVBOdata generateVBOdata(const ChunkBlocks &blocks);
+
+    // build the navigation layer from the current blocks
+    uPtr<NavGrid> generateNavGrid() const;
+    // the same from a copy of the blocks (any thread, like generateVBOdata)
+    static uPtr<NavGrid> generateNavGrid(const ChunkBlocks &blocks);
+    // hand over a navigation layer built by generateNavGrid (any thread)
+    void setNavGrid(uPtr<NavGrid> navGrid);
+    // nullptr if the chunk was never meshed
+    // Note: the world lock must be held, as for setBlockAt: this adopts the pending grid,
+    // so it's only called on the serial side of a step (NPC::commitTick, PathService::dispatch)
+    const NavGrid* getNavGrid() const;
 
     // this takes ChunkVBOdata in and buffers them into this Chunk (Drawable)
     void createVBOdata(ChunkVBOdata &vbo);
+    // this takes ChunkVBOdata in and buffers them into the shared arenas of the terrain
+    // the previous mesh of this chunk (if any) is freed
+    void createVBOdata(ChunkVBOdata &vbo, ChunkArena &arena, ChunkArena &transparentArena);
 
     // return the map of the neighbors
     std::unordered_map<Direction, Chunk*, EnumHash> getNeighbors() const;
@@ -92,8 +173,17 @@ public:
     // check whether the VBO of a chunk is loaded or not
     bool isVBOLoaded() const;
 
+    // the first index of section (0 - 16) in the loaded VBO of the given draw type
+    int getSectionOffset(int section, TerrainDrawType drawType) const;
+    // which faces of section (0 - 15) are linked, as of the loaded VBO
+    SectionConnectivity getSectionConnectivity(int section) const;
+
     // helper method to destroy vbo and set isVBOLoaded to false
     void destroyVBOdata();
+    // give the ranges of this chunk back to the arenas and set isVBOLoaded to false
+    void destroyVBOdata(ChunkArena &arena, ChunkArena &transparentArena);
+
+    const ChunkArenaSlot& getArenaSlot(TerrainDrawType drawType) const;
 
     virtual ~Chunk();
 };
@@ -0,0 +1,283 @@
+#include "chunkarena.h"
+#include <algorithm>
+
+
+BufferArena::BufferArena(OpenGLContext *context, BufferPool *pool, GLenum target, int elemSize, int initialCapacity)
+    : mp_context(context), mp_pool(pool), m_target(target), m_elemSize(elemSize),
+      m_buf(), m_generated(false), m_capacity(initialCapacity), m_used(0),
+      m_freeRanges(), m_allocations(), m_nextHandle(0), m_relocations(0)
+{
+    m_freeRanges[0] = initialCapacity;
+}
+
+/**
+ * @brief BufferArena::takeFreeRange
+ *  Find the first free range that fits count elements,
+ *  the rest of the range stays in the free list.
+ * @param count
+ * @return the offset of the range, -1 if none fits
+ */
+int BufferArena::takeFreeRange(int count)
+{
+    for (auto it = m_freeRanges.begin(); it != m_freeRanges.end(); ++it) {
+        if (it->second < count) {
+            continue;
+        }
+        int offset = it->first;
+        int remaining = it->second - count;
+        m_freeRanges.erase(it);
+        if (remaining > 0) {
+            m_freeRanges[offset + count] = remaining;
+        }
+        return offset;
+    }
+    return -1;
+}
+
+/**
+ * @brief BufferArena::relocate
+ *  Pack the live ranges (in their current order) to the front of a new buffer.
+ *  This both removes the holes between them and lets the buffer grow.
+ *  Note: glCopyBufferSubData can't copy between overlapping ranges of one buffer,
+ *  so even packing without growing goes through a new buffer.
+ *  The new buffer comes from the pool & the old one goes back to it,
+ *  so repeated packing at the same size doesn't re-allocate GPU memory.
+ * @param newCapacity : int, in elements, at least m_used
+ */
+void BufferArena::relocate(int newCapacity)
+{
+    BufferPool::Buffer newBuf = mp_pool->acquire(GL_COPY_WRITE_BUFFER,
+                                                 static_cast<GLsizeiptr>(newCapacity) * m_elemSize);
+    // the pool rounds the size up, use all of it
+    newCapacity = static_cast<int>(newBuf.capacity / m_elemSize);
+
+    // sort the live ranges by offset so the packed order matches the old one
+    std::vector<std::pair<int, Range*>> live;
+    live.reserve(m_allocations.size());
+    for (auto &p : m_allocations) {
+        live.push_back(std::make_pair(p.second.offset, &p.second));
+    }
+    std::sort(live.begin(), live.end(),
+              [](const std::pair<int, Range*> &a, const std::pair<int, Range*> &b) { return a.first < b.first; });
+
+    if (m_generated) {
+        mp_context->glBindBuffer(GL_COPY_READ_BUFFER, m_buf.name);
+    }
+
+    int offset = 0;
+    for (const std::pair<int, Range*> &p : live) {
+        Range *range = p.second;
+        if (m_generated) {
+            mp_context->glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER,
+                                            static_cast<GLintptr>(range->offset) * m_elemSize,
+                                            static_cast<GLintptr>(offset) * m_elemSize,
+                                            static_cast<GLsizeiptr>(range->count) * m_elemSize);
+        }
+        range->offset = offset;
+        offset += range->count;
+    }
+
+    if (m_generated) {
+        mp_pool->release(m_buf);
+        m_relocations++;
+    }
+    m_buf = newBuf;
+    m_generated = true;
+    m_capacity = newCapacity;
+
+    m_freeRanges.clear();
+    if (offset < newCapacity) {
+        m_freeRanges[offset] = newCapacity - offset;
+    }
+}
+
+/**
+ * @brief BufferArena::allocate
+ *  Reserve count elements and upload data into them.
+ *  If no free range fits, pack the live ranges first,
+ *  and double the buffer if there is not enough free space in total.
+ * @param data
+ * @param count : int, in elements
+ * @return handle, -1 if count is 0
+ */
+int BufferArena::allocate(const void *data, int count)
+{
+    if (count <= 0) {
+        return -1;
+    }
+
+    // the buffer is created on the first allocation (the GL context may not exist before)
+    if (!m_generated) {
+        relocate(std::max(m_capacity, count));
+    }
+
+    int offset = takeFreeRange(count);
+    if (offset < 0) {
+        int newCapacity = m_capacity;
+        while (newCapacity - m_used < count) {
+            newCapacity *= 2;
+        }
+        relocate(newCapacity);
+        offset = takeFreeRange(count);
+    }
+
+    int handle = m_nextHandle++;
+    m_allocations[handle] = Range{offset, count};
+    m_used += count;
+
+    mp_context->glBindBuffer(m_target, m_buf.name);
+    mp_context->glBufferSubData(m_target, static_cast<GLintptr>(offset) * m_elemSize,
+                                static_cast<GLsizeiptr>(count) * m_elemSize, data);
+    return handle;
+}
+
+/**
+ * @brief BufferArena::free
+ *  Put the range back into the free list, merged with its free neighbours
+ * @param handle
+ */
+void BufferArena::free(int handle)
+{
+    auto it = m_allocations.find(handle);
+    if (it == m_allocations.end()) {
+        return;
+    }
+
+    int offset = it->second.offset;
+    int count = it->second.count;
+    m_used -= count;
+    m_allocations.erase(it);
+
+    // merge with the next free range
+    auto next = m_freeRanges.find(offset + count);
+    if (next != m_freeRanges.end()) {
+        count += next->second;
+        m_freeRanges.erase(next);
+    }
+
+    // merge with the previous free range
+    auto prev = m_freeRanges.lower_bound(offset);
+    if (prev != m_freeRanges.begin()) {
+        --prev;
+        if (prev->first + prev->second == offset) {
+            prev->second += count;
+            return;
+        }
+    }
+    m_freeRanges[offset] = count;
+}
+
+int BufferArena::getOffset(int handle) const
+{
+    auto it = m_allocations.find(handle);
+    return it == m_allocations.end() ? 0 : it->second.offset;
+}
+
+bool BufferArena::bind()
+{
+    if (m_generated) {
+        mp_context->glBindBuffer(m_target, m_buf.name);
+    }
+    return m_generated;
+}
+
+void BufferArena::destroy()
+{
+    if (m_generated) {
+        mp_pool->release(m_buf);
+        m_buf = BufferPool::Buffer();
+        m_generated = false;
+    }
+    m_allocations.clear();
+    m_freeRanges.clear();
+    m_freeRanges[0] = m_capacity;
+    m_used = 0;
+}
+
+int BufferArena::getCapacity() const
+{
+    return m_capacity;
+}
+
+int BufferArena::getUsed() const
+{
+    return m_used;
+}
+
+int BufferArena::getFreeRangeCount() const
+{
+    return static_cast<int>(m_freeRanges.size());
+}
+
+int BufferArena::getRelocationCount() const
+{
+    return m_relocations;
+}
+
+
+// start with room for roughly 64 surface chunks, the arenas double when full
+ChunkArena::ChunkArena(OpenGLContext *context, BufferPool *pool)
+    : m_vertices(context, pool, GL_ARRAY_BUFFER, VERTEX_SIZE, 1 << 18),
+      m_indices(context, pool, GL_ELEMENT_ARRAY_BUFFER, sizeof(GLuint), 3 << 17)
+{}
+
+/**
+ * @brief ChunkArena::allocate
+ * @param buffer : interleaved vertex data
+ * @param indices : indices relative to the first vertex of buffer
+ * @return slot
+ */
+ChunkArenaSlot ChunkArena::allocate(const std::vector<float> &buffer, const std::vector<GLuint> &indices)
+{
+    ChunkArenaSlot slot;
+    int vertexCount = static_cast<int>(buffer.size() * sizeof(float) / VERTEX_SIZE);
+    slot.vertexHandle = m_vertices.allocate(buffer.data(), vertexCount);
+    slot.indexHandle = m_indices.allocate(indices.data(), static_cast<int>(indices.size()));
+    slot.indexCount = static_cast<int>(indices.size());
+    return slot;
+}
+
+void ChunkArena::free(ChunkArenaSlot &slot)
+{
+    m_vertices.free(slot.vertexHandle);
+    m_indices.free(slot.indexHandle);
+    slot = ChunkArenaSlot();
+}
+
+int ChunkArena::getBaseVertex(const ChunkArenaSlot &slot) const
+{
+    return m_vertices.getOffset(slot.vertexHandle);
+}
+
+int ChunkArena::getFirstIndex(const ChunkArenaSlot &slot) const
+{
+    return m_indices.getOffset(slot.indexHandle);
+}
+
+bool ChunkArena::bindVertices()
+{
+    return m_vertices.bind();
+}
+
+bool ChunkArena::bindIndices()
+{
+    return m_indices.bind();
+}
+
+void ChunkArena::destroy()
+{
+    m_vertices.destroy();
+    m_indices.destroy();
+}
+
+long long ChunkArena::getUsedBytes() const
+{
+    return static_cast<long long>(m_vertices.getUsed()) * VERTEX_SIZE
+            + static_cast<long long>(m_indices.getUsed()) * sizeof(GLuint);
+}
+
+long long ChunkArena::getCapacityBytes() const
+{
+    return static_cast<long long>(m_vertices.getCapacity()) * VERTEX_SIZE
+            + static_cast<long long>(m_indices.getCapacity()) * sizeof(GLuint);
+}
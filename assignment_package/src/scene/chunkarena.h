@@ -0,0 +1,109 @@
+#pragma once
+#include "glm_includes.h"
+#include <openglcontext.h>
+#include "bufferpool.h"
+#include <map>
+#include <unordered_map>
+#include <vector>
+
+// One large GL buffer handed out in ranges of fixed-size elements.
+// Freed ranges go back to a free list (adjacent ranges are merged).
+// When no free range is big enough, the live ranges are packed
+// to the front of a new buffer, which grows if needed.
+// The buffers come from (and go back to) a BufferPool.
+// Allocations are referred to by handles because packing moves them.
+class BufferArena
+{
+private:
+    struct Range
+    {
+        int offset; // in elements
+        int count;
+    };
+
+    OpenGLContext *mp_context;
+    BufferPool *mp_pool;
+    GLenum m_target;
+    int m_elemSize; // bytes per element
+
+    BufferPool::Buffer m_buf;
+    bool m_generated;
+    int m_capacity; // in elements, all of m_buf that fits whole elements
+    int m_used;
+
+    // offset -> count, sorted so neighbours can be merged
+    std::map<int, int> m_freeRanges;
+    // handle -> range
+    std::unordered_map<int, Range> m_allocations;
+    int m_nextHandle;
+
+    // the number of times the live ranges were packed into a new buffer
+    int m_relocations;
+
+    // first fit, returns the offset or -1
+    int takeFreeRange(int count);
+    // copy the live ranges to the front of a new buffer of at least newCapacity elements
+    void relocate(int newCapacity);
+
+public:
+    BufferArena(OpenGLContext *context, BufferPool *pool, GLenum target, int elemSize, int initialCapacity);
+
+    // copy count elements of data into the buffer, returns a handle (-1 if count is 0)
+    int allocate(const void *data, int count);
+    // give the range back, handle -1 is ignored
+    void free(int handle);
+    // the current offset (in elements) of an allocation, 0 for handle -1
+    int getOffset(int handle) const;
+
+    bool bind();
+    void destroy();
+
+    int getCapacity() const;
+    int getUsed() const;
+    int getFreeRangeCount() const;
+    int getRelocationCount() const;
+};
+
+// Where the mesh of one chunk (of one TerrainDrawType) lives in a ChunkArena
+struct ChunkArenaSlot
+{
+    int vertexHandle;
+    int indexHandle;
+    int indexCount;
+
+    ChunkArenaSlot()
+        : vertexHandle(-1), indexHandle(-1), indexCount(0)
+    {}
+};
+
+// The interleaved vertices & indices of many chunks, so that the
+// whole terrain can be drawn with one glMultiDrawElementsBaseVertex.
+// The indices of a chunk stay relative to its first vertex (base vertex).
+class ChunkArena
+{
+private:
+    BufferArena m_vertices;
+    BufferArena m_indices;
+
+public:
+    // pos (vec4) + normal (vec4) + uv (vec2) + animatable flag (vec2)
+    static const int VERTEX_SIZE = 2 * sizeof(glm::vec4) + 2 * sizeof(glm::vec2);
+
+    ChunkArena(OpenGLContext *context, BufferPool *pool);
+
+    // upload a chunk mesh, buffer holds interleaved vertices of VERTEX_SIZE bytes
+    ChunkArenaSlot allocate(const std::vector<float> &buffer, const std::vector<GLuint> &indices);
+    // give the ranges of slot back & reset it
+    void free(ChunkArenaSlot &slot);
+
+    int getBaseVertex(const ChunkArenaSlot &slot) const;
+    int getFirstIndex(const ChunkArenaSlot &slot) const;
+
+    bool bindVertices();
+    bool bindIndices();
+    void destroy();
+
+    // bytes in use / allocated on the GPU
+    long long getUsedBytes() const;
+    long long getCapacityBytes() const;
+};
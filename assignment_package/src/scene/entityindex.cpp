@@ -0,0 +1,249 @@
+#include "entityindex.h"
+#include <algorithm>
+#include <utility>
+
+
+EntityIndex::EntityIndex()
+    : m_items(), m_freeHandles(), m_cells(), m_queryStamp(0)
+{}
+
+// 21 bits per axis, negative cells included
+int64_t EntityIndex::toCellKey(int x, int y, int z)
+{
+    const int64_t mask = (1 << 21) - 1;
+    return ((static_cast<int64_t>(x) & mask) << 42) | ((static_cast<int64_t>(y) & mask) << 21)
+            | (static_cast<int64_t>(z) & mask);
+}
+
+glm::ivec3 EntityIndex::getCell(glm::vec3 p)
+{
+    return glm::ivec3(glm::floor(p / static_cast<float>(CELL_SIZE)));
+}
+
+void EntityIndex::addToCells(int handle)
+{
+    const Item &item = m_items[handle];
+    for (int x = item.cellMin.x; x <= item.cellMax.x; x++) {
+        for (int y = item.cellMin.y; y <= item.cellMax.y; y++) {
+            for (int z = item.cellMin.z; z <= item.cellMax.z; z++) {
+                m_cells[toCellKey(x, y, z)].push_back(handle);
+            }
+        }
+    }
+}
+
+void EntityIndex::removeFromCells(int handle)
+{
+    const Item &item = m_items[handle];
+    for (int x = item.cellMin.x; x <= item.cellMax.x; x++) {
+        for (int y = item.cellMin.y; y <= item.cellMax.y; y++) {
+            for (int z = item.cellMin.z; z <= item.cellMax.z; z++) {
+                auto it = m_cells.find(toCellKey(x, y, z));
+                if (it == m_cells.end()) {
+                    continue;
+                }
+                std::vector<int> &bucket = it->second;
+                // swap & pop, the order within a bucket doesn't matter to the queries' results
+                auto found = std::find(bucket.begin(), bucket.end(), handle);
+                if (found != bucket.end()) {
+                    *found = bucket.back();
+                    bucket.pop_back();
+                }
+                if (bucket.empty()) {
+                    m_cells.erase(it);
+                }
+            }
+        }
+    }
+}
+
+template <typename F>
+void EntityIndex::visitCells(glm::ivec3 cellMin, glm::ivec3 cellMax, F visit) const
+{
+    for (int x = cellMin.x; x <= cellMax.x; x++) {
+        for (int y = cellMin.y; y <= cellMax.y; y++) {
+            for (int z = cellMin.z; z <= cellMax.z; z++) {
+                auto it = m_cells.find(toCellKey(x, y, z));
+                if (it == m_cells.end()) {
+                    continue;
+                }
+                for (int handle : it->second) {
+                    // an item in several cells is visited in the first one both ranges share
+                    if (glm::ivec3(x, y, z) == glm::max(m_items[handle].cellMin, cellMin)) {
+                        visit(handle);
+                    }
+                }
+            }
+        }
+    }
+}
+
+/**
+ * @brief EntityIndex::insert
+ * @param entity
+ * @param box
+ * @return the handle of the entity
+ */
+int EntityIndex::insert(const Entity *entity, const AABB &box)
+{
+    int handle;
+    if (!m_freeHandles.empty()) {
+        handle = m_freeHandles.back();
+        m_freeHandles.pop_back();
+        m_items[handle] = Item(entity, box);
+    } else {
+        handle = static_cast<int>(m_items.size());
+        m_items.push_back(Item(entity, box));
+    }
+    m_items[handle].cellMin = getCell(box.min);
+    m_items[handle].cellMax = getCell(box.max);
+    addToCells(handle);
+    return handle;
+}
+
+/**
+ * @brief EntityIndex::update
+ *  The buckets only change if the box moved into other cells
+ * @param handle
+ * @param box
+ */
+void EntityIndex::update(int handle, const AABB &box)
+{
+    Item &item = m_items[handle];
+    item.box = box;
+    glm::ivec3 cellMin = getCell(box.min);
+    glm::ivec3 cellMax = getCell(box.max);
+    if (cellMin == item.cellMin && cellMax == item.cellMax) {
+        return;
+    }
+    removeFromCells(handle);
+    item.cellMin = cellMin;
+    item.cellMax = cellMax;
+    addToCells(handle);
+}
+
+void EntityIndex::remove(int handle)
+{
+    removeFromCells(handle);
+    m_items[handle].used = false;
+    m_items[handle].entity = nullptr;
+    m_freeHandles.push_back(handle);
+}
+
+int EntityIndex::size() const
+{
+    return static_cast<int>(m_items.size() - m_freeHandles.size());
+}
+
+const Entity* EntityIndex::getEntity(int handle) const
+{
+    return m_items[handle].entity;
+}
+
+const AABB& EntityIndex::getBox(int handle) const
+{
+    return m_items[handle].box;
+}
+
+float EntityIndex::getDistance(int handle, glm::vec3 p) const
+{
+    const AABB &box = m_items[handle].box;
+    return glm::length(p - glm::clamp(p, box.min, box.max));
+}
+
+/**
+ * @brief EntityIndex::queryRadius
+ *  The handles are in no particular order
+ * @param center
+ * @param radius
+ * @param out_handles
+ */
+void EntityIndex::queryRadius(glm::vec3 center, float radius, std::vector<int> *out_handles) const
+{
+    out_handles->clear();
+    visitCells(getCell(center - radius), getCell(center + radius), [this, center, radius, out_handles](int handle) {
+        if (getDistance(handle, center) <= radius) {
+            out_handles->push_back(handle);
+        }
+    });
+}
+
+/**
+ * @brief EntityIndex::queryBox
+ *  The handles are in no particular order
+ * @param box
+ * @param out_handles
+ */
+void EntityIndex::queryBox(const AABB &box, std::vector<int> *out_handles) const
+{
+    out_handles->clear();
+    visitCells(getCell(box.min), getCell(box.max), [this, &box, out_handles](int handle) {
+        const AABB &other = m_items[handle].box;
+        if (glm::all(glm::lessThan(box.min, other.max)) && glm::all(glm::lessThan(other.min, box.max))) {
+            out_handles->push_back(handle);
+        }
+    });
+}
+
+/**
+ * @brief EntityIndex::queryNearest
+ *  Visit the shells of cells around p, nearest first: after shell r,
+ *  every entity not seen yet is at least r * CELL_SIZE away,
+ *  so the search stops once k entities closer than that are known
+ * @param p
+ * @param k
+ * @param maxDist
+ * @param out_handles
+ */
+void EntityIndex::queryNearest(glm::vec3 p, int k, float maxDist, std::vector<int> *out_handles) const
+{
+    out_handles->clear();
+    if (k <= 0) {
+        return;
+    }
+
+    // (distance, handle)
+    std::vector<std::pair<float, int>> found;
+    glm::ivec3 center = getCell(p);
+    int maxShell = static_cast<int>(glm::ceil(maxDist / CELL_SIZE));
+    m_queryStamp++;
+    for (int r = 0; r <= maxShell; r++) {
+        for (int x = center.x - r; x <= center.x + r; x++) {
+            for (int y = center.y - r; y <= center.y + r; y++) {
+                // only the cells of the shell (the inner ones were visited)
+                bool onShellXY = glm::abs(x - center.x) == r || glm::abs(y - center.y) == r;
+                for (int z = center.z - r; z <= center.z + r; z += (onShellXY || r == 0) ? 1 : 2 * r) {
+                    auto it = m_cells.find(toCellKey(x, y, z));
+                    if (it == m_cells.end()) {
+                        continue;
+                    }
+                    for (int handle : it->second) {
+                        const Item &item = m_items[handle];
+                        if (item.queryStamp == m_queryStamp) {
+                            continue;
+                        }
+                        item.queryStamp = m_queryStamp;
+                        float dist = getDistance(handle, p);
+                        if (dist <= maxDist) {
+                            found.push_back(std::make_pair(dist, handle));
+                        }
+                    }
+                }
+            }
+        }
+
+        if (static_cast<int>(found.size()) >= k) {
+            std::nth_element(found.begin(), found.begin() + (k - 1), found.end());
+            found.resize(k);
+            float kthDist = std::max_element(found.begin(), found.end())->first;
+            if (kthDist <= r * static_cast<float>(CELL_SIZE)) {
+                break;
+            }
+        }
+    }
+
+    std::sort(found.begin(), found.end());
+    for (int i = 0; i < static_cast<int>(found.size()) && i < k; i++) {
+        out_handles->push_back(found[i].second);
+    }
+}
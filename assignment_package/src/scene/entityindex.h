@@ -0,0 +1,79 @@
+#pragma once
+#include "glm_includes.h"
+#include "voxelcollider.h"
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+class Entity;
+
+// The player & NPCs by position, for proximity queries (NPC separation,
+// blocks placed inside an entity, ...) without going through every entity.
+// The world is cut into CELL_SIZE^3 cells & an entity is in the bucket
+// of every cell its box touches. update() only touches the buckets
+// when the box moves into other cells.
+// Entities are referred to by the handle insert() returns.
+// Note: only used with the world lock held (by the simulation step);
+// queryRadius & queryBox don't write anything, so threads can run them at once
+// (e.g. the NPCs' ticks, see NPCUpdater), as long as nothing is inserted / updated
+class EntityIndex
+{
+public:
+    static constexpr int CELL_SIZE = 8;
+
+private:
+    struct Item
+    {
+        const Entity *entity;
+        AABB box;
+        // the cells the box touches
+        glm::ivec3 cellMin, cellMax;
+        // the last queryNearest that saw it (an entity in several cells is counted once)
+        mutable unsigned int queryStamp;
+        bool used;
+
+        Item(const Entity *entity, const AABB &box)
+            : entity(entity), box(box), cellMin(0), cellMax(-1), queryStamp(0), used(true)
+        {}
+    };
+
+    std::vector<Item> m_items;
+    // the handles of the removed items, reused by insert()
+    std::vector<int> m_freeHandles;
+    // the handles of the items touching a cell, by toCellKey
+    std::unordered_map<int64_t, std::vector<int>> m_cells;
+    mutable unsigned int m_queryStamp;
+
+    static int64_t toCellKey(int x, int y, int z);
+    static glm::ivec3 getCell(glm::vec3 p);
+    void addToCells(int handle);
+    void removeFromCells(int handle);
+    // call visit(handle) once for every item in the cells [cellMin, cellMax]
+    template <typename F>
+    void visitCells(glm::ivec3 cellMin, glm::ivec3 cellMax, F visit) const;
+
+public:
+    EntityIndex();
+
+    // entity may be null (e.g. for a benchmark), the handle is >= 0
+    int insert(const Entity *entity, const AABB &box);
+    // the entity moved
+    void update(int handle, const AABB &box);
+    void remove(int handle);
+    int size() const;
+
+    const Entity* getEntity(int handle) const;
+    const AABB& getBox(int handle) const;
+
+    // the distance between p & the box of handle (0 inside)
+    float getDistance(int handle, glm::vec3 p) const;
+
+    // Each query clears *out_handles first
+    // the entities whose box is at most radius from center
+    void queryRadius(glm::vec3 center, float radius, std::vector<int> *out_handles) const;
+    // the entities whose box overlaps box (touching faces don't)
+    void queryBox(const AABB &box, std::vector<int> *out_handles) const;
+    // the (at most) k entities nearest to p within maxDist, nearest first
+    // (one thread at a time, it marks the entities it sees)
+    void queryNearest(glm::vec3 p, int k, float maxDist, std::vector<int> *out_handles) const;
+};
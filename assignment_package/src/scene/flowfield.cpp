@@ -0,0 +1,272 @@
+#include "flowfield.h"
+#include "terrain.h"
+#include "metrics.h"
+#include <functional>
+#include <queue>
+
+static const int SIDE = 2 * FlowField::HALF_SIZE + 1;
+static const int HEIGHT = 2 * FlowField::HALF_HEIGHT + 1;
+
+// the origin of the chunk holding world column (x, z)
+static glm::ivec2 getChunkOrigin(int x, int z)
+{
+    return glm::ivec2(x - (x & 15), z - (z & 15));
+}
+
+// a step of dx, dz in [-1, 1] & dy in [-2, 1] as a number in [0, 36)
+static uint8_t getMoveCode(int dx, int dy, int dz)
+{
+    return static_cast<uint8_t>((dx + 1) + 3 * (dz + 1) + 9 * (dy + 2));
+}
+
+static glm::ivec3 getMove(uint8_t code)
+{
+    return glm::ivec3(code % 3 - 1, code / 9 - 2, (code / 3) % 3 - 1);
+}
+
+// the NavColumns of the box, looked up once per chunk
+class BoxColumns
+{
+private:
+    glm::ivec3 m_min;
+    std::vector<const NavColumn*> m_columns;
+
+public:
+    BoxColumns(const Terrain &terrain, glm::ivec3 min)
+        : m_min(min), m_columns(SIDE * SIDE, nullptr)
+    {
+        for (int x = 0; x < SIDE; x++) {
+            const Chunk *chunk = nullptr;
+            const NavGrid *grid = nullptr;
+            for (int z = 0; z < SIDE; z++) {
+                int worldX = min.x + x;
+                int worldZ = min.z + z;
+                if (chunk == nullptr || worldZ - chunk->getOrigin().y >= 16) {
+                    chunk = terrain.findChunkAt(worldX, worldZ);
+                    grid = chunk != nullptr ? chunk->getNavGrid() : nullptr;
+                }
+                if (grid != nullptr) {
+                    glm::ivec2 origin = chunk->getOrigin();
+                    m_columns[x * SIDE + z] = &grid->getColumn(worldX - origin.x, worldZ - origin.y);
+                }
+            }
+        }
+    }
+
+    // y relative to the box too
+    bool isStandable(int x, int y, int z) const
+    {
+        if (x < 0 || x >= SIDE || y < 0 || y >= HEIGHT || z < 0 || z >= SIDE) {
+            return false;
+        }
+        const NavColumn *column = m_columns[x * SIDE + z];
+        return column != nullptr && column->isStandable(m_min.y + y);
+    }
+};
+
+
+FlowField::FlowField()
+    : m_goal(0), m_min(0), m_costs(), m_moves(), m_revisions()
+{}
+
+int FlowField::getIndex(glm::ivec3 cell) const
+{
+    glm::ivec3 local = cell - m_min;
+    if (local.x < 0 || local.x >= SIDE || local.y < 0 || local.y >= HEIGHT || local.z < 0 || local.z >= SIDE) {
+        return -1;
+    }
+    return (local.y * SIDE + local.x) * SIDE + local.z;
+}
+
+/**
+ * @brief FlowField::build
+ *  Dijkstra from every standable cell an NPC reaches the goal on
+ *  (the 3 x 3 columns around it, up to 3 blocks below it).
+ *  A cell is expanded to the cells that walk to it: from a neighbor column,
+ *  down 1 block (a hop) to up 2 blocks (a drop), as PortalGraph::flood in reverse
+ * @param terrain
+ * @param goal
+ */
+void FlowField::build(const Terrain &terrain, glm::ivec3 goal)
+{
+    m_goal = goal;
+    m_min = goal - glm::ivec3(HALF_SIZE, HALF_HEIGHT, HALF_SIZE);
+    m_costs.assign(SIDE * HEIGHT * SIDE, UNREACHED);
+    m_moves.assign(SIDE * HEIGHT * SIDE, NO_MOVE);
+
+    m_revisions.clear();
+    glm::ivec2 minChunk = getChunkOrigin(m_min.x, m_min.z);
+    glm::ivec2 maxChunk = getChunkOrigin(m_min.x + SIDE - 1, m_min.z + SIDE - 1);
+    for (int x = minChunk.x; x <= maxChunk.x; x += 16) {
+        for (int z = minChunk.y; z <= maxChunk.y; z += 16) {
+            const Chunk *chunk = terrain.findChunkAt(x, z);
+            const NavGrid *grid = chunk != nullptr ? chunk->getNavGrid() : nullptr;
+            m_revisions.push_back(std::make_pair(glm::ivec2(x, z), grid != nullptr ? grid->getRevision() : 0));
+        }
+    }
+
+    BoxColumns columns(terrain, m_min);
+
+    // (cost, index)
+    typedef std::pair<int, int> Item;
+    std::priority_queue<Item, std::vector<Item>, std::greater<Item>> open;
+    for (int dx = -1; dx <= 1; dx++) {
+        for (int dz = -1; dz <= 1; dz++) {
+            for (int dy = -3; dy <= 0; dy++) {
+                glm::ivec3 local(HALF_SIZE + dx, HALF_HEIGHT + dy, HALF_SIZE + dz);
+                if (columns.isStandable(local.x, local.y, local.z)) {
+                    int index = (local.y * SIDE + local.x) * SIDE + local.z;
+                    m_costs[index] = 0;
+                    open.push(Item(0, index));
+                }
+            }
+        }
+    }
+
+    int settled = 0;
+    while (!open.empty()) {
+        Item item = open.top();
+        open.pop();
+        int index = item.second;
+        if (item.first != m_costs[index]) {
+            // reached cheaper since it was pushed
+            continue;
+        }
+        settled++;
+        int z = index % SIDE;
+        int x = (index / SIDE) % SIDE;
+        int y = index / (SIDE * SIDE);
+        for (int dx = -1; dx <= 1; dx++) {
+            for (int dz = -1; dz <= 1; dz++) {
+                if (dx == 0 && dz == 0) {
+                    continue;
+                }
+                // the previous cell is at y + dy, its step to this cell goes -dy
+                for (int dy = -1; dy <= 2; dy++) {
+                    if (!columns.isStandable(x + dx, y + dy, z + dz)) {
+                        continue;
+                    }
+                    int cost = item.first + (dx != 0 && dz != 0 ? 3 : 2) + (dy < 0 ? 1 : 0);
+                    int prev = ((y + dy) * SIDE + (x + dx)) * SIDE + (z + dz);
+                    if (cost >= m_costs[prev]) {
+                        continue;
+                    }
+                    m_costs[prev] = static_cast<uint16_t>(cost);
+                    m_moves[prev] = getMoveCode(-dx, -dy, -dz);
+                    open.push(Item(cost, prev));
+                }
+            }
+        }
+    }
+
+    static Counter &built = MetricsRegistry::global().counter("path.flow_fields_built");
+    static Histogram &cells = MetricsRegistry::global().histogram("path.flow_field_cells");
+    built.add();
+    cells.record(settled);
+}
+
+/**
+ * @brief FlowField::isCurrent
+ * @param terrain
+ * @return
+ */
+bool FlowField::isCurrent(const Terrain &terrain) const
+{
+    for (const std::pair<glm::ivec2, uint64_t> &revision : m_revisions) {
+        const Chunk *chunk = terrain.findChunkAt(revision.first.x, revision.first.y);
+        const NavGrid *grid = chunk != nullptr ? chunk->getNavGrid() : nullptr;
+        if ((grid != nullptr ? grid->getRevision() : 0) != revision.second) {
+            return false;
+        }
+    }
+    return true;
+}
+
+glm::ivec3 FlowField::getGoal() const
+{
+    return m_goal;
+}
+
+uint16_t FlowField::getCost(glm::ivec3 cell) const
+{
+    int index = getIndex(cell);
+    return index != -1 ? m_costs[index] : UNREACHED;
+}
+
+/**
+ * @brief FlowField::getNextCell
+ * @param cell
+ * @param out_next
+ * @return
+ */
+bool FlowField::getNextCell(glm::ivec3 cell, glm::ivec3 *out_next) const
+{
+    int index = getIndex(cell);
+    if (index == -1 || m_moves[index] == NO_MOVE) {
+        return false;
+    }
+    *out_next = cell + getMove(m_moves[index]);
+    return true;
+}
+
+/**
+ * @brief FlowField::findCell
+ * @param pos
+ * @param out_cell
+ * @return
+ */
+bool FlowField::findCell(glm::vec3 pos, glm::ivec3 *out_cell) const
+{
+    glm::ivec3 cell = glm::ivec3(glm::floor(pos));
+    for (int dy = 1; dy <= 3; dy++) {
+        glm::ivec3 below = cell - glm::ivec3(0, dy, 0);
+        if (getCost(below) != UNREACHED) {
+            *out_cell = below;
+            return true;
+        }
+    }
+    return false;
+}
+
+
+FlowFieldCache::FlowFieldCache(const Terrain &terrain)
+    : mcr_terrain(terrain), m_entries(), m_useCount(0)
+{}
+
+/**
+ * @brief FlowFieldCache::getField
+ *  Rebuild the field if a grid it covers changed since
+ * @param goal
+ * @return
+ */
+const FlowField* FlowFieldCache::getField(glm::vec3 goal)
+{
+    glm::ivec3 goalCell = glm::ivec3(glm::floor(goal));
+    m_useCount++;
+
+    Entry *entry = nullptr;
+    for (Entry &e : m_entries) {
+        if (e.field->getGoal() == goalCell) {
+            entry = &e;
+            break;
+        }
+    }
+    if (entry == nullptr) {
+        if (static_cast<int>(m_entries.size()) < MAX_FIELDS) {
+            m_entries.push_back(Entry{mkU<FlowField>(), 0});
+            entry = &m_entries.back();
+        } else {
+            entry = &m_entries.front();
+            for (Entry &e : m_entries) {
+                if (e.lastUse < entry->lastUse) {
+                    entry = &e;
+                }
+            }
+        }
+        entry->field->build(mcr_terrain, goalCell);
+    } else if (!entry->field->isCurrent(mcr_terrain)) {
+        entry->field->build(mcr_terrain, goalCell);
+    }
+    entry->lastUse = m_useCount;
+    return entry->field.get();
+}
@@ -0,0 +1,81 @@
+#pragma once
+#include "glm_includes.h"
+#include "smartpointerhelp.h"
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+class Terrain;
+
+// The walking costs to one goal from every standable cell of a box around it,
+// & the step to take from each cell: any number of NPCs heading to the goal
+// follow the same field, one lookup per step instead of one A* per NPC.
+// Built by a Dijkstra from the cells around the goal outward (the moves of a walk
+// taken backward, see PortalGraph::flood) over the chunks' navigation grids.
+class FlowField
+{
+public:
+    // the box: the goal's column +- HALF_SIZE on x & z, its y +- HALF_HEIGHT
+    static constexpr int HALF_SIZE = 48;
+    static constexpr int HALF_HEIGHT = 24;
+
+private:
+    glm::ivec3 m_goal;
+    // the lowest corner of the box
+    glm::ivec3 m_min;
+    // the cost to the goal (2 per straight step, 3 per diagonal one, 1 more up), UNREACHED if it can't walk there
+    std::vector<uint16_t> m_costs;
+    // the step toward the goal (see getMoveCode), NO_MOVE at the goal
+    std::vector<uint8_t> m_moves;
+    // the chunks the box covers & the revision of their grids (0: no grid)
+    std::vector<std::pair<glm::ivec2, uint64_t>> m_revisions;
+
+    // -1 out of the box
+    int getIndex(glm::ivec3 cell) const;
+
+public:
+    static constexpr uint16_t UNREACHED = 0xffff;
+    static constexpr uint8_t NO_MOVE = 0xff;
+
+    FlowField();
+
+    // Note: the world lock must be held
+    void build(const Terrain &terrain, glm::ivec3 goal);
+    // no grid of the box has changed since build
+    bool isCurrent(const Terrain &terrain) const;
+
+    glm::ivec3 getGoal() const;
+    // UNREACHED out of the box too
+    uint16_t getCost(glm::ivec3 cell) const;
+    // the cell to step on from cell, false at the goal or where the field doesn't lead to it
+    bool getNextCell(glm::ivec3 cell, glm::ivec3 *out_next) const;
+    // the reached cell at most 3 blocks below pos (the block an NPC at pos stands on)
+    bool findCell(glm::vec3 pos, glm::ivec3 *out_cell) const;
+};
+
+// The flow fields of the goals NPCs head to, built on first use
+// & rebuilt when a grid they cover changes (a block edit, a new mesh).
+// Note: only used with the world lock held (by the NPCs' ticks)
+class FlowFieldCache
+{
+public:
+    // the least recently used field is dropped past this many
+    static constexpr int MAX_FIELDS = 8;
+
+private:
+    struct Entry
+    {
+        uPtr<FlowField> field;
+        long long lastUse;
+    };
+
+    const Terrain &mcr_terrain;
+    std::vector<Entry> m_entries;
+    long long m_useCount;
+
+public:
+    explicit FlowFieldCache(const Terrain &terrain);
+
+    // the field toward the block right below goal
+    const FlowField* getField(glm::vec3 goal);
+};
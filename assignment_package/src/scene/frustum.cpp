@@ -0,0 +1,144 @@
+#include "frustum.h"
+
+// SSE2 is available on every x86-64 compiler we build with;
+// other platforms (e.g. Apple silicon) use the scalar loop.
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define FRUSTUM_USE_SSE
+#include <emmintrin.h>
+#endif
+
+
+void AABBList::clear()
+{
+    minX.clear();
+    minY.clear();
+    minZ.clear();
+    maxX.clear();
+    maxY.clear();
+    maxZ.clear();
+}
+
+void AABBList::push(glm::vec3 min, glm::vec3 max)
+{
+    minX.push_back(min.x);
+    minY.push_back(min.y);
+    minZ.push_back(min.z);
+    maxX.push_back(max.x);
+    maxY.push_back(max.y);
+    maxZ.push_back(max.z);
+}
+
+int AABBList::size() const
+{
+    return static_cast<int>(minX.size());
+}
+
+
+Frustum::Frustum()
+    : m_planes()
+{
+    // planes with a zero normal & d = 1 accept everything
+    m_planes.fill(glm::vec4(0.f, 0.f, 0.f, 1.f));
+}
+
+Frustum::Frustum(const glm::mat4 &viewProj)
+    : m_planes()
+{
+    update(viewProj);
+}
+
+/**
+ * @brief Frustum::update
+ *  Extract the planes from the rows of the view-projection matrix
+ *  (Gribb & Hartmann). A point is inside if -w <= x, y, z <= w in clip space.
+ *  Note: glm is column-major, so row i is (m[0][i], m[1][i], m[2][i], m[3][i]).
+ * @param viewProj
+ */
+void Frustum::update(const glm::mat4 &viewProj)
+{
+    glm::vec4 rows[4];
+    for (int i = 0; i < 4; i++)
+    {
+        rows[i] = glm::vec4(viewProj[0][i], viewProj[1][i], viewProj[2][i], viewProj[3][i]);
+    }
+
+    m_planes[0] = rows[3] + rows[0]; // left
+    m_planes[1] = rows[3] - rows[0]; // right
+    m_planes[2] = rows[3] + rows[1]; // bottom
+    m_planes[3] = rows[3] - rows[1]; // top
+    m_planes[4] = rows[3] + rows[2]; // near
+    m_planes[5] = rows[3] - rows[2]; // far
+}
+
+/**
+ * @brief Frustum::intersectsAABB
+ *  For each plane, test the corner of the box furthest along the plane normal.
+ *  If that corner is outside, the whole box is outside.
+ * @param min
+ * @param max
+ * @return
+ */
+bool Frustum::intersectsAABB(glm::vec3 min, glm::vec3 max) const
+{
+    for (const glm::vec4 &plane : m_planes)
+    {
+        glm::vec3 corner(plane.x > 0.f ? max.x : min.x,
+                         plane.y > 0.f ? max.y : min.y,
+                         plane.z > 0.f ? max.z : min.z);
+        if (glm::dot(glm::vec3(plane), corner) + plane.w < 0.f)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Frustum::cullAABBs
+ *  Same test as intersectsAABB, 4 boxes at a time.
+ *  The corner to test only depends on the signs of the plane normal,
+ *  so for each plane we just pick the min or max array of every axis.
+ * @param boxes
+ * @param visible
+ */
+void Frustum::cullAABBs(const AABBList &boxes, std::vector<uint8_t> *visible) const
+{
+    int count = boxes.size();
+    visible->assign(count, 1);
+
+    int i = 0;
+
+#ifdef FRUSTUM_USE_SSE
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+
+        for (const glm::vec4 &plane : m_planes)
+        {
+            const float *px = plane.x > 0.f ? boxes.maxX.data() : boxes.minX.data();
+            const float *py = plane.y > 0.f ? boxes.maxY.data() : boxes.minY.data();
+            const float *pz = plane.z > 0.f ? boxes.maxZ.data() : boxes.minZ.data();
+
+            __m128 dist = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(plane.x), _mm_loadu_ps(px + i)),
+                                     _mm_mul_ps(_mm_set1_ps(plane.y), _mm_loadu_ps(py + i)));
+            dist = _mm_add_ps(dist, _mm_mul_ps(_mm_set1_ps(plane.z), _mm_loadu_ps(pz + i)));
+            dist = _mm_add_ps(dist, _mm_set1_ps(plane.w));
+
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(dist, _mm_setzero_ps()));
+        }
+
+        int mask = _mm_movemask_ps(inside);
+        for (int j = 0; j < 4; j++)
+        {
+            (*visible)[i + j] = (mask >> j) & 1;
+        }
+    }
+#endif
+
+    // the remaining boxes (or all of them without SSE)
+    for (; i < count; i++)
+    {
+        (*visible)[i] = intersectsAABB(glm::vec3(boxes.minX[i], boxes.minY[i], boxes.minZ[i]),
+                                       glm::vec3(boxes.maxX[i], boxes.maxY[i], boxes.maxZ[i])) ? 1 : 0;
+    }
+}
@@ -0,0 +1,40 @@
+#pragma once
+#include "glm_includes.h"
+#include <array>
+#include <vector>
+#include <cstdint>
+
+// A list of axis-aligned boxes stored as separate arrays (SoA),
+// so that Frustum::cullAABBs can test 4 boxes at once.
+struct AABBList
+{
+    std::vector<float> minX, minY, minZ;
+    std::vector<float> maxX, maxY, maxZ;
+
+    void clear();
+    void push(glm::vec3 min, glm::vec3 max);
+    int size() const;
+};
+
+// The 6 clipping planes of a camera, extracted from its view-projection matrix.
+class Frustum
+{
+private:
+    // (a, b, c, d) with a * x + b * y + c * z + d >= 0 for points inside
+    // order: left, right, bottom, top, near, far
+    std::array<glm::vec4, 6> m_planes;
+
+public:
+    Frustum();
+    explicit Frustum(const glm::mat4 &viewProj);
+
+    // extract the planes from a (OpenGL) view-projection matrix
+    void update(const glm::mat4 &viewProj);
+
+    // conservative test, false only if the box is completely outside one plane
+    bool intersectsAABB(glm::vec3 min, glm::vec3 max) const;
+
+    // run intersectsAABB on every box of the list
+    // visible[i] is set to 1 if box i might be visible, 0 otherwise
+    void cullAABBs(const AABBList &boxes, std::vector<uint8_t> *visible) const;
+};
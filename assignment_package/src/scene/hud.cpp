@@ -0,0 +1,166 @@
+#include "hud.h"
+#include <algorithm>
+
+
+HUD::HUD(OpenGLContext *context)
+    : Drawable(context), m_layers(), m_bufferDirty(true), m_buffer(),
+      m_quadCapacity(0), m_tessellatedLayers(0)
+{}
+
+HUD::~HUD()
+{}
+
+int HUD::addLayer(HUDElement *element, Texture *texture, int textureSlot, bool blend)
+{
+    Layer layer;
+    layer.element = element;
+    layer.texture = texture;
+    layer.textureSlot = textureSlot;
+    layer.blend = blend;
+    layer.visible = true;
+    layer.dirty = true;
+    layer.firstIdx = 0;
+    layer.idxCount = 0;
+    m_layers.push_back(layer);
+    return static_cast<int>(m_layers.size()) - 1;
+}
+
+void HUD::setLayerVisible(int layer, bool visible)
+{
+    m_layers[layer].visible = visible;
+}
+
+void HUD::markDirty(int layer)
+{
+    m_layers[layer].dirty = true;
+}
+
+void HUD::markAllDirty()
+{
+    for (Layer &layer : m_layers) {
+        layer.dirty = true;
+    }
+}
+
+/**
+ * @brief HUD::update
+ *  Only the dirty layers are re-tessellated,
+ *  the vertices are uploaded only if any layer was.
+ */
+void HUD::update()
+{
+    m_tessellatedLayers = 0;
+    for (Layer &layer : m_layers) {
+        if (!layer.dirty) {
+            continue;
+        }
+        layer.vertices.clear();
+        layer.element->tessellate(layer.vertices);
+        layer.dirty = false;
+        m_bufferDirty = true;
+        m_tessellatedLayers++;
+    }
+
+    if (m_bufferDirty) {
+        createVBOdata();
+    }
+}
+
+/**
+ * @brief HUD::createVBOdata
+ *  inherited from Drawable
+ *  Pack the vertices of all the layers (hidden ones included, so showing
+ *  them doesn't need an upload) into one interleaved buffer.
+ *  The index buffer is only re-uploaded when the number of quads grows.
+ */
+void HUD::createVBOdata()
+{
+    m_buffer.clear();
+    int quadCount = 0;
+
+    for (Layer &layer : m_layers) {
+        int layerQuads = static_cast<int>(layer.vertices.size()) / 4;
+        layer.firstIdx = quadCount * 6;
+        layer.idxCount = layerQuads * 6;
+        quadCount += layerQuads;
+
+        for (int i = 0; i < layerQuads * 4; ++i) {
+            pushVec4ToBuffer(m_buffer, layer.vertices[i].pos);
+            pushVec2ToBuffer(m_buffer, layer.vertices[i].uv);
+        }
+    }
+
+    generatePos();
+    bufferData(GL_ARRAY_BUFFER, m_bufPos, m_buffer.size() * sizeof(float), m_buffer.data());
+
+    if (quadCount > m_quadCapacity) {
+        // grow to the next power of two, so adding a few quads doesn't re-upload every time
+        int capacity = std::max(m_quadCapacity, 64);
+        while (capacity < quadCount) {
+            capacity *= 2;
+        }
+
+        std::vector<GLuint> indices;
+        std::vector<GLuint> faceIndices = {0, 1, 2, 0, 2, 3};
+        indices.reserve(capacity * 6);
+        for (int quad = 0; quad < capacity; ++quad) {
+            for (GLuint index : faceIndices) {
+                indices.push_back(quad * 4 + index);
+            }
+        }
+
+        generateIdx();
+        bufferData(GL_ELEMENT_ARRAY_BUFFER, m_bufIdx, indices.size() * sizeof(GLuint), indices.data());
+        m_quadCapacity = capacity;
+    }
+
+    m_count = quadCount * 6;
+    m_bufferDirty = false;
+}
+
+/**
+ * @brief HUD::draw
+ *  Draw the visible layers in order, merging consecutive layers
+ *  that use the same texture & blend state into one draw call.
+ * @param prog : a shader program with texture.vert.glsl & texture.frag.glsl
+ */
+void HUD::draw(ShaderProgram &prog)
+{
+    int layerCount = static_cast<int>(m_layers.size());
+    int i = 0;
+    while (i < layerCount) {
+        const Layer &first = m_layers[i];
+        if (!first.visible || first.idxCount == 0) {
+            ++i;
+            continue;
+        }
+
+        int idxCount = first.idxCount;
+        int j = i + 1;
+        for (; j < layerCount; ++j) {
+            const Layer &next = m_layers[j];
+            if (!next.visible || next.texture != first.texture || next.blend != first.blend
+                    || next.firstIdx != first.firstIdx + idxCount) {
+                break;
+            }
+            idxCount += next.idxCount;
+        }
+
+        if (first.blend) {
+            mp_context->glEnable(GL_BLEND);
+        }
+        first.texture->bind(first.textureSlot);
+        prog.setTexture(first.textureSlot);
+        prog.drawInterleavedTexture(*this, first.firstIdx, idxCount);
+        if (first.blend) {
+            mp_context->glDisable(GL_BLEND);
+        }
+
+        i = j;
+    }
+}
+
+int HUD::getTessellatedLayerCount() const
+{
+    return m_tessellatedLayers;
+}
@@ -0,0 +1,63 @@
+#pragma once
+#include "drawable.h"
+#include "hudelement.h"
+#include "shaderprogram.h"
+#include "texture.h"
+#include <vector>
+
+// Retained-mode HUD: the quads of all the HUD elements live in one
+// interleaved (pos vec4, uv vec2) vertex buffer. An element is only
+// re-tessellated when it is marked dirty, and the buffer is only
+// re-uploaded when an element changed, so an unchanged HUD costs
+// a few draw calls and no CPU-side geometry work.
+// Layers are drawn in the order they were added; consecutive visible
+// layers with the same texture & blend state are drawn with one draw call.
+class HUD : public Drawable
+{
+private:
+    struct Layer
+    {
+        HUDElement *element;
+        Texture *texture;
+        int textureSlot;
+        bool blend;
+        bool visible;
+        bool dirty;
+        // the last tessellation of element
+        std::vector<HUDVertex> vertices;
+        // the indices of the layer in the index buffer
+        int firstIdx;
+        int idxCount;
+    };
+
+    std::vector<Layer> m_layers;
+    // set when a layer was re-tessellated, cleared by createVBOdata()
+    bool m_bufferDirty;
+    // reused by createVBOdata()
+    std::vector<float> m_buffer;
+    // the number of quads the index buffer holds indices for,
+    // every quad uses the same 6 indices so it only grows
+    int m_quadCapacity;
+    // the number of layers re-tessellated by the last update()
+    int m_tessellatedLayers;
+
+public:
+    HUD(OpenGLContext *context);
+    virtual ~HUD();
+
+    // draw element with the given texture, returns the layer index
+    int addLayer(HUDElement *element, Texture *texture, int textureSlot, bool blend);
+    void setLayerVisible(int layer, bool visible);
+    // re-tessellate the layer in the next update()
+    void markDirty(int layer);
+    void markAllDirty();
+
+    // re-tessellate the dirty layers & upload the vertices if any changed
+    void update();
+    void draw(ShaderProgram &prog);
+
+    // upload the vertices of all the layers
+    virtual void createVBOdata();
+
+    int getTessellatedLayerCount() const;
+};
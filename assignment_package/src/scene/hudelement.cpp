@@ -0,0 +1,31 @@
+#include "hudelement.h"
+
+
+/**
+ * @brief HUDElement::splitQuads
+ *  used by the createVBOdata of the HUD elements,
+ *  so they can still be drawn on their own
+ * @param verts : 4 vertices per quad
+ * @param indices
+ * @param buffer_pos : vec4 per vertex
+ * @param buffer_uv : vec2 per vertex
+ */
+void HUDElement::splitQuads(const std::vector<HUDVertex> &verts, std::vector<GLuint> &indices,
+                            std::vector<float> &buffer_pos, std::vector<float> &buffer_uv)
+{
+    static const GLuint faceIndices[6] = {0, 1, 2, 0, 2, 3};
+
+    for (int nVert = 0; nVert + 3 < static_cast<int>(verts.size()); nVert += 4) {
+        for (GLuint index : faceIndices) {
+            indices.push_back(nVert + index);
+        }
+    }
+
+    for (const HUDVertex &v : verts) {
+        for (int i = 0; i < 4; ++i) {
+            buffer_pos.push_back(v.pos[i]);
+        }
+        buffer_uv.push_back(v.uv[0]);
+        buffer_uv.push_back(v.uv[1]);
+    }
+}
@@ -0,0 +1,35 @@
+#pragma once
+#include <openglcontext.h>
+#include <glm_includes.h>
+#include <vector>
+
+// one vertex of a HUD quad
+struct HUDVertex
+{
+    glm::vec4 pos;
+    glm::vec2 uv;
+
+    HUDVertex(glm::vec2 p, glm::vec2 u)
+        : pos(glm::vec4(p, 0.999999f, 1.f)), uv(u) {}
+    HUDVertex(glm::vec4 p, glm::vec2 u)
+        : pos(p), uv(u) {}
+    HUDVertex()
+        : pos(), uv() {}
+};
+
+// Something drawn on the HUD (widgets, items in widgets, text).
+// The draw data is collected by addItem / addText and turned into quads by tessellate(),
+// which the HUD only calls when the element is marked dirty.
+class HUDElement
+{
+public:
+    virtual ~HUDElement() {}
+
+    // append 4 vertices per quad (bottom-left, bottom-right, top-right, top-left)
+    // for the collected draw data to verts, then clear the collected data
+    virtual void tessellate(std::vector<HUDVertex> &verts) = 0;
+
+    // split the quads of tessellate() into the separate index / pos / uv buffers of a Drawable
+    static void splitQuads(const std::vector<HUDVertex> &verts, std::vector<GLuint> &indices,
+                           std::vector<float> &buffer_pos, std::vector<float> &buffer_uv);
+};
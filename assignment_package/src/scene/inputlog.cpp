@@ -0,0 +1,189 @@
+#include "inputlog.h"
+#include "player.h"
+
+
+// "MCIL", then the format version
+static const quint32 LOG_MAGIC = 0x4d43494c;
+static const quint32 LOG_VERSION = 1;
+
+/**
+ * @brief PlayerCommand::apply
+ *  Note: the world lock must be held
+ * @param player
+ * @param inputs : the inputs of the step
+ */
+void PlayerCommand::apply(Player &player, InputBundle &inputs) const
+{
+    switch (type) {
+    case ROTATE_VIEW:
+        player.rotateCameraView(v.x, v.y);
+        break;
+    case ROTATE_UP_GLOBAL:
+        player.rotateOnUpGlobal(v.x);
+        break;
+    case ROTATE_RIGHT_LOCAL:
+        player.rotateOnRightLocal(v.x);
+        break;
+    case TOGGLE_FLIGHT:
+        player.toggleFlightMode();
+        break;
+    case FILL_ALL_BLOCKS:
+        player.fillAllBlocks();
+        break;
+    case SELECT_NEXT_BLOCK:
+        player.selectNextBlockOnHand(inputs);
+        break;
+    case TOGGLE_CONTAINER:
+        player.toggleContainerMode();
+        break;
+    case SWITCH_CAMERA:
+        player.switchCameraView();
+        break;
+    case TELEPORT:
+        player.setPos(v);
+        break;
+    }
+}
+
+// the keys of an InputBundle, one bit each
+static quint32 packKeys(const InputBundle &inputs)
+{
+    bool keys[12] = {inputs.wPressed, inputs.aPressed, inputs.sPressed, inputs.dPressed,
+                     inputs.qPressed, inputs.ePressed, inputs.spacePressed,
+                     inputs.leftMouseButtonPressed, inputs.rightMouseButtonPressed,
+                     inputs.pPressed, inputs.nPressed, inputs.iPressed};
+    quint32 bits = 0;
+    for (int i = 0; i < 12; i++) {
+        bits |= static_cast<quint32>(keys[i]) << i;
+    }
+    for (int i = 0; i < 10; i++) {
+        bits |= static_cast<quint32>(inputs.numberPressed[i]) << (12 + i);
+    }
+    return bits;
+}
+
+static void unpackKeys(quint32 bits, InputBundle &inputs)
+{
+    bool *keys[12] = {&inputs.wPressed, &inputs.aPressed, &inputs.sPressed, &inputs.dPressed,
+                      &inputs.qPressed, &inputs.ePressed, &inputs.spacePressed,
+                      &inputs.leftMouseButtonPressed, &inputs.rightMouseButtonPressed,
+                      &inputs.pPressed, &inputs.nPressed, &inputs.iPressed};
+    for (int i = 0; i < 12; i++) {
+        *keys[i] = (bits >> i) & 1;
+    }
+    for (int i = 0; i < 10; i++) {
+        inputs.numberPressed[i] = (bits >> (12 + i)) & 1;
+    }
+}
+
+
+InputRecorder::InputRecorder()
+    : m_file(), m_out()
+{}
+
+InputRecorder::~InputRecorder()
+{
+    close();
+}
+
+bool InputRecorder::open(const QString &path, const InputLogHeader &header)
+{
+    close();
+    m_file.setFileName(path);
+    if (!m_file.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+    m_out.setDevice(&m_file);
+    m_out.setVersion(QDataStream::Qt_6_0);
+    m_out.setFloatingPointPrecision(QDataStream::SinglePrecision);
+
+    m_out << LOG_MAGIC << LOG_VERSION
+          << static_cast<quint32>(header.seed) << static_cast<qint32>(header.width)
+          << static_cast<qint32>(header.height) << header.timeStep;
+    return true;
+}
+
+/**
+ * @brief InputRecorder::write
+ *  18 bytes per step, 13 more per command
+ * @param frame
+ */
+void InputRecorder::write(const InputFrame &frame)
+{
+    if (!m_file.isOpen()) {
+        return;
+    }
+    m_out << frame.dT << packKeys(frame.inputs) << frame.inputs.mouseX << frame.inputs.mouseY
+          << static_cast<quint16>(frame.commands.size());
+    for (const PlayerCommand &command : frame.commands) {
+        m_out << static_cast<quint8>(command.type) << command.v.x << command.v.y << command.v.z;
+    }
+}
+
+void InputRecorder::close()
+{
+    if (m_file.isOpen()) {
+        m_file.close();
+    }
+    m_out.setDevice(nullptr);
+}
+
+bool InputRecorder::isOpen() const
+{
+    return m_file.isOpen();
+}
+
+
+InputReplay::InputReplay()
+    : m_file(), m_in(), m_header()
+{}
+
+bool InputReplay::open(const QString &path)
+{
+    m_file.setFileName(path);
+    if (!m_file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    m_in.setDevice(&m_file);
+    m_in.setVersion(QDataStream::Qt_6_0);
+    m_in.setFloatingPointPrecision(QDataStream::SinglePrecision);
+
+    quint32 magic = 0, version = 0, seed = 0;
+    qint32 width = 0, height = 0;
+    m_in >> magic >> version >> seed >> width >> height >> m_header.timeStep;
+    if (m_in.status() != QDataStream::Ok || magic != LOG_MAGIC || version != LOG_VERSION) {
+        m_file.close();
+        return false;
+    }
+    m_header.seed = seed;
+    m_header.width = width;
+    m_header.height = height;
+    return true;
+}
+
+bool InputReplay::next(InputFrame &frame)
+{
+    if (!m_file.isOpen() || m_in.atEnd()) {
+        return false;
+    }
+    quint32 keys = 0;
+    quint16 commandCount = 0;
+    frame.inputs = InputBundle();
+    m_in >> frame.dT >> keys >> frame.inputs.mouseX >> frame.inputs.mouseY >> commandCount;
+    unpackKeys(keys, frame.inputs);
+
+    frame.commands.clear();
+    for (int i = 0; i < commandCount; i++) {
+        quint8 type = 0;
+        glm::vec3 v;
+        m_in >> type >> v.x >> v.y >> v.z;
+        frame.commands.push_back(PlayerCommand(static_cast<PlayerCommand::Type>(type), v));
+    }
+    // a log cut short (e.g. the app was killed) ends at the last whole step
+    return m_in.status() == QDataStream::Ok;
+}
+
+const InputLogHeader& InputReplay::getHeader() const
+{
+    return m_header;
+}
@@ -0,0 +1,101 @@
+#pragma once
+#include "glm_includes.h"
+#include "entity.h"
+#include <QDataStream>
+#include <QFile>
+#include <QString>
+#include <vector>
+
+class Player;
+
+// A change of the player requested by the GUI thread (camera rotation, mode toggles, ...).
+// They are queued & applied at the start of the next simulation step,
+// so a step only depends on its InputFrame.
+struct PlayerCommand
+{
+    enum Type : unsigned char
+    {
+        ROTATE_VIEW,        // v.xy: mouse offset from the screen centre (pixels)
+        ROTATE_UP_GLOBAL,   // v.x: degrees
+        ROTATE_RIGHT_LOCAL, // v.x: degrees
+        TOGGLE_FLIGHT,
+        FILL_ALL_BLOCKS,
+        SELECT_NEXT_BLOCK,
+        TOGGLE_CONTAINER,
+        SWITCH_CAMERA,
+        TELEPORT            // v: position
+    };
+
+    Type type;
+    glm::vec3 v;
+
+    PlayerCommand(Type type, glm::vec3 v = glm::vec3(0.f))
+        : type(type), v(v)
+    {}
+
+    void apply(Player &player, InputBundle &inputs) const;
+};
+
+// Everything a simulation step reads: its time step, the key / mouse state
+// & the commands queued since the previous step
+struct InputFrame
+{
+    float dT;
+    InputBundle inputs;
+    std::vector<PlayerCommand> commands;
+
+    InputFrame()
+        : dT(0.f), inputs(), commands()
+    {}
+};
+
+// The header of an input log: what the session must start from to replay the same
+struct InputLogHeader
+{
+    unsigned int seed;
+    // the viewport of the recording, a replay renders as many pixels
+    int width, height;
+    float timeStep;
+
+    InputLogHeader()
+        : seed(0), width(0), height(0), timeStep(0.f)
+    {}
+};
+
+// Writes the InputFrames of a session into a compact binary log:
+// the header, then per step dT, the pressed keys as a bit mask,
+// the mouse position & the commands.
+class InputRecorder
+{
+private:
+    QFile m_file;
+    QDataStream m_out;
+
+public:
+    InputRecorder();
+    ~InputRecorder();
+
+    bool open(const QString &path, const InputLogHeader &header);
+    void write(const InputFrame &frame);
+    void close();
+    bool isOpen() const;
+};
+
+// Reads an input log written by InputRecorder
+class InputReplay
+{
+private:
+    QFile m_file;
+    QDataStream m_in;
+    InputLogHeader m_header;
+
+public:
+    InputReplay();
+
+    // false if the file can't be read or is not an input log
+    bool open(const QString &path);
+    // false at the end of the log
+    bool next(InputFrame &frame);
+
+    const InputLogHeader& getHeader() const;
+};
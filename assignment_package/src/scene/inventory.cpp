@@ -1,7 +1,8 @@
 #include "inventory.h"
 
 Inventory::Inventory()
-    : selectedBlockPtr(0), max_blocks(64), blocksOnHandSize(9), blocksInInventorySize(blocksOnHandSize+27)
+    : selectedBlockPtr(0), max_blocks(64), blocksOnHandSize(9), blocksInInventorySize(blocksOnHandSize+27),
+      version(0)
 {
     initBlocks();
 }
@@ -13,6 +14,7 @@ void Inventory::initBlocks() {
     for (int j = 0; j < blocksInInventorySize; ++j) {
         blocksInInventory.push_back(std::make_pair(EMPTY, 0));
     }
+    version++;
 }
 
 /**
@@ -40,6 +42,7 @@ void Inventory::getItemInfo(std::vector<std::pair<BlockType, int>>* itemsInfo) {
  */
 void Inventory::setBlock(int overallIdx, BlockType& blockType, int count) {
     blocksInInventory[overallIdx] = (std::make_pair(blockType, count));
+    version++;
     return;
 }
 
@@ -51,6 +54,7 @@ void Inventory::setBlocks(std::vector<BlockType>& blockTypes, int count) {
     for (int j = 0; j < inventory_count; ++j) {
         blocksInInventory[j] = (std::make_pair(blockTypes[j], count));
     }
+    version++;
 
     return;
 }
@@ -82,6 +86,10 @@ int Inventory::getBlocksInInventorySize() {
     return blocksInInventorySize;
 }
 
+int Inventory::getVersion() const {
+    return version;
+}
+
 bool Inventory::storeBlock(BlockType blockType) {    
 
     int firstEmptyIdxInInventory = -1;
@@ -89,6 +97,7 @@ bool Inventory::storeBlock(BlockType blockType) {
     for (int i = 0; i < blocksInInventorySize; ++i) {
         if (blocksInInventory[i].first == blockType && blocksInInventory[i].second < max_blocks) {
             blocksInInventory[i].second += 1;
+            version++;
             return true;
         }
 
@@ -100,6 +109,7 @@ bool Inventory::storeBlock(BlockType blockType) {
     if (firstEmptyIdxInInventory >= 0) {
         blocksInInventory[firstEmptyIdxInInventory].first = blockType;
         blocksInInventory[firstEmptyIdxInInventory].second = 1;
+        version++;
         return true;
     }
     return false;
@@ -116,6 +126,7 @@ BlockType Inventory::placeBlock() {
     if (blocksInInventory[selectedBlockPtr].second == 0) {
         blocksInInventory[selectedBlockPtr].first = EMPTY;
     }
+    version++;
 
     return targetBlockType;
 }
@@ -151,6 +162,7 @@ bool Inventory::switchItems(int overallIdxFrom, int overallIdxTo, BlockType from
     if (Block::isEmpty(fromItemType)) {
         return false;
     }
+    version++;
 
     if (fromItemType == blocksInInventory[overallIdxTo].first) {
         if (fromItemCount + blocksInInventory[overallIdxTo].second > max_blocks) {
@@ -177,4 +189,5 @@ bool Inventory::switchItems(int overallIdxFrom, int overallIdxTo, BlockType from
 void Inventory::clearItem(int overallIdx) {
     blocksInInventory[overallIdx].first = EMPTY;
     blocksInInventory[overallIdx].second = 0;
+    version++;
 }
@@ -28,6 +28,9 @@ private:
     // the blocks that the player currently holds (including in box)
     std::vector<std::pair<BlockType, int>> blocksInInventory;
 
+    // incremented whenever blocksInInventory changes
+    int version;
+
 public:
 
     Inventory();
@@ -67,6 +70,9 @@ public:
     // getter function of size
     int getBlocksOnHandSize();
     int getBlocksInInventorySize();
+
+    // compare with an earlier value to check if the items changed (e.g. to redraw the HUD)
+    int getVersion() const;
 };
 
 
@@ -1,4 +1,5 @@
 #include "lsystems.h"
+#include "seededrandom.h"
 #define GLM_FORCE_RADIANS
 #include <glm/gtx/transform.hpp>
 #include <iostream>
@@ -83,7 +84,7 @@ void LSystem::printPath(){
 }
 
 float LSystem::rand01(){
-    float n = static_cast <float> (rand()) / static_cast <float> (RAND_MAX);
+    float n = SeededRandom::next01();
     return n;
 }
 
@@ -138,7 +139,7 @@ void Turtle::printOrientation() const{
 }
 
 float Turtle::randAngle() const{
-    float n = static_cast <float> (rand()) / static_cast <float> (RAND_MAX);
+    float n = SeededRandom::next01();
     return n * PI_4;
 }
 
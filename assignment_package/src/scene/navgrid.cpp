@@ -0,0 +1,144 @@
+#include "navgrid.h"
+#include "chunk.h"
+
+NavColumn::NavColumn()
+    : standable(), blocker()
+{
+    standable.fill(0);
+    blocker.fill(0);
+}
+
+bool NavColumn::isStandable(int y) const
+{
+    return y >= 0 && y < 256 && (standable[y >> 6] >> (y & 63)) & 1;
+}
+
+bool NavColumn::isBlocker(int y) const
+{
+    return y >= 0 && y < 256 && (blocker[y >> 6] >> (y & 63)) & 1;
+}
+
+// 0 is left for "no grid"
+std::atomic<uint64_t> NavGrid::s_nextRevision(1);
+
+NavGrid::NavGrid()
+    : m_columns(), m_revision(s_nextRevision++), m_editCount(0)
+{}
+
+bool NavGrid::isWalkable(BlockType t)
+{
+    switch (t) {
+    case GRASS:
+    case DIRT:
+    case STONE:
+    case SNOW:
+    case GWOOD:
+    case WOOD:
+        return true;
+    default:
+        return false;
+    }
+}
+
+// the blocks outside of [0, 256) are EMPTY
+static BlockType getColumnBlock(const Chunk &chunk, int x, int y, int z)
+{
+    if (y < 0 || y >= 256) {
+        return EMPTY;
+    }
+    return chunk.getBlockAt(x, y, z);
+}
+
+bool NavGrid::computeStandable(const Chunk &chunk, int x, int y, int z)
+{
+    return isWalkable(getColumnBlock(chunk, x, y, z)) && getColumnBlock(chunk, x, y + 1, z) == EMPTY;
+}
+
+bool NavGrid::computeBlocker(const Chunk &chunk, int x, int y, int z)
+{
+    if (getColumnBlock(chunk, x, y + 1, z) != EMPTY) {
+        return true;
+    }
+    return getColumnBlock(chunk, x, y, z) == EMPTY
+            && getColumnBlock(chunk, x, y - 1, z) == EMPTY
+            && getColumnBlock(chunk, x, y - 2, z) == EMPTY;
+}
+
+/**
+ * @brief NavGrid::build
+ *  One pass up each column, keeping the 3 blocks below & the one above
+ * @param blocks
+ */
+void NavGrid::build(const ChunkBlocks &blocks)
+{
+    m_revision = s_nextRevision++;
+    m_editCount = blocks.editCount;
+    for (int z = 0; z < 16; z++) {
+        for (int x = 0; x < 16; x++) {
+            NavColumn &column = m_columns[x + 16 * z];
+            column = NavColumn();
+            BlockType below2 = EMPTY, below1 = EMPTY;
+            BlockType curr = blocks.getBlockAt(x, 0, z);
+            for (int y = 0; y < 256; y++) {
+                BlockType above = y < 255 ? blocks.getBlockAt(x, y + 1, z) : EMPTY;
+                uint64_t bit = uint64_t(1) << (y & 63);
+                if (isWalkable(curr) && above == EMPTY) {
+                    column.standable[y >> 6] |= bit;
+                }
+                if (above != EMPTY || (curr == EMPTY && below1 == EMPTY && below2 == EMPTY)) {
+                    column.blocker[y >> 6] |= bit;
+                }
+                below2 = below1;
+                below1 = curr;
+                curr = above;
+            }
+        }
+    }
+}
+
+/**
+ * @brief NavGrid::update
+ *  Block y is the top of block y - 1 & in the drop below blocks y + 1 & y + 2.
+ *  The revision only changes with a flag, so a field or a portal over the grid stays current
+ * @param chunk
+ * @param x
+ * @param y
+ * @param z
+ */
+void NavGrid::update(const Chunk &chunk, int x, int y, int z)
+{
+    NavColumn &column = m_columns[x + 16 * z];
+    bool changed = false;
+    for (int cy = glm::max(y - 1, 0); cy <= glm::min(y + 2, 255); cy++) {
+        uint64_t bit = uint64_t(1) << (cy & 63);
+        uint64_t standable = column.standable[cy >> 6] & ~bit;
+        uint64_t blocker = column.blocker[cy >> 6] & ~bit;
+        if (computeStandable(chunk, x, cy, z)) {
+            standable |= bit;
+        }
+        if (computeBlocker(chunk, x, cy, z)) {
+            blocker |= bit;
+        }
+        changed = changed || standable != column.standable[cy >> 6] || blocker != column.blocker[cy >> 6];
+        column.standable[cy >> 6] = standable;
+        column.blocker[cy >> 6] = blocker;
+    }
+    if (changed) {
+        m_revision = s_nextRevision++;
+    }
+}
+
+const NavColumn& NavGrid::getColumn(int x, int z) const
+{
+    return m_columns[x + 16 * z];
+}
+
+uint64_t NavGrid::getRevision() const
+{
+    return m_revision;
+}
+
+uint64_t NavGrid::getEditCount() const
+{
+    return m_editCount;
+}
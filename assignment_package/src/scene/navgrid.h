@@ -0,0 +1,60 @@
+#pragma once
+#include "block.h"
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+class Chunk;
+struct ChunkBlocks;
+
+// The navigation flags of one 16 x 256 x 16 column of blocks, bit y of a mask is the block at y
+struct NavColumn
+{
+    // an NPC can stand on the block: a walkable block with EMPTY right above it
+    std::array<uint64_t, 4> standable;
+    // an NPC standing next to the block may have to jump:
+    // a block right above it, or a drop of 3+ blocks
+    std::array<uint64_t, 4> blocker;
+
+    NavColumn();
+
+    bool isStandable(int y) const;
+    bool isBlocker(int y) const;
+};
+
+// The navigation layer of a Chunk, queried by the PathFinder instead of the blocks:
+// whether a neighbor can be walked or jumped to is one bit of its column.
+// Built alongside the chunk's mesh (VBOWorker) & patched by Chunk::setBlockAt.
+// Both flags only depend on the blocks of their own column,
+// so an edit never touches the grid of another chunk.
+class NavGrid
+{
+private:
+    // indexed by x + 16 * z
+    std::array<NavColumn, 256> m_columns;
+    // changes whenever a flag does, never the same for 2 grids (see PortalGraph)
+    uint64_t m_revision;
+    static std::atomic<uint64_t> s_nextRevision;
+    // the edit count of the chunk's blocks it was built from (see Chunk::adoptPendingNavGrid)
+    uint64_t m_editCount;
+
+    // compute the flags of block y of the column
+    static bool computeStandable(const Chunk &chunk, int x, int y, int z);
+    static bool computeBlocker(const Chunk &chunk, int x, int y, int z);
+
+public:
+    NavGrid();
+
+    // the blocks an NPC walks on
+    static bool isWalkable(BlockType t);
+
+    // compute every flag from a copy of the blocks of the chunk
+    void build(const ChunkBlocks &blocks);
+    // recompute the flags depending on block (x, y, z) after it changed
+    void update(const Chunk &chunk, int x, int y, int z);
+
+    // x, z in [0, 16)
+    const NavColumn& getColumn(int x, int z) const;
+    uint64_t getRevision() const;
+    uint64_t getEditCount() const;
+};
@@ -291,9 +291,22 @@ glm::vec3 RotateNode::getAxis() const
  * @return mat3
  */
 glm::mat4 RotateNode::computeTransform(glm::mat4 transform)
+{
+    return computeTransform(transform, deg);
+}
+
+/**
+ * @brief RotateNode::computeTransform
+ *  Same as computeTransform(transform), but with the given degree
+ *  instead of the stored one (used to draw interpolated snapshots).
+ * @param transform
+ * @param degree
+ * @return mat4
+ */
+glm::mat4 RotateNode::computeTransform(glm::mat4 transform, float degree) const
 {
     // convert to radian
-    float radian = deg * (PI / 180.f);
+    float radian = degree * (PI / 180.f);
 
     // apply on transform => transform * rotateMatrix
     // return glm::rotate(transform, radian);
@@ -111,6 +111,8 @@ public:
 
     // compute & return transformation matrix (3 x 3)
     glm::mat4 computeTransform(glm::mat4 transform) override;
+    // same, but rotate by the given degree instead of deg
+    glm::mat4 computeTransform(glm::mat4 transform, float degree) const;
 
     // virtual destructor
     virtual ~RotateNode();
@@ -1,4 +1,7 @@
 #include "npc.h"
+#include "npcstore.h"
+#include "metrics.h"
+#include <algorithm>
 
 extern void pushVec4ToBuffer(std::vector<float> &buf, const glm::vec4 &vec);
 extern void pushVec2ToBuffer(std::vector<float> &buf, const glm::vec2 &vec);
@@ -21,17 +24,26 @@ NPC::NPC(OpenGLContext *context, glm::vec3 pos, Terrain &terrain, Player &player
     actionTimer(0.f),
     actionTimeout(3.f),
     nToDoActions(0),
+    plansRoutes(false),
+    followsFlowFields(false),
+    mp_pathService(nullptr),
+    pathPending(false),
+    m_pathRequested(false),
+    m_requestedGoal(0.f),
+    m_cancelPath(false),
     stuckPos(pos),
     stuckTimer(0.f),
     toleranceOfGoal(toleranceOfGoal),
     toleranceOfStep(toleranceOfStep),
+    m_neighbors(),
     m_acceleration(0.f, 0.f, 0.f),
     m_velocity(initialVelocity),
-    m_gravity(0.f, -12.f, 0.f),
+    m_gravity(0.f, GRAVITY, 0.f),
     m_default_velocity(initialVelocity),
     prev_m_position(pos),
-    maxFallingSpeed(-10.f),
+    maxFallingSpeed(MAX_FALLING_SPEED),
     onGround(false),
+    m_collider(true),
     walkingDistCycle(0),
     limbRotNodes(),
     limbRotationSpeedOnGround(4.f),
@@ -86,11 +98,126 @@ NPC::NPC(OpenGLContext *context, glm::vec3 pos, Terrain &terrain, Player &player
 void NPC::draw(ShaderProgram *shader)
 {
     // traverse the scene graph to get all overall transforms
-    glm::mat4 transform = glm::mat4(glm::vec4(m_right, 0.f),
-                                    glm::vec4(m_up, 0.f),
-                                    glm::vec4(m_forward, 0.f),
-                                    glm::vec4(this->mcr_position, 1));
-    traverseSceneGraph(shader, root, transform);
+    traverseSceneGraph(shader, root, getRootTransform());
+}
+
+/**
+ * @brief NPC::draw
+ *  Draw this npc with the transforms stored in the snapshot.
+ *  Only reads the (immutable) scene graph structure,
+ *  so it is safe while the simulation thread ticks this NPC.
+ * @param shader
+ * @param snapshot
+ */
+void NPC::draw(ShaderProgram *shader, const NPCSnapshot &snapshot)
+{
+    unsigned int rotIdx = 0;
+    traverseSceneGraph(shader, root, snapshot.rootTransform, snapshot.rotDegs, &rotIdx);
+}
+
+/**
+ * @brief NPC::getRootTransform
+ * @return the world transform of the scene graph root
+ */
+glm::mat4 NPC::getRootTransform() const
+{
+    return glm::mat4(glm::vec4(m_right, 0.f),
+                     glm::vec4(m_up, 0.f),
+                     glm::vec4(m_forward, 0.f),
+                     glm::vec4(this->mcr_position, 1));
+}
+
+/**
+ * @brief collectRotations
+ *  Helper to collect the degrees of all RotateNodes (pre-order)
+ * @param node
+ * @param rotDegs
+ */
+static void collectRotations(const uPtr<Node> &node, std::vector<float> *rotDegs)
+{
+    RotateNode *rot = dynamic_cast<RotateNode *>(node.get());
+    if (rot != nullptr)
+    {
+        rotDegs->push_back(rot->getDeg());
+    }
+
+    for (const uPtr<Node> &subNode : node->getChildren())
+    {
+        collectRotations(subNode, rotDegs);
+    }
+}
+
+/**
+ * @brief NPC::takeSnapshot
+ *  Capture everything needed to draw this NPC at the current tick
+ * @return snapshot
+ */
+NPCSnapshot NPC::takeSnapshot() const
+{
+    NPCSnapshot snapshot;
+    snapshot.rootTransform = getRootTransform();
+    if (root != nullptr)
+    {
+        collectRotations(root, &snapshot.rotDegs);
+    }
+    return snapshot;
+}
+
+/**
+ * @brief collectLimbIndices
+ *  Helper to find the limbs among the RotateNodes (pre-order, as collectRotations)
+ * @param node
+ * @param limbs
+ * @param rotIdx : the RotateNodes met so far
+ * @param indices
+ */
+static void collectLimbIndices(const uPtr<Node> &node, const std::vector<Node*> &limbs,
+                               int *rotIdx, std::vector<int> *indices)
+{
+    if (dynamic_cast<RotateNode *>(node.get()) != nullptr)
+    {
+        if (std::find(limbs.begin(), limbs.end(), node.get()) != limbs.end())
+        {
+            indices->push_back(*rotIdx);
+        }
+        (*rotIdx)++;
+    }
+
+    for (const uPtr<Node> &subNode : node->getChildren())
+    {
+        collectLimbIndices(subNode, limbs, rotIdx, indices);
+    }
+}
+
+/**
+ * @brief NPC::getArchetype
+ * @return
+ */
+NPCArchetype NPC::getArchetype() const
+{
+    NPCArchetype archetype;
+    archetype.texture = npcTexture;
+    archetype.rootToGround = rootToGround;
+    archetype.rootToTop = rootToTop;
+    archetype.rootToFront = rootToFront;
+    archetype.rootToBack = rootToBack;
+    archetype.rootToLeft = rootToLeft;
+    archetype.rootToRight = rootToRight;
+    archetype.defaultVelocity = m_default_velocity;
+    archetype.toleranceOfGoal = toleranceOfGoal;
+    archetype.toleranceOfStep = toleranceOfStep;
+    archetype.searchRadius = pathFinder.getRadius();
+    archetype.limbRotationSpeedOnGround = limbRotationSpeedOnGround;
+    archetype.limbRotationSpeedOffGround = limbRotationSpeedOffGround;
+    archetype.maxLimbDegOnGround = maxLimbDegOnGround;
+    archetype.maxLimbDegOffGround = maxLimbDegOffGround;
+    if (root != nullptr)
+    {
+        collectRotations(root, &archetype.restDegs);
+        int rotIdx = 0;
+        collectLimbIndices(root, limbRotNodes, &rotIdx, &archetype.limbRotIndices);
+    }
+    return archetype;
 }
 
 
@@ -116,6 +243,44 @@ void NPC::traverseSceneGraph(ShaderProgram *shader, const uPtr<Node> &node, glm:
     }
 }
 
+/**
+ * @brief traverseSceneGraph
+ *  Same as above, but the RotateNodes use the degrees in rotDegs
+ *  (in the same pre-order as NPC::takeSnapshot collects them)
+ * @param node
+ * @param transform
+ * @param rotDegs
+ * @param rotIdx : index of the next degree in rotDegs
+ */
+void NPC::traverseSceneGraph(ShaderProgram *shader, const uPtr<Node> &node, glm::mat4 transform,
+                             const std::vector<float> &rotDegs, unsigned int *rotIdx)
+{
+    glm::mat4 nodeTransform;
+    RotateNode *rot = dynamic_cast<RotateNode *>(node.get());
+
+    if (rot != nullptr && *rotIdx < rotDegs.size())
+    {
+        nodeTransform = rot->computeTransform(transform, rotDegs[*rotIdx]);
+        (*rotIdx)++;
+    }
+    else
+    {
+        nodeTransform = node->computeTransform(transform);
+    }
+
+    if (node->block != nullptr)
+    {
+        shader->setModelMatrix(nodeTransform);
+        shader->drawInterleaved(*(node->block));
+    }
+
+    // visit children
+    for (const uPtr<Node> &subNode : node->getChildren())
+    {
+        traverseSceneGraph(shader, subNode, nodeTransform, rotDegs, rotIdx);
+    }
+}
+
 /**
  * @brief NPC::tick
  * @param dT
@@ -138,6 +303,9 @@ glm::vec3 NPC::getCurrentGoal()
     {
         if (!goals.empty())
         {
+            static Counter &goalsReached = MetricsRegistry::global().counter("npc.goals_reached");
+            goalsReached.add();
+
             // meet the current goal
             if (goalPtr == (goals.size() - 1))
             {
@@ -232,11 +400,123 @@ void NPC::replanIfNeeded(glm::vec3 goal)
     if ((actionTimer >= actionTimeout) && (actions.size() == nToDoActions))
     {
         // std::cout << "Replan ..." << std::endl;
-        actions = pathFinder.searchPathToward(m_position,
-                                              goal);
+        // (the current actions are followed until the new ones arrive)
+        updatePath(goal);
+        actionTimer = 0.f;
+    }
+}
+
+/**
+ * @brief NPC::updatePath
+ *  Only noted during the tick, commitTick looks the path up
+ *  (the NPC keeps its actions, or idles without any, until they arrive)
+ * @param goal
+ */
+void NPC::updatePath(glm::vec3 goal)
+{
+    m_pathRequested = true;
+    m_requestedGoal = goal;
+    pathPending = true;
+}
+
+/**
+ * @brief NPC::commitTick
+ *  The path updatePath asked for: along the goal's flow field, searched now without a PathService,
+ *  or requested from it (it answers a later tick; a request already waiting gets the new goal).
+ *  Note: the world lock must be held, on one thread for every NPC (the flow fields,
+ *  the service & the nav grids are shared)
+ */
+void NPC::commitTick()
+{
+    if (m_cancelPath)
+    {
+        if (mp_pathService != nullptr)
+        {
+            mp_pathService->cancel(&pathFinder);
+        }
+        m_cancelPath = false;
+    }
+    if (!m_pathRequested)
+    {
+        return;
+    }
+    m_pathRequested = false;
+    glm::vec3 goal = m_requestedGoal;
+
+    if (followsFlowFields && !goals.empty())
+    {
+        std::queue<NPCAction> fieldActions = followFlowField(goal);
+        if (!fieldActions.empty())
+        {
+            if (mp_pathService != nullptr)
+            {
+                mp_pathService->cancel(&pathFinder);
+            }
+            pathPending = false;
+            actions = fieldActions;
+            nToDoActions = actions.size();
+            actionTimer = 0.f;
+            return;
+        }
+    }
+
+    if (mp_pathService == nullptr)
+    {
+        actions = plansRoutes ? pathFinder.searchRouteToward(m_position, goal)
+                              : pathFinder.searchPathToward(m_position, goal);
+        nToDoActions = actions.size();
+        actionTimer = 0.f;
+        pathPending = false;
+        return;
+    }
+
+    mp_pathService->request(&pathFinder, m_position, goal, plansRoutes,
+                            [this](std::queue<NPCAction> result) {
+        actions = result;
         nToDoActions = actions.size();
         actionTimer = 0.f;
+        pathPending = false;
+    });
+}
+
+/**
+ * @brief NPC::followFlowField
+ *  As many steps as a search of pathFinder would plan, one lookup each
+ * @param goal
+ * @return
+ */
+std::queue<NPCAction> NPC::followFlowField(glm::vec3 goal)
+{
+    std::queue<NPCAction> fieldActions;
+    const FlowField *field = mcr_terrain->getFlowFields().getField(goal);
+    glm::ivec3 cell;
+    if (!field->findCell(m_position, &cell))
+    {
+        return fieldActions;
+    }
+    glm::ivec3 next;
+    for (int i = 0; i < pathFinder.getRadius() && field->getNextCell(cell, &next); i++)
+    {
+        fieldActions.push(NPCAction(glm::vec3(next) + glm::vec3(0.f, 1.f, 0.f), next.y > cell.y ? JUMP : WALK));
+        cell = next;
+    }
+    return fieldActions;
+}
+
+/**
+ * @brief NPC::setPathService
+ * @param pathService : may be null
+ */
+void NPC::setPathService(PathService *pathService)
+{
+    if (mp_pathService != nullptr)
+    {
+        mp_pathService->cancel(&pathFinder);
     }
+    mp_pathService = pathService;
+    pathPending = false;
+    m_pathRequested = false;
+    m_cancelPath = false;
 }
 
 void NPC::npcRestart()
@@ -249,6 +529,13 @@ void NPC::npcRestart()
     goalDir = 1;
     actionTimer = 0.f;
     actions = std::queue<NPCAction>();
+    // a path from where it was stuck is of no use (dropped by commitTick)
+    if (pathPending)
+    {
+        m_cancelPath = true;
+        m_pathRequested = false;
+        pathPending = false;
+    }
     resetHorizontalSpeed();
     m_velocity[1] = 0.f;
     m_acceleration = glm::vec3(0.f);
@@ -274,12 +561,10 @@ void NPC::tick(float dT)
         resetHorizontalSpeed();
 
         // check if need to find a path
-        if (actions.empty())
+        if (actions.empty() && !pathPending)
         {
             // update the path
-            actions = pathFinder.searchPathToward(m_position,
-                                                  currGoal);
-            nToDoActions = actions.size();
+            updatePath(currGoal);
             actionTimer = 0.f;
         }
 
@@ -491,29 +776,25 @@ void NPC::tryMoveToward(float dT, glm::vec3 target)
     currVelocity[0] = (target[0] - currBottom[0]) * m_velocity[0];
     currVelocity[2] = (target[2] - currBottom[2]) * m_velocity[2];
 
+    // step aside from the others heading the same way
+    glm::vec3 separation = getSeparation();
+    currVelocity[0] += separation[0] * glm::abs(m_default_velocity[0]);
+    currVelocity[2] += separation[2] * glm::abs(m_default_velocity[2]);
+
     // add horizontal displacement
     glm::vec3 disp = dT * currVelocity;
 
-    if (checkYCollision())
+    bool groundHit = false;
+    disp = collide(disp, &groundHit);
+    if (groundHit)
     {
         // collide against the ground
-        disp[1] = 0.f;
         // remove the gravity effect
         resetHorizontalSpeed();
         m_acceleration[1] = 0.f;
         onGround = true;
     }
 
-    if (checkXZCollision(0))
-    {
-        disp[0] = 0.f;
-    }
-
-    if (checkXZCollision(2))
-    {
-        disp[2] = 0.f;
-    }
-
     // set the previous m_position
     prev_m_position = m_position;
 
@@ -542,7 +823,7 @@ void NPC::tryJumpToward(float dT, glm::vec3 target)
     m_velocity[1] += dT * (m_gravity[1] + m_acceleration[1]);
 
     // set upper bound
-    m_velocity[1] = glm::min(6.f, m_velocity[1]);
+    m_velocity[1] = glm::min(MAX_JUMP_SPEED, m_velocity[1]);
 
     // prevent NPCs from penetraing the terrain
     m_velocity[1] = glm::max(maxFallingSpeed, m_velocity[1]);
@@ -562,26 +843,18 @@ void NPC::tryJumpToward(float dT, glm::vec3 target)
 
     glm::vec3 disp = dT * currVelocity;
 
-    if (checkYCollision() && ((m_acceleration[1] + m_gravity[1] <= 0.f) || m_velocity[1] <= 0.f))
+    // only a fall ends the jump, not the take-off
+    bool groundHit = false;
+    disp = collide(disp, &groundHit);
+    if (groundHit)
     {
         // collide against the ground
-        disp[1] = 0.f;
         // remove the gravity effect
         resetHorizontalSpeed();
         m_acceleration[1] = 0.f;
         onGround = true;
     }
 
-    if (checkXZCollision(0))
-    {
-        disp[0] = 0.f;
-    }
-
-    if (checkXZCollision(2))
-    {
-        disp[2] = 0.f;
-    }
-
     // set the previous m_position
     prev_m_position = m_position;
 
@@ -610,26 +883,17 @@ void NPC::tryMove(float dT)
     // add horizontal displacement
     glm::vec3 disp = dT * currVelocity;
 
-    if (checkYCollision())
+    bool groundHit = false;
+    disp = collide(disp, &groundHit);
+    if (groundHit)
     {
         // collide against the ground
-        disp[1] = 0.f;
         // remove the gravity effect
         resetHorizontalSpeed();
         m_acceleration[1] = 0.f;
         onGround = true;
     }
 
-    if (checkXZCollision(0))
-    {
-        disp[0] = 0.f;
-    }
-
-    if (checkXZCollision(2))
-    {
-        disp[2] = 0.f;
-    }
-
     // set the previous m_position
     prev_m_position = m_position;
 
@@ -654,26 +918,17 @@ void NPC::fall(float dT)
     // add vertical displacement
     disp[1] += (dT * currVelocity[1]);
 
-    if (checkYCollision())
+    bool groundHit = false;
+    disp = collide(disp, &groundHit);
+    if (groundHit)
     {
         // collide against the ground
-        disp[1] = 0.f;
         // remove the gravity effect
         m_velocity[1] = 0.f;
         m_acceleration[1] = 0.f;
         onGround = true;
     }
 
-    if (checkXZCollision(0))
-    {
-        disp[0] = 0.f;
-    }
-
-    if (checkXZCollision(2))
-    {
-        disp[2] = 0.f;
-    }
-
     // set the previous m_position
     prev_m_position = m_position;
 
@@ -682,175 +937,80 @@ void NPC::fall(float dT)
 }
 
 /**
- * @brief NPC::checkXZCollision
- *  Note: m_position is the center of the NPC's body
- *  true: collide with any blocks along x or z direction
- * @param idx
- * @param terrain
+ * @brief NPC::getBoundingBox
+ *  Note: m_position is the root of the scene graph,
+ *  the box spans rootToGround below it to rootToTop above it
+ *  & holds the 4 corners of the footprint (front / back / left / right of the root)
  * @return
  */
-bool NPC::checkXZCollision(int idx) {
-
-    glm::vec3 axisDir = glm::vec3(0.f);
-
-    // only handle x & z
-    axisDir[idx] = m_forward[idx] > 0.f ? 0.5f : -0.5f;
-
-    if (m_forward[idx] == 0.f)
-    {
-        // current facing direction won't be intersected with axis [idx]
-        return false;
-    }
-
-    float tolerance = 0.1f;
-    // idx must be either 0 (x) or 2 (z)
-    glm::ivec3 out_blockHit = glm::ivec3(0);
-    float out_dist = 0.f;
-
-    // get top, root, middle (between root & bottom), bottom center
-    glm::vec3 topCenter = m_position;
-    topCenter[1] += rootToTop;
-    glm::vec3 bottomCenter = m_position;
-    bottomCenter[1] -= rootToGround;
-    std::vector<glm::vec3> centers = {m_position, topCenter, bottomCenter};
-
-    // get radius
-    std::vector<glm::vec3> cornerDirs = {
-        m_forward * rootToFront + m_right * rootToRight,
-        m_forward * rootToFront - m_right * rootToLeft,
-        -m_forward * rootToBack - m_right * rootToLeft,
-        -m_forward * rootToBack + m_right * rootToRight
+AABB NPC::getBoundingBox() const
+{
+    glm::vec3 forward = glm::vec3(m_forward.x, 0.f, m_forward.z);
+    glm::vec3 right = glm::vec3(m_right.x, 0.f, m_right.z);
+    std::array<glm::vec3, 4> corners = {
+        forward * rootToFront + right * rootToRight,
+        forward * rootToFront - right * rootToLeft,
+        -forward * rootToBack - right * rootToLeft,
+        -forward * rootToBack + right * rootToRight
     };
 
-    for (glm::vec3 &center: centers)
+    glm::vec3 min = corners[0];
+    glm::vec3 max = corners[0];
+    for (const glm::vec3 &corner : corners)
     {
-        for (glm::vec3 &cornerDir : cornerDirs)
-        {
-            glm::vec3 rayOrigin = center + cornerDir;
-            bool blockHit = gridMarch(rayOrigin, axisDir, (*mcr_terrain), &out_dist, &out_blockHit);
-            if (blockHit && (out_dist < tolerance))
-            {
-                return true;
-            }
-        }
+        min = glm::min(min, corner);
+        max = glm::max(max, corner);
     }
-    return false;
+    min[1] = -rootToGround;
+    max[1] = rootToTop;
+    return AABB(m_position + min, m_position + max);
 }
 
-
 /**
- * @brief NPC::checkYCollision
- *  true: collide with any blocks along y direction
- * @param terrain
+ * @brief NPC::getSeparation
+ *  The sum of horizontal pushes away from the entities within SEPARATION_RADIUS,
+ *  each stronger the closer the entity
  * @return
  */
-bool NPC::checkYCollision()
+glm::vec3 NPC::getSeparation()
 {
-    // only check against the ground
-    glm::ivec3 out_blockHit = glm::ivec3(0);
-    float out_dist = 0.f;
-
-    float tolerance = 0.25f;
+    static const float SEPARATION_RADIUS = 1.f;
 
-    // get 4 corners of the bottom
-    glm::vec3 bottomCenter = m_position;
-    bottomCenter[1] -= rootToGround;
-
-    // get radius
-    std::vector<glm::vec3> cornerDirs = {
-        m_forward * rootToFront + m_right * rootToRight,
-        m_forward * rootToFront - m_right * rootToLeft,
-        -m_forward * rootToBack - m_right * rootToLeft,
-        -m_forward * rootToBack + m_right * rootToRight
-    };
-
-    glm::vec3 rayDir = glm::vec3(0.f, -1.f, 0.f);
-
-    // check bottom itself
-    bool blockHit = gridMarch(bottomCenter, rayDir, (*mcr_terrain), &out_dist, &out_blockHit);
-    if (blockHit && (out_dist < tolerance))
+    const EntityIndex &entities = mcr_terrain->getEntityIndex();
+    entities.queryRadius(m_position, SEPARATION_RADIUS, &m_neighbors);
+    glm::vec3 separation(0.f);
+    for (int handle : m_neighbors)
     {
-        return true;
-    }
-
-    for (glm::vec3 &cornerDir : cornerDirs)
-    {
-        glm::vec3 rayOrigin = bottomCenter + cornerDir;
-        bool blockHit = gridMarch(rayOrigin, rayDir, (*mcr_terrain), &out_dist, &out_blockHit);
-        if (blockHit && (out_dist < tolerance))
+        if (entities.getEntity(handle) == this)
         {
-            return true;
+            continue;
         }
+        const AABB &box = entities.getBox(handle);
+        glm::vec3 away = m_position - 0.5f * (box.min + box.max);
+        away[1] = 0.f;
+        float len = glm::length(away);
+        // on top of each other: any way out will do
+        glm::vec3 dir = len > 1e-4f ? away / len : glm::vec3(m_right.x, 0.f, m_right.z);
+        separation += dir * (1.f - entities.getDistance(handle, m_position) / SEPARATION_RADIUS);
     }
-
-    return false;
+    return separation;
 }
 
 /**
- * @brief NPC::gridMarch
- * @param rayOrigin
- * @param rayDirection
- * @param terrain
- * @param out_dist
- * @param out_blockHit
+ * @brief NPC::collide
+ *  Sweep the bounding box through the blocks (liquids are solid for NPCs)
+ * @param disp
+ * @param out_groundHit
  * @return
  */
-bool NPC::gridMarch(glm::vec3 rayOrigin, glm::vec3 rayDirection, const Terrain &terrain, float *out_dist, glm::ivec3 *out_blockHit) {
-
-    float maxLen = glm::length(rayDirection); // Farthest we search
-    glm::ivec3 currCell = glm::ivec3(glm::floor(rayOrigin));
-    rayDirection = glm::normalize(rayDirection); // Now all t values represent world dist.
-    float curr_t = 0.f;
-
-    while(curr_t < maxLen) {
-        float min_t = glm::sqrt(3.f);
-        float interfaceAxis = -1; // Track axis for which t is smallest
-        for(int i = 0; i < 3; ++i) { // Iterate over the three axes
-            if(rayDirection[i] != 0) { // Is ray parallel to axis i?
-                float offset = glm::max(0.f, glm::sign(rayDirection[i])); // See slide 5
-                // If the player is *exactly* on an interface then
-                // they'll never move if they're looking in a negative direction
-                if(currCell[i] == rayOrigin[i] && offset == 0.f) {
-                    offset = -1.f;
-                }
-                int nextIntercept = currCell[i] + offset;
-                float axis_t = (nextIntercept - rayOrigin[i]) / rayDirection[i];
-                axis_t = glm::min(axis_t, maxLen); // Clamp to max len to avoid super out of bounds errors
-                if(axis_t < min_t) {
-                    min_t = axis_t;
-                    interfaceAxis = i;
-                }
-            }
-        }
-
-        if(interfaceAxis == -1) {
-            throw std::out_of_range("interfaceAxis was -1 after the for loop in gridMarch!");
-        }
-
-        curr_t += min_t; // min_t is declared in slide 7 algorithm
-        rayOrigin += rayDirection * min_t;
-        glm::ivec3 offset(0);
-        // Sets it to 0 if sign is +, -1 if sign is -
-        offset[interfaceAxis] = glm::min(0.f, glm::sign(rayDirection[interfaceAxis]));
-        currCell = glm::ivec3(glm::floor(rayOrigin)) + offset;
-        // If currCell contains something other than EMPTY, return
-        // curr_t
-        if (!terrain.hasBlockAt(glm::vec3(currCell.x, currCell.y, currCell.z)))
-        {
-            // no block here => treat as hit
-            *out_blockHit = currCell;
-            *out_dist = glm::min(maxLen, curr_t);
-            return true;
-        }
-        BlockType cellType = terrain.getBlockAt(currCell.x, currCell.y, currCell.z);
-        if(cellType != EMPTY) {
-            *out_blockHit = currCell;
-            *out_dist = glm::min(maxLen, curr_t);
-            return true;
-        }
-    }
-    *out_dist = glm::min(maxLen, curr_t);
-    return false;
+glm::vec3 NPC::collide(glm::vec3 disp, bool *out_groundHit)
+{
+    AABB box = getBoundingBox();
+    m_collider.gather(*mcr_terrain, box, disp);
+    glm::bvec3 hit(false);
+    glm::vec3 allowed = m_collider.move(box, disp, &hit);
+    *out_groundHit = hit.y && disp.y < 0.f;
+    return allowed;
 }
 
 
@@ -899,12 +1059,10 @@ void NPCBlock::createVBOdata()
     int bufferSize = buffer.size();
 
     generateIdx();
-    mp_context->glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_bufIdx);
-    mp_context->glBufferData(GL_ELEMENT_ARRAY_BUFFER, m_count * sizeof(GLuint), indices.data(), GL_STATIC_DRAW);
+    bufferData(GL_ELEMENT_ARRAY_BUFFER, m_bufIdx, m_count * sizeof(GLuint), indices.data());
 
     generatePos();
-    mp_context->glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_bufPos);
-    mp_context->glBufferData(GL_ELEMENT_ARRAY_BUFFER, bufferSize * sizeof(float), buffer.data(), GL_STATIC_DRAW);
+    bufferData(GL_ELEMENT_ARRAY_BUFFER, m_bufPos, bufferSize * sizeof(float), buffer.data());
 
     // TODO: at some point, need to delete vbo?
     return;
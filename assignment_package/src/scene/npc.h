@@ -4,10 +4,25 @@
 #include "drawable.h"
 #include "scene/node.h"
 #include "scene/pathfinder.h"
+#include "scene/pathservice.h"
+#include "scene/voxelcollider.h"
 #include "texture.h"
 
 
 class Node;
+struct NPCArchetype;
+
+// The state needed to draw an NPC at one simulation tick.
+// Published by the simulation thread and interpolated by the renderer.
+struct NPCSnapshot
+{
+    // world transform of the scene graph root
+    glm::mat4 rootTransform;
+    // degrees of every RotateNode (pre-order traversal of the scene graph)
+    std::vector<float> rotDegs;
+
+    NPCSnapshot() : rootTransform(1.f), rotDegs() {}
+};
 
 class NPC : public Drawable, public Entity
 {
@@ -32,6 +47,22 @@ protected:
     float actionTimer;
     float actionTimeout;
     uint nToDoActions;
+    // plan far goals over the chunk portals (PathFinder::searchRouteToward)
+    bool plansRoutes;
+    // near a goal of goals, follow the goal's flow field (shared with the other NPCs) instead of searching
+    bool followsFlowFields;
+    // the actions along the flow field of goal, none if the NPC is out of its reach
+    std::queue<NPCAction> followFlowField(glm::vec3 goal);
+    // runs pathFinder's searches on its workers, null: search during the tick
+    PathService *mp_pathService;
+    // a search was requested & hasn't answered yet
+    bool pathPending;
+    // replace the actions with a path toward the goal (at commitTick, or when the service answers)
+    void updatePath(glm::vec3 goal);
+    // left by tick for commitTick: the goal of updatePath, the pending search is of no use
+    bool m_pathRequested;
+    glm::vec3 m_requestedGoal;
+    bool m_cancelPath;
 
     bool isStuck();
     void replanIfNeeded(glm::vec3 goal);
@@ -50,6 +81,11 @@ protected:
 
     void checkActionIsDone();
 
+    // a push away from the entities (NPCs & the player) right around it, see tryMoveToward
+    glm::vec3 getSeparation();
+    // reused by getSeparation
+    std::vector<int> m_neighbors;
+
     // NPC's physics params
     glm::vec3 m_acceleration;
     glm::vec3 m_velocity;
@@ -64,6 +100,7 @@ protected:
     // used to prevent NPCs from penetraing the terrrain
     float maxFallingSpeed;
     bool onGround;
+    VoxelCollider m_collider;
 
     // a variable to accumulate traveled distance (do % 360)
     float walkingDistCycle;
@@ -88,6 +125,10 @@ protected:
     Player *player;
 
 public:
+    // the physics of every NPC (& of the rows of an NPCStore)
+    static constexpr float GRAVITY = -12.f;
+    static constexpr float MAX_FALLING_SPEED = -10.f;
+    static constexpr float MAX_JUMP_SPEED = 6.f;
 
     // constructors
     NPC(OpenGLContext *context, glm::vec3 pos, Terrain &terrain, Player &player, NPCTexture npcTexture);
@@ -120,12 +161,29 @@ public:
     virtual void initSceneGraph() = 0;
 
     virtual void draw(ShaderProgram *shader);
+    // draw with the transforms captured in a snapshot instead of the live ones
+    virtual void draw(ShaderProgram *shader, const NPCSnapshot &snapshot);
 
     virtual void traverseSceneGraph(ShaderProgram *shader, const uPtr<Node> &node, glm::mat4 transform);
+    void traverseSceneGraph(ShaderProgram *shader, const uPtr<Node> &node, glm::mat4 transform,
+                            const std::vector<float> &rotDegs, unsigned int *rotIdx);
+
+    // world transform of the scene graph root
+    virtual glm::mat4 getRootTransform() const;
+
+    // capture the current root transform & limb rotations
+    NPCSnapshot takeSnapshot() const;
+    // the body, walk & look of this class, for the NPCs of an NPCStore
+    // Note: the scene graph must be initialized
+    NPCArchetype getArchetype() const;
 
     // override tick
     virtual void tick(float dT, InputBundle &input) override;
+    // think & move: only writes this NPC, so NPCs can tick on several threads at once
+    // (see NPCUpdater), followed by commitTick
     virtual void tick(float dT);
+    // what the tick left to do on shared state (the path searches), one NPC at a time
+    void commitTick();
 
     // move
     virtual void tryMove(float dT);
@@ -150,10 +208,13 @@ public:
     // set up the goals (explicitly)
     virtual void setupGoals(std::vector<glm::vec3> targetPositions);
 
-    // re-write collision
-    virtual bool checkXZCollision(int idx);
-    virtual bool checkYCollision();
-    bool gridMarch(glm::vec3 rayOrigin, glm::vec3 rayDirection, const Terrain &terrain, float *out_dist, glm::ivec3 *out_blockHit);
+    // search the paths with the service from now on (see PathService)
+    void setPathService(PathService *pathService);
+
+    // the box around the body (& its footprint turned with the NPC)
+    virtual AABB getBoundingBox() const;
+    // the part of disp the blocks allow, *out_groundHit: the ground stopped a fall
+    glm::vec3 collide(glm::vec3 disp, bool *out_groundHit);
 
     virtual ~NPC();
 };
@@ -11,7 +11,12 @@ Sheep::Sheep(OpenGLContext *context, glm::vec3 pos, Terrain &terrain, Player &pl
          head(context, SHEEPHEAD),
          body(context, SHEEPBODY),
          limb(context, SHEEPLIMB)
-{}
+{
+    // the sheep wander between goals hundreds of blocks apart
+    plansRoutes = true;
+    // ...which all the sheep share
+    followsFlowFields = true;
+}
 
 Sheep::Sheep(OpenGLContext *context, glm::vec3 pos, Terrain &terrain, Player &player, NPCTexture npcTexture,
     std::vector<glm::vec3> goals,
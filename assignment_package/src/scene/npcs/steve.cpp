@@ -164,10 +164,10 @@ void Steve::rotateRUL()
 }
 
 /**
- * @brief Steve::draw
- * @param shader
+ * @brief Steve::getRootTransform
+ * @return the root transform based on the player's position
  */
-void Steve::draw(ShaderProgram *shader)
+glm::mat4 Steve::getRootTransform() const
 {
     // based on player's position
     glm::vec3 rootPos = m_position;
@@ -176,11 +176,10 @@ void Steve::draw(ShaderProgram *shader)
     rootPos -= rootToFront * m_forward;
 
     // up vector always (0.f, 1.f, 0.f)
-    glm::mat4 transform = glm::mat4(glm::vec4(m_right, 0.f),
-                                    glm::vec4(m_up, 0.f),
-                                    glm::vec4(m_forward, 0.f),
-                                    glm::vec4(rootPos, 1));
-    traverseSceneGraph(shader, root, transform);
+    return glm::mat4(glm::vec4(m_right, 0.f),
+                     glm::vec4(m_up, 0.f),
+                     glm::vec4(m_forward, 0.f),
+                     glm::vec4(rootPos, 1));
 }
 
 /**
@@ -45,7 +45,7 @@ public:
     // for Drawable
     virtual void createVBOdata() override;
     virtual void initSceneGraph() override;
-    virtual void draw(ShaderProgram *shader) override;
+    virtual glm::mat4 getRootTransform() const override;
     // override tick
     virtual void tick(float dT) override;
     virtual void tick(float dT, InputBundle &inputs) override;
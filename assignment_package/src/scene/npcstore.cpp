@@ -0,0 +1,577 @@
+#include "npcstore.h"
+#include "terrain.h"
+#include "flowfield.h"
+#include "metrics.h"
+#include <array>
+
+// a step not reached in this long (s) is given up & the path searched again
+static const float STEP_TIMEOUT = 3.f;
+
+
+NPCArchetype::NPCArchetype()
+    : texture(SHEEP),
+      rootToGround(0.f), rootToTop(2.f), rootToFront(0.5f), rootToBack(0.5f), rootToLeft(0.5f), rootToRight(0.5f),
+      defaultVelocity(1.f, 0.f, 1.f), toleranceOfGoal(1.5f), toleranceOfStep(1.3f), searchRadius(5),
+      limbRotationSpeedOnGround(4.f), limbRotationSpeedOffGround(2.f),
+      maxLimbDegOnGround(25.f), maxLimbDegOffGround(45.f),
+      restDegs(), limbRotIndices()
+{}
+
+
+NPCStore::NPCStore(Terrain &terrain)
+    : mcr_terrain(terrain), m_archetypes(), m_routes(),
+      m_positions(), m_forwards(), m_velocities(), m_accelerations(), m_onGround(),
+      m_archetypeIds(), m_routeIds(), m_goalIndices(), m_goalDirs(),
+      m_pathSteps(), m_pathLengths(), m_pathCursors(), m_stepTimers(),
+      m_pathFinders(), m_pathPending(), m_freePathFinders(), mp_pathService(nullptr),
+      m_walkedDists(), m_walkCycles(), m_limbDegs(),
+      m_collider(true)
+{}
+
+/**
+ * @brief NPCStore::setPathService
+ *  As NPC::setPathService
+ * @param pathService : may be null
+ */
+void NPCStore::setPathService(PathService *pathService)
+{
+    for (int i = 0; i < size(); i++)
+    {
+        cancelRoute(i);
+    }
+    mp_pathService = pathService;
+}
+
+int NPCStore::addArchetype(const NPCArchetype &archetype)
+{
+    m_archetypes.push_back(archetype);
+    return static_cast<int>(m_archetypes.size()) - 1;
+}
+
+int NPCStore::addRoute(const std::vector<glm::vec3> &goals)
+{
+    m_routes.push_back(goals);
+    return static_cast<int>(m_routes.size()) - 1;
+}
+
+/**
+ * @brief NPCStore::spawn
+ *  Facing -z, at the archetype's speed, in the air until it lands
+ * @param archetype
+ * @param route
+ * @param pos : the root
+ * @return the row
+ */
+int NPCStore::spawn(int archetype, int route, glm::vec3 pos)
+{
+    m_positions.push_back(pos);
+    m_forwards.push_back(glm::vec3(0.f, 0.f, -1.f));
+    m_velocities.push_back(m_archetypes[archetype].defaultVelocity);
+    m_accelerations.push_back(glm::vec3(0.f));
+    m_onGround.push_back(0);
+    m_archetypeIds.push_back(static_cast<uint16_t>(archetype));
+    m_routeIds.push_back(static_cast<uint16_t>(route >= 0 ? route : UINT16_MAX));
+    m_goalIndices.push_back(0);
+    m_goalDirs.push_back(1);
+    m_pathSteps.resize(m_pathSteps.size() + MAX_PATH_STEPS, NPCAction(glm::vec3(0.f), REST));
+    m_pathLengths.push_back(0);
+    m_pathCursors.push_back(0);
+    m_stepTimers.push_back(0.f);
+    m_pathFinders.push_back(nullptr);
+    m_pathPending.push_back(0);
+    m_walkedDists.push_back(0.f);
+    m_walkCycles.push_back(0.f);
+    m_limbDegs.push_back(0.f);
+    return size() - 1;
+}
+
+/**
+ * @brief NPCStore::despawn
+ * @param row
+ */
+void NPCStore::despawn(int row)
+{
+    // a cancelled search may still be running in the PathFinder,
+    // a new one only starts after PathService::collect waited for it
+    cancelRoute(row);
+    if (m_pathFinders[row] != nullptr)
+    {
+        m_freePathFinders.push_back(std::move(m_pathFinders[row]));
+    }
+
+    int last = size() - 1;
+    if (row != last)
+    {
+        m_positions[row] = m_positions[last];
+        m_forwards[row] = m_forwards[last];
+        m_velocities[row] = m_velocities[last];
+        m_accelerations[row] = m_accelerations[last];
+        m_onGround[row] = m_onGround[last];
+        m_archetypeIds[row] = m_archetypeIds[last];
+        m_routeIds[row] = m_routeIds[last];
+        m_goalIndices[row] = m_goalIndices[last];
+        m_goalDirs[row] = m_goalDirs[last];
+        std::copy(m_pathSteps.begin() + last * MAX_PATH_STEPS, m_pathSteps.begin() + (last + 1) * MAX_PATH_STEPS,
+                  m_pathSteps.begin() + row * MAX_PATH_STEPS);
+        m_pathLengths[row] = m_pathLengths[last];
+        m_pathCursors[row] = m_pathCursors[last];
+        m_stepTimers[row] = m_stepTimers[last];
+        m_pathFinders[row] = std::move(m_pathFinders[last]);
+        m_pathPending[row] = m_pathPending[last];
+        m_walkedDists[row] = m_walkedDists[last];
+        m_walkCycles[row] = m_walkCycles[last];
+        m_limbDegs[row] = m_limbDegs[last];
+    }
+
+    m_positions.pop_back();
+    m_forwards.pop_back();
+    m_velocities.pop_back();
+    m_accelerations.pop_back();
+    m_onGround.pop_back();
+    m_archetypeIds.pop_back();
+    m_routeIds.pop_back();
+    m_goalIndices.pop_back();
+    m_goalDirs.pop_back();
+    m_pathSteps.resize(m_pathSteps.size() - MAX_PATH_STEPS, NPCAction(glm::vec3(0.f), REST));
+    m_pathLengths.pop_back();
+    m_pathCursors.pop_back();
+    m_stepTimers.pop_back();
+    m_pathFinders.pop_back();
+    m_pathPending.pop_back();
+    m_walkedDists.pop_back();
+    m_walkCycles.pop_back();
+    m_limbDegs.pop_back();
+}
+
+void NPCStore::clear()
+{
+    while (size() > 0)
+    {
+        despawn(size() - 1);
+    }
+}
+
+int NPCStore::size() const
+{
+    return static_cast<int>(m_positions.size());
+}
+
+/**
+ * @brief NPCStore::tick
+ * @param dT
+ */
+void NPCStore::tick(float dT)
+{
+    static Histogram &tickTime = MetricsRegistry::global().histogram("npcstore.tick_us");
+    long long start = MetricsRegistry::now();
+
+    updateGoals();
+    updatePaths();
+    move(dT);
+    animate();
+
+    tickTime.record(MetricsRegistry::now() - start);
+}
+
+/**
+ * @brief NPCStore::updateGoals
+ *  Back & forth along the route, as NPC::getCurrentGoal;
+ *  the path to a reached goal is dropped
+ */
+void NPCStore::updateGoals()
+{
+    int n = size();
+    for (int i = 0; i < n; i++)
+    {
+        if (m_routeIds[i] == UINT16_MAX)
+        {
+            continue;
+        }
+        const std::vector<glm::vec3> &route = m_routes[m_routeIds[i]];
+        const NPCArchetype &archetype = m_archetypes[m_archetypeIds[i]];
+        glm::vec3 bottom = m_positions[i] - glm::vec3(0.f, archetype.rootToGround, 0.f);
+        if (route.size() < 2 || glm::length(route[m_goalIndices[i]] - bottom) > archetype.toleranceOfGoal)
+        {
+            continue;
+        }
+        static Counter &goalsReached = MetricsRegistry::global().counter("npc.goals_reached");
+        goalsReached.add();
+
+        int last = static_cast<int>(route.size()) - 1;
+        if (m_goalIndices[i] == last)
+        {
+            m_goalDirs[i] = -1;
+        }
+        else if (m_goalIndices[i] == 0)
+        {
+            m_goalDirs[i] = 1;
+        }
+        m_goalIndices[i] = glm::clamp(m_goalIndices[i] + m_goalDirs[i], 0, last);
+        m_pathLengths[i] = 0;
+        m_pathCursors[i] = 0;
+        cancelRoute(i);
+    }
+}
+
+/**
+ * @brief NPCStore::updatePaths
+ *  The NPCs on the ground without a step left get up to MAX_PATH_STEPS along
+ *  the flow field of their goal (as NPC::followFlowField) & the goal where it ends.
+ *  Out of the field's reach they search a route (as NPC::commitTick),
+ *  or take a step straight at the goal without a PathService
+ */
+void NPCStore::updatePaths()
+{
+    FlowFieldCache &flowFields = mcr_terrain.getFlowFields();
+    // the fields looked up this tick (a getField checks every chunk of the field)
+    std::vector<const FlowField*> fields;
+
+    int n = size();
+    for (int i = 0; i < n; i++)
+    {
+        if (m_routeIds[i] == UINT16_MAX || !m_onGround[i] || m_pathPending[i]
+                || m_pathCursors[i] < m_pathLengths[i])
+        {
+            continue;
+        }
+        glm::vec3 goal = m_routes[m_routeIds[i]][m_goalIndices[i]];
+        glm::ivec3 goalCell = glm::ivec3(glm::floor(goal));
+
+        // a lookup may rebuild a field of the cache for another goal, so check the goal too
+        const FlowField *field = nullptr;
+        for (const FlowField *f : fields)
+        {
+            if (f->getGoal() == goalCell)
+            {
+                field = f;
+                break;
+            }
+        }
+        if (field == nullptr)
+        {
+            field = flowFields.getField(goal);
+            fields.push_back(field);
+        }
+
+        NPCAction *steps = &m_pathSteps[i * MAX_PATH_STEPS];
+        int nSteps = 0;
+        glm::ivec3 cell;
+        glm::ivec3 next;
+        bool fieldEnds = false;
+        bool inField = field->findCell(m_positions[i], &cell);
+        if (!inField && mp_pathService != nullptr)
+        {
+            requestRoute(i, goal);
+            continue;
+        }
+        if (inField)
+        {
+            // on the middle of the blocks
+            while (nSteps < MAX_PATH_STEPS && !(fieldEnds = !field->getNextCell(cell, &next)))
+            {
+                steps[nSteps++] = NPCAction(glm::vec3(next) + glm::vec3(0.5f, 1.f, 0.5f), next.y > cell.y ? JUMP : WALK);
+                cell = next;
+            }
+        }
+        // the field ends a column around the goal
+        if (nSteps < MAX_PATH_STEPS && (fieldEnds || nSteps == 0))
+        {
+            steps[nSteps++] = NPCAction(goal, WALK);
+        }
+        m_pathLengths[i] = static_cast<uint8_t>(nSteps);
+        m_pathCursors[i] = 0;
+        m_stepTimers[i] = 0.f;
+    }
+}
+
+/**
+ * @brief NPCStore::requestRoute
+ * @param row
+ * @param goal
+ */
+void NPCStore::requestRoute(int row, glm::vec3 goal)
+{
+    if (m_pathFinders[row] == nullptr)
+    {
+        if (m_freePathFinders.empty())
+        {
+            m_pathFinders[row] = mkU<PathFinder>(m_archetypes[m_archetypeIds[row]].searchRadius, mcr_terrain);
+        }
+        else
+        {
+            m_pathFinders[row] = std::move(m_freePathFinders.back());
+            m_freePathFinders.pop_back();
+            m_pathFinders[row]->setRadius(m_archetypes[m_archetypeIds[row]].searchRadius);
+        }
+    }
+
+    // the row may move (despawn) before the answer, the PathFinder doesn't
+    const PathFinder *pathFinder = m_pathFinders[row].get();
+    m_pathPending[row] = 1;
+    mp_pathService->request(m_pathFinders[row].get(), m_positions[row], goal, true,
+                            [this, pathFinder](std::queue<NPCAction> result) {
+        takeRoute(pathFinder, result);
+    });
+}
+
+/**
+ * @brief NPCStore::takeRoute
+ *  Up to MAX_PATH_STEPS of the search's steps, without the ones the NPC already reached.
+ *  A search ends at its waypoint, often a portal right across a chunk border:
+ *  an NPC within toleranceOfStep of it would stop short of the border & search again
+ *  forever, so it takes a step past the waypoint instead (toward the goal if the search found nothing)
+ * @param pathFinder
+ * @param result
+ */
+void NPCStore::takeRoute(const PathFinder *pathFinder, const std::queue<NPCAction> &result)
+{
+    int row = 0;
+    while (row < size() && m_pathFinders[row].get() != pathFinder)
+    {
+        row++;
+    }
+    if (row == size())
+    {
+        return;
+    }
+
+    m_pathPending[row] = 0;
+    const NPCArchetype &archetype = m_archetypes[m_archetypeIds[row]];
+    glm::vec3 bottom = m_positions[row] - glm::vec3(0.f, archetype.rootToGround, 0.f);
+
+    std::queue<NPCAction> actions = result;
+    NPCAction last(m_routes[m_routeIds[row]][m_goalIndices[row]], WALK);
+    while (!actions.empty() && glm::length(actions.front().dest - bottom) <= archetype.toleranceOfStep)
+    {
+        last = actions.front();
+        actions.pop();
+    }
+
+    NPCAction *steps = &m_pathSteps[row * MAX_PATH_STEPS];
+    int nSteps = 0;
+    while (nSteps < MAX_PATH_STEPS && !actions.empty())
+    {
+        steps[nSteps++] = actions.front();
+        actions.pop();
+    }
+    if (nSteps == 0)
+    {
+        glm::vec3 ahead = glm::vec3(last.dest.x - bottom.x, 0.f, last.dest.z - bottom.z);
+        if (glm::length(ahead) > 1e-4f)
+        {
+            // just out of reach, so the walk is no faster than along a path
+            glm::vec3 dest = bottom + glm::normalize(ahead) * (archetype.toleranceOfStep + 1.f);
+            steps[nSteps++] = NPCAction(glm::vec3(dest.x, last.dest.y, dest.z), last.action);
+        }
+    }
+    m_pathLengths[row] = static_cast<uint8_t>(nSteps);
+    m_pathCursors[row] = 0;
+    m_stepTimers[row] = 0.f;
+}
+
+/**
+ * @brief NPCStore::cancelRoute
+ * @param row
+ */
+void NPCStore::cancelRoute(int row)
+{
+    if (m_pathPending[row] && mp_pathService != nullptr)
+    {
+        mp_pathService->cancel(m_pathFinders[row].get());
+    }
+    m_pathPending[row] = 0;
+}
+
+/**
+ * @brief NPCStore::move
+ *  NPC::tick's movement: walk or jump toward the next step (tryMoveToward / tryJumpToward),
+ *  fall without one (tryMove), stand on the ground without one
+ * @param dT
+ */
+void NPCStore::move(float dT)
+{
+    int n = size();
+    for (int i = 0; i < n; i++)
+    {
+        const NPCArchetype &archetype = m_archetypes[m_archetypeIds[i]];
+        glm::vec3 &pos = m_positions[i];
+        glm::vec3 &velocity = m_velocities[i];
+        glm::vec3 &acceleration = m_accelerations[i];
+        bool onGround = m_onGround[i] != 0;
+        glm::vec3 bottom = pos - glm::vec3(0.f, archetype.rootToGround, 0.f);
+
+        // the step is done (NPC::checkActionIsDone)
+        const NPCAction *step = nullptr;
+        if (m_pathCursors[i] < m_pathLengths[i])
+        {
+            step = &m_pathSteps[i * MAX_PATH_STEPS + m_pathCursors[i]];
+            if (velocity.y <= 0.f && onGround && glm::length(step->dest - bottom) <= archetype.toleranceOfStep)
+            {
+                m_pathCursors[i]++;
+                m_stepTimers[i] = 0.f;
+                step = m_pathCursors[i] < m_pathLengths[i] ? step + 1 : nullptr;
+            }
+        }
+
+        m_walkedDists[i] = 0.f;
+        if (onGround)
+        {
+            velocity.x = archetype.defaultVelocity.x;
+            velocity.z = archetype.defaultVelocity.z;
+            if (step == nullptr)
+            {
+                continue;
+            }
+        }
+
+        glm::vec3 disp;
+        if (step != nullptr)
+        {
+            glm::vec3 facing = glm::vec3(step->dest.x - pos.x, 0.f, step->dest.z - pos.z);
+            if (onGround && glm::length(facing) > 1e-4f)
+            {
+                m_forwards[i] = glm::normalize(facing);
+            }
+
+            bool jump = step->action == JUMP;
+            if (jump && onGround)
+            {
+                acceleration.y = 100.f + (step->dest.y - bottom.y) * 10.f;
+                onGround = false;
+            }
+            velocity.y += dT * (NPC::GRAVITY + acceleration.y);
+            if (jump)
+            {
+                velocity.y = glm::min(NPC::MAX_JUMP_SPEED, velocity.y);
+            }
+            velocity.y = glm::max(NPC::MAX_FALLING_SPEED, velocity.y);
+            if (acceleration.y > 0.f)
+            {
+                acceleration.y = glm::max(0.f, acceleration.y + NPC::GRAVITY);
+            }
+            disp = dT * glm::vec3((step->dest.x - bottom.x) * velocity.x, velocity.y,
+                                  (step->dest.z - bottom.z) * velocity.z);
+
+            m_stepTimers[i] += dT;
+            if (m_stepTimers[i] >= STEP_TIMEOUT)
+            {
+                // search again from here
+                m_pathLengths[i] = m_pathCursors[i];
+            }
+        }
+        else
+        {
+            velocity.y = glm::max(NPC::MAX_FALLING_SPEED, velocity.y + dT * NPC::GRAVITY);
+            disp = dT * velocity;
+        }
+
+        AABB box = getBoundingBox(archetype, pos, m_forwards[i]);
+        m_collider.gather(mcr_terrain, box, disp);
+        glm::bvec3 hit(false);
+        glm::vec3 allowed = m_collider.move(box, disp, &hit);
+        // only a fall ends a jump, not the take-off
+        if (hit.y && disp.y < 0.f)
+        {
+            velocity.x = archetype.defaultVelocity.x;
+            velocity.z = archetype.defaultVelocity.z;
+            acceleration.y = 0.f;
+            onGround = true;
+        }
+
+        pos += allowed;
+        m_onGround[i] = onGround ? 1 : 0;
+        m_walkedDists[i] = glm::length(allowed);
+    }
+}
+
+/**
+ * @brief NPCStore::animate
+ *  The limbs swing with the walked distance, as NPC::updateLimbRotations
+ */
+void NPCStore::animate()
+{
+    int n = size();
+    for (int i = 0; i < n; i++)
+    {
+        const NPCArchetype &archetype = m_archetypes[m_archetypeIds[i]];
+        m_walkCycles[i] += m_walkedDists[i];
+        if (m_onGround[i])
+        {
+            m_limbDegs[i] = glm::sin(m_walkCycles[i] * archetype.limbRotationSpeedOnGround) * archetype.maxLimbDegOnGround;
+        }
+        else
+        {
+            m_limbDegs[i] = glm::sin(m_walkCycles[i] * archetype.limbRotationSpeedOffGround) * archetype.maxLimbDegOffGround;
+        }
+    }
+}
+
+glm::vec3 NPCStore::getPosition(int row) const
+{
+    return m_positions[row];
+}
+
+int NPCStore::getArchetypeId(int row) const
+{
+    return m_archetypeIds[row];
+}
+
+/**
+ * @brief NPCStore::getBoundingBox
+ *  As NPC::getBoundingBox
+ * @param archetype
+ * @param pos
+ * @param forward
+ * @return
+ */
+AABB NPCStore::getBoundingBox(const NPCArchetype &archetype, glm::vec3 pos, glm::vec3 forward) const
+{
+    glm::vec3 right = glm::cross(forward, glm::vec3(0.f, 1.f, 0.f));
+    std::array<glm::vec3, 4> corners = {
+        forward * archetype.rootToFront + right * archetype.rootToRight,
+        forward * archetype.rootToFront - right * archetype.rootToLeft,
+        -forward * archetype.rootToBack - right * archetype.rootToLeft,
+        -forward * archetype.rootToBack + right * archetype.rootToRight
+    };
+
+    glm::vec3 min = corners[0];
+    glm::vec3 max = corners[0];
+    for (const glm::vec3 &corner : corners)
+    {
+        min = glm::min(min, corner);
+        max = glm::max(max, corner);
+    }
+    min.y = -archetype.rootToGround;
+    max.y = archetype.rootToTop;
+    return AABB(pos + min, pos + max);
+}
+
+AABB NPCStore::getBoundingBox(int row) const
+{
+    return getBoundingBox(m_archetypes[m_archetypeIds[row]], m_positions[row], m_forwards[row]);
+}
+
+/**
+ * @brief NPCStore::takeSnapshot
+ *  The class's rest pose with the limbs turned
+ * @param row
+ * @return
+ */
+NPCSnapshot NPCStore::takeSnapshot(int row) const
+{
+    const NPCArchetype &archetype = m_archetypes[m_archetypeIds[row]];
+    glm::vec3 forward = m_forwards[row];
+    glm::vec3 up = glm::vec3(0.f, 1.f, 0.f);
+
+    NPCSnapshot snapshot;
+    snapshot.rootTransform = glm::mat4(glm::vec4(glm::cross(forward, up), 0.f),
+                                       glm::vec4(up, 0.f),
+                                       glm::vec4(forward, 0.f),
+                                       glm::vec4(m_positions[row], 1.f));
+    snapshot.rotDegs = archetype.restDegs;
+    for (int index : archetype.limbRotIndices)
+    {
+        snapshot.rotDegs[index] = m_limbDegs[row];
+    }
+    return snapshot;
+}
@@ -0,0 +1,130 @@
+#pragma once
+#include "npc.h"
+#include "voxelcollider.h"
+#include "pathservice.h"
+#include <cstdint>
+#include <vector>
+
+class Terrain;
+
+// The body, walk & look NPCs of one kind share, taken from an NPC class
+// (see NPC::getArchetype): a Sheep, a Lama, ... defines an archetype & the store
+// holds any number of plain NPCs of it, drawn with the class's scene graph
+// (NPC::draw with the NPCSnapshot of NPCStore::takeSnapshot).
+struct NPCArchetype
+{
+    NPCTexture texture;
+    // from the root (the position) to the sides of the body
+    float rootToGround, rootToTop, rootToFront, rootToBack, rootToLeft, rootToRight;
+    // the horizontal speed factors
+    glm::vec3 defaultVelocity;
+    float toleranceOfGoal, toleranceOfStep;
+    // the grid of the route searches out of the reach of a goal's flow field (see PathFinder)
+    int searchRadius;
+    float limbRotationSpeedOnGround, limbRotationSpeedOffGround;
+    float maxLimbDegOnGround, maxLimbDegOffGround;
+    // the degrees of the RotateNodes of the class's scene graph (NPCSnapshot::rotDegs)
+    // & which of them turn with the walk
+    std::vector<float> restDegs;
+    std::vector<int> limbRotIndices;
+
+    NPCArchetype();
+};
+
+// NPCs as rows of component arrays (structure of arrays) instead of one object each:
+// every system goes through one or two arrays front to back, no virtual tick,
+// no scene graph, no per-NPC heap blocks.
+//   transform  - position, forward
+//   physics    - velocity, acceleration, onGround
+//   goals      - route, goal index & direction (back & forth along the route, as NPC::getCurrentGoal)
+//   path pool  - up to MAX_PATH_STEPS steps along the flow field of the goal, the next one, a timer;
+//                out of the field's reach, the steps of a route search (as NPC::plansRoutes)
+//                run by the PathService in a PathFinder the NPC keeps until it's despawned
+//   animation  - the walked distance & the limbs' degree
+// An NPC is a row index, valid until a despawn moves the last row into the freed one.
+// Note: only used with the world lock held (tick reads the blocks & the flow fields),
+// & the PathService must be cleared before the store is destroyed (the searches run in its PathFinders)
+class NPCStore
+{
+public:
+    static constexpr int MAX_PATH_STEPS = 8;
+
+private:
+    Terrain &mcr_terrain;
+    std::vector<NPCArchetype> m_archetypes;
+    std::vector<std::vector<glm::vec3>> m_routes;
+
+    // transform
+    std::vector<glm::vec3> m_positions;
+    std::vector<glm::vec3> m_forwards;
+    // physics
+    std::vector<glm::vec3> m_velocities;
+    std::vector<glm::vec3> m_accelerations;
+    std::vector<uint8_t> m_onGround;
+    // goals
+    std::vector<uint16_t> m_archetypeIds;
+    std::vector<uint16_t> m_routeIds;
+    std::vector<int> m_goalIndices;
+    std::vector<int8_t> m_goalDirs;
+    // path pool, MAX_PATH_STEPS steps per NPC
+    std::vector<NPCAction> m_pathSteps;
+    std::vector<uint8_t> m_pathLengths;
+    std::vector<uint8_t> m_pathCursors;
+    // the time spent on the current step, the path is dropped past STEP_TIMEOUT
+    std::vector<float> m_stepTimers;
+    // route searches: the NPC's PathFinder (null until its first search) & whether one is running
+    std::vector<uPtr<PathFinder>> m_pathFinders;
+    std::vector<uint8_t> m_pathPending;
+    // the PathFinders of the despawned NPCs, reused by the next ones
+    std::vector<uPtr<PathFinder>> m_freePathFinders;
+    // runs the route searches, null: the NPCs out of a field walk straight to the goal
+    PathService *mp_pathService;
+    // animation
+    std::vector<float> m_walkedDists;
+    std::vector<float> m_walkCycles;
+    std::vector<float> m_limbDegs;
+
+    // the sweeps of move, one NPC after another
+    VoxelCollider m_collider;
+
+    AABB getBoundingBox(const NPCArchetype &archetype, glm::vec3 pos, glm::vec3 forward) const;
+
+    // ask mp_pathService for a route from row toward goal
+    void requestRoute(int row, glm::vec3 goal);
+    // the steps of the route search run in pathFinder (by PathService::collect)
+    void takeRoute(const PathFinder *pathFinder, const std::queue<NPCAction> &result);
+    // drop the running search of row, if any
+    void cancelRoute(int row);
+
+    // the systems, in the order tick runs them
+    void updateGoals();
+    void updatePaths();
+    void move(float dT);
+    void animate();
+
+public:
+    explicit NPCStore(Terrain &terrain);
+
+    // the running searches are dropped, may be null
+    void setPathService(PathService *pathService);
+
+    // the ids to spawn with
+    int addArchetype(const NPCArchetype &archetype);
+    int addRoute(const std::vector<glm::vec3> &goals);
+
+    // the row of the new NPC, route may be -1 (it only falls)
+    int spawn(int archetype, int route, glm::vec3 pos);
+    // the last row takes the place of row
+    void despawn(int row);
+    void clear();
+    int size() const;
+
+    // every system over every NPC
+    void tick(float dT);
+
+    glm::vec3 getPosition(int row) const;
+    int getArchetypeId(int row) const;
+    AABB getBoundingBox(int row) const;
+    // the pose for the scene graph of the archetype's class
+    NPCSnapshot takeSnapshot(int row) const;
+};
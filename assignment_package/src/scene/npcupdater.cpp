@@ -0,0 +1,162 @@
+#include "npcupdater.h"
+#include "tracer.h"
+#include "metrics.h"
+#include <QThread>
+
+
+NPCUpdater::NPCUpdater(int maxThreads)
+    : m_pool(), m_maxThreads(1), m_usPerNPC(0.0), m_batchSize(1),
+      mp_npcs(nullptr), m_dT(0.f), m_nextNPC(0), m_busyUs(0)
+{
+    setMaxThreads(maxThreads);
+}
+
+NPCUpdater::~NPCUpdater()
+{
+    m_pool.waitForDone();
+}
+
+/**
+ * @brief NPCUpdater::planBatches
+ *  Serial until a tick was measured, or when the ticks are too cheap to share;
+ *  otherwise batches of ~TARGET_BATCH_US, at least 4 per thread so they finish together
+ * @param nNPCs
+ * @return the threads to run, the calling one included
+ */
+int NPCUpdater::planBatches(int nNPCs)
+{
+    if (m_maxThreads == 1 || m_usPerNPC <= 0.0 || m_usPerNPC * nNPCs < MIN_PARALLEL_US)
+    {
+        m_batchSize = nNPCs;
+        return 1;
+    }
+
+    int batchSize = static_cast<int>(TARGET_BATCH_US / m_usPerNPC + 0.5);
+    int maxBatchSize = (nNPCs + 4 * m_maxThreads - 1) / (4 * m_maxThreads);
+    m_batchSize = glm::clamp(batchSize, 1, glm::max(1, maxBatchSize));
+    return glm::min(m_maxThreads, (nNPCs + m_batchSize - 1) / m_batchSize);
+}
+
+/**
+ * @brief NPCUpdater::tickAll
+ *  The NPCs' ticks see where the others were at the end of the last step
+ *  (the EntityIndex is updated after this), so every NPC gets the same tick
+ *  whichever thread runs it & a replay simulates the same at any thread count
+ * @param npcs
+ * @param dT
+ */
+void NPCUpdater::tickAll(const std::vector<uPtr<NPC>> &npcs, float dT)
+{
+    if (npcs.empty())
+    {
+        return;
+    }
+
+    static Histogram &thinkTime = MetricsRegistry::global().histogram("npc.think_us");
+    static Histogram &commitTime = MetricsRegistry::global().histogram("npc.commit_us");
+    static Gauge &batchSize = MetricsRegistry::global().gauge("npc.batch_size");
+
+    int nNPCs = static_cast<int>(npcs.size());
+    int nThreads = planBatches(nNPCs);
+    batchSize.set(m_batchSize);
+
+    // think + move
+    mp_npcs = &npcs;
+    m_dT = dT;
+    m_nextNPC = 0;
+    m_busyUs = 0;
+    long long start = MetricsRegistry::now();
+    {
+        TraceSpan span("npc think", "npc");
+        for (int i = 1; i < nThreads; i++)
+        {
+            m_pool.start(new NPCTickWorker(this));
+        }
+        runBatches();
+        m_pool.waitForDone();
+    }
+    mp_npcs = nullptr;
+    thinkTime.record(MetricsRegistry::now() - start);
+
+    double usPerNPC = static_cast<double>(m_busyUs.load()) / nNPCs;
+    m_usPerNPC = m_usPerNPC > 0.0 ? 0.9 * m_usPerNPC + 0.1 * usPerNPC : usPerNPC;
+
+    // commit, in the NPCs' order
+    start = MetricsRegistry::now();
+    {
+        TraceSpan span("npc commit", "npc");
+        for (const uPtr<NPC> &npc : npcs)
+        {
+            npc->commitTick();
+        }
+    }
+    commitTime.record(MetricsRegistry::now() - start);
+}
+
+/**
+ * @brief NPCUpdater::runBatches
+ */
+void NPCUpdater::runBatches()
+{
+    static Histogram &npcTick = MetricsRegistry::global().histogram("npc.tick_us");
+
+    const std::vector<uPtr<NPC>> &npcs = *mp_npcs;
+    int nNPCs = static_cast<int>(npcs.size());
+    long long busyUs = 0;
+    while (true)
+    {
+        int first = m_nextNPC.fetch_add(m_batchSize);
+        if (first >= nNPCs)
+        {
+            break;
+        }
+        int last = glm::min(first + m_batchSize, nNPCs);
+
+        long long batchStart = MetricsRegistry::now();
+        long long tickStart = batchStart;
+        for (int i = first; i < last; i++)
+        {
+            npcs[i]->tick(m_dT);
+            long long tickEnd = MetricsRegistry::now();
+            npcTick.record(tickEnd - tickStart);
+            tickStart = tickEnd;
+        }
+        busyUs += tickStart - batchStart;
+    }
+    m_busyUs += busyUs;
+}
+
+/**
+ * @brief NPCUpdater::setMaxThreads
+ *  Not while tickAll runs
+ * @param maxThreads
+ */
+void NPCUpdater::setMaxThreads(int maxThreads)
+{
+    m_maxThreads = maxThreads > 0 ? maxThreads : glm::max(1, QThread::idealThreadCount());
+    // the calling thread takes batches too
+    m_pool.setMaxThreadCount(glm::max(1, m_maxThreads - 1));
+}
+
+int NPCUpdater::getMaxThreads() const
+{
+    return m_maxThreads;
+}
+
+int NPCUpdater::getBatchSize() const
+{
+    return m_batchSize;
+}
+
+
+NPCTickWorker::NPCTickWorker(NPCUpdater *updater)
+    : updater(updater)
+{}
+
+/**
+ * @brief NPCTickWorker::run
+ */
+void NPCTickWorker::run()
+{
+    updater->runBatches();
+}
@@ -0,0 +1,70 @@
+#pragma once
+#include "npc.h"
+#include <QRunnable>
+#include <QThreadPool>
+#include <atomic>
+#include <vector>
+
+// Ticks the NPCs of a simulation step in two phases (with the world lock held):
+//   think + move - NPC::tick of every NPC, spread over worker threads (& the calling one).
+//                  An NPC only writes itself; it reads the blocks, the player
+//                  & the EntityIndex, which nothing changes during the phase,
+//   commit       - NPC::commitTick of every NPC in order on the calling thread,
+//                  for what touches shared state (path requests, flow fields, nav grids).
+// The NPCs are handed out in batches sized so one takes ~TARGET_BATCH_US,
+// from the measured cost of a tick: big enough to keep the hand-out cheap,
+// small enough to even out NPCs that cost more (a jump, a replan) across threads.
+class NPCUpdater
+{
+private:
+    // a batch should take about this long (us)
+    static constexpr double TARGET_BATCH_US = 100.0;
+    // below this many us of ticks in total, starting the workers costs more than it saves
+    static constexpr double MIN_PARALLEL_US = 200.0;
+
+    // the workers (not the global pool, where the chunk workers queue up)
+    QThreadPool m_pool;
+    // the calling thread included
+    int m_maxThreads;
+    // smoothed cost of one NPC::tick (us), 0 until measured
+    double m_usPerNPC;
+    int m_batchSize;
+
+    // the NPCs of the running phase
+    const std::vector<uPtr<NPC>> *mp_npcs;
+    float m_dT;
+    // the first NPC no thread took yet
+    std::atomic<int> m_nextNPC;
+    // the time the threads spent in ticks (us)
+    std::atomic<long long> m_busyUs;
+
+    // pick the batch size & how many threads to use for nNPCs
+    int planBatches(int nNPCs);
+
+public:
+    explicit NPCUpdater(int maxThreads = 0);
+    ~NPCUpdater();
+
+    // both phases, the NPCs are ticked by dT
+    // Note: the world lock must be held
+    void tickAll(const std::vector<uPtr<NPC>> &npcs, float dT);
+    // take batches of the running phase until there are none left (by the threads of tickAll)
+    void runBatches();
+
+    // 0: QThread::idealThreadCount()
+    void setMaxThreads(int maxThreads);
+    int getMaxThreads() const;
+    int getBatchSize() const;
+};
+
+// Takes batches of NPC ticks from an NPCUpdater
+class NPCTickWorker : public QRunnable
+{
+private:
+    NPCUpdater *updater;
+
+public:
+    NPCTickWorker(NPCUpdater *updater);
+
+    void run() override;
+};
@@ -0,0 +1,213 @@
+#include "occlusionculler.h"
+#include "terrain.h"
+
+
+SectionBox::SectionBox(OpenGLContext *context)
+    : Drawable(context)
+{}
+
+void SectionBox::createVBOdata()
+{
+    std::vector<glm::vec4> pos;
+    for (int i = 0; i < 8; i++) {
+        pos.push_back(glm::vec4(i & 1, (i >> 1) & 1, (i >> 2) & 1, 1.f));
+    }
+
+    // two triangles per face, corner i is at (i & 1, (i >> 1) & 1, (i >> 2) & 1)
+    GLuint idx[36] = {0, 1, 3, 0, 3, 2,  // z = 0
+                      4, 6, 7, 4, 7, 5,  // z = 1
+                      0, 2, 6, 0, 6, 4,  // x = 0
+                      1, 5, 7, 1, 7, 3,  // x = 1
+                      0, 4, 5, 0, 5, 1,  // y = 0
+                      2, 3, 7, 2, 7, 6}; // y = 1
+
+    m_count = 36;
+
+    generateIdx();
+    bufferData(GL_ELEMENT_ARRAY_BUFFER, m_bufIdx, 36 * sizeof(GLuint), idx);
+
+    generatePos();
+    bufferData(GL_ARRAY_BUFFER, m_bufPos, pos.size() * sizeof(glm::vec4), pos.data());
+}
+
+
+OcclusionCuller::OcclusionCuller(OpenGLContext *context)
+    : mp_context(context), m_depthBuffer(context, 1, 1, 1), m_width(1), m_height(1),
+      m_box(context), m_queries(), m_freeQueries(), m_frame(0), m_enabled(true), m_created(false)
+{}
+
+// Combine the chunk origin & the section into one key, like toKey in terrain.cpp
+// (x & z are multiples of 16, so their low 4 bits are free for the section)
+int64_t OcclusionCuller::sectionKey(int x, int z, int section)
+{
+    return toKey(x, z | section);
+}
+
+void OcclusionCuller::resize(unsigned int width, unsigned int height)
+{
+    m_width = std::max(1u, width / DOWNSCALE);
+    m_height = std::max(1u, height / DOWNSCALE);
+    m_depthBuffer.resize(m_width, m_height, 1);
+    if (m_created) {
+        m_depthBuffer.destroy();
+        m_depthBuffer.create();
+    }
+}
+
+void OcclusionCuller::create()
+{
+    m_depthBuffer.create();
+    m_box.createVBOdata();
+    m_created = true;
+}
+
+void OcclusionCuller::destroy()
+{
+    m_depthBuffer.destroy();
+    m_box.destroyVBOdata();
+    for (auto &p : m_queries) {
+        m_freeQueries.push_back(p.second.query);
+    }
+    m_queries.clear();
+    if (!m_freeQueries.empty()) {
+        mp_context->glDeleteQueries(static_cast<GLsizei>(m_freeQueries.size()), m_freeQueries.data());
+        m_freeQueries.clear();
+    }
+    m_created = false;
+}
+
+GLuint OcclusionCuller::takeQuery()
+{
+    if (m_freeQueries.empty()) {
+        // make queries in batches, most frames test a few hundred sections
+        m_freeQueries.resize(64);
+        mp_context->glGenQueries(64, m_freeQueries.data());
+    }
+    GLuint query = m_freeQueries.back();
+    m_freeQueries.pop_back();
+    return query;
+}
+
+/**
+ * @brief OcclusionCuller::collectResults
+ *  Results that are not available yet are left pending
+ *  (the section is drawn until a result arrives).
+ *  Queries of sections that haven't been tested for a while are recycled.
+ */
+void OcclusionCuller::collectResults()
+{
+    m_frame++;
+
+    for (auto it = m_queries.begin(); it != m_queries.end();) {
+        SectionQuery &q = it->second;
+
+        if (q.pending) {
+            GLuint available = 0;
+            mp_context->glGetQueryObjectuiv(q.query, GL_QUERY_RESULT_AVAILABLE, &available);
+            if (available) {
+                GLuint anySamplesPassed = 0;
+                mp_context->glGetQueryObjectuiv(q.query, GL_QUERY_RESULT, &anySamplesPassed);
+                // a result older than one frame is not trusted
+                q.occluded = anySamplesPassed == 0 && q.issuedFrame == m_frame - 1;
+                q.resultFrame = m_frame;
+                q.pending = false;
+            }
+        }
+
+        if (!q.pending && m_frame - q.issuedFrame > MAX_IDLE_FRAMES) {
+            m_freeQueries.push_back(q.query);
+            it = m_queries.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+/**
+ * @brief OcclusionCuller::isOccluded
+ *  Conservative: only a result of a query issued in the previous frame
+ *  & read in this one can hide a section (see collectResults).
+ */
+bool OcclusionCuller::isOccluded(int x, int z, int section) const
+{
+    if (!m_enabled) {
+        return false;
+    }
+    auto it = m_queries.find(sectionKey(x, z, section));
+    if (it == m_queries.end()) {
+        return false;
+    }
+    const SectionQuery &q = it->second;
+    return q.occluded && q.resultFrame == m_frame;
+}
+
+void OcclusionCuller::issueQueries(Terrain &terrain, ShaderProgram &depthProg, const glm::mat4 &viewProj,
+                                   const glm::vec3 &cameraPos)
+{
+    if (!m_enabled || !m_created) {
+        return;
+    }
+
+    m_depthBuffer.bindFrameBuffer();
+    mp_context->glViewport(0, 0, m_width, m_height);
+    mp_context->glClear(GL_DEPTH_BUFFER_BIT);
+    mp_context->glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+
+    // the occluders: the opaque terrain drawn this frame
+    depthProg.setViewProjMatrix(viewProj);
+    terrain.redrawLastBatch(&depthProg, TerrainDrawType::opaque);
+
+    // test the boxes without changing the depth buffer
+    mp_context->glDepthMask(GL_FALSE);
+    mp_context->glDepthFunc(GL_LEQUAL);
+
+    for (const glm::ivec3 &s : terrain.getOcclusionCandidates()) {
+        glm::vec3 boxMin = glm::vec3(s.x, s.y * 16, s.z) - glm::vec3(BOX_PADDING);
+        glm::vec3 boxMax = glm::vec3(s.x + 16, s.y * 16 + 16, s.z + 16) + glm::vec3(BOX_PADDING);
+
+        // the near plane would clip the faces of a box around the camera,
+        // such a section has no result & is always drawn
+        if (glm::all(glm::greaterThan(cameraPos, boxMin - glm::vec3(1.f)))
+                && glm::all(glm::lessThan(cameraPos, boxMax + glm::vec3(1.f)))) {
+            continue;
+        }
+
+        int64_t key = sectionKey(s.x, s.z, s.y);
+        auto it = m_queries.find(key);
+        if (it == m_queries.end()) {
+            SectionQuery q;
+            q.query = takeQuery();
+            q.pending = false;
+            q.issuedFrame = m_frame;
+            q.occluded = false;
+            q.resultFrame = -1;
+            it = m_queries.insert(std::make_pair(key, q)).first;
+        }
+        SectionQuery &q = it->second;
+        // a query still in flight can't be restarted
+        if (q.pending) {
+            continue;
+        }
+
+        depthProg.setModelMatrix(glm::translate(glm::mat4(1.f), boxMin) * glm::scale(glm::mat4(1.f), boxMax - boxMin));
+        mp_context->glBeginQuery(GL_ANY_SAMPLES_PASSED, q.query);
+        depthProg.draw(m_box);
+        mp_context->glEndQuery(GL_ANY_SAMPLES_PASSED);
+        q.pending = true;
+        q.issuedFrame = m_frame;
+    }
+
+    mp_context->glDepthFunc(GL_LESS);
+    mp_context->glDepthMask(GL_TRUE);
+    mp_context->glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+}
+
+void OcclusionCuller::setEnabled(bool enabled)
+{
+    m_enabled = enabled;
+}
+
+bool OcclusionCuller::isEnabled() const
+{
+    return m_enabled;
+}
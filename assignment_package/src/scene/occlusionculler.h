@@ -0,0 +1,85 @@
+#pragma once
+#include "drawable.h"
+#include "framebuffer.h"
+#include "shaderprogram.h"
+#include "glm_includes.h"
+#include <unordered_map>
+#include <vector>
+
+class Terrain;
+
+// A unit cube [0, 1]^3 (positions only), scaled to the bounding box
+// of a chunk section when it is tested for occlusion
+class SectionBox : public Drawable
+{
+public:
+    SectionBox(OpenGLContext *context);
+    virtual void createVBOdata();
+};
+
+// Hardware occlusion culling of the 16 x 16 x 16 sections of the terrain.
+// After the opaque terrain pass, the drawn terrain is rendered again into a
+// low resolution depth buffer, and the bounding box of every section that
+// was in the frustum is drawn against it inside a GL_ANY_SAMPLES_PASSED query.
+// The results are read at the start of the next frame, so Terrain::draw skips
+// sections hidden one frame ago. A section without a fresh result (new in the
+// frustum, result not ready yet, camera inside its box) is always drawn.
+class OcclusionCuller
+{
+private:
+    struct SectionQuery
+    {
+        GLuint query;
+        bool pending;    // issued, the result was not read yet
+        int issuedFrame;
+        bool occluded;   // the last result read
+        int resultFrame; // the frame the last result was read in
+    };
+
+    OpenGLContext *mp_context;
+    // the occluder depth, DOWNSCALE times smaller than the screen
+    FrameBuffer m_depthBuffer;
+    unsigned int m_width, m_height;
+    SectionBox m_box;
+
+    // key of (chunk x, chunk z, section) -> query
+    std::unordered_map<int64_t, SectionQuery> m_queries;
+    std::vector<GLuint> m_freeQueries;
+    int m_frame;
+    bool m_enabled;
+    bool m_created;
+
+    static int64_t sectionKey(int x, int z, int section);
+    GLuint takeQuery();
+
+public:
+    // the occluder depth buffer is 1 / DOWNSCALE of the screen size in each direction
+    static const int DOWNSCALE = 4;
+    // the boxes are grown by this much (in blocks), so a section's own faces never hide its box
+    static constexpr float BOX_PADDING = 0.5f;
+    // queries not issued for this many frames (the section left the frustum) are recycled
+    static const int MAX_IDLE_FRAMES = 120;
+
+    OcclusionCuller(OpenGLContext *context);
+
+    // width & height of the screen in pixels, re-creates the depth buffer if it exists
+    void resize(unsigned int width, unsigned int height);
+    void create();
+    // frees the depth buffer, the box & all the queries
+    void destroy();
+
+    // read the results of the queries issued in the previous frame,
+    // call at the start of a frame before Terrain::draw
+    void collectResults();
+
+    // true only if the section was tested in the previous frame and was hidden
+    bool isOccluded(int x, int z, int section) const;
+
+    // Render the terrain drawn by the last opaque Terrain::draw into the low resolution
+    // depth buffer, then issue a query for every section of Terrain::getOcclusionCandidates().
+    // Leaves the depth buffer bound, the caller rebinds its frame buffer & viewport.
+    void issueQueries(Terrain &terrain, ShaderProgram &depthProg, const glm::mat4 &viewProj, const glm::vec3 &cameraPos);
+
+    void setEnabled(bool enabled);
+    bool isEnabled() const;
+};
@@ -1,9 +1,39 @@
 #include "pathfinder.h"
+#include "tracer.h"
+#include "metrics.h"
+#include "seededrandom.h"
+#include <algorithm>
 
-std::unordered_set<BlockType> PathFinder::validBlocks = {GRASS, DIRT, STONE, SNOW, GWOOD, WOOD};
+// the search box on y, relative to the start: [Y_MIN, Y_MAX)
+static const int Y_MIN = -3;
+static const int Y_MAX = 3;
+
+// orders node indices by the cost of their nodes
+struct CompareNode
+{
+    const std::vector<PathNode> *nodes;
+
+    bool operator() (int n1, int n2) const
+    {
+        return (*nodes)[n1].costSoFar > (*nodes)[n2].costSoFar;
+    }
+};
+
+struct CompareNodeMaxHeap
+{
+    const std::vector<PathNode> *nodes;
+
+    bool operator() (int n1, int n2) const
+    {
+        return (*nodes)[n1].costSoFar < (*nodes)[n2].costSoFar;
+    }
+};
 
 PathFinder::PathFinder(int radius, Terrain &terrain)
-    : radius(radius), mcr_terrain(&terrain)
+    : radius(radius), mcr_terrain(&terrain), m_nodes(), m_openHeap(),
+      m_walkClosed(), m_jumpClosed(), m_navColumns(), m_lastExpansions(0),
+      m_route(), m_lastRouteExpansions(0),
+      m_startBlock(0.f), m_targetBlock(0.f), m_fallbackBlock(0.f), m_hasFallback(false), m_pick(0)
 {}
 
 /**
@@ -24,6 +54,114 @@ int PathFinder::getRadius() const
     return radius;
 }
 
+/**
+ * @brief PathFinder::getLastExpansions
+ * @return the number of nodes the last search popped
+ */
+int PathFinder::getLastExpansions() const
+{
+    return m_lastExpansions;
+}
+
+/**
+ * @brief PathFinder::getLastRouteExpansions
+ * @return the number of portals the last search expanded, 0 if it didn't plan a route
+ */
+int PathFinder::getLastRouteExpansions() const
+{
+    return m_lastRouteExpansions;
+}
+
+/**
+ * @brief PathFinder::getCellIndex
+ *  Every cell of the search box gets its own index (x & z fastest)
+ * @param x : in [-radius, radius]
+ * @param y : in [Y_MIN, Y_MAX)
+ * @param z : in [-radius, radius]
+ * @return
+ */
+int PathFinder::getCellIndex(int x, int y, int z) const
+{
+    int sideLen = 1 + 2 * radius;
+    return ((y - Y_MIN) * sideLen + (x + radius)) * sideLen + (z + radius);
+}
+
+/**
+ * @brief PathFinder::gatherNavColumns
+ *  Copy the columns of the search box & one more around it (the obstacles next to its border),
+ *  an empty column (nothing to stand on, no obstacle) where there's no chunk or it hasn't been meshed yet
+ * @param startCell
+ */
+void PathFinder::gatherNavColumns(glm::ivec3 startCell)
+{
+    int navSide = 3 + 2 * radius;
+    m_navColumns.assign(navSide * navSide, NavColumn());
+    const Chunk *chunk = nullptr;
+    const NavGrid *navGrid = nullptr;
+    for (int x = -radius - 1; x <= radius + 1; x++)
+    {
+        for (int z = -radius - 1; z <= radius + 1; z++)
+        {
+            int worldX = startCell.x + x;
+            int worldZ = startCell.z + z;
+            // the columns of a chunk are gathered one after the other on z
+            if (chunk == nullptr || worldX - chunk->getOrigin().x < 0 || worldX - chunk->getOrigin().x >= 16
+                    || worldZ - chunk->getOrigin().y < 0 || worldZ - chunk->getOrigin().y >= 16)
+            {
+                chunk = mcr_terrain->findChunkAt(worldX, worldZ);
+                navGrid = chunk != nullptr ? chunk->getNavGrid() : nullptr;
+            }
+            if (navGrid == nullptr)
+            {
+                continue;
+            }
+            glm::ivec2 origin = chunk->getOrigin();
+            m_navColumns[(x + radius + 1) * navSide + (z + radius + 1)] =
+                    navGrid->getColumn(worldX - origin.x, worldZ - origin.y);
+        }
+    }
+}
+
+/**
+ * @brief PathFinder::getNavColumn
+ * @param x : in [-radius - 1, radius + 1]
+ * @param z : in [-radius - 1, radius + 1]
+ * @return
+ */
+const NavColumn* PathFinder::getNavColumn(int x, int z) const
+{
+    int navSide = 3 + 2 * radius;
+    if (x < -radius - 1 || x > radius + 1 || z < -radius - 1 || z > radius + 1)
+    {
+        return nullptr;
+    }
+    return &m_navColumns[(x + radius + 1) * navSide + (z + radius + 1)];
+}
+
+/**
+ * @brief PathFinder::pushNode
+ *  Add the node to the arena & the open heap
+ * @param node
+ */
+void PathFinder::pushNode(const PathNode &node)
+{
+    m_nodes.push_back(node);
+    m_openHeap.push_back(static_cast<int>(m_nodes.size()) - 1);
+    std::push_heap(m_openHeap.begin(), m_openHeap.end(), CompareNode{&m_nodes});
+}
+
+/**
+ * @brief PathFinder::popNode
+ * @return the index of the cheapest node to explore
+ */
+int PathFinder::popNode()
+{
+    std::pop_heap(m_openHeap.begin(), m_openHeap.end(), CompareNode{&m_nodes});
+    int node = m_openHeap.back();
+    m_openHeap.pop_back();
+    return node;
+}
+
 glm::vec3 PathFinder::getBlockAt(glm::vec3 pos)
 {
     glm::vec3 blockPos = glm::vec3(glm::floor(pos.x),
@@ -123,12 +261,132 @@ glm::vec3 PathFinder::getStableStartPoint(glm::vec3 pos)
  */
 std::queue<NPCAction> PathFinder::searchPathToward(glm::vec3 startPos,
                                                    glm::vec3 targetPos)
+{
+    prepareSearchToward(startPos, targetPos);
+    return runPreparedSearch();
+}
+
+/**
+ * @brief PathFinder::searchRouteToward
+ *  For a target out of the search grid, plan the whole route over the chunk portals
+ *  (see PortalGraph) & only search the path to the farthest route cell in the grid.
+ *  A target that can't be reached falls back to searchPathToward's behavior.
+ * @param startPos
+ * @param targetPos
+ * @return
+ */
+std::queue<NPCAction> PathFinder::searchRouteToward(glm::vec3 startPos,
+                                                    glm::vec3 targetPos)
+{
+    prepareRouteToward(startPos, targetPos);
+    return runPreparedSearch();
+}
+
+/**
+ * @brief PathFinder::prepareSearchToward
+ *  The terrain half of searchPathToward
+ *  Note: the world lock must be held
+ * @param startPos
+ * @param targetPos
+ */
+void PathFinder::prepareSearchToward(glm::vec3 startPos, glm::vec3 targetPos)
 {
     // align the startPos & targetPos with the grid (of the world)
     // the block right below the npc
-    startPos = getStableStartPoint(startPos);
-    targetPos = getBlockRightBelow(targetPos);
+    m_lastRouteExpansions = 0;
+    prepareBlocks(getStableStartPoint(startPos), getBlockRightBelow(targetPos));
+}
+
+/**
+ * @brief PathFinder::prepareRouteToward
+ *  The terrain half of searchRouteToward: the route & the waypoint on it
+ *  Note: the world lock must be held
+ * @param startPos
+ * @param targetPos
+ */
+void PathFinder::prepareRouteToward(glm::vec3 startPos, glm::vec3 targetPos)
+{
+    glm::vec3 startBlock = getStableStartPoint(startPos);
+    glm::vec3 targetBlock = getBlockRightBelow(targetPos);
+    glm::ivec3 start = glm::ivec3(startBlock);
+    glm::ivec3 goal = glm::ivec3(targetBlock);
+
+    m_lastRouteExpansions = 0;
+    prepareBlocks(startBlock, targetBlock);
+    if (glm::max(glm::abs(goal.x - start.x), glm::abs(goal.z - start.z)) > radius)
+    {
+        PortalGraph &portalGraph = mcr_terrain->getPortalGraph();
+        bool found = portalGraph.findRoute(start, goal, &m_route);
+        m_lastRouteExpansions = portalGraph.getLastExpansions();
+        if (found && !m_route.empty())
+        {
+            // the farthest cell of the route in the search grid, or the first one
+            glm::ivec3 waypoint = m_route[0];
+            for (const glm::ivec3 &cell : m_route)
+            {
+                if (glm::max(glm::abs(cell.x - start.x), glm::abs(cell.z - start.z)) > radius)
+                {
+                    break;
+                }
+                waypoint = cell;
+            }
+            // if the grid can't get to a waypoint in it (e.g. it's out of its height range),
+            // head straight for the target instead; a waypoint out of it (the first cell is
+            // farther than the radius) is never reached, the partial path heads toward it
+            m_targetBlock = glm::vec3(waypoint);
+            m_fallbackBlock = targetBlock;
+            m_hasFallback = glm::max(glm::abs(waypoint.x - start.x), glm::abs(waypoint.z - start.z)) <= radius;
+        }
+    }
+}
+
+/**
+ * @brief PathFinder::prepareBlocks
+ *  Copy the navigation columns around startBlock & draw the random path choice,
+ *  on the calling thread (SeededRandom's stream is per thread)
+ * @param startBlock : the block the npc stands on
+ * @param targetBlock : the block to stand on
+ */
+void PathFinder::prepareBlocks(glm::vec3 startBlock, glm::vec3 targetBlock)
+{
+    m_startBlock = startBlock;
+    m_targetBlock = targetBlock;
+    m_hasFallback = false;
+    m_pick = SeededRandom::next();
+    gatherNavColumns(glm::ivec3(startBlock));
+}
+
+/**
+ * @brief PathFinder::runPreparedSearch
+ *  The A* half of the searches, it doesn't touch the terrain
+ *  (only the columns copied by prepareSearchToward / prepareRouteToward)
+ * @return
+ */
+std::queue<NPCAction> PathFinder::runPreparedSearch()
+{
+    TraceSpan span("pathfinding", "npc",
+                   static_cast<int>(m_startBlock.x), static_cast<int>(m_startBlock.z));
+
+    bool found = false;
+    std::queue<NPCAction> actions = searchBlocks(m_targetBlock, &found);
+    if (!found && m_hasFallback)
+    {
+        // not the partial path toward the waypoint, the grid can't reach it
+        actions = searchBlocks(m_fallbackBlock, &found);
+    }
+    return actions;
+}
 
+/**
+ * @brief PathFinder::searchBlocks
+ *  The A* search of searchPathToward, from the prepared start
+ *  Without a path to targetPos, the path to one of the closest nodes is picked at random
+ * @param targetPos : the block to stand on
+ * @param out_found : whether the path reaches targetPos
+ * @return
+ */
+std::queue<NPCAction> PathFinder::searchBlocks(glm::vec3 targetPos, bool *out_found)
+{
     // std::cout << "Start from: " << glm::to_string(startPos) << std::endl;
     // std::cout << "Target to: " << glm::to_string(targetPos) << std::endl;
 
@@ -136,54 +394,63 @@ std::queue<NPCAction> PathFinder::searchPathToward(glm::vec3 startPos,
     int xMin, xMax, yMin, yMax, zMin, zMax;
     xMin = -radius;
     xMax = radius + 1;
-    yMin = -3;
-    yMax = 3;
+    yMin = Y_MIN;
+    yMax = Y_MAX;
     zMin = -radius;
     zMax = radius + 1;
 
     // set of visited positions (for each state)
     // currently, there are only two states (walk & jump)
-    std::unordered_set<int> walkVisited = {};
-    std::unordered_set<int> jumpVisited = {};
+    int sideLen = 1 + 2 * radius;
+    int nCells = (yMax - yMin) * sideLen * sideLen;
+    m_walkClosed.assign(nCells, false);
+    m_jumpClosed.assign(nCells, false);
 
-    // heap (costSoFar, pos)
-    std::priority_queue<Path, std::vector<Path>, CompareStep> pathsToExplore;
-    Path initialPath = Path({NPCAction(startPos, REST)}, 0.f, getHorizontalDistance(startPos, targetPos), 0, 0, 0);
-    pathsToExplore.push(initialPath);
+    // the navigation columns of the search box were copied by prepareBlocks
+    glm::vec3 startPos = m_startBlock;
+    glm::ivec3 startCell = glm::ivec3(startPos);
+
+    // the arena & the heap (costSoFar, node) keep their capacity between searches
+    m_nodes.clear();
+    m_openHeap.clear();
+    pushNode(PathNode(startPos, REST, -1, 0, getHorizontalDistance(startPos, targetPos), 0, 0, 0));
 
     bool foundDestination = false;
-    Path minPath = initialPath;
+    int minNode = 0;
 
     // keep top 10 paths for random sampling (if no destination is found)
-    std::priority_queue<Path, std::vector<Path>, CompareStepMaxHeap> minCostPathHeap;
+    std::priority_queue<int, std::vector<int>, CompareNodeMaxHeap> minCostPathHeap(CompareNodeMaxHeap{&m_nodes});
     int nToKeep = 10;
 
     // assume only walk & each walk takes 1 block
     // able to explore 8 directions with y (+-1)
     // TODO: so, basically, 3 x 3 cube
-    int sideLen = 1 + 2 * radius;
-    while (!pathsToExplore.empty())
+    int expansions = 0;
+    while (!m_openHeap.empty())
     {
-        // get the top
-        Path currPath = pathsToExplore.top();
         // pop the top
-        pathsToExplore.pop();
+        int currNode = popNode();
+        // copied, pushing the neighbors can move the arena
+        PathNode currPath = m_nodes[currNode];
+        expansions++;
 
         // reach the goal or not
         if (currPath.dest == targetPos)
         {
-            minPath = currPath;
+            minNode = currNode;
             foundDestination = true;
             break;
         }
 
-        minCostPathHeap.push(currPath);
+        minCostPathHeap.push(currNode);
         if (minCostPathHeap.size() > nToKeep)
         {
             // this will pop out the max cost in the heap so far
             minCostPathHeap.pop();
         }
 
+        int currY = startCell.y + currPath.currY;
+
         // explore walk
         // search x & z
         for (int dx : {-1, 0, 1})
@@ -209,59 +476,43 @@ std::queue<NPCAction> PathFinder::searchPathToward(glm::vec3 startPos,
                         continue;
                     }
 
-                    // y from [-2, 2)
-                    int id = (y + 3) * 5 * ((x + radius) * sideLen + (z + radius));
+                    int id = getCellIndex(x, y, z);
 
-                    if (walkVisited.find(id) != walkVisited.end())
+                    if (m_walkClosed[id])
                     {
                         continue;
                     }
 
-                    walkVisited.insert(id);
-
-                    // explore this action
-                    glm::vec3 nextDest = currPath.dest + glm::vec3(dx, dy, dz);
-
-                    glm::vec3 nextDestTop = glm::vec3(nextDest.x, nextDest.y + 1.f, nextDest.z);
+                    m_walkClosed[id] = true;
 
-                    if (!mcr_terrain->hasBlockAt(nextDest))
+                    // a walkable block with room above it
+                    const NavColumn *column = getNavColumn(x, z);
+                    if (column == nullptr || !column->isStandable(startCell.y + y))
                     {
-                        // no block here
                         continue;
                     }
 
-                    if (mcr_terrain->getBlockAt(nextDestTop) != EMPTY)
-                    {
-                        continue;
-                    }
-
-                    if (validBlocks.find(mcr_terrain->getBlockAt(nextDest)) == validBlocks.end())
-                    {
-                        continue;
-                    }
+                    // explore this action
+                    glm::vec3 nextDest = currPath.dest + glm::vec3(dx, dy, dz);
 
                     int nextNSteps = currPath.nStepsSoFar + 1;
 
                     float nextCost = getHorizontalDistance(nextDest, targetPos) + (float) nextNSteps;
 
-                    std::vector<NPCAction> nextActions = currPath.actions;
-
-                    nextActions.push_back(NPCAction(nextDest, WALK));
-                    Path nextPath = Path(nextActions, nextNSteps, nextCost, x, y, z);
-                    pathsToExplore.push(nextPath);
+                    pushNode(PathNode(nextDest, WALK, currNode, nextNSteps, nextCost, x, y, z));
 
                 }
             }
         }
 
         // no continuous jump
-        if (currPath.lastAct == JUMP)
+        if (currPath.action == JUMP)
         {
             continue;
         }
 
         // if there's any obstacle around, try jump?
-        // either empty or having blocks
+        // either a block above a neighbor or a drop (see NavColumn::blocker)
         bool hasObstacles = false;
         for (int dx : {-1, 0, 1})
         {
@@ -271,31 +522,8 @@ std::queue<NPCAction> PathFinder::searchPathToward(glm::vec3 startPos,
                 {
                     continue;
                 }
-                glm::vec3 neighbor = currPath.dest + glm::vec3(dx, 0, dz);
-
-                if (!mcr_terrain->hasBlockAt(neighbor))
-                {
-                    // no such block
-                    continue;
-                }
-
-                glm::vec3 neighborTop = glm::vec3(neighbor.x, neighbor.y + 1.f, neighbor.z);
-                if (mcr_terrain->getBlockAt(neighborTop) != EMPTY)
-                {
-                    hasObstacles = true;
-                }
-                // empty
-                int nToCheck = 3;
-                bool allEmpty = true;
-                for (int i = 0; i < nToCheck; i++)
-                {
-                    glm::vec3 neighborDown = glm::vec3(neighbor.x, neighbor.y - (float)i, neighbor.z);
-                    if (mcr_terrain->getBlockAt(neighborDown) != EMPTY)
-                    {
-                        allEmpty = false;
-                    }
-                }
-                if (allEmpty)
+                const NavColumn *column = getNavColumn(currPath.currX + dx, currPath.currZ + dz);
+                if (column != nullptr && column->isBlocker(currY))
                 {
                     hasObstacles = true;
                 }
@@ -322,42 +550,29 @@ std::queue<NPCAction> PathFinder::searchPathToward(glm::vec3 startPos,
                         int y = currPath.currY + dy;
                         int z = currPath.currZ + dz;
 
-                        // y from [-2, 2)
-                        int id = (y + 3) * 5 * ((x + radius) * sideLen + (z + radius));
-
                         // out of search grid
                         if (x < xMin || x >= xMax || y < yMin || y >= yMax || z < zMin || z >= zMax )
                         {
                             continue;
                         }
 
-                        if (jumpVisited.find(id) != jumpVisited.end())
-                        {
-                            continue;
-                        }
-
-                        jumpVisited.insert(id);
-
-                        // explore this action
-                        glm::vec3 nextDest = currPath.dest + glm::vec3(dx, dy, dz);
+                        int id = getCellIndex(x, y, z);
 
-                        if (!mcr_terrain->hasBlockAt(nextDest))
+                        if (m_jumpClosed[id])
                         {
-                            // no such block
                             continue;
                         }
 
-                        glm::vec3 nextDestTop = glm::vec3(nextDest.x, nextDest.y + 1.f, nextDest.z);
+                        m_jumpClosed[id] = true;
 
-                        if (mcr_terrain->getBlockAt(nextDestTop) != EMPTY)
+                        const NavColumn *column = getNavColumn(x, z);
+                        if (column == nullptr || !column->isStandable(startCell.y + y))
                         {
                             continue;
                         }
 
-                        if (validBlocks.find(mcr_terrain->getBlockAt(nextDest)) == validBlocks.end())
-                        {
-                            continue;
-                        }
+                        // explore this action
+                        glm::vec3 nextDest = currPath.dest + glm::vec3(dx, dy, dz);
 
                         int maxD = glm::abs(dx) + glm::abs(dz);
                         int nextNSteps = currPath.nStepsSoFar + 1;
@@ -365,12 +580,7 @@ std::queue<NPCAction> PathFinder::searchPathToward(glm::vec3 startPos,
                         // additional cost for farther jump
                         float nextCost = getHorizontalDistance(nextDest, targetPos) + (float) nextNSteps + (float)(maxD);
 
-                        std::vector<NPCAction> nextActions = currPath.actions;
-
-                        nextActions.push_back(NPCAction(nextDest, JUMP));
-
-                        Path nextPath = Path(nextActions, nextNSteps, nextCost, x, y, z);
-                        pathsToExplore.push(nextPath);
+                        pushNode(PathNode(nextDest, JUMP, currNode, nextNSteps, nextCost, x, y, z));
 
                     }
                 }
@@ -379,35 +589,41 @@ std::queue<NPCAction> PathFinder::searchPathToward(glm::vec3 startPos,
 
     }
 
-    // if found destination => use minPath
+    static Histogram &searchExpansions = MetricsRegistry::global().histogram("path.expansions");
+    searchExpansions.record(expansions);
+    m_lastExpansions = expansions;
+    *out_found = foundDestination;
+
+    // if found destination => use minNode
     // if not explore options
-    Path finalPath = minPath;
+    int finalNode = minNode;
     if (!foundDestination)
     {
-        int selectID =  rand() % minCostPathHeap.size();
+        int selectID = m_pick % minCostPathHeap.size();
         // std::cout << "Random path : " << selectID << " out of " << minCostPathHeap.size() << std::endl;
         while (selectID > 0)
         {
             minCostPathHeap.pop();
             selectID -= 1;
         }
-        finalPath = minCostPathHeap.top();
+        finalNode = minCostPathHeap.top();
+
+    }
 
+    // walk back to the start (which isn't an action to take)
+    std::vector<int> pathNodes;
+    for (int node = finalNode; m_nodes[node].parent != -1; node = m_nodes[node].parent)
+    {
+        pathNodes.push_back(node);
     }
 
     // update the actions
     std::queue<NPCAction> npcPath = std::queue<NPCAction>();
-    // std::cout << "Plan" << std::endl;
-    for (int i = 0; i < finalPath.actions.size(); i++)
+    for (auto it = pathNodes.rbegin(); it != pathNodes.rend(); ++it)
     {
-        if (i == 0)
-        {
-            continue;
-        }
-
-        glm::vec3 blockTopCenter = getBlockTopAt(finalPath.actions[i].dest);
-        npcPath.push(NPCAction(blockTopCenter, finalPath.actions[i].action));
-        // std::cout << "finalPath act: " << (finalPath.actions[i].action == JUMP) << std::endl;
+        const PathNode &node = m_nodes[*it];
+        glm::vec3 blockTopCenter = getBlockTopAt(node.dest);
+        npcPath.push(NPCAction(blockTopCenter, node.action));
     }
 
     return npcPath;
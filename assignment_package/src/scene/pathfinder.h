@@ -5,6 +5,7 @@
 #include <deque>
 #include <unordered_set>
 #include <queue>
+#include <vector>
 #include <iostream>
 
 enum Action : unsigned char
@@ -26,51 +27,29 @@ struct NPCAction
 };
 
 /**
- * @brief The Path class
- *  Mainly used for A* search
+ * @brief The PathNode class
+ *  A node of the A* search, the endpoint of a path;
+ *  the rest of the path is reached through the parent nodes
  */
-struct Path
+struct PathNode
 {
-    // the last action in the path indicates the endpoint of this path so far
-    std::vector<NPCAction> actions;
-
     glm::vec3 dest;
-    Action lastAct;
+    // the action taken to get to dest
+    Action action;
+    // the index of the previous node in the arena, -1 for the start
+    int parent;
 
     // the number of steps taken to get the endpoint
-    float nStepsSoFar;
+    int nStepsSoFar;
     // the overall cost of this path
     float costSoFar;
-    // used to check the point is visited or not
+    // position in the search grid, relative to the start
     int currX, currY, currZ;
 
-    Path(std::vector<NPCAction>actions, float nSteps, float totalCost, int x, int y, int z)
-        : actions(actions), nStepsSoFar(nSteps), costSoFar(totalCost), currX(x), currY(y), currZ(z)
-    {
-        dest = actions[actions.size() - 1].dest;
-        lastAct = actions[actions.size() - 1].action;
-    }
-
-};
-
-/**
- * @brief The CompareStep class
- *  for priority queue (min-heap implementation)
- */
-struct CompareStep
-{
-    bool operator() (const Path &p1, const Path &p2)
-    {
-        return p1.costSoFar > p2.costSoFar;
-    }
-};
-
-struct CompareStepMaxHeap
-{
-    bool operator() (const Path &p1, const Path &p2)
-    {
-        return p1.costSoFar < p2.costSoFar;
-    }
+    PathNode(glm::vec3 dest, Action action, int parent, int nSteps, float totalCost, int x, int y, int z)
+        : dest(dest), action(action), parent(parent), nStepsSoFar(nSteps), costSoFar(totalCost),
+          currX(x), currY(y), currZ(z)
+    {}
 };
 
 /**
@@ -83,11 +62,47 @@ class PathFinder
     // radius of the grid
     int radius;
 
-    // blocks to consider
-    static std::unordered_set<BlockType> validBlocks;
-
     Terrain *mcr_terrain;
 
+    // reused by every search (kept to avoid reallocating them each time)
+    // every node created by the search, the heap & paths refer to them by index
+    std::vector<PathNode> m_nodes;
+    // min-heap (by costSoFar) of the nodes to explore
+    std::vector<int> m_openHeap;
+    // one bit per cell of the search box, for each state (walk & jump)
+    std::vector<bool> m_walkClosed;
+    std::vector<bool> m_jumpClosed;
+    // copies of the navigation columns around the start (see gatherNavColumns),
+    // so a prepared search doesn't read the terrain
+    std::vector<NavColumn> m_navColumns;
+    // nodes popped by the last search
+    int m_lastExpansions;
+    // the route to the target (see searchRouteToward)
+    std::vector<glm::ivec3> m_route;
+    int m_lastRouteExpansions;
+
+    // the prepared search (see prepareSearchToward): the blocks to stand on,
+    // the target to fall back to if the first can't be headed for
+    glm::vec3 m_startBlock;
+    glm::vec3 m_targetBlock;
+    glm::vec3 m_fallbackBlock;
+    bool m_hasFallback;
+    // picks the path taken when the target isn't found
+    unsigned int m_pick;
+
+    // index of the relative cell (x, y, z) in the closed sets
+    int getCellIndex(int x, int y, int z) const;
+    void pushNode(const PathNode &node);
+    void gatherNavColumns(glm::ivec3 startCell);
+    // the column at (x, z) relative to the start, nullptr out of the gathered columns
+    const NavColumn* getNavColumn(int x, int z) const;
+    // read what the search from startBlock needs from the terrain
+    void prepareBlocks(glm::vec3 startBlock, glm::vec3 targetBlock);
+    // A* from the prepared start to the block targetPos, within the search grid
+    // out_found: whether it got there (or the path is a partial one)
+    std::queue<NPCAction> searchBlocks(glm::vec3 targetPos, bool *out_found);
+    int popNode();
+
     glm::vec3 getBlockAt(glm::vec3 pos);
     glm::vec3 getBlockTopAt(glm::vec3 pos);
     glm::vec3 getBlockRightBelow(glm::vec3 pos);
@@ -109,10 +124,22 @@ public:
     // returns a series of block center coords to move to
     std::queue<NPCAction> searchPathToward(glm::vec3 startPos,
                                           glm::vec3 targetPos);
+    // the same, heading for a far target along the route over the chunk portals
+    std::queue<NPCAction> searchRouteToward(glm::vec3 startPos,
+                                           glm::vec3 targetPos);
+
+    // The 2 halves of the searches above, for the PathService:
+    // prepare reads the terrain (with the world lock held),
+    // runPreparedSearch only uses this PathFinder, so it can run on another thread
+    void prepareSearchToward(glm::vec3 startPos, glm::vec3 targetPos);
+    void prepareRouteToward(glm::vec3 startPos, glm::vec3 targetPos);
+    std::queue<NPCAction> runPreparedSearch();
 
     // getters & setters
     void setRadius(int radius);
     int getRadius() const;
+    int getLastExpansions() const;
+    int getLastRouteExpansions() const;
 
 };
 
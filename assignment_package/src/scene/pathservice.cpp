@@ -0,0 +1,174 @@
+#include "pathservice.h"
+#include "tracer.h"
+#include "metrics.h"
+#include <QThread>
+
+
+PathService::PathService(int searchesPerTick)
+    : m_pool(), m_waiting(), m_running(), m_results(), m_searchesPerTick(searchesPerTick)
+{
+    m_pool.setMaxThreadCount(glm::max(1, glm::min(searchesPerTick, QThread::idealThreadCount())));
+}
+
+PathService::~PathService()
+{
+    clear();
+}
+
+/**
+ * @brief PathService::request
+ *  Queue a search, or move the goal of the one pathFinder has waiting
+ * @param pathFinder
+ * @param startPos
+ * @param goal
+ * @param route
+ * @param onDone
+ */
+void PathService::request(PathFinder *pathFinder, glm::vec3 startPos, glm::vec3 goal, bool route,
+                          PathCallback onDone)
+{
+    for (PathRequest &waiting : m_waiting)
+    {
+        if (waiting.pathFinder == pathFinder)
+        {
+            waiting.startPos = startPos;
+            waiting.goal = goal;
+            waiting.route = route;
+            waiting.onDone = onDone;
+            return;
+        }
+    }
+    m_waiting.push_back(PathRequest(pathFinder, startPos, goal, route, onDone));
+}
+
+/**
+ * @brief PathService::cancel
+ *  A running search still finishes (its PathFinder stays busy until the next collect),
+ *  its actions are dropped
+ * @param pathFinder
+ */
+void PathService::cancel(const PathFinder *pathFinder)
+{
+    for (auto it = m_waiting.begin(); it != m_waiting.end(); ++it)
+    {
+        if (it->pathFinder == pathFinder)
+        {
+            m_waiting.erase(it);
+            break;
+        }
+    }
+    for (PathRequest &running : m_running)
+    {
+        if (running.pathFinder == pathFinder)
+        {
+            running.onDone = nullptr;
+        }
+    }
+}
+
+/**
+ * @brief PathService::clear
+ *  Before the PathFinders of the requests are destroyed
+ */
+void PathService::clear()
+{
+    m_pool.waitForDone();
+    m_running.clear();
+    m_results.clear();
+    m_waiting.clear();
+}
+
+/**
+ * @brief PathService::collect
+ *  Wait for the searches started by the last dispatch & call back their requesters,
+ *  in the order they were started
+ *  Note: the world lock must be held, the callbacks change the NPCs
+ */
+void PathService::collect()
+{
+    if (m_running.empty())
+    {
+        return;
+    }
+
+    static Histogram &waitTime = MetricsRegistry::global().histogram("path.collect_wait_us");
+    long long start = MetricsRegistry::now();
+    {
+        TraceSpan wait("wait path searches", "npc");
+        m_pool.waitForDone();
+    }
+    waitTime.record(MetricsRegistry::now() - start);
+
+    // a callback may request again, which only touches m_waiting
+    std::vector<PathRequest> done;
+    std::vector<std::queue<NPCAction>> results;
+    done.swap(m_running);
+    results.swap(m_results);
+    for (unsigned int i = 0; i < done.size(); i++)
+    {
+        if (done[i].onDone)
+        {
+            done[i].onDone(results[i]);
+        }
+    }
+}
+
+/**
+ * @brief PathService::dispatch
+ *  Prepare the oldest requests (up to the budget) on this thread & start their searches
+ *  Note: the world lock must be held
+ */
+void PathService::dispatch()
+{
+    static Gauge &waitingCount = MetricsRegistry::global().gauge("path.requests_waiting");
+
+    // a PathFinder runs one search at a time
+    collect();
+
+    int nSearches = glm::min(m_searchesPerTick, static_cast<int>(m_waiting.size()));
+    // the workers write into m_results, it must not move once they start
+    m_running.clear();
+    m_results.assign(nSearches, std::queue<NPCAction>());
+    for (int i = 0; i < nSearches; i++)
+    {
+        m_running.push_back(m_waiting.front());
+        m_waiting.pop_front();
+
+        const PathRequest &request = m_running.back();
+        if (request.route)
+        {
+            request.pathFinder->prepareRouteToward(request.startPos, request.goal);
+        }
+        else
+        {
+            request.pathFinder->prepareSearchToward(request.startPos, request.goal);
+        }
+    }
+    for (int i = 0; i < nSearches; i++)
+    {
+        m_pool.start(new PathSearchWorker(m_running[i].pathFinder, &m_results[i]));
+    }
+    waitingCount.set(m_waiting.size());
+}
+
+/**
+ * @brief PathService::getWaitingCount
+ * @return the requests not started yet
+ */
+int PathService::getWaitingCount() const
+{
+    return static_cast<int>(m_waiting.size());
+}
+
+
+PathSearchWorker::PathSearchWorker(PathFinder *pathFinder, std::queue<NPCAction> *result)
+    : pathFinder(pathFinder), result(result)
+{}
+
+/**
+ * @brief PathSearchWorker::run
+ */
+void PathSearchWorker::run()
+{
+    *result = pathFinder->runPreparedSearch();
+}
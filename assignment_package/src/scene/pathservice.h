@@ -0,0 +1,81 @@
+#pragma once
+#include "pathfinder.h"
+#include <QRunnable>
+#include <QThreadPool>
+#include <deque>
+#include <functional>
+#include <vector>
+
+// called with the actions of a search, on the thread running PathService::collect
+typedef std::function<void(std::queue<NPCAction>)> PathCallback;
+
+// A search an NPC asked for
+struct PathRequest
+{
+    // the requester's own PathFinder, the search runs in it
+    PathFinder *pathFinder;
+    glm::vec3 startPos;
+    glm::vec3 goal;
+    // PathFinder::searchRouteToward instead of searchPathToward
+    bool route;
+    // empty once the request is cancelled
+    PathCallback onDone;
+
+    PathRequest(PathFinder *pathFinder, glm::vec3 startPos, glm::vec3 goal, bool route, PathCallback onDone)
+        : pathFinder(pathFinder), startPos(startPos), goal(goal), route(route), onDone(onDone)
+    {}
+};
+
+// Runs the NPCs' path searches on worker threads, a few per simulation tick.
+// Each tick (with the world lock held):
+//   collect()  - wait for the searches started last tick & hand their actions to the NPCs,
+//   the NPC ticks request new searches,
+//   dispatch() - prepare the oldest requests (the terrain reads, see PathFinder::prepareSearchToward)
+//                & start their A* on the workers, where they run while the simulation sleeps.
+// A search always answers the tick after it starts, whatever the thread timing,
+// so a replay gets the same paths.
+// Fairness: an NPC has at most one request waiting (a new one replaces its goal
+// but keeps its place), & they're started oldest first.
+class PathService
+{
+private:
+    // the workers (not the global pool, where the chunk workers queue up)
+    QThreadPool m_pool;
+    // the requests not started yet, oldest first
+    std::deque<PathRequest> m_waiting;
+    // the requests started by the last dispatch() & their actions (written by the workers)
+    std::vector<PathRequest> m_running;
+    std::vector<std::queue<NPCAction>> m_results;
+    // the most searches started by one dispatch()
+    int m_searchesPerTick;
+
+public:
+    explicit PathService(int searchesPerTick = 4);
+    ~PathService();
+
+    // search from startPos toward goal in pathFinder, onDone gets the actions
+    // Note: pathFinder mustn't be used until then
+    void request(PathFinder *pathFinder, glm::vec3 startPos, glm::vec3 goal, bool route, PathCallback onDone);
+    // drop the request of pathFinder, onDone won't be called
+    void cancel(const PathFinder *pathFinder);
+    // wait for the running searches & drop every request
+    void clear();
+
+    void collect();
+    void dispatch();
+
+    int getWaitingCount() const;
+};
+
+// Runs the prepared search of one PathFinder
+class PathSearchWorker : public QRunnable
+{
+private:
+    PathFinder *pathFinder;
+    std::queue<NPCAction> *result;
+
+public:
+    PathSearchWorker(PathFinder *pathFinder, std::queue<NPCAction> *result);
+
+    void run() override;
+};
@@ -7,28 +7,72 @@ Player::Player(glm::vec3 pos, Terrain &terrain)
       m_camera(pos + glm::vec3(0, 1.5f, 0)), m_tpv_camera(pos + glm::vec3(0, 1.5f, 0), -8.f, 30.f, 190.f),
       mcr_terrain(terrain),
       flight_velocity_max(15.f), non_flight_velocity_max(10.f), m_velocity_val(flight_velocity_max),
-      m_acceleration_val(40.f), cameraBlockDist(3.f), flightMode(true), containerMode(false),
+      m_acceleration_val(40.f), cameraBlockDist(3.f), flightMode(true), containerMode(false), grounded(false), m_collider(false),
       destroyBufferTime(0.f), creationBufferTime(0.f), minWaitTime(0.5f),
-      selectedBlockOnHandPtr(0), hp(100.f), hp_max(100.f), mcr_camera(m_camera), mcr_tpv_camera(m_tpv_camera), hp_top_left_pos(glm::vec2(-0.95, 0.95)),
-      tpv(false)
+      selectedBlockOnHandPtr(0), isGrabbingItem(false), hp(100.f), hp_max(100.f), mcr_camera(m_camera), mcr_tpv_camera(m_tpv_camera), hp_top_left_pos(glm::vec2(-0.95, 0.95)),
+      tpv(false), lastHUDState(), hudValid(false)
 {}
 
 Player::~Player()
 {}
 
+// Runs on the simulation thread, so it must not touch
+// the HUD drawables (see Player::drawHUD).
 void Player::tick(float dT, InputBundle &input) {
     destroyBufferTime += dT;
     creationBufferTime += dT;
     destroyBlock(input, mcr_terrain);
     placeBlock(input, mcr_terrain);
-    widgetInteraction();
-    stateOperation(input);
+    computePlayerState(input);
     selectBlockOnHand(input);
-    drawInventoryItem();
     processInputs(input);
     computePhysics(dT, mcr_terrain, input);
 }
 
+/**
+ * @brief Player::drawHUD
+ *  pass the player's state, inventory and widgets to the HUD drawables
+ *  called from MyGL::paintGL (GUI thread) while holding the world lock
+ */
+void Player::drawHUD() {
+    widgetInteraction();
+    drawPlayerState();
+    // setup the selected frame in inventoryWidgetOnHand
+    inventoryWidgetOnHand->addItem(selectedBlockOnHandPtr);
+    drawInventoryItem();
+
+    lastHUDState = getHUDState();
+    hudValid = true;
+}
+
+bool Player::HUDState::operator==(const HUDState &other) const {
+    return hp == other.hp && selectedBlock == other.selectedBlock && containerMode == other.containerMode
+            && grabbing == other.grabbing && inventoryVersion == other.inventoryVersion;
+}
+
+Player::HUDState Player::getHUDState() const {
+    HUDState state;
+    state.hp = hp;
+    state.selectedBlock = selectedBlockOnHandPtr;
+    state.containerMode = containerMode;
+    state.grabbing = isGrabbingItem;
+    state.inventoryVersion = inventory.getVersion();
+    return state;
+}
+
+/**
+ * @brief Player::needsHUDRedraw
+ *  The HUD only shows the HP, the inventory and the selected block,
+ *  so it only has to be re-tessellated when one of them changed.
+ */
+bool Player::needsHUDRedraw() const {
+    return !hudValid || !(getHUDState() == lastHUDState);
+}
+
+void Player::invalidateHUD() {
+    hudValid = false;
+}
+
 void Player::processInputs(InputBundle &inputs) {
     // TODO: Update the Player's velocity and acceleration based on the
     // state of the inputs.
@@ -105,19 +149,6 @@ void Player::computePhysics(float dT, const Terrain &terrain, InputBundle &input
         break;
     }
 
-    if (!checkXZCollision(0, terrain)) {
-        m_velocity[0] = 0.f;
-    }
-    if (!checkXZCollision(2, terrain)) {
-        m_velocity[2] = 0.f;
-    }
-    if (!checkYCollision(terrain)) {
-        if (m_velocity[1] <= -9.5) {
-            hpChange(-30);
-        }
-        m_velocity[1] = 0.f;
-    }
-
     if (inputs.spacePressed) {
         implementJumping(terrain, inputs);
     }
@@ -127,6 +158,9 @@ void Player::computePhysics(float dT, const Terrain &terrain, InputBundle &input
     }
     m_velocity = liquidFactor * m_velocity;
     displacement = m_velocity * dampingFactor * dT;
+    if (!flightMode) {
+        displacement = collide(displacement, terrain);
+    }
     moveAlongVector(displacement);
 
 }
@@ -320,7 +354,7 @@ void Player::rotateCameraView(InputBundle &input) {
 /**
  * @brief Player::rotateCameraView
  *  Rotate the camera view based on the difference in x-direction and y-direction on screen
- *  This function is specifically for MacOS, but now we do not use it
+ *  Used by the ROTATE_VIEW PlayerCommand, and once for MacOS
  * @param thetaChange : float, difference in x-direction on screen
  * @param phiChange : float, difference in y-direction on screen
  */
@@ -348,130 +382,6 @@ void Player::rotateCameraView(float thetaChange, float phiChange) {
     rotateOnUpGlobal(-thetaChange * scalar);
 }
 
-/**
- * @brief Player::gridMarch
- *  Find the hit block given ray direction and position
- * @param rayOrigin : glm::vec3, coordinate of start point
- * @param rayDirection : glm::vec3, direction of the ray, and the length is the farthest length we search
- * @param terrain : Terrain, terrain storing block data
- * @param out_dist : float, distance between ray origin and colliding surface
- * @param out_blockHit : glm::ivec3, coordinate of hit block
- */
-bool Player::gridMarch(glm::vec3 rayOrigin, glm::vec3 rayDirection, const Terrain &terrain, float *out_dist, glm::ivec3 *out_blockHit) {
-    float maxLen = glm::length(rayDirection); // Farthest we search
-    glm::ivec3 currCell = glm::ivec3(glm::floor(rayOrigin));
-    rayDirection = glm::normalize(rayDirection); // Now all t values represent world dist.
-    float curr_t = 0.f;
-
-    while(curr_t < maxLen) {
-        float min_t = glm::sqrt(3.f);
-        float interfaceAxis = -1; // Track axis for which t is smallest
-        for(int i = 0; i < 3; ++i) { // Iterate over the three axes
-            if(rayDirection[i] != 0) { // Is ray parallel to axis i?
-                float offset = glm::max(0.f, glm::sign(rayDirection[i])); // See slide 5
-                // If the player is *exactly* on an interface then
-                // they'll never move if they're looking in a negative direction
-                if(currCell[i] == rayOrigin[i] && offset == 0.f) {
-                    offset = -1.f;
-                }
-                int nextIntercept = currCell[i] + offset;
-                float axis_t = (nextIntercept - rayOrigin[i]) / rayDirection[i];
-                axis_t = glm::min(axis_t, maxLen); // Clamp to max len to avoid super out of bounds errors
-                if(axis_t < min_t) {
-                    min_t = axis_t;
-                    interfaceAxis = i;
-                }
-            }
-        }
-
-        if(interfaceAxis == -1) {
-            throw std::out_of_range("interfaceAxis was -1 after the for loop in gridMarch!");
-        }
-        curr_t += min_t; // min_t is declared in slide 7 algorithm
-        rayOrigin += rayDirection * min_t;
-        glm::ivec3 offset(0);
-        // Sets it to 0 if sign is +, -1 if sign is -
-        offset[interfaceAxis] = glm::min(0.f, glm::sign(rayDirection[interfaceAxis]));
-        currCell = glm::ivec3(glm::floor(rayOrigin)) + offset;
-        // If currCell contains something other than EMPTY, return
-        // curr_t
-        BlockType cellType = terrain.getBlockAt(currCell.x, currCell.y, currCell.z);
-//        blockTouchingPlayer = cellType;
-        if(cellType != EMPTY) {
-            *out_blockHit = currCell;
-            *out_dist = glm::min(maxLen, curr_t);
-            return true;
-        }
-    }
-    *out_dist = glm::min(maxLen, curr_t);
-    return false;
-}
-
-/**
- * @brief Player::gridMarchPrevBlock
- *  Find the hit block and adjacent empty block given ray direction and position
- * @param rayOrigin : glm::vec3, coordinate of start point
- * @param rayDirection : glm::vec3, direction of the ray, and the length is the farthest length we search
- * @param terrain : Terrain, terrain storing block data
- * @param out_prevBlock : glm::ivec3, coordinate of empty block adjacent to hit block
- * @param out_blockHit : glm::ivec3, coordinate of hit block
- */
-bool Player::gridMarchPrevBlock(glm::vec3 rayOrigin, glm::vec3 rayDirection, const Terrain &terrain, glm::ivec3 *out_prevBlock, glm::ivec3 *out_blockHit) {
-
-    float maxLen = glm::length(rayDirection); // Farthest we search
-    glm::ivec3 currCell = glm::ivec3(glm::floor(rayOrigin));
-    rayDirection = glm::normalize(rayDirection); // Now all t values represent world dist.
-    float curr_t = 0.f;
-
-    while(curr_t < maxLen) {
-        float min_t = glm::sqrt(3.f);
-        float interfaceAxis = -1; // Track axis for which t is smallest
-        for(int i = 0; i < 3; ++i) { // Iterate over the three axes
-            if(rayDirection[i] != 0) { // Is ray parallel to axis i?
-                float offset = glm::max(0.f, glm::sign(rayDirection[i])); // See slide 5
-                // If the player is *exactly* on an interface then
-                // they'll never move if they're looking in a negative direction
-                if(currCell[i] == rayOrigin[i] && offset == 0.f) {
-                    offset = -1.f;
-                }
-                int nextIntercept = currCell[i] + offset;
-                float axis_t = (nextIntercept - rayOrigin[i]) / rayDirection[i];
-                axis_t = glm::min(axis_t, maxLen); // Clamp to max len to avoid super out of bounds errors
-                if(axis_t < min_t) {
-                    min_t = axis_t;
-                    interfaceAxis = i;
-                }
-            }
-        }
-
-        if(interfaceAxis == -1) {
-            throw std::out_of_range("interfaceAxis was -1 after the for loop in gridMarch!");
-        }
-        curr_t += min_t; // min_t is declared in slide 7 algorithm
-        rayOrigin += rayDirection * min_t;
-        glm::ivec3 offset(0);
-        // Sets it to 0 if sign is +, -1 if sign is -
-        offset[interfaceAxis] = glm::min(0.f, glm::sign(rayDirection[interfaceAxis]));
-
-        glm::ivec3 prevOffset(0);
-        prevOffset[interfaceAxis] = glm::sign(rayDirection[interfaceAxis]);
-
-        currCell = glm::ivec3(glm::floor(rayOrigin)) + offset;
-        // If currCell contains something other than EMPTY, return
-        // curr_t
-        BlockType cellType = terrain.getBlockAt(currCell.x, currCell.y, currCell.z);
-//        blockTouchingPlayer = cellType;
-        if(cellType != EMPTY) {
-            *out_blockHit = currCell;
-            *out_prevBlock = currCell - prevOffset;
-            BlockType prevCellType = terrain.getBlockAt((*out_prevBlock).x, (*out_prevBlock).y, (*out_prevBlock).z);
-            return (prevCellType == EMPTY);
-        }
-    }
-    return false;
-
-}
-
 bool Player::isWalking(){
     if(m_velocity.x != 0 || m_velocity.z != 0)
         return true;
@@ -481,92 +391,47 @@ bool Player::isWalking(){
 
 
 /**
- * @brief Player::checkXZCollision
- *  This helper is used to check if the player collides on x or z axis
- * @param idx : int, axis that check the collision (0: x axis, 2: z axis)
- * @param terrain : Terrain, terrain storing block data
+ * @brief Player::getBoundingBox
+ *  From the feet to 0.4 above the eyes
  */
-bool Player::checkXZCollision(int idx, const Terrain &terrain) {
-
-    if (idx != 0 && idx != 2) {
-        return true;
-    }
-
-    if (flightMode) {
-        return true;
-    }
-
-    glm::ivec3 out_blockHit(0);
-    float out_dist = 0.f;
-
-    glm::vec3 currForward(0.f);
-    if (m_forward[idx] > 0.f) {
-        currForward[idx] = 0.5f;
-    } else if (m_forward[idx] < 0.f) {
-        currForward[idx] = -0.5f;
-    } else {
-        return false;
-    }
-
-    float horizontalDistTolerance = 0.13f; // 0.5 * 0.707 = 0.35 -> 0.5 - 0.35 = 0.15
-    std::array<glm::vec3, 3> cornerArr;
-
-    // 4 corners: 45, 135, 225, 315
-    for (int i = 0; i < 4; ++i) {
-        float currDeg = 45.f + i * 90.f;
-        float currRad = glm::radians(currDeg);
-        float fowardDir = (currDeg >= 90.f && currDeg <= 270.f) ? -1.f : 1.f; // the orientation of player and velocity is same or opposite
-        glm::vec3 forwardDeg = glm::vec3(glm::rotate(glm::mat4(), currRad, glm::vec3(0,1,0)) * glm::vec4(currForward, 0.f));
-        // each angle has three points: up, middle and down
-        glm::vec3 cameraCorner = m_camera.getCurrentPos() + forwardDeg + glm::vec3(0.f, 0.5f, 0.f);
-        glm::vec3 middleCorner(cameraCorner - glm::vec3(0.f, 1.f, 0.f));
-        glm::vec3 playerCorner(cameraCorner - glm::vec3(0.f, 2.f, 0.f));
-        cornerArr[0] = cameraCorner;
-        cornerArr[1] = middleCorner;
-        cornerArr[2] = playerCorner;
-
-        for (auto& corner: cornerArr) {
-            bool cornerHit = gridMarch(corner, fowardDir*currForward, terrain, &out_dist, &out_blockHit);
-            if (cornerHit && out_dist < horizontalDistTolerance && m_velocity[idx] * forwardDeg[idx] >= 0 && !isLiquid(terrain, &out_blockHit)) {
-                return false;
-            }
-        }
-    }
-
-    return true;
-
+AABB Player::getBoundingBox() const {
+    return AABB(m_position - glm::vec3(0.4f, 0.f, 0.4f), m_position + glm::vec3(0.4f, 1.9f, 0.4f));
 }
 
 /**
- * @brief Player::checkYCollision
- *  This helper is used to check if the player collides on y axis
+ * @brief Player::collide
+ *  Sweep the bounding box through the blocks around it (liquids let it through),
+ *  stop the velocity on the axes that hit & note the block the player stands on
+ * @param displacement : glm::vec3, the move of this tick
  * @param terrain : Terrain, terrain storing block data
+ * @return the part of the displacement the player can move
  */
-bool Player::checkYCollision(const Terrain &terrain) {
-    if (flightMode) {
-        return true;
-    }
+glm::vec3 Player::collide(glm::vec3 displacement, const Terrain &terrain) {
+    AABB box = getBoundingBox();
+    m_collider.gather(terrain, box, displacement);
+    glm::bvec3 hit(false);
+    glm::vec3 allowed = m_collider.move(box, displacement, &hit);
 
-    glm::ivec3 out_blockHit_ground(0);
-    glm::ivec3 out_blockHit_ceiling(0);
-    float out_dist_neg_y = 0.f;
-    float out_dist_pos_y = 0.f;
-
-    // check if the player touches the ground
-    float negYTolerance = 0.4f; // (specifically for gravity) max velocity: 10, average dt: 0.016 > displacement: 10 * 0.016 = 0.16
-    float posYTolerance = 0.4f;
-    bool playerGroundHit = gridMarch(m_position, glm::vec3(0.f, -1.f, 0.f), terrain, &out_dist_neg_y, &out_blockHit_ground);
-    bool playerCeilingHit = gridMarch(m_camera.getCurrentPos(), glm::vec3(0.f, 1.f, 0.f), terrain, &out_dist_pos_y, &out_blockHit_ceiling);
-    blockTouchingPlayer = terrain.getBlockAt(out_blockHit_ground.x, out_blockHit_ground.y, out_blockHit_ground.z);
-    if (playerGroundHit && out_dist_neg_y < negYTolerance && m_velocity[1] <= 0 && !isLiquid(terrain, &out_blockHit_ground)) {
-        return false;
+    if (hit.x) {
+        m_velocity[0] = 0.f;
     }
-    if (playerCeilingHit && out_dist_pos_y < posYTolerance && m_velocity[1] >= 0 && !isLiquid(terrain, &out_blockHit_ceiling)) {
-        return false;
+    if (hit.z) {
+        m_velocity[2] = 0.f;
+    }
+    // gravity pulls the player down every tick, the ground stops it every tick
+    grounded = hit.y && displacement.y < 0.f;
+    if (hit.y) {
+        if (grounded && m_velocity[1] <= -9.5f) {
+            hpChange(-30);
+        }
+        m_velocity[1] = 0.f;
     }
 
-    return true;
-
+    glm::vec3 feet = m_position + allowed;
+    blockTouchingPlayer = grounded
+            ? m_collider.getBlockAt(glm::ivec3(glm::floor(feet - glm::vec3(0.f, 0.5f, 0.f))))
+            : EMPTY;
+    return allowed;
 }
 
 /**
@@ -579,7 +444,7 @@ void Player::implementJumping(const Terrain &terrain, InputBundle &inputs) {
         return;
     }
 
-    if (flightMode || m_velocity[1] != 0.f) {
+    if (flightMode || !grounded) {
         return;
     }
     // empirical
@@ -673,23 +538,18 @@ void Player::destroyBlock(InputBundle &inputs, Terrain &terrain) {
         return;
     }
 
-    glm::ivec3 out_blockHit(0);
-    float out_dist_camera = 0.f;
-    glm::vec3 cameraRay(cameraBlockDist * m_camera.getForward());
+    RayHit cameraHit = terrain.raycast(m_camera.getCurrentPos(), m_camera.getForward(), cameraBlockDist);
 
-    bool cameraHit = gridMarch(m_camera.getCurrentPos(), cameraRay, terrain, &out_dist_camera, &out_blockHit);
-
-    if (!cameraHit) {
+    if (!cameraHit.hit) {
         return;
     }
 
     // add destroyed block to inventory
-    BlockType destroyedBlockType = terrain.getBlockAt(glm::vec3(out_blockHit));
-    destroyedBlockType = Block::getDestroyedBlockType(destroyedBlockType);
+    BlockType destroyedBlockType = Block::getDestroyedBlockType(cameraHit.type);
     inventory.storeBlock(destroyedBlockType);
 
     // remove hit block
-    terrain.placeBlockAt(out_blockHit[0], out_blockHit[1], out_blockHit[2], EMPTY);
+    terrain.placeBlockAt(cameraHit.block.x, cameraHit.block.y, cameraHit.block.z, EMPTY);
 
     // reset the buffer time
     destroyBufferTime = 0.f;
@@ -714,13 +574,18 @@ void Player::placeBlock(InputBundle &inputs, Terrain &terrain) {
         return;
     }
 
-    glm::ivec3 out_blockHit(0);
-    glm::ivec3 out_blockHitPrev(0);
-    glm::vec3 cameraRay(cameraBlockDist * m_camera.getForward());
+    RayHit cameraHit = terrain.raycast(m_camera.getCurrentPos(), m_camera.getForward(), cameraBlockDist);
 
-    bool newBlockHit = gridMarchPrevBlock(m_camera.getCurrentPos(), cameraRay, terrain, &out_blockHitPrev, &out_blockHit);
+    // the new block goes on the face the ray hit, if nothing is there (the camera may be in a block)
+    if (!cameraHit.hit || terrain.getBlockAt(cameraHit.prevBlock.x, cameraHit.prevBlock.y, cameraHit.prevBlock.z) != EMPTY) {
+        return;
+    }
 
-    if (!newBlockHit) {
+    // nor an entity (the player included)
+    glm::vec3 blockMin = glm::vec3(cameraHit.prevBlock);
+    std::vector<int> entities;
+    terrain.getEntityIndex().queryBox(AABB(blockMin, blockMin + glm::vec3(1.f)), &entities);
+    if (!entities.empty()) {
         return;
     }
 
@@ -730,7 +595,7 @@ void Player::placeBlock(InputBundle &inputs, Terrain &terrain) {
         return;
     }
 
-    terrain.placeBlockAt(out_blockHitPrev.x, out_blockHitPrev.y, out_blockHitPrev.z, placeBlockType);
+    terrain.placeBlockAt(cameraHit.prevBlock.x, cameraHit.prevBlock.y, cameraHit.prevBlock.z, placeBlockType);
 
     // reset the buffer time
     creationBufferTime = 0.f;
@@ -750,7 +615,7 @@ void Player::selectNextBlockOnHand(InputBundle &inputs) {
 /**
  * @brief Player::selectBlockOnHand
  *  change the selected block based on the input key (1-9)
- *  Also setup the selected frame in inventoryWidgetOnHand
+ *  (the selected frame is drawn in Player::drawHUD)
  * @param inputs : InputBundle, state of key pressed
  */
 void Player::selectBlockOnHand(InputBundle &inputs) {
@@ -766,9 +631,6 @@ void Player::selectBlockOnHand(InputBundle &inputs) {
     // setup the new selected pointer in inventory
     inventory.changeSelectedBlock(selectedBlockOnHandPtr);
 
-    // setup the new selected pointer in widget
-    inventoryWidgetOnHand->addItem(selectedBlockOnHandPtr);
-
     return;
 
 }
@@ -1058,6 +920,16 @@ glm::mat4 Player::getCameraViewProj() const
     return tpv ? m_tpv_camera.getViewProj() : m_camera.getViewProj();
 }
 
+/**
+ * @brief Player::getCameraPos
+ *  Return the eye position of the camera used by getCameraViewProj
+ * @return
+ */
+glm::vec3 Player::getCameraPos() const
+{
+    return tpv ? m_tpv_camera.mcr_position : m_camera.mcr_position;
+}
+
 void Player::setPos(glm::vec3 pos) {
     m_position = pos;
 }
@@ -6,6 +6,7 @@
 #include "widget.h"
 #include "blockinwidget.h"
 #include "text.h"
+#include "voxelcollider.h"
 #include <iostream>
 #include <set>
 
@@ -24,6 +25,8 @@ private:
     float cameraBlockDist; // max distance from the camera while using ray tracing
     bool flightMode; // determine the current moving mode
     bool containerMode; // determine if the player opens the container or not
+    bool grounded; // the last move was stopped by the ground
+    VoxelCollider m_collider;
     double destroyBufferTime; // compute the passing time (s) starting from last destroy
     double creationBufferTime; // compute the passing time (s) starting from last block creation
     double minWaitTime; // the minimum waiting time (s) to destroy the next block
@@ -39,8 +42,7 @@ private:
     BlockInWidget *inventoryItemInContainer;
     Text* textOnScreen;
 
-    bool checkXZCollision(int idx, const Terrain &terrain); // determine if current movement collide in X or Z axis (with idx 0 and 2)
-    bool checkYCollision(const Terrain &terrain); // determine if current movement collide in Y axis (specifically for the ground)
+    glm::vec3 collide(glm::vec3 displacement, const Terrain &terrain); // the part of the displacement the blocks allow
     void implementJumping(const Terrain &terrain, InputBundle &inputs);
     void destroyBlock(InputBundle &inputs, Terrain &terrain); // destroy the block within 3 unit from camera pos when left mouse button is pressed
     void placeBlock(InputBundle &inputs, Terrain &terrain);
@@ -72,6 +74,21 @@ private:
     // third person view
     bool tpv;
 
+    // the state the HUD drawables were last filled with by drawHUD()
+    struct HUDState
+    {
+        float hp;
+        int selectedBlock;
+        bool containerMode;
+        bool grabbing;
+        int inventoryVersion;
+
+        bool operator==(const HUDState &other) const;
+    };
+    HUDState lastHUDState;
+    bool hudValid;
+    HUDState getHUDState() const;
+
 public:
     // Readonly public reference to our camera
     // for easy access from MyGL
@@ -87,9 +104,12 @@ public:
 
     void setCameraWidthHeight(unsigned int w, unsigned int h);
     glm::mat4 getCameraViewProj() const;
+    glm::vec3 getCameraPos() const;
 
     void tick(float dT, InputBundle &input) override;
 
+    AABB getBoundingBox() const; // 0.8 x 1.9 x 0.8 around the feet
+
     // Player overrides all of Entity's movement
     // functions so that it transforms its camera
     // by the same amount as it transforms itself.
@@ -137,8 +157,6 @@ public:
     // check if the given position is liquid or not
     bool isLiquid(const Terrain &terrain, glm::ivec3* pos);
 
-    bool gridMarch(glm::vec3 rayOrigin, glm::vec3 rayDirection, const Terrain &terrain, float *out_dist, glm::ivec3 *out_blockHit);
-    bool gridMarchPrevBlock(glm::vec3 rayOrigin, glm::vec3 rayDirection, const Terrain &terrain, glm::ivec3 *out_prevBlock, glm::ivec3 *out_blockHit);
 
     void setBlocksHold();
 
@@ -180,6 +198,13 @@ public:
     // set and draw the state of the player (e.g. HP)
     void stateOperation(InputBundle &input);
 
+    // draw the HP, inventory and widgets (GUI thread only)
+    void drawHUD();
+    // true if the HP, inventory or widgets changed since the last drawHUD()
+    bool needsHUDRedraw() const;
+    // make needsHUDRedraw() true, e.g. after the screen size changed
+    void invalidateHUD();
+
     // switch between player's view third-person view
     void switchCameraView();
 
@@ -0,0 +1,422 @@
+#include "portalgraph.h"
+#include "terrain.h"
+#include "metrics.h"
+#include <algorithm>
+#include <limits>
+#include <map>
+#include <queue>
+
+// a route search gives up after expanding this many portals
+static const int MAX_EXPANSIONS = 4096;
+
+// the neighbors in the order of ChunkPortals::revisions
+static const glm::ivec2 NEIGHBOR_OFFSETS[4] = {glm::ivec2(16, 0), glm::ivec2(-16, 0),
+                                               glm::ivec2(0, 16), glm::ivec2(0, -16)};
+
+// the origin of the chunk holding world column (x, z)
+static glm::ivec2 getChunkOrigin(int x, int z)
+{
+    return glm::ivec2(x - (x & 15), z - (z & 15));
+}
+
+static int getLocalIndex(glm::ivec3 local)
+{
+    return local.x + 16 * (local.y + 256 * local.z);
+}
+
+// the steps between 2 cells are at least the largest of |dx| & |dz|
+static int estimateSteps(glm::ivec3 from, glm::ivec3 to)
+{
+    return glm::max(glm::abs(from.x - to.x), glm::abs(from.z - to.z));
+}
+
+PortalGraph::PortalGraph(const Terrain &terrain)
+    : mcr_terrain(terrain), m_chunks(), m_searchPortals(),
+      m_floodSteps(65536, 0), m_floodStamps(65536, 0), m_floodQueue(), m_floodGeneration(0),
+      m_lastExpansions(0)
+{}
+
+int PortalGraph::getLastExpansions() const
+{
+    return m_lastExpansions;
+}
+
+const NavGrid* PortalGraph::getNavGrid(glm::ivec2 origin) const
+{
+    const Chunk *chunk = mcr_terrain.findChunkAt(origin.x, origin.y);
+    return chunk != nullptr ? chunk->getNavGrid() : nullptr;
+}
+
+/**
+ * @brief PortalGraph::getChunkPortals
+ *  Rebuild the portals if a grid they depend on changed since
+ * @param origin
+ * @return
+ */
+const ChunkPortals* PortalGraph::getChunkPortals(glm::ivec2 origin)
+{
+    const NavGrid *grid = getNavGrid(origin);
+    if (grid == nullptr) {
+        return nullptr;
+    }
+    std::array<uint64_t, 5> revisions;
+    revisions[0] = grid->getRevision();
+    for (int d = 0; d < 4; d++) {
+        const NavGrid *neighbor = getNavGrid(origin + NEIGHBOR_OFFSETS[d]);
+        revisions[d + 1] = neighbor != nullptr ? neighbor->getRevision() : 0;
+    }
+
+    ChunkPortals &portals = m_chunks[toKey(origin.x, origin.y)];
+    if (portals.revisions != revisions) {
+        buildChunkPortals(*grid, origin, &portals);
+        portals.revisions = revisions;
+        static Counter &built = MetricsRegistry::global().counter("path.portal_chunks_built");
+        built.add();
+    }
+    return &portals;
+}
+
+/**
+ * @brief PortalGraph::getSearchPortals
+ *  The first call for a chunk in a search takes its portals (rebuilt if stale),
+ *  the next ones return the same, even if a grid they depend on changed since
+ * @param origin
+ * @return
+ */
+const ChunkPortals* PortalGraph::getSearchPortals(glm::ivec2 origin)
+{
+    int64_t key = toKey(origin.x, origin.y);
+    auto it = m_searchPortals.find(key);
+    if (it == m_searchPortals.end()) {
+        it = m_searchPortals.emplace(key, getChunkPortals(origin)).first;
+    }
+    return it->second;
+}
+
+/**
+ * @brief PortalGraph::findEntrances
+ *  Walk along the border: a pair of standable cells (at most 1 block apart on y)
+ *  continues the run of the previous position it lines up with, or starts a new run.
+ *  Always called with the same (low, high) order, so both chunks get the same portals.
+ * @param low : the chunk on the XNEG / ZNEG side
+ * @param high
+ * @param alongX : the chunks are neighbors on x
+ * @param out_entrances
+ */
+void PortalGraph::findEntrances(const NavGrid &low, const NavGrid &high, bool alongX,
+                                std::vector<std::pair<glm::ivec3, glm::ivec3>> *out_entrances)
+{
+    typedef std::vector<std::pair<glm::ivec3, glm::ivec3>> Run;
+    std::vector<Run> openRuns;
+    std::vector<Run> nextRuns;
+
+    // the middle of a run is its portal
+    auto closeRun = [out_entrances](const Run &run) {
+        out_entrances->push_back(run[run.size() / 2]);
+    };
+
+    for (int i = 0; i <= 16; i++) {
+        nextRuns.clear();
+        std::vector<bool> continued(openRuns.size(), false);
+        if (i < 16) {
+            const NavColumn &lowColumn = alongX ? low.getColumn(15, i) : low.getColumn(i, 15);
+            const NavColumn &highColumn = alongX ? high.getColumn(0, i) : high.getColumn(i, 0);
+            for (int y = 0; y < 256; y++) {
+                if (!lowColumn.isStandable(y)) {
+                    continue;
+                }
+                for (int highY = y - 1; highY <= y + 1; highY++) {
+                    if (!highColumn.isStandable(highY)) {
+                        continue;
+                    }
+                    glm::ivec3 lowCell = alongX ? glm::ivec3(15, y, i) : glm::ivec3(i, y, 15);
+                    glm::ivec3 highCell = alongX ? glm::ivec3(0, highY, i) : glm::ivec3(i, highY, 0);
+                    int r = 0;
+                    for (; r < static_cast<int>(openRuns.size()); r++) {
+                        if (continued[r]) {
+                            continue;
+                        }
+                        const std::pair<glm::ivec3, glm::ivec3> &last = openRuns[r].back();
+                        if (glm::abs(last.first.y - y) <= 1 && glm::abs(last.second.y - highY) <= 1) {
+                            break;
+                        }
+                    }
+                    if (r < static_cast<int>(openRuns.size())) {
+                        continued[r] = true;
+                        nextRuns.push_back(std::move(openRuns[r]));
+                    } else {
+                        nextRuns.push_back(Run());
+                    }
+                    nextRuns.back().push_back(std::make_pair(lowCell, highCell));
+                }
+            }
+        }
+        for (size_t r = 0; r < openRuns.size(); r++) {
+            if (!continued[r]) {
+                closeRun(openRuns[r]);
+            }
+        }
+        std::swap(openRuns, nextRuns);
+    }
+}
+
+/**
+ * @brief PortalGraph::buildChunkPortals
+ * @param grid
+ * @param origin
+ * @param out_portals
+ */
+void PortalGraph::buildChunkPortals(const NavGrid &grid, glm::ivec2 origin, ChunkPortals *out_portals)
+{
+    out_portals->portals.clear();
+    std::vector<std::pair<glm::ivec3, glm::ivec3>> entrances;
+    for (int d = 0; d < 4; d++) {
+        glm::ivec2 neighborOrigin = origin + NEIGHBOR_OFFSETS[d];
+        const NavGrid *neighbor = getNavGrid(neighborOrigin);
+        if (neighbor == nullptr) {
+            continue;
+        }
+        // XPOS & ZPOS: this chunk is the low side
+        bool isLow = d == 0 || d == 2;
+        bool alongX = d < 2;
+        entrances.clear();
+        findEntrances(isLow ? grid : *neighbor, isLow ? *neighbor : grid, alongX, &entrances);
+        for (const std::pair<glm::ivec3, glm::ivec3> &entrance : entrances) {
+            glm::ivec3 local = isLow ? entrance.first : entrance.second;
+            glm::ivec3 across = isLow ? entrance.second : entrance.first;
+            out_portals->portals.push_back(Portal(local + glm::ivec3(origin.x, 0, origin.y),
+                                                  across + glm::ivec3(neighborOrigin.x, 0, neighborOrigin.y)));
+        }
+    }
+
+    int n = static_cast<int>(out_portals->portals.size());
+    out_portals->steps.assign(n * n, -1);
+    for (int i = 0; i < n; i++) {
+        flood(grid, out_portals->portals[i].cell - glm::ivec3(origin.x, 0, origin.y), false);
+        for (int j = 0; j < n; j++) {
+            out_portals->steps[i * n + j] = getFloodSteps(out_portals->portals[j].cell
+                                                          - glm::ivec3(origin.x, 0, origin.y));
+        }
+    }
+}
+
+/**
+ * @brief PortalGraph::flood
+ *  Breadth first over the standable cells of the chunk, with the moves of a walk:
+ *  to one of the 8 neighbor columns, down by up to 2 blocks or up by 1 (a hop)
+ * @param grid
+ * @param local
+ * @param reverse
+ */
+void PortalGraph::flood(const NavGrid &grid, glm::ivec3 local, bool reverse)
+{
+    m_floodGeneration++;
+    m_floodQueue.clear();
+    int start = getLocalIndex(local);
+    m_floodStamps[start] = m_floodGeneration;
+    m_floodSteps[start] = 0;
+    m_floodQueue.push_back(start);
+
+    // the y of the next cell minus the y of the current one
+    int dyMin = reverse ? -1 : -2;
+    int dyMax = reverse ? 2 : 1;
+    for (size_t head = 0; head < m_floodQueue.size(); head++) {
+        int index = m_floodQueue[head];
+        int x = index % 16;
+        int y = (index / 16) % 256;
+        int z = index / (16 * 256);
+        int steps = m_floodSteps[index];
+        for (int dx = -1; dx <= 1; dx++) {
+            for (int dz = -1; dz <= 1; dz++) {
+                if ((dx == 0 && dz == 0) || x + dx < 0 || x + dx >= 16 || z + dz < 0 || z + dz >= 16) {
+                    continue;
+                }
+                const NavColumn &column = grid.getColumn(x + dx, z + dz);
+                for (int dy = dyMin; dy <= dyMax; dy++) {
+                    if (!column.isStandable(y + dy)) {
+                        continue;
+                    }
+                    int next = getLocalIndex(glm::ivec3(x + dx, y + dy, z + dz));
+                    if (m_floodStamps[next] == m_floodGeneration) {
+                        continue;
+                    }
+                    m_floodStamps[next] = m_floodGeneration;
+                    m_floodSteps[next] = steps + 1;
+                    m_floodQueue.push_back(next);
+                }
+            }
+        }
+    }
+}
+
+int PortalGraph::getFloodSteps(glm::ivec3 local) const
+{
+    int index = getLocalIndex(local);
+    return m_floodStamps[index] == m_floodGeneration ? m_floodSteps[index] : -1;
+}
+
+// a portal the route search reached, & how
+struct RouteNode
+{
+    glm::ivec2 chunk;
+    int portal;
+    glm::ivec3 cell;
+    // the steps from the start
+    int steps;
+    // index of the previous node, -1 if it's reached from the start
+    int parent;
+    bool closed;
+
+    RouteNode(glm::ivec2 chunk, int portal, glm::ivec3 cell, int steps, int parent)
+        : chunk(chunk), portal(portal), cell(cell), steps(steps), parent(parent), closed(false)
+    {}
+};
+
+/**
+ * @brief PortalGraph::findRoute
+ *  A* over the portals, from those the start can walk to in its chunk
+ *  to those that can walk to the goal in its chunk
+ * @param start
+ * @param goal
+ * @param out_route
+ * @return
+ */
+bool PortalGraph::findRoute(glm::ivec3 start, glm::ivec3 goal, std::vector<glm::ivec3> *out_route)
+{
+    out_route->clear();
+    m_lastExpansions = 0;
+    m_searchPortals.clear();
+
+    glm::ivec2 startChunk = getChunkOrigin(start.x, start.z);
+    glm::ivec2 goalChunk = getChunkOrigin(goal.x, goal.z);
+    const ChunkPortals *startPortals = getSearchPortals(startChunk);
+    if (startPortals == nullptr || start.y < 0 || start.y >= 256) {
+        return false;
+    }
+    const ChunkPortals *goalPortals = goal.y >= 0 && goal.y < 256 ? getSearchPortals(goalChunk) : nullptr;
+    glm::ivec3 startLocal = start - glm::ivec3(startChunk.x, 0, startChunk.y);
+    glm::ivec3 goalLocal = goal - glm::ivec3(goalChunk.x, 0, goalChunk.y);
+
+    // the steps from each portal of the goal's chunk to the goal (& from the start, if it's there)
+    int bestSteps = std::numeric_limits<int>::max();
+    std::vector<int> stepsToGoal;
+    if (goalPortals != nullptr) {
+        flood(*getNavGrid(goalChunk), goalLocal, true);
+        for (const Portal &portal : goalPortals->portals) {
+            stepsToGoal.push_back(getFloodSteps(portal.cell - glm::ivec3(goalChunk.x, 0, goalChunk.y)));
+        }
+        if (startChunk == goalChunk && getFloodSteps(startLocal) >= 0) {
+            bestSteps = getFloodSteps(startLocal);
+        }
+    }
+
+    std::vector<RouteNode> nodes;
+    std::map<std::pair<int64_t, int>, int> nodeIds;
+    // (steps + estimate, node), smallest first
+    std::priority_queue<std::pair<int, int>, std::vector<std::pair<int, int>>,
+                        std::greater<std::pair<int, int>>> open;
+    auto reach = [&](glm::ivec2 chunk, int portal, glm::ivec3 cell, int steps, int parent) {
+        std::pair<int64_t, int> key(toKey(chunk.x, chunk.y), portal);
+        auto it = nodeIds.find(key);
+        if (it == nodeIds.end()) {
+            it = nodeIds.emplace(key, static_cast<int>(nodes.size())).first;
+            nodes.push_back(RouteNode(chunk, portal, cell, steps, parent));
+        } else if (nodes[it->second].closed || nodes[it->second].steps <= steps) {
+            return;
+        } else {
+            nodes[it->second].steps = steps;
+            nodes[it->second].parent = parent;
+        }
+        open.push(std::make_pair(steps + estimateSteps(cell, goal), it->second));
+    };
+
+    flood(*getNavGrid(startChunk), startLocal, false);
+    for (int i = 0; i < static_cast<int>(startPortals->portals.size()); i++) {
+        const Portal &portal = startPortals->portals[i];
+        int steps = getFloodSteps(portal.cell - glm::ivec3(startChunk.x, 0, startChunk.y));
+        if (steps >= 0) {
+            reach(startChunk, i, portal.cell, steps, -1);
+        }
+    }
+
+    // the node the goal is reached from (-1: straight from the start)
+    int goalParent = -1;
+    // the closed node nearest to the goal, for a goal out of the loaded chunks
+    int nearestNode = -1;
+    while (!open.empty() && m_lastExpansions < MAX_EXPANSIONS) {
+        std::pair<int, int> top = open.top();
+        open.pop();
+        RouteNode &node = nodes[top.second];
+        if (node.closed || top.first != node.steps + estimateSteps(node.cell, goal)) {
+            // a stale entry
+            continue;
+        }
+        if (top.first >= bestSteps) {
+            break;
+        }
+        node.closed = true;
+        m_lastExpansions++;
+        int nodeId = top.second;
+        glm::ivec2 chunk = node.chunk;
+        int portal = node.portal;
+        int steps = node.steps;
+
+        if (nearestNode == -1 || estimateSteps(node.cell, goal) < estimateSteps(nodes[nearestNode].cell, goal)) {
+            nearestNode = nodeId;
+        }
+
+        // the same portals the node was reached with
+        const ChunkPortals *portals = getSearchPortals(chunk);
+        int n = static_cast<int>(portals->portals.size());
+        if (portal < 0 || portal >= n) {
+            continue;
+        }
+
+        // goalPortals is the goal chunk's snapshot, so stepsToGoal lines up with its portals
+        if (chunk == goalChunk && goalPortals != nullptr && !stepsToGoal.empty()
+                && stepsToGoal[portal] >= 0 && steps + stepsToGoal[portal] < bestSteps) {
+            bestSteps = steps + stepsToGoal[portal];
+            goalParent = nodeId;
+        }
+
+        for (int j = 0; j < n; j++) {
+            int intraSteps = portals->steps[portal * n + j];
+            if (j != portal && intraSteps >= 0) {
+                reach(chunk, j, portals->portals[j].cell, steps + intraSteps, nodeId);
+            }
+        }
+
+        // the twin portal across the border
+        const Portal &curr = portals->portals[portal];
+        glm::ivec2 neighborChunk = getChunkOrigin(curr.across.x, curr.across.z);
+        const ChunkPortals *neighborPortals = getSearchPortals(neighborChunk);
+        if (neighborPortals == nullptr) {
+            continue;
+        }
+        for (int j = 0; j < static_cast<int>(neighborPortals->portals.size()); j++) {
+            const Portal &twin = neighborPortals->portals[j];
+            if (twin.cell == curr.across && twin.across == curr.cell) {
+                reach(neighborChunk, j, twin.cell, steps + 1, nodeId);
+                break;
+            }
+        }
+    }
+
+    static Histogram &routeExpansions = MetricsRegistry::global().histogram("path.route_expansions");
+    routeExpansions.record(m_lastExpansions);
+
+    int last;
+    if (bestSteps != std::numeric_limits<int>::max()) {
+        last = goalParent;
+        out_route->push_back(goal);
+    } else if (goalPortals == nullptr && nearestNode != -1) {
+        last = nearestNode;
+    } else {
+        return false;
+    }
+    for (int node = last; node != -1; node = nodes[node].parent) {
+        out_route->push_back(nodes[node].cell);
+    }
+    std::reverse(out_route->begin(), out_route->end());
+    return true;
+}
@@ -0,0 +1,96 @@
+#pragma once
+#include "glm_includes.h"
+#include <array>
+#include <cstdint>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+class Terrain;
+class NavGrid;
+
+// A standable cell on the border of a chunk & the cell of the neighbor chunk it leads to
+struct Portal
+{
+    glm::ivec3 cell;
+    glm::ivec3 across;
+
+    Portal(glm::ivec3 cell, glm::ivec3 across)
+        : cell(cell), across(across)
+    {}
+};
+
+// The abstract graph of one chunk: its portals & the walking steps between them
+struct ChunkPortals
+{
+    // the revisions of the grids it was built from:
+    // the chunk's, then its XPOS, XNEG, ZPOS & ZNEG neighbors' (0: no grid)
+    std::array<uint64_t, 5> revisions;
+    std::vector<Portal> portals;
+    // steps[i * n + j]: from portal i to portal j inside the chunk, -1 if it can't be walked
+    std::vector<int> steps;
+
+    ChunkPortals()
+        : revisions(), portals(), steps()
+    {
+        revisions.fill(0);
+    }
+};
+
+// Long-range planning for the PathFinder (hierarchical A* over chunk portals).
+// Each border between 2 chunks is cut into entrances (runs of standable cells facing
+// each other) & each entrance gets a portal, its middle cell, on both sides.
+// The abstract graph links the portals of a chunk by their walking distance,
+// from a flood fill of its NavGrid, & each portal to its twin across the border.
+// A chunk's portals are built the first time a route crosses it & rebuilt
+// when its grid or a neighbor's changes (a block edit, a new mesh).
+// Note: only used with the world lock held (by the NPCs' ticks)
+class PortalGraph
+{
+private:
+    const Terrain &mcr_terrain;
+
+    // by chunk origin (toKey)
+    std::unordered_map<int64_t, ChunkPortals> m_chunks;
+    // the portals the running findRoute took of each chunk (nullptr: no grid),
+    // so a chunk isn't rebuilt under the search when a worker hands a grid over
+    std::unordered_map<int64_t, const ChunkPortals*> m_searchPortals;
+
+    // the flood fill of one chunk (by local cell index), kept between floods
+    // a cell was reached by the last flood if its stamp is m_floodGeneration
+    std::vector<int> m_floodSteps;
+    std::vector<uint32_t> m_floodStamps;
+    std::vector<int> m_floodQueue;
+    uint32_t m_floodGeneration;
+
+    int m_lastExpansions;
+
+    const NavGrid* getNavGrid(glm::ivec2 origin) const;
+    // nullptr if the chunk has no grid
+    const ChunkPortals* getChunkPortals(glm::ivec2 origin);
+    // getChunkPortals, only once per chunk during a search
+    const ChunkPortals* getSearchPortals(glm::ivec2 origin);
+    void buildChunkPortals(const NavGrid &grid, glm::ivec2 origin, ChunkPortals *out_portals);
+
+    // the entrances of the border between the chunks low & high (on x or on z),
+    // as pairs of local cells (in low, in high)
+    static void findEntrances(const NavGrid &low, const NavGrid &high, bool alongX,
+                              std::vector<std::pair<glm::ivec3, glm::ivec3>> *out_entrances);
+
+    // the steps from the local cell to every cell of the chunk it can walk to
+    // (reverse: from every cell to the local cell)
+    void flood(const NavGrid &grid, glm::ivec3 local, bool reverse);
+    // -1 if the last flood didn't reach it
+    int getFloodSteps(glm::ivec3 local) const;
+
+public:
+    explicit PortalGraph(const Terrain &terrain);
+
+    // the cells to walk through from start to goal (both the blocks stood on), goal last.
+    // If the goal's chunk isn't loaded the route ends at the portal nearest to the goal.
+    // false if the goal can't be reached or there's no chunk grid to plan over
+    bool findRoute(glm::ivec3 start, glm::ivec3 goal, std::vector<glm::ivec3> *out_route);
+
+    // the abstract nodes the last findRoute expanded
+    int getLastExpansions() const;
+};
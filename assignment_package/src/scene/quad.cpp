@@ -18,14 +18,11 @@ void Quad::createVBOdata(){
     m_count = 6;
 
     generateIdx();
-    bindIdx();
-    mp_context->glBufferData(GL_ELEMENT_ARRAY_BUFFER, 6 * sizeof(GLuint), idx, GL_STATIC_DRAW);
+    bufferData(GL_ELEMENT_ARRAY_BUFFER, m_bufIdx, 6 * sizeof(GLuint), idx);
 
     generatePos();
-    bindPos();
-    mp_context->glBufferData(GL_ARRAY_BUFFER, 4 * sizeof(glm::vec4), vert_pos, GL_STATIC_DRAW);
+    bufferData(GL_ARRAY_BUFFER, m_bufPos, 4 * sizeof(glm::vec4), vert_pos);
 
     generateUV();
-    mp_context->glBindBuffer(GL_ARRAY_BUFFER, m_bufUV);
-    mp_context->glBufferData(GL_ARRAY_BUFFER, 4 * sizeof(glm::vec2), vert_UV, GL_STATIC_DRAW);
+    bufferData(GL_ARRAY_BUFFER, m_bufUV, 4 * sizeof(glm::vec2), vert_UV);
 }
@@ -0,0 +1,196 @@
+#include "terrain.h"
+#include <limits>
+
+// Terrain::raycast & Terrain::raycastBatch: one voxel traversal (Amanatides & Woo)
+// for block picking, NPC sensing & probes.
+// It steps from cell to cell without floor() or a hash lookup per step
+// (the chunk is looked up when the ray crosses into another column)
+// & crosses a run of empty sections, or the air above / below the world,
+// in one step.
+
+
+// the empty runs above & below the world end here
+static const int WORLD_FAR = 1 << 20;
+
+// x / 16 rounded down, also for negative x (arithmetic shift)
+static int floorDiv16(int x)
+{
+    return x >> 4;
+}
+
+// The chunk of the last column a ray was in; rays of a batch are usually near each other
+struct ChunkCache
+{
+    glm::ivec2 column;
+    const Chunk *chunk;
+    bool valid;
+
+    ChunkCache()
+        : column(0), chunk(nullptr), valid(false)
+    {}
+
+    const Chunk* get(const Terrain &terrain, int x, int z)
+    {
+        glm::ivec2 c(floorDiv16(x), floorDiv16(z));
+        if (!valid || c != column) {
+            column = c;
+            chunk = terrain.findChunkAt(16 * c.x, 16 * c.y);
+            valid = true;
+        }
+        return chunk;
+    }
+};
+
+/**
+ * @brief march
+ *  The cell the ray starts in is not tested (a camera is never meant to hit the block it's in)
+ * @param terrain
+ * @param origin
+ * @param direction
+ * @param maxDist
+ * @param cache
+ * @return
+ */
+static RayHit march(const Terrain &terrain, glm::vec3 origin, glm::vec3 direction, float maxDist,
+                    ChunkCache &cache)
+{
+    RayHit result;
+    result.dist = maxDist;
+    float len = glm::length(direction);
+    if (len == 0.f || maxDist <= 0.f) {
+        return result;
+    }
+    glm::vec3 dir = direction / len;
+
+    // tMax[i]: the distance at which the ray crosses the next face along i,
+    // tDelta[i]: the distance between 2 faces along i
+    glm::ivec3 cell = glm::ivec3(glm::floor(origin));
+    glm::ivec3 step(0);
+    glm::vec3 tMax(std::numeric_limits<float>::infinity());
+    glm::vec3 tDelta(std::numeric_limits<float>::infinity());
+    for (int i = 0; i < 3; i++) {
+        if (dir[i] > 0.f) {
+            step[i] = 1;
+            tMax[i] = (cell[i] + 1 - origin[i]) / dir[i];
+            tDelta[i] = 1.f / dir[i];
+        } else if (dir[i] < 0.f) {
+            step[i] = -1;
+            tMax[i] = (cell[i] - origin[i]) / dir[i];
+            tDelta[i] = -1.f / dir[i];
+        }
+    }
+
+    glm::ivec3 prev = cell;
+    float t = 0.f;
+    bool atOrigin = true;
+    while (true) {
+        if (!atOrigin) {
+            int axis = tMax.x < tMax.y ? (tMax.x < tMax.z ? 0 : 2) : (tMax.y < tMax.z ? 1 : 2);
+            t = tMax[axis];
+            if (t > maxDist) {
+                break;
+            }
+            prev = cell;
+            cell[axis] += step[axis];
+            tMax[axis] += tDelta[axis];
+        }
+        bool testCell = !atOrigin;
+        atOrigin = false;
+
+        const Chunk *chunk = cache.get(terrain, cell.x, cell.z);
+        if (chunk == nullptr) {
+            result.unloaded = true;
+            result.dist = t;
+            result.block = cell;
+            result.prevBlock = prev;
+            break;
+        }
+
+        // the run of empty sections around the cell, -1 / 16: below / above the world
+        int section = cell.y < 0 ? -1 : (cell.y >= 256 ? 16 : cell.y / 16);
+        if (section == -1 || section == 16 || chunk->isSectionEmpty(section)) {
+            int lo = section;
+            while (lo > 0 && chunk->isSectionEmpty(lo - 1)) {
+                lo--;
+            }
+            int hi = section;
+            while (hi < 15 && chunk->isSectionEmpty(hi + 1)) {
+                hi++;
+            }
+            glm::ivec2 origin2D = chunk->getOrigin();
+            glm::ivec3 boxLo(origin2D.x, lo <= 0 ? -WORLD_FAR : 16 * lo, origin2D.y);
+            glm::ivec3 boxHi(origin2D.x + 15, hi >= 15 ? WORLD_FAR : 16 * hi + 15, origin2D.y + 15);
+
+            // where the ray leaves the box
+            float tExit = std::numeric_limits<float>::infinity();
+            for (int i = 0; i < 3; i++) {
+                if (step[i] != 0) {
+                    float face = step[i] > 0 ? boxHi[i] + 1.f : static_cast<float>(boxLo[i]);
+                    tExit = glm::min(tExit, (face - origin[i]) / dir[i]);
+                }
+            }
+            if (tExit > maxDist) {
+                break;
+            }
+            // the last cell of the box along the ray: every face crossed before tExit,
+            // but never past the box (float error must not skip the cell after it)
+            for (int i = 0; i < 3; i++) {
+                if (step[i] == 0 || tMax[i] >= tExit) {
+                    continue;
+                }
+                int crossings = static_cast<int>((tExit - tMax[i]) / tDelta[i]) + 1;
+                int maxCrossings = step[i] > 0 ? boxHi[i] - cell[i] : cell[i] - boxLo[i];
+                crossings = glm::min(crossings, maxCrossings);
+                cell[i] += step[i] * crossings;
+                tMax[i] += tDelta[i] * crossings;
+            }
+            prev = cell;
+            continue;
+        }
+
+        if (testCell) {
+            glm::ivec2 origin2D = chunk->getOrigin();
+            BlockType type = chunk->getBlockAt(static_cast<unsigned int>(cell.x - origin2D.x),
+                                               static_cast<unsigned int>(cell.y),
+                                               static_cast<unsigned int>(cell.z - origin2D.y));
+            if (type != EMPTY) {
+                result.hit = true;
+                result.dist = t;
+                result.block = cell;
+                result.prevBlock = prev;
+                result.type = type;
+                break;
+            }
+        }
+    }
+    return result;
+}
+
+/**
+ * @brief Terrain::raycast
+ *  Note: the blocks lock must be held (as for getBlockAt)
+ * @param origin
+ * @param direction : needn't be normalized
+ * @param maxDist
+ * @return
+ */
+RayHit Terrain::raycast(glm::vec3 origin, glm::vec3 direction, float maxDist) const
+{
+    ChunkCache cache;
+    return march(*this, origin, direction, maxDist, cache);
+}
+
+/**
+ * @brief Terrain::raycastBatch
+ *  The rays share the chunk lookups, e.g. the probes around one NPC
+ * @param rays
+ * @param out_hits : one per ray, same order
+ */
+void Terrain::raycastBatch(const std::vector<Ray> &rays, std::vector<RayHit> *out_hits) const
+{
+    out_hits->resize(rays.size());
+    ChunkCache cache;
+    for (size_t i = 0; i < rays.size(); i++) {
+        (*out_hits)[i] = march(*this, rays[i].origin, rays[i].direction, rays[i].maxDist, cache);
+    }
+}
@@ -0,0 +1,36 @@
+#pragma once
+#include "glm_includes.h"
+#include "block.h"
+
+// A ray of Terrain::raycastBatch
+struct Ray
+{
+    glm::vec3 origin;
+    // needn't be normalized
+    glm::vec3 direction;
+    // the farthest distance searched
+    float maxDist;
+
+    Ray(glm::vec3 origin, glm::vec3 direction, float maxDist)
+        : origin(origin), direction(direction), maxDist(maxDist)
+    {}
+};
+
+// What Terrain::raycast found along a ray
+struct RayHit
+{
+    // a block other than EMPTY (liquids included) within maxDist
+    bool hit;
+    // the ray reached a column without a chunk first, block is its first cell
+    bool unloaded;
+    // from the origin to the face where the ray entered block, maxDist if nothing was found
+    float dist;
+    glm::ivec3 block;
+    // the cell the ray came from, where a block placed on the hit face goes
+    glm::ivec3 prevBlock;
+    BlockType type;
+
+    RayHit()
+        : hit(false), unloaded(false), dist(0.f), block(0), prevBlock(0), type(EMPTY)
+    {}
+};
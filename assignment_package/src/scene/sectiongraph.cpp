@@ -0,0 +1,230 @@
+#include "sectiongraph.h"
+#include <algorithm>
+
+
+// the step (x, y, z) of each Direction, in the order of the enum
+static const int DIRECTION_STEPS[6][3] = {
+    {1, 0, 0}, {-1, 0, 0}, {0, 1, 0}, {0, -1, 0}, {0, 0, 1}, {0, 0, -1}
+};
+
+// XPOS / XNEG, YPOS / YNEG & ZPOS / ZNEG are next to each other in the enum
+static Direction opposite(Direction d)
+{
+    return static_cast<Direction>(d ^ 1);
+}
+
+// no face is entered from when the search starts in a section
+static const uint8_t NO_FACE = 6;
+
+
+SectionConnectivity::SectionConnectivity()
+    : m_bits(0)
+{}
+
+/**
+ * @brief SectionConnectivity::pairBit
+ *  The bit of the unordered pair (a, b), a != b, in 0 - 14
+ */
+int SectionConnectivity::pairBit(Direction a, Direction b)
+{
+    int lo = std::min<int>(a, b);
+    int hi = std::max<int>(a, b);
+    // the pairs (0, 1) ... (0, 5), (1, 2) ... (1, 5), ..., (4, 5)
+    return lo * 5 - lo * (lo - 1) / 2 + (hi - lo - 1);
+}
+
+SectionConnectivity SectionConnectivity::all()
+{
+    SectionConnectivity c;
+    c.m_bits = (1 << 15) - 1;
+    return c;
+}
+
+/**
+ * @brief SectionConnectivity::compute
+ *  Flood fill every region of non-opaque blocks, and link all the faces
+ *  of the section that a region touches with each other.
+ * @param opaque : indexed by x + 16 * (y + 16 * z)
+ * @return
+ */
+SectionConnectivity SectionConnectivity::compute(const std::array<bool, CELL_COUNT> &opaque)
+{
+    SectionConnectivity c;
+
+    // most sections are either all stone or all air
+    int opaqueCount = static_cast<int>(std::count(opaque.begin(), opaque.end(), true));
+    if (opaqueCount == 0) {
+        return all();
+    }
+    if (opaqueCount == CELL_COUNT) {
+        return c;
+    }
+
+    std::array<bool, CELL_COUNT> visited = opaque;
+    std::vector<int> stack;
+    stack.reserve(CELL_COUNT);
+
+    for (int start = 0; start < CELL_COUNT; start++) {
+        if (visited[start]) {
+            continue;
+        }
+
+        // the faces touched by this region, one bit per Direction
+        int faces = 0;
+        visited[start] = true;
+        stack.push_back(start);
+        while (!stack.empty()) {
+            int cell = stack.back();
+            stack.pop_back();
+            int p[3] = {cell & 15, (cell >> 4) & 15, cell >> 8};
+
+            for (int d = 0; d < 6; d++) {
+                int n[3] = {p[0] + DIRECTION_STEPS[d][0], p[1] + DIRECTION_STEPS[d][1], p[2] + DIRECTION_STEPS[d][2]};
+                if (n[0] < 0 || n[0] > 15 || n[1] < 0 || n[1] > 15 || n[2] < 0 || n[2] > 15) {
+                    faces |= 1 << d;
+                    continue;
+                }
+                int next = n[0] + 16 * (n[1] + 16 * n[2]);
+                if (!visited[next]) {
+                    visited[next] = true;
+                    stack.push_back(next);
+                }
+            }
+        }
+
+        for (int a = 0; a < 6; a++) {
+            for (int b = a + 1; b < 6; b++) {
+                if ((faces & (1 << a)) && (faces & (1 << b))) {
+                    c.connect(static_cast<Direction>(a), static_cast<Direction>(b));
+                }
+            }
+        }
+    }
+    return c;
+}
+
+void SectionConnectivity::connect(Direction a, Direction b)
+{
+    if (a != b) {
+        m_bits |= 1 << pairBit(a, b);
+    }
+}
+
+bool SectionConnectivity::isConnected(Direction a, Direction b) const
+{
+    return a != b && (m_bits & (1 << pairBit(a, b))) != 0;
+}
+
+bool SectionConnectivity::operator==(const SectionConnectivity &other) const
+{
+    return m_bits == other.m_bits;
+}
+
+
+SectionVisibilityGraph::SectionVisibilityGraph()
+    : m_gridX(0), m_gridZ(0), m_connectivity(), m_inFrustum(), m_visible(),
+      m_entryFace(), m_walkedDirs(), m_queue(), m_visibleCount(0)
+{}
+
+int SectionVisibilityGraph::cellIndex(int cx, int cz, int section) const
+{
+    return (cx * m_gridZ + cz) * 16 + section;
+}
+
+void SectionVisibilityGraph::reset(int gridX, int gridZ)
+{
+    m_gridX = gridX;
+    m_gridZ = gridZ;
+    int cellCount = gridX * gridZ * 16;
+    m_connectivity.assign(cellCount, SectionConnectivity::all());
+    m_inFrustum.assign(cellCount, 1);
+    m_visible.assign(cellCount, 0);
+    m_entryFace.assign(cellCount, NO_FACE);
+    m_walkedDirs.assign(cellCount, 0);
+    m_visibleCount = 0;
+}
+
+void SectionVisibilityGraph::setSection(int cx, int cz, int section, SectionConnectivity connectivity, bool inFrustum)
+{
+    int i = cellIndex(cx, cz, section);
+    m_connectivity[i] = connectivity;
+    m_inFrustum[i] = inFrustum;
+}
+
+/**
+ * @brief SectionVisibilityGraph::search
+ *  Breadth-first search from the camera's section.
+ *  A section is left through face d only if
+ *  - it is the start section, or d is linked to the face it was entered from
+ *  - the search has not walked in the opposite direction of d yet (no going back)
+ *  - the next section is in the grid & in the frustum
+ * @param cx, cz : the chunk of the camera in the grid
+ * @param section : the section of the camera, clamped to 0 - 15
+ */
+void SectionVisibilityGraph::search(int cx, int cz, int section)
+{
+    std::fill(m_visible.begin(), m_visible.end(), 0);
+    std::fill(m_entryFace.begin(), m_entryFace.end(), NO_FACE);
+    std::fill(m_walkedDirs.begin(), m_walkedDirs.end(), 0);
+    m_visibleCount = 0;
+
+    if (cx < 0 || cx >= m_gridX || cz < 0 || cz >= m_gridZ) {
+        std::fill(m_visible.begin(), m_visible.end(), 1);
+        m_visibleCount = static_cast<int>(m_visible.size());
+        return;
+    }
+    section = std::max(0, std::min(15, section));
+
+    m_queue.clear();
+    int start = cellIndex(cx, cz, section);
+    m_visible[start] = 1;
+    m_visibleCount++;
+    m_queue.push_back(start);
+
+    // m_queue only grows, head walks through it
+    for (unsigned int head = 0; head < m_queue.size(); head++) {
+        int cell = m_queue[head];
+        int s = cell % 16;
+        int chunk = cell / 16;
+        int x = chunk / m_gridZ;
+        int z = chunk % m_gridZ;
+        uint8_t entry = m_entryFace[cell];
+
+        for (int d = 0; d < 6; d++) {
+            Direction dir = static_cast<Direction>(d);
+            if (m_walkedDirs[cell] & (1 << opposite(dir))) {
+                continue;
+            }
+            if (entry != NO_FACE && !m_connectivity[cell].isConnected(static_cast<Direction>(entry), dir)) {
+                continue;
+            }
+
+            int nx = x + DIRECTION_STEPS[d][0];
+            int ns = s + DIRECTION_STEPS[d][1];
+            int nz = z + DIRECTION_STEPS[d][2];
+            if (nx < 0 || nx >= m_gridX || nz < 0 || nz >= m_gridZ || ns < 0 || ns > 15) {
+                continue;
+            }
+            int next = cellIndex(nx, nz, ns);
+            if (m_visible[next] || !m_inFrustum[next]) {
+                continue;
+            }
+
+            m_visible[next] = 1;
+            m_visibleCount++;
+            m_entryFace[next] = opposite(dir);
+            m_walkedDirs[next] = m_walkedDirs[cell] | (1 << d);
+            m_queue.push_back(next);
+        }
+    }
+}
+
+bool SectionVisibilityGraph::isVisible(int cx, int cz, int section) const
+{
+    return m_visible[cellIndex(cx, cz, section)] != 0;
+}
+
+int SectionVisibilityGraph::getVisibleCount() const
+{
+    return m_visibleCount;
+}
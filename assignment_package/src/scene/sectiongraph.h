@@ -0,0 +1,67 @@
+#pragma once
+#include "block.h"
+#include <array>
+#include <cstdint>
+#include <vector>
+
+// Which pairs of the 6 faces of a 16 x 16 x 16 section are linked through
+// non-opaque blocks, one bit per unordered pair of Directions.
+// Computed when the chunk is meshed, used by SectionVisibilityGraph.
+class SectionConnectivity
+{
+private:
+    uint16_t m_bits;
+
+    static int pairBit(Direction a, Direction b);
+
+public:
+    // the number of blocks in a section, indexed by x + 16 * (y + 16 * z)
+    static const int CELL_COUNT = 4096;
+
+    // no face linked to another one
+    SectionConnectivity();
+    // every face linked to every other one
+    static SectionConnectivity all();
+    // flood fill the non-opaque blocks of a section & link the faces each region touches
+    static SectionConnectivity compute(const std::array<bool, CELL_COUNT> &opaque);
+
+    void connect(Direction a, Direction b);
+    bool isConnected(Direction a, Direction b) const;
+    bool operator==(const SectionConnectivity &other) const;
+};
+
+// The sections of a grid of chunks that can be seen from the camera's section.
+// A breadth-first search walks from section to section through linked faces,
+// only into sections in the frustum & never back towards the camera,
+// so the caves behind solid stone are not reached from the surface (and vice versa).
+// Pure CPU code with no GL, it only needs the connectivity of each section.
+class SectionVisibilityGraph
+{
+private:
+    int m_gridX, m_gridZ;
+    std::vector<SectionConnectivity> m_connectivity;
+    std::vector<uint8_t> m_inFrustum;
+    std::vector<uint8_t> m_visible;
+    // per visited section: the face it was entered from & the directions walked so far
+    std::vector<uint8_t> m_entryFace;
+    std::vector<uint8_t> m_walkedDirs;
+    std::vector<int> m_queue;
+    int m_visibleCount;
+
+    int cellIndex(int cx, int cz, int section) const;
+
+public:
+    SectionVisibilityGraph();
+
+    // gridX x gridZ chunks of 16 sections, every section open & in the frustum
+    // (the state of a chunk that is not loaded)
+    void reset(int gridX, int gridZ);
+    void setSection(int cx, int cz, int section, SectionConnectivity connectivity, bool inFrustum);
+
+    // find the visible sections starting from the camera's section,
+    // everything is visible if the start is outside the grid
+    void search(int cx, int cz, int section);
+
+    bool isVisible(int cx, int cz, int section) const;
+    int getVisibleCount() const;
+};
@@ -0,0 +1,39 @@
+#include "seededrandom.h"
+#include <cstdint>
+
+
+// xorshift32, never 0
+static thread_local uint32_t t_state = 2463534242u;
+
+/**
+ * @brief SeededRandom::seed
+ *  Scramble s (so nearby seeds, e.g. chunk coordinates, give unrelated streams)
+ * @param s
+ */
+void SeededRandom::seed(unsigned int s)
+{
+    // the finalizer of MurmurHash3
+    uint32_t h = s;
+    h ^= h >> 16;
+    h *= 0x85ebca6bu;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35u;
+    h ^= h >> 16;
+    t_state = h != 0 ? h : 2463534242u;
+}
+
+unsigned int SeededRandom::next()
+{
+    uint32_t x = t_state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    t_state = x;
+    return x;
+}
+
+float SeededRandom::next01()
+{
+    // the top 24 bits, exact in a float
+    return static_cast<float>(next() >> 8) / static_cast<float>((1u << 24) - 1);
+}
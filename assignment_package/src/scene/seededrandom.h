@@ -0,0 +1,16 @@
+#pragma once
+
+// Random numbers for the world (terrain decoration, trees, NPC path choice).
+// Unlike rand(), whose single state is shared by every thread, each thread
+// has its own state, so a thread that seeds it gets the same numbers
+// whatever the other threads do. FillBlocksWorker seeds it per chunk,
+// the simulation thread once per session, which makes a replay deterministic.
+class SeededRandom
+{
+public:
+    static void seed(unsigned int s);
+
+    static unsigned int next();
+    // uniform in [0, 1]
+    static float next01();
+};
@@ -0,0 +1,373 @@
+#include "simulation.h"
+#include "tracer.h"
+#include "seededrandom.h"
+#include <QMutexLocker>
+#include <algorithm>
+
+
+Simulation::Simulation(Terrain &terrain, Player &player, Steve &playerModel,
+                       std::vector<uPtr<NPC>> &npcs, NPCStore &herd,
+                       const InputBundle *inputs, std::vector<PlayerCommand> *commands, QMutex *inputsLock,
+                       QMutex *worldLock, Profiler *profiler)
+    : mcr_terrain(terrain), mcr_player(player), mcr_playerModel(playerModel), mcr_npcs(npcs), mcr_herd(herd),
+      m_pathService(), m_npcUpdater(), m_playerEntity(-1), m_npcEntities(), m_herdEntities(),
+      mp_inputs(inputs), mp_commands(commands), mp_inputsLock(inputsLock), m_inputs(),
+      mp_worldLock(worldLock),
+      m_timeStep(1.f / 60.f), m_maxStepsPerFrame(5), m_tickCount(0),
+      m_clock(), m_snapshots(), m_currSnapshot(0), m_publishTime(0),
+      m_snapshotLock(), m_avgTickTime(0.f),
+      m_seed(1), mp_recorder(nullptr),
+      mp_profiler(profiler), m_profPlayer(-1), m_profNPCs(-1)
+{
+    m_clock.start();
+
+    // the scopes are added before the thread starts
+    if (mp_profiler != nullptr) {
+        m_profPlayer = mp_profiler->addScope("sim: player", false);
+        m_profNPCs = mp_profiler->addScope("sim: NPCs", false);
+    }
+
+    EntityIndex &entities = mcr_terrain.getEntityIndex();
+    m_playerEntity = entities.insert(&mcr_player, mcr_player.getBoundingBox());
+    for (const uPtr<NPC> &npc : mcr_npcs) {
+        npc->setPathService(&m_pathService);
+        m_npcEntities.push_back(entities.insert(npc.get(), npc->getBoundingBox()));
+    }
+    mcr_herd.setPathService(&m_pathService);
+    for (int i = 0; i < mcr_herd.size(); i++) {
+        m_herdEntities.push_back(entities.insert(nullptr, mcr_herd.getBoundingBox(i)));
+    }
+
+    // fill both buffers so the renderer always has two valid snapshots
+    WorldSnapshot snapshot = takeSnapshot();
+    publishSnapshot(snapshot);
+    publishSnapshot(snapshot);
+}
+
+Simulation::~Simulation()
+{
+    stop();
+    EntityIndex &entities = mcr_terrain.getEntityIndex();
+    entities.remove(m_playerEntity);
+    for (int handle : m_npcEntities) {
+        entities.remove(handle);
+    }
+    for (int handle : m_herdEntities) {
+        entities.remove(handle);
+    }
+}
+
+/**
+ * @brief Simulation::run
+ *  The fixed-timestep loop.
+ *  Accumulate the real time passed and consume it in steps of m_timeStep,
+ *  then sleep until the next step is due.
+ */
+void Simulation::run()
+{
+    Tracer::setThreadName("simulation");
+    SeededRandom::seed(m_seed);
+    qint64 prevTime = m_clock.nsecsElapsed();
+    double accumulator = 0.0;
+
+    while (!isInterruptionRequested())
+    {
+        qint64 currTime = m_clock.nsecsElapsed();
+        accumulator += (currTime - prevTime) / 1e9;
+        prevTime = currTime;
+
+        // after a very slow tick, drop the time instead of
+        // running more and more steps to catch up
+        accumulator = std::min(accumulator, static_cast<double>(m_timeStep) * m_maxStepsPerFrame);
+
+        while (accumulator >= m_timeStep)
+        {
+            QElapsedTimer tickTimer;
+            tickTimer.start();
+
+            step(m_timeStep);
+
+            float tickTime = tickTimer.nsecsElapsed() / 1e6f;
+            m_avgTickTime = 0.9f * m_avgTickTime + 0.1f * tickTime;
+            accumulator -= m_timeStep;
+        }
+
+        // sleep until the next step
+        unsigned long sleepTime = static_cast<unsigned long>((m_timeStep - accumulator) * 1e6);
+        QThread::usleep(sleepTime);
+    }
+}
+
+/**
+ * @brief Simulation::stop
+ *  Ask the loop to exit and wait for it
+ */
+void Simulation::stop()
+{
+    requestInterruption();
+    wait();
+    // the searches run in the NPCs' PathFinders
+    m_pathService.clear();
+}
+
+/**
+ * @brief Simulation::step
+ *  Take the GUI's inputs & queued commands (and record them), then run one step
+ * @param dT : float, the fixed time step (s)
+ */
+void Simulation::step(float dT)
+{
+    InputFrame frame;
+    frame.dT = dT;
+
+    // take a copy of the inputs,
+    // the GUI thread keeps writing into its own InputBundle
+    {
+        TraceSpan wait("wait inputsLock", "lock");
+        QMutexLocker locker(mp_inputsLock);
+        wait.end();
+        frame.inputs = *mp_inputs;
+        frame.commands.swap(*mp_commands);
+    }
+
+    if (mp_recorder != nullptr) {
+        mp_recorder->write(frame);
+    }
+    stepWith(frame);
+}
+
+/**
+ * @brief Simulation::stepWith
+ *  Advance the world by frame.dT with the inputs of frame and publish a new snapshot
+ * @param frame
+ */
+void Simulation::stepWith(const InputFrame &frame)
+{
+    TraceSpan span("sim step", "simulation");
+    m_inputs = frame.inputs;
+    float dT = frame.dT;
+
+    WorldSnapshot snapshot;
+    {
+        TraceSpan wait("wait worldLock", "lock");
+        QMutexLocker locker(mp_worldLock);
+        wait.end();
+
+        for (const PlayerCommand &command : frame.commands)
+        {
+            command.apply(mcr_player, m_inputs);
+        }
+
+        // Draw Golden Tree (s)
+        mcr_terrain.drawErdtree(glm::ivec2(32, 48));
+
+        {
+            ProfileScope scope(mp_profiler, m_profPlayer);
+            mcr_player.tick(dT, m_inputs);
+            mcr_terrain.getEntityIndex().update(m_playerEntity, mcr_player.getBoundingBox());
+            // steve model
+            mcr_playerModel.tick(dT, m_inputs);
+        }
+
+        // give the terrain around the player ~15 s to load before NPCs start moving
+        if (m_tickCount * m_timeStep > 15.f)
+        {
+            ProfileScope scope(mp_profiler, m_profNPCs);
+            // the paths searched since the last step, then the new requests
+            m_pathService.collect();
+            m_npcUpdater.tickAll(mcr_npcs, dT);
+            mcr_herd.tick(dT);
+            // the NPCs see where the others moved next step
+            EntityIndex &entities = mcr_terrain.getEntityIndex();
+            for (unsigned int i = 0; i < mcr_npcs.size(); i++)
+            {
+                entities.update(m_npcEntities[i], mcr_npcs[i]->getBoundingBox());
+            }
+            for (int i = 0; i < mcr_herd.size(); i++)
+            {
+                entities.update(m_herdEntities[i], mcr_herd.getBoundingBox(i));
+            }
+            m_pathService.dispatch();
+        }
+
+        snapshot = takeSnapshot();
+    }
+
+    publishSnapshot(snapshot);
+    m_tickCount++;
+}
+
+/**
+ * @brief Simulation::takeSnapshot
+ *  Copy the state needed by the renderer
+ *  Note: the world lock must be held (or the loop not started)
+ * @return snapshot
+ */
+WorldSnapshot Simulation::takeSnapshot()
+{
+    WorldSnapshot snapshot;
+
+    snapshot.viewProj = mcr_player.getCameraViewProj();
+    snapshot.cameraPos = mcr_player.getCameraPos();
+    snapshot.playerPos = mcr_player.mcr_position;
+    snapshot.playerUnderWater = mcr_player.isUnderWater(mcr_terrain, m_inputs);
+    snapshot.playerUnderLava = mcr_player.isUnderLava(mcr_terrain, m_inputs);
+    snapshot.playerWalking = mcr_player.isWalking();
+    snapshot.blockTouchingPlayer = mcr_player.blockTouchingPlayer;
+
+    snapshot.playerModel = mcr_playerModel.takeSnapshot();
+    snapshot.npcs.reserve(mcr_npcs.size());
+    for (const uPtr<NPC> &npc : mcr_npcs)
+    {
+        snapshot.npcs.push_back(npc->takeSnapshot());
+    }
+    snapshot.herd.reserve(mcr_herd.size());
+    snapshot.herdArchetypes.reserve(mcr_herd.size());
+    for (int i = 0; i < mcr_herd.size(); i++)
+    {
+        snapshot.herd.push_back(mcr_herd.takeSnapshot(i));
+        snapshot.herdArchetypes.push_back(mcr_herd.getArchetypeId(i));
+    }
+
+    return snapshot;
+}
+
+/**
+ * @brief Simulation::publishSnapshot
+ *  Swap the buffers: the newest snapshot becomes the previous one
+ * @param snapshot
+ */
+void Simulation::publishSnapshot(const WorldSnapshot &snapshot)
+{
+    QMutexLocker locker(&m_snapshotLock);
+    m_currSnapshot = 1 - m_currSnapshot;
+    m_snapshots[m_currSnapshot] = snapshot;
+    m_publishTime = m_clock.elapsed();
+}
+
+/**
+ * @brief interpolateNPCSnapshot
+ *  Blend the position & limb rotations of two NPC snapshots,
+ *  the orientation is taken from curr
+ * @param prev
+ * @param curr
+ * @param t : float, 0 gives prev and 1 gives curr
+ * @return
+ */
+static NPCSnapshot interpolateNPCSnapshot(const NPCSnapshot &prev, const NPCSnapshot &curr, float t)
+{
+    NPCSnapshot snapshot = curr;
+    snapshot.rootTransform[3] = glm::mix(prev.rootTransform[3], curr.rootTransform[3], t);
+
+    if (prev.rotDegs.size() == curr.rotDegs.size())
+    {
+        for (unsigned int i = 0; i < curr.rotDegs.size(); i++)
+        {
+            snapshot.rotDegs[i] = glm::mix(prev.rotDegs[i], curr.rotDegs[i], t);
+        }
+    }
+    return snapshot;
+}
+
+/**
+ * @brief Simulation::getInterpolatedSnapshot
+ *  Blend the last two snapshots.
+ *  The renderer is one tick behind the simulation,
+ *  which keeps the motion smooth when the frame rate and tick rate differ.
+ * @return snapshot
+ */
+WorldSnapshot Simulation::getInterpolatedSnapshot() const
+{
+    m_snapshotLock.lock();
+    WorldSnapshot prev = m_snapshots[1 - m_currSnapshot];
+    WorldSnapshot curr = m_snapshots[m_currSnapshot];
+    qint64 publishTime = m_publishTime;
+    m_snapshotLock.unlock();
+
+    float t = (m_clock.elapsed() - publishTime) / (m_timeStep * 1000.f);
+    t = glm::clamp(t, 0.f, 1.f);
+
+    WorldSnapshot snapshot = curr;
+
+    // lookAt(eye) == lookAt(currEye) * translate(currEye - eye)
+    glm::vec3 eye = glm::mix(prev.cameraPos, curr.cameraPos, t);
+    snapshot.cameraPos = eye;
+    snapshot.viewProj = curr.viewProj * glm::translate(glm::mat4(1.f), curr.cameraPos - eye);
+    snapshot.playerPos = glm::mix(prev.playerPos, curr.playerPos, t);
+
+    snapshot.playerModel = interpolateNPCSnapshot(prev.playerModel, curr.playerModel, t);
+    for (unsigned int i = 0; i < curr.npcs.size() && i < prev.npcs.size(); i++)
+    {
+        snapshot.npcs[i] = interpolateNPCSnapshot(prev.npcs[i], curr.npcs[i], t);
+    }
+    for (unsigned int i = 0; i < curr.herd.size() && i < prev.herd.size(); i++)
+    {
+        snapshot.herd[i] = interpolateNPCSnapshot(prev.herd[i], curr.herd[i], t);
+    }
+
+    return snapshot;
+}
+
+float Simulation::getAverageTickTime() const
+{
+    return m_avgTickTime;
+}
+
+void Simulation::setSeed(unsigned int seed)
+{
+    m_seed = seed;
+}
+
+unsigned int Simulation::getSeed() const
+{
+    return m_seed;
+}
+
+void Simulation::setRecorder(InputRecorder *recorder)
+{
+    mp_recorder = recorder;
+}
+
+float Simulation::getTimeStep() const
+{
+    return m_timeStep;
+}
+
+// FNV-1a over the bytes of n floats
+static void hashFloats(unsigned int &hash, const float *values, int n)
+{
+    const unsigned char *bytes = reinterpret_cast<const unsigned char*>(values);
+    for (unsigned int i = 0; i < n * sizeof(float); i++) {
+        hash = (hash ^ bytes[i]) * 16777619u;
+    }
+}
+
+/**
+ * @brief Simulation::getChecksum
+ *  The bits of the floats are hashed, so any difference in the physics or
+ *  the AI (even in the last bit) shows, as long as it moved something
+ * @return
+ */
+unsigned int Simulation::getChecksum() const
+{
+    WorldSnapshot snapshot;
+    {
+        QMutexLocker locker(&m_snapshotLock);
+        snapshot = m_snapshots[m_currSnapshot];
+    }
+
+    unsigned int hash = 2166136261u;
+    hashFloats(hash, glm::value_ptr(snapshot.viewProj), 16);
+    hashFloats(hash, glm::value_ptr(snapshot.cameraPos), 3);
+    hashFloats(hash, glm::value_ptr(snapshot.playerPos), 3);
+    hashFloats(hash, glm::value_ptr(snapshot.playerModel.rootTransform), 16);
+    for (const NPCSnapshot &npc : snapshot.npcs) {
+        hashFloats(hash, glm::value_ptr(npc.rootTransform), 16);
+        hashFloats(hash, npc.rotDegs.data(), static_cast<int>(npc.rotDegs.size()));
+    }
+    for (const NPCSnapshot &npc : snapshot.herd) {
+        hashFloats(hash, glm::value_ptr(npc.rootTransform), 16);
+        hashFloats(hash, npc.rotDegs.data(), static_cast<int>(npc.rotDegs.size()));
+    }
+    return hash;
+}
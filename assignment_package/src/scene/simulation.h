@@ -0,0 +1,146 @@
+#pragma once
+#include "glm_includes.h"
+#include "smartpointerhelp.h"
+#include "scene/terrain.h"
+#include "scene/player.h"
+#include "scene/npc.h"
+#include "scene/npcs/steve.h"
+#include "scene/pathservice.h"
+#include "scene/npcupdater.h"
+#include "scene/npcstore.h"
+#include "profiler.h"
+#include "scene/inputlog.h"
+#include <QThread>
+#include <QMutex>
+#include <QElapsedTimer>
+#include <array>
+#include <atomic>
+
+// Everything the renderer needs from one simulation tick.
+// The renderer never reads the live Player / NPCs, only these snapshots.
+struct WorldSnapshot
+{
+    // camera view-projection & the eye position it was built from
+    glm::mat4 viewProj;
+    glm::vec3 cameraPos;
+
+    glm::vec3 playerPos;
+    bool playerUnderWater;
+    bool playerUnderLava;
+    bool playerWalking;
+    BlockType blockTouchingPlayer;
+
+    NPCSnapshot playerModel;
+    std::vector<NPCSnapshot> npcs;
+    // the rows of the NPCStore & their archetype ids (drawn with the class of the archetype)
+    std::vector<NPCSnapshot> herd;
+    std::vector<int> herdArchetypes;
+
+    WorldSnapshot()
+        : viewProj(1.f), cameraPos(0.f), playerPos(0.f),
+          playerUnderWater(false), playerUnderLava(false), playerWalking(false),
+          blockTouchingPlayer(EMPTY), playerModel(), npcs(), herd(), herdArchetypes()
+    {}
+};
+
+// Runs the world simulation (player physics, NPC AI, block edits)
+// at a fixed time step on its own thread.
+// After every tick a snapshot is published; the last two snapshots
+// are kept so that the renderer can interpolate between them.
+class Simulation : public QThread
+{
+private:
+    Terrain &mcr_terrain;
+    Player &mcr_player;
+    Steve &mcr_playerModel;
+    std::vector<uPtr<NPC>> &mcr_npcs;
+    // the NPCs kept as component arrays, ticked after mcr_npcs
+    NPCStore &mcr_herd;
+    // the NPCs' path searches, a few per step
+    PathService m_pathService;
+    // ticks the NPCs on several threads
+    NPCUpdater m_npcUpdater;
+    // the handles of the player & the NPCs (same order as mcr_npcs) in the terrain's EntityIndex
+    int m_playerEntity;
+    std::vector<int> m_npcEntities;
+    // the same for the rows of mcr_herd (no Entity)
+    std::vector<int> m_herdEntities;
+
+    // key / mouse state & player commands written by the GUI thread
+    const InputBundle *mp_inputs;
+    std::vector<PlayerCommand> *mp_commands;
+    QMutex *mp_inputsLock;
+    // the simulation's own copy of the inputs
+    InputBundle m_inputs;
+
+    // held while the world (player, NPCs, blocks) is modified
+    QMutex *mp_worldLock;
+
+    // fixed simulation step (s)
+    const float m_timeStep;
+    // at most this many steps are run to catch up after a slow tick
+    const int m_maxStepsPerFrame;
+    long long m_tickCount;
+
+    QElapsedTimer m_clock;
+
+    // double-buffered snapshots, m_snapshots[m_currSnapshot] is the newest
+    std::array<WorldSnapshot, 2> m_snapshots;
+    int m_currSnapshot;
+    // the time (ms since m_clock started) the newest snapshot was published
+    qint64 m_publishTime;
+    mutable QMutex m_snapshotLock;
+
+    // smoothed duration of one tick (ms)
+    std::atomic<float> m_avgTickTime;
+
+    // the seed of SeededRandom on the simulation thread
+    unsigned int m_seed;
+    // writes the InputFrame of every step, may be null
+    InputRecorder *mp_recorder;
+
+    // times the player & NPC ticks, may be null
+    Profiler *mp_profiler;
+    int m_profPlayer;
+    int m_profNPCs;
+
+    // take the GUI's inputs & run one step
+    void step(float dT);
+    WorldSnapshot takeSnapshot();
+    void publishSnapshot(const WorldSnapshot &snapshot);
+
+public:
+    // Note: the scene graphs of the NPCs must be initialized,
+    // the NPCs & the rows of herd mustn't change until the simulation is destroyed
+    Simulation(Terrain &terrain, Player &player, Steve &playerModel,
+               std::vector<uPtr<NPC>> &npcs, NPCStore &herd,
+               const InputBundle *inputs, std::vector<PlayerCommand> *commands, QMutex *inputsLock,
+               QMutex *worldLock, Profiler *profiler = nullptr);
+    ~Simulation();
+
+    // the fixed-timestep loop
+    void run() override;
+
+    // ask the loop to exit & wait for it
+    void stop();
+
+    // blend the last two snapshots based on the time passed since the newest one
+    WorldSnapshot getInterpolatedSnapshot() const;
+
+    // smoothed duration of one tick (ms)
+    float getAverageTickTime() const;
+
+    // set before start()
+    void setSeed(unsigned int seed);
+    unsigned int getSeed() const;
+    void setRecorder(InputRecorder *recorder);
+    float getTimeStep() const;
+
+    // run one step with the given inputs on the calling thread,
+    // for replays (the loop must not be running)
+    void stepWith(const InputFrame &frame);
+
+    // a hash of the newest snapshot (camera, player, NPC & herd transforms),
+    // equal in two runs that simulated the same
+    unsigned int getChecksum() const;
+};
@@ -1,5 +1,9 @@
 #include "terrain.h"
 #include "noise.h"
+#include "occlusionculler.h"
+#include "tracer.h"
+#include "metrics.h"
+#include "seededrandom.h"
 #include <algorithm>
 #include <stdexcept>
 #include <iostream>
@@ -9,8 +13,19 @@ Terrain::Terrain(OpenGLContext *context)
     : m_chunks(),
       m_chunksWithBlocks(), m_chunksWithBlocksLock(),
       m_chunksWithVBOs(), m_chunksWithVBOsLock(),
+      m_editTimes(), m_meshingEditTimes(),
       m_generatedTerrain(), m_prevBorderZones(), m_initialTerrainLoaded(false),
-      mp_context(context)
+      mp_context(context),
+      m_drawChunkCoords(), m_sectionBoxes(), m_sectionVisible(),
+      m_drawnChunks(0), m_culledChunks(0), m_drawCalls(0),
+      m_sectionsInFrustum(0), m_occludedSections(0), m_unreachableSections(0), m_occlusionCandidates(),
+      m_visibilityGraph(), m_caveCulling(true), m_viewPos(0.f),
+      m_sortChunks(true), m_chunkOrder(), m_chunkOrderKeys(), m_chunkDistances(),
+      m_bufferPool(context), m_arena(context, &m_bufferPool), m_transparentArena(context, &m_bufferPool),
+      m_multiDraw(true),
+      m_drawIdxCounts(), m_drawIdxOffsets(), m_drawBaseVertices(),
+      m_lastBatchDrawType(TerrainDrawType::opaque),
+      m_portalGraph(*this), m_flowFields(*this), m_entities()
 {}
 
 Terrain::~Terrain() {}
@@ -251,6 +266,28 @@ const uPtr<Chunk>& Terrain::getChunkAt(int x, int z) const {
     return m_chunks.at(toKey(16 * xFloor, 16 * zFloor));
 }
 
+const Chunk* Terrain::findChunkAt(int x, int z) const {
+    int xFloor = static_cast<int>(glm::floor(x / 16.f));
+    int zFloor = static_cast<int>(glm::floor(z / 16.f));
+    auto it = m_chunks.find(toKey(16 * xFloor, 16 * zFloor));
+    return it != m_chunks.end() ? it->second.get() : nullptr;
+}
+
+PortalGraph& Terrain::getPortalGraph()
+{
+    return m_portalGraph;
+}
+
+FlowFieldCache& Terrain::getFlowFields()
+{
+    return m_flowFields;
+}
+
+EntityIndex& Terrain::getEntityIndex()
+{
+    return m_entities;
+}
+
 void Terrain::setBlockAt(int x, int y, int z, BlockType t)
 {
     if(hasChunkAt(x, z)) {
@@ -270,7 +307,7 @@ void Terrain::setBlockAt(int x, int y, int z, BlockType t)
 
 Chunk* Terrain::instantiateChunkAt(int x, int z) {
     // each instantiated chunk is a drawable item
-    uPtr<Chunk> chunk = mkU<Chunk>(this->mp_context);
+    uPtr<Chunk> chunk = mkU<Chunk>(this->mp_context, x, z);
     Chunk *cPtr = chunk.get();
     m_chunks[toKey(x, z)] = move(chunk);
     // Set the neighbor pointers of itself and its neighbors
@@ -299,8 +336,11 @@ Chunk* Terrain::instantiateChunkAt(int x, int z) {
  * @param playerZ
  * @param halfGridSize
  * @param shaderProgram
+ * @param drawType
+ * @param frustum : the camera frustum, nullptr to draw every chunk
  */
-void Terrain::draw(float playerX, float playerZ, int halfGridSize, ShaderProgram *shaderProgram, TerrainDrawType drawType)
+void Terrain::draw(float playerX, float playerZ, int halfGridSize, ShaderProgram *shaderProgram, TerrainDrawType drawType,
+                   const Frustum *frustum, const OcclusionCuller *occlusion)
 {
     // get the grid of minX, maxX, minZ, maxZ by (playerX, playerZ)
     // MS2: set to Zone's min max
@@ -315,7 +355,7 @@ void Terrain::draw(float playerX, float playerZ, int halfGridSize, ShaderProgram
                     maxZ);
 
     // use the original terrain::draw
-    draw(minX, maxX, minZ, maxZ, shaderProgram, drawType);
+    draw(minX, maxX, minZ, maxZ, shaderProgram, drawType, frustum, occlusion);
 
 }
 
@@ -325,11 +365,22 @@ void Terrain::draw(float playerX, float playerZ, int halfGridSize, ShaderProgram
 // Note: minX, maxX, minZ, maxZ should already be the origins of each chunk
 // USse Terrain::draw(float playerX, float playerZ, ShaderProgram*) in MyGL
 // to ensure the region around the player is drawn.
-void Terrain::draw(int minX, int maxX, int minZ, int maxZ, ShaderProgram *shaderProgram, TerrainDrawType drawType) {
+void Terrain::draw(int minX, int maxX, int minZ, int maxZ, ShaderProgram *shaderProgram, TerrainDrawType drawType,
+                   const Frustum *frustum, const OcclusionCuller *occlusion) {
+
+    m_drawnChunks = 0;
+    m_culledChunks = 0;
+    m_drawCalls = 0;
+    m_sectionsInFrustum = 0;
+    m_occludedSections = 0;
+    m_unreachableSections = 0;
+    // the occlusion queries are made for the sections of the opaque pass
+    if (drawType == TerrainDrawType::opaque) {
+        m_occlusionCandidates.clear();
+    }
 
-    // - Iterate through each chunk
-    // - Set the model matrix based on new X, Z
-    // - Let each chunk draw itself
+    // collect the chunks with vbo loaded
+    m_drawChunkCoords.clear();
     for (int x = minX; x < maxX; x += 16) {
         for (int z = minZ; z < maxZ; z += 16) {
 
@@ -339,45 +390,424 @@ void Terrain::draw(int minX, int maxX, int minZ, int maxZ, ShaderProgram *shader
                 continue;
             }
 
-            // get the pointer of the chunk at (x, z)
-            const uPtr<Chunk> &chunk = getChunkAt(x, z);
-
             // only draw the chunk with vbo loaded
             // skip if not loaded yet
-            if (!chunk->isVBOLoaded()) {
+            if (!getChunkAt(x, z)->isVBOLoaded()) {
                 continue;
             }
 
-            // set model matrix
-            glm::mat4 translation = glm::mat4(1.f);
-            translation[3] = glm::vec4(x, 0, z, 1);
+            m_drawChunkCoords.push_back(glm::ivec2(x, z));
+        }
+    }
+
+    // nearest chunk first, the transparent pass walks the order backwards
+    if (m_sortChunks) {
+        sortDrawChunks();
+    }
 
-            shaderProgram->setModelMatrix(translation);
-            // use drawInterleavedTerrainDrawType to draw the interleaved buffer data given specific terrain draw type
-            shaderProgram->drawInterleavedTerrainDrawType(*chunk, drawType);
+    // test the 16 sections of every chunk against the frustum in one batch
+    if (frustum != nullptr) {
+        m_sectionBoxes.clear();
+        for (const glm::ivec2 &coords : m_drawChunkCoords) {
+            for (int section = 0; section < 16; section++) {
+                m_sectionBoxes.push(glm::vec3(coords.x, section * 16, coords.y),
+                                    glm::vec3(coords.x + 16, section * 16 + 16, coords.y + 16));
+            }
         }
+        frustum->cullAABBs(m_sectionBoxes, &m_sectionVisible);
     }
+
+    // walk from the camera's section through the linked faces of the sections in the frustum,
+    // the sections it doesn't reach (e.g. the caves under the surface) are hidden
+    if (m_caveCulling) {
+        m_visibilityGraph.reset((maxX - minX + 15) / 16, (maxZ - minZ + 15) / 16);
+        for (unsigned int i = 0; i < m_drawChunkCoords.size(); i++) {
+            int cx = (m_drawChunkCoords[i].x - minX) / 16;
+            int cz = (m_drawChunkCoords[i].y - minZ) / 16;
+            const uPtr<Chunk> &chunk = getChunkAt(m_drawChunkCoords[i].x, m_drawChunkCoords[i].y);
+            for (int section = 0; section < 16; section++) {
+                m_visibilityGraph.setSection(cx, cz, section, chunk->getSectionConnectivity(section),
+                                             frustum == nullptr || m_sectionVisible[i * 16 + section]);
+            }
+        }
+        m_visibilityGraph.search(static_cast<int>(glm::floor((m_viewPos.x - minX) / 16.f)),
+                                 static_cast<int>(glm::floor((m_viewPos.z - minZ) / 16.f)),
+                                 static_cast<int>(glm::floor(m_viewPos.y / 16.f)));
+    }
+
+    // - Iterate through each chunk
+    // - Collect one index range per run of consecutive visible sections
+    // - Draw all the ranges together
+    // Note: the chunk vertices are in world space, no per-chunk model matrix is needed
+    ChunkArena &arena = getArena(drawType);
+    m_drawIdxCounts.clear();
+    m_drawIdxOffsets.clear();
+    m_drawBaseVertices.clear();
+
+    // opaque front-to-back for early depth rejection, transparent back-to-front for blending
+    bool backToFront = m_sortChunks && drawType == TerrainDrawType::transparent;
+    unsigned int chunkCount = static_cast<unsigned int>(m_drawChunkCoords.size());
+    for (unsigned int k = 0; k < chunkCount; k++) {
+
+        unsigned int i = backToFront ? chunkCount - 1 - k : k;
+        int x = m_drawChunkCoords[i].x;
+        int z = m_drawChunkCoords[i].y;
+        const uPtr<Chunk> &chunk = getChunkAt(x, z);
+
+        const ChunkArenaSlot &slot = chunk->getArenaSlot(drawType);
+        int chunkFirstIdx = arena.getFirstIndex(slot);
+        int baseVertex = arena.getBaseVertex(slot);
+
+        // the sections with faces that are in the frustum & not occluded,
+        // consecutive ones are drawn as one range (sections without faces don't break a run)
+        int runStart = -1;
+        int runEnd = -1;
+        bool drawn = false;
+        for (int section = 0; section <= 16; section++) {
+            bool visible = false;
+            if (section < 16 && chunk->getSectionOffset(section, drawType) != chunk->getSectionOffset(section + 1, drawType)) {
+                bool inFrustum = frustum == nullptr || m_sectionVisible[i * 16 + section];
+                if (inFrustum && m_caveCulling
+                        && !m_visibilityGraph.isVisible((x - minX) / 16, (z - minZ) / 16, section)) {
+                    m_sectionsInFrustum++;
+                    m_unreachableSections++;
+                } else if (inFrustum) {
+                    m_sectionsInFrustum++;
+                    if (drawType == TerrainDrawType::opaque) {
+                        m_occlusionCandidates.push_back(glm::ivec3(x, section, z));
+                    }
+                    if (occlusion != nullptr && occlusion->isOccluded(x, z, section)) {
+                        m_occludedSections++;
+                    } else {
+                        visible = true;
+                    }
+                }
+            } else if (section < 16) {
+                // empty section, keep the current run going
+                continue;
+            }
+
+            if (visible) {
+                if (runStart < 0) {
+                    runStart = section;
+                }
+                runEnd = section;
+                continue;
+            }
+
+            // close the current run
+            if (runStart >= 0) {
+                int firstIdx = chunkFirstIdx + chunk->getSectionOffset(runStart, drawType);
+                int idxCount = chunk->getSectionOffset(runEnd + 1, drawType) - chunk->getSectionOffset(runStart, drawType);
+                m_drawIdxCounts.push_back(idxCount);
+                m_drawIdxOffsets.push_back(reinterpret_cast<const void*>(firstIdx * sizeof(GLuint)));
+                m_drawBaseVertices.push_back(baseVertex);
+                runStart = -1;
+                drawn = true;
+            }
+        }
+
+        if (drawn) {
+            m_drawnChunks++;
+        } else {
+            m_culledChunks++;
+        }
+    }
+
+    m_lastBatchDrawType = drawType;
+    submitBatch(shaderProgram, drawType);
 }
 
+/**
+ * @brief Terrain::submitBatch
+ *  Draw the index ranges collected by draw()
+ * @param shaderProgram
+ * @param drawType
+ */
+void Terrain::submitBatch(ShaderProgram *shaderProgram, TerrainDrawType drawType)
+{
+    ChunkArena &arena = getArena(drawType);
+
+    if (m_drawIdxCounts.empty()) {
+        return;
+    }
+
+    if (m_multiDraw) {
+        shaderProgram->setModelMatrix(glm::mat4(1.f));
+        shaderProgram->drawChunkArena(arena, m_drawIdxCounts.data(), m_drawIdxOffsets.data(),
+                                      m_drawBaseVertices.data(), static_cast<int>(m_drawIdxCounts.size()));
+        m_drawCalls = 1;
+    } else {
+        // one range at a time, as before the arena (kept to compare the submit time)
+        for (unsigned int i = 0; i < m_drawIdxCounts.size(); i++) {
+            shaderProgram->setModelMatrix(glm::mat4(1.f));
+            shaderProgram->drawChunkArena(arena, &m_drawIdxCounts[i], &m_drawIdxOffsets[i],
+                                          &m_drawBaseVertices[i], 1);
+        }
+        m_drawCalls = static_cast<int>(m_drawIdxCounts.size());
+    }
+}
 
 /**
- * @brief Terrain::checkThreadResults
+ * @brief Terrain::redrawLastBatch
+ *  Draw the ranges of the last draw() call again with another shader,
+ *  e.g. the depth pre-pass of the OcclusionCuller.
+ *  Does nothing if the last draw() was of another TerrainDrawType.
+ * @param shaderProgram
+ * @param drawType
  */
-void Terrain::checkThreadResults()
+void Terrain::redrawLastBatch(ShaderProgram *shaderProgram, TerrainDrawType drawType)
+{
+    if (drawType != m_lastBatchDrawType) {
+        return;
+    }
+    int drawCalls = m_drawCalls;
+    submitBatch(shaderProgram, drawType);
+    // keep the stats of the draw() call
+    m_drawCalls = drawCalls;
+}
+
+const std::vector<glm::ivec3>& Terrain::getOcclusionCandidates() const
+{
+    return m_occlusionCandidates;
+}
+
+int Terrain::getSectionsInFrustumCount() const
+{
+    return m_sectionsInFrustum;
+}
+
+int Terrain::getOccludedSectionCount() const
+{
+    return m_occludedSections;
+}
+
+int Terrain::getUnreachableSectionCount() const
+{
+    return m_unreachableSections;
+}
+
+void Terrain::setCaveCulling(bool caveCulling)
+{
+    m_caveCulling = caveCulling;
+}
+
+bool Terrain::isCaveCulling() const
+{
+    return m_caveCulling;
+}
+
+void Terrain::setViewPosition(const glm::vec3 &viewPos)
+{
+    m_viewPos = viewPos;
+}
+
+ChunkArena& Terrain::getArena(TerrainDrawType drawType)
+{
+    if (drawType == TerrainDrawType::transparent) {
+        return m_transparentArena;
+    }
+    return m_arena;
+}
+
+int Terrain::getDrawCallCount() const
+{
+    return m_drawCalls;
+}
+
+/**
+ * @brief Terrain::sortDrawChunks
+ *  Order m_drawChunkCoords by the distance of the chunk centers to the camera.
+ *  The order of the last call is kept in m_chunkOrder, the chunks that left the
+ *  draw range are dropped & the new ones appended. The camera moves little between
+ *  frames, so the list is nearly sorted and an insertion sort is close to linear.
+ */
+void Terrain::sortDrawChunks()
+{
+    m_chunkOrderKeys.clear();
+    for (const glm::ivec2 &coords : m_drawChunkCoords) {
+        m_chunkOrderKeys.insert(toKey(coords.x, coords.y));
+    }
+
+    // drop the chunks no longer drawn, the ones left in m_chunkOrderKeys are new
+    unsigned int kept = 0;
+    for (unsigned int i = 0; i < m_chunkOrder.size(); i++) {
+        if (m_chunkOrderKeys.erase(toKey(m_chunkOrder[i].x, m_chunkOrder[i].y)) > 0) {
+            m_chunkOrder[kept++] = m_chunkOrder[i];
+        }
+    }
+    m_chunkOrder.resize(kept);
+    for (const glm::ivec2 &coords : m_drawChunkCoords) {
+        if (m_chunkOrderKeys.count(toKey(coords.x, coords.y)) > 0) {
+            m_chunkOrder.push_back(coords);
+        }
+    }
+
+    // squared xz distance from the camera to the chunk's center
+    m_chunkDistances.resize(m_chunkOrder.size());
+    for (unsigned int i = 0; i < m_chunkOrder.size(); i++) {
+        glm::vec2 d = glm::vec2(m_chunkOrder[i]) + glm::vec2(8.f) - glm::vec2(m_viewPos.x, m_viewPos.z);
+        m_chunkDistances[i] = glm::dot(d, d);
+    }
+
+    for (unsigned int i = 1; i < m_chunkOrder.size(); i++) {
+        glm::ivec2 coords = m_chunkOrder[i];
+        float dist = m_chunkDistances[i];
+        unsigned int j = i;
+        while (j > 0 && m_chunkDistances[j - 1] > dist) {
+            m_chunkOrder[j] = m_chunkOrder[j - 1];
+            m_chunkDistances[j] = m_chunkDistances[j - 1];
+            j--;
+        }
+        m_chunkOrder[j] = coords;
+        m_chunkDistances[j] = dist;
+    }
+
+    m_drawChunkCoords = m_chunkOrder;
+}
+
+void Terrain::setChunkSorting(bool sortChunks)
+{
+    m_sortChunks = sortChunks;
+}
+
+bool Terrain::isChunkSorting() const
+{
+    return m_sortChunks;
+}
+
+void Terrain::setMultiDraw(bool multiDraw)
+{
+    m_multiDraw = multiDraw;
+}
+
+bool Terrain::isMultiDraw() const
+{
+    return m_multiDraw;
+}
+
+int Terrain::getPooledBufferCount() const
+{
+    return m_bufferPool.getPooledCount();
+}
+
+int Terrain::getDrawnChunkCount() const
+{
+    return m_drawnChunks;
+}
+
+int Terrain::getCulledChunkCount() const
+{
+    return m_culledChunks;
+}
+
+
+/**
+ * @brief Terrain::spawnPendingVBOWorkers
+ *  Each worker meshes a copy of the blocks taken here,
+ *  so the simulation can keep editing them (world lock held)
+ */
+void Terrain::spawnPendingVBOWorkers()
 {
     // Send the result from FillBlocksWorkers to VBOWorkers
-    m_chunksWithBlocksLock.lock();
+    {
+        TraceSpan wait("wait chunksWithBlocksLock", "lock");
+        m_chunksWithBlocksLock.lock();
+    }
+    static Gauge &fillQueue = MetricsRegistry::global().gauge("terrain.fill_queue");
+    fillQueue.set(m_chunksWithBlocks.size());
+    // the edited chunks are meshed from now on
+    for (Chunk *chunk : m_chunksWithBlocks) {
+        auto edit = m_editTimes.find(chunk);
+        if (edit != m_editTimes.end()) {
+            m_meshingEditTimes[chunk] = edit->second;
+            m_editTimes.erase(edit);
+        }
+    }
     spawnVBOWorkers(m_chunksWithBlocks);
     m_chunksWithBlocks.clear();
     m_chunksWithBlocksLock.unlock();
+}
 
+/**
+ * @brief Terrain::checkThreadResults
+ */
+void Terrain::checkThreadResults()
+{
     // send to gpu
-    m_chunksWithVBOsLock.lock();
+    {
+        TraceSpan wait("wait chunksWithVBOsLock", "lock");
+        m_chunksWithVBOsLock.lock();
+    }
+    static Gauge &vboQueue = MetricsRegistry::global().gauge("terrain.vbo_queue");
+    static Counter &uploaded = MetricsRegistry::global().counter("terrain.chunks_uploaded");
+    static Histogram &editToVisible = MetricsRegistry::global().histogram("terrain.edit_to_visible_us");
+    vboQueue.set(m_chunksWithVBOs.size());
+    uploaded.add(m_chunksWithVBOs.size());
     for (ChunkVBOdata &vbo : m_chunksWithVBOs) {
-        vbo.mp_chunk->createVBOdata(vbo);
+        glm::ivec2 origin = vbo.mp_chunk->getOrigin();
+        TraceSpan span("upload", "terrain", origin.x, origin.y);
+        vbo.mp_chunk->createVBOdata(vbo, m_arena, m_transparentArena);
+
+        // drawn from the next frame on
+        auto edit = m_meshingEditTimes.find(vbo.mp_chunk);
+        if (edit != m_meshingEditTimes.end()) {
+            editToVisible.record(MetricsRegistry::now() - edit->second);
+            m_meshingEditTimes.erase(edit);
+        }
     }
     m_chunksWithVBOs.clear();
     m_chunksWithVBOsLock.unlock();
+
+    static Gauge &residentChunks = MetricsRegistry::global().gauge("terrain.resident_chunks");
+    static Gauge &residentBytes = MetricsRegistry::global().gauge("terrain.resident_bytes");
+    static Gauge &gpuBytes = MetricsRegistry::global().gauge("gpu.chunk_buffer_bytes");
+    residentChunks.set(m_chunks.size());
+    residentBytes.set(m_chunks.size() * sizeof(Chunk));
+    gpuBytes.set(m_arena.getCapacityBytes() + m_transparentArena.getCapacityBytes());
+}
+
+void Terrain::finishPendingWork()
+{
+    while (true) {
+        QThreadPool::globalInstance()->waitForDone();
+        bool pending = false;
+        {
+            QMutexLocker blocksLocker(&m_chunksWithBlocksLock);
+            QMutexLocker vbosLocker(&m_chunksWithVBOsLock);
+            pending = !m_chunksWithBlocks.empty() || !m_chunksWithVBOs.empty();
+        }
+        if (!pending) {
+            return;
+        }
+        // spawns the VBOWorkers of the filled chunks, waited for in the next loop
+        spawnPendingVBOWorkers();
+        checkThreadResults();
+    }
+}
+
+unsigned int Terrain::getBlocksChecksum() const
+{
+    std::vector<int64_t> keys;
+    keys.reserve(m_chunks.size());
+    for (const auto &p : m_chunks) {
+        keys.push_back(p.first);
+    }
+    std::sort(keys.begin(), keys.end());
+
+    // FNV-1a
+    unsigned int hash = 2166136261u;
+    for (int64_t key : keys) {
+        const uPtr<Chunk> &chunk = m_chunks.at(key);
+        for (int y = 0; y < 256; y++) {
+            for (int z = 0; z < 16; z++) {
+                for (int x = 0; x < 16; x++) {
+                    hash = (hash ^ static_cast<unsigned int>(chunk->getBlockAt(x, y, z))) * 16777619u;
+                }
+            }
+        }
+    }
+    return hash;
 }
 
 void Terrain::loadInitialTerrain(float playerX, float playerZ, int halfGridSize)
@@ -417,7 +847,7 @@ void Terrain::destroyZoneVBOs(int xCorner, int zCorner)
                 Chunk *chunk = getChunkAt(x, z).get();
                 // only deload the vbo when it is loaded
                 if (chunk->isVBOLoaded()) {
-                    chunk->destroyVBOdata();
+                    chunk->destroyVBOdata(m_arena, m_transparentArena);
                 }
             }
         }
@@ -538,7 +968,9 @@ void Terrain::instantiateChunkAndfillBlocks(int chunkX, int chunkZ)
 /**
  * @brief Terrain::putBlockAt
  *  Set the block at (x, y, z) as a block t,
- *  then destroy the chunk's VBO containing this block (to reload).
+ *  then queue the chunk containing this block for a new VBO.
+ *  Called from the simulation thread, so the VBO is rebuilt by a VBOWorker
+ *  (spawned by spawnPendingVBOWorkers) and sent to the gpu in checkThreadResults (GUI thread).
  * @param x
  * @param y
  * @param z
@@ -559,14 +991,13 @@ void Terrain::placeBlockAt(int x, int y, int z, BlockType t)
         return;
     }
 
-    // create the VBO again
+    // create the VBO again (the chunk already has its blocks)
     const uPtr<Chunk> &chunk = getChunkAt(chunkX, chunkZ);
-    ChunkVBOdata vbo = chunk->generateVBOdata();
-    // update the one in the map
-    vbo.mp_chunk->createVBOdata(vbo);
-    // m_chunkVBOs[chunk.get()] = vbo;
-    // chunk->createVBOdata(vbo);
-
+    m_chunksWithBlocksLock.lock();
+    m_chunksWithBlocks.insert(chunk.get());
+    // the edits placed before the mesh starts show up together, time from the first one
+    m_editTimes.emplace(chunk.get(), MetricsRegistry::now());
+    m_chunksWithBlocksLock.unlock();
 }
 
 /**
@@ -596,11 +1027,13 @@ void Terrain::spawnFillBlocksWorker(int xCorner, int zCorner)
 
 /**
  * @brief Terrain::spawnVBOWorker
+ *  The blocks are copied here, the world lock must be held
  * @param mp_chunk
  */
 void Terrain::spawnVBOWorker(Chunk* mp_chunk)
 {
     VBOWorker *worker = new VBOWorker(mp_chunk,
+                                      mp_chunk->copyBlocks(),
                                       &m_chunksWithVBOs,
                                       &m_chunksWithVBOsLock);
     QThreadPool::globalInstance()->start(worker);
@@ -692,7 +1125,7 @@ void Terrain::drawErdtree(const glm::ivec2 pos){
         tr->populateOps();
 
         // draw the tree trunk
-        int height = 45 + (int)(4.0f * (static_cast <float> (rand()) / static_cast <float> (RAND_MAX)));
+        int height = 45 + (int)(4.0f * SeededRandom::next01());
 
         int thickness = 4;
 
@@ -778,7 +1211,7 @@ void FillBlocksWorker::drawTree(Chunk* chunk, const glm::ivec2 pos){
         tr->populateOps();
 
         // draw the tree trunk
-        int height = 7 + (int)(4.0f * (static_cast <float> (rand()) / static_cast <float> (RAND_MAX)));
+        int height = 7 + (int)(4.0f * SeededRandom::next01());
 
         int thickness = 0;
 
@@ -998,6 +1431,8 @@ void addNPCJumpStages(Chunk *chunk, int chunkXCorner, int chunkZCorner)
  */
 void FillBlocksWorker::setBlocks(Chunk *chunk, int chunkXCorner, int chunkZCorner)
 {
+    // the trees of a chunk only depend on where it is
+    SeededRandom::seed(static_cast<unsigned int>(chunkXCorner) * 73856093u ^ static_cast<unsigned int>(chunkZCorner) * 19349663u);
 
     Noise terrainHeightMap;
 
@@ -1008,7 +1443,7 @@ void FillBlocksWorker::setBlocks(Chunk *chunk, int chunkXCorner, int chunkZCorne
             // Make Surface Terrain
             double y = terrainHeightMap.getHeight(chunkXCorner + x , chunkZCorner + z);
 
-            double r = ((double) rand() / (RAND_MAX));
+            double r = SeededRandom::next01();
             if (r > 0.5){
                 float treePosNoiseVal = terrainHeightMap.getTreeProbability(chunkXCorner + x , chunkZCorner + z);
                 if(treePosNoiseVal > 0.5 && treePosNoiseVal < 1.2){
@@ -1066,6 +1501,7 @@ void FillBlocksWorker::setBlocks(Chunk *chunk, int chunkXCorner, int chunkZCorne
  */
 void FillBlocksWorker::run()
 {
+    TraceSpan span("fill", "terrain", xCorner, zCorner);
     // TODO: iterate through each chunks in the zone
     std::unordered_set<Chunk*> chunksWithBlocks = std::unordered_set<Chunk*>();
     for (std::pair<int64_t, Chunk*> p : chunks) {
@@ -1079,7 +1515,13 @@ void FillBlocksWorker::run()
         }
     }
 
-    completedChunksLock->lock();
+    static Counter &generated = MetricsRegistry::global().counter("terrain.chunks_generated");
+    generated.add(chunks.size());
+
+    {
+        TraceSpan wait("wait chunksWithBlocksLock", "lock");
+        completedChunksLock->lock();
+    }
     for (Chunk *chunk : chunksWithBlocks) {
         completedChunks->insert(chunk);
     }
@@ -1090,13 +1532,16 @@ void FillBlocksWorker::run()
 /**
  * @brief VBOWorker::VBOWorker
  * @param chunkWithoutVBO
+ * @param blocks
  * @param completedChunkVBOs
  * @param completedChunkVBOsLock
  */
 VBOWorker::VBOWorker(Chunk *chunkWithoutVBO,
+                     uPtr<ChunkBlocks> blocks,
                      std::vector<ChunkVBOdata> *completedChunkVBOs,
                      QMutex *completedChunkVBOsLock)
     : chunkWithoutVBO(chunkWithoutVBO),
+      blocks(std::move(blocks)),
       completedChunkVBOs(completedChunkVBOs),
       completedChunkVBOsLock(completedChunkVBOsLock)
 {}
@@ -1107,9 +1552,19 @@ VBOWorker::VBOWorker(Chunk *chunkWithoutVBO,
  */
 void VBOWorker::run()
 {
+    glm::ivec2 origin = chunkWithoutVBO->getOrigin();
+    TraceSpan span("mesh", "terrain", origin.x, origin.y);
+
     // create vbo
-    ChunkVBOdata vbo = chunkWithoutVBO->generateVBOdata();
-    completedChunkVBOsLock->lock();
+    ChunkVBOdata vbo = chunkWithoutVBO->generateVBOdata(*blocks);
+    // and the navigation layer of the same blocks, read by the NPCs' path finders
+    chunkWithoutVBO->setNavGrid(Chunk::generateNavGrid(*blocks));
+    static Counter &meshed = MetricsRegistry::global().counter("terrain.chunks_meshed");
+    meshed.add();
+    {
+        TraceSpan wait("wait chunksWithVBOsLock", "lock");
+        completedChunkVBOsLock->lock();
+    }
     completedChunkVBOs->push_back(vbo);
     completedChunkVBOsLock->unlock();
 }
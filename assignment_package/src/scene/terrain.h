@@ -3,6 +3,12 @@
 #include "smartpointerhelp.h"
 #include "glm_includes.h"
 #include "chunk.h"
+#include "frustum.h"
+#include "sectiongraph.h"
+#include "raycast.h"
+#include "portalgraph.h"
+#include "flowfield.h"
+#include "entityindex.h"
 #include <array>
 #include <unordered_map>
 #include <unordered_set>
@@ -13,6 +19,8 @@
 #include <QThreadPool>
 #include "lsystems.h"
 
+class OcclusionCuller;
+
 
 //using namespace std;
 
@@ -44,6 +52,12 @@ private:
     // the lock for the read / write to the m_chunksWithVBOs
     QMutex m_chunksWithVBOsLock;
 
+    // when (MetricsRegistry::now) a block of the chunk was placed, for the edit-to-visible latency
+    // m_editTimes: edits not sent to a VBOWorker yet, guarded by m_chunksWithBlocksLock
+    // m_meshingEditTimes: edits being meshed, GUI thread only
+    std::unordered_map<Chunk*, long long> m_editTimes;
+    std::unordered_map<Chunk*, long long> m_meshingEditTimes;
+
     // private helpers for workers
     // Note: (x, z) is zone's (xCorner, zCorner)
     void spawnFillBlocksWorker(int x, int z);
@@ -72,6 +86,63 @@ private:
 
     OpenGLContext* mp_context;
 
+    // reused by draw() for frustum culling
+    // (x, z) of the loaded chunks in the draw range & the boxes of their 16 sections
+    std::vector<glm::ivec2> m_drawChunkCoords;
+    AABBList m_sectionBoxes;
+    std::vector<uint8_t> m_sectionVisible;
+
+    // stats of the last draw() call
+    int m_drawnChunks;
+    int m_culledChunks;
+    int m_drawCalls;
+    int m_sectionsInFrustum;
+    int m_occludedSections;
+    int m_unreachableSections;
+
+    // (x, section, z) of the sections with opaque faces in the frustum, from the last opaque draw()
+    std::vector<glm::ivec3> m_occlusionCandidates;
+
+    // the sections reachable from the camera through non-opaque blocks, see SectionVisibilityGraph
+    SectionVisibilityGraph m_visibilityGraph;
+    bool m_caveCulling;
+    glm::vec3 m_viewPos;
+
+    // draw the chunks sorted by distance to m_viewPos
+    bool m_sortChunks;
+    // the sorted order of the last draw(), re-sorted incrementally
+    std::vector<glm::ivec2> m_chunkOrder;
+    std::unordered_set<int64_t> m_chunkOrderKeys;
+    std::vector<float> m_chunkDistances;
+    void sortDrawChunks();
+
+    // recycles the arena buffers when they are packed or grown
+    BufferPool m_bufferPool;
+    // the meshes of all the loaded chunks, one arena per TerrainDrawType
+    ChunkArena m_arena;
+    ChunkArena m_transparentArena;
+    ChunkArena& getArena(TerrainDrawType drawType);
+
+    // submit all the visible chunks with one glMultiDrawElementsBaseVertex,
+    // or one draw call per chunk if false
+    bool m_multiDraw;
+
+    // reused by draw(), the arguments of glMultiDrawElementsBaseVertex
+    std::vector<GLsizei> m_drawIdxCounts;
+    std::vector<const void*> m_drawIdxOffsets;
+    std::vector<GLint> m_drawBaseVertices;
+    TerrainDrawType m_lastBatchDrawType;
+    // draw the ranges collected above
+    void submitBatch(ShaderProgram *shaderProgram, TerrainDrawType drawType);
+
+    // the long routes of the NPCs, over the chunks' navigation grids
+    PortalGraph m_portalGraph;
+    // & the flow fields of their common goals
+    FlowFieldCache m_flowFields;
+
+    // the player & NPCs by position (kept up to date by the Simulation)
+    EntityIndex m_entities;
+
 public:
     Terrain(OpenGLContext *context);
     ~Terrain();
@@ -89,6 +160,8 @@ public:
     // Assuming a Chunk exists at these coords,
     // return a const reference to it
     const uPtr<Chunk>& getChunkAt(int x, int z) const;
+    // hasChunkAt & getChunkAt in one lookup, nullptr if there's no Chunk
+    const Chunk* findChunkAt(int x, int z) const;
     // Given a world-space coordinate (which may have negative
     // values) return the block stored at that point in space.
     BlockType getBlockAt(int x, int y, int z) const;
@@ -101,15 +174,61 @@ public:
     // add additional helper to check whether the block exist or not
     bool hasBlockAt(glm::vec3 p) const;
 
+    // the first block other than EMPTY along the ray, within maxDist (see raycast.cpp)
+    RayHit raycast(glm::vec3 origin, glm::vec3 direction, float maxDist) const;
+    // raycast each ray, *out_hits holds one hit per ray
+    void raycastBatch(const std::vector<Ray> &rays, std::vector<RayHit> *out_hits) const;
+
+    // the chunk portals the NPCs plan long routes over (see PathFinder::searchRouteToward)
+    PortalGraph& getPortalGraph();
+    // the flow fields of the goals NPCs share (see NPC::followsFlowFields)
+    FlowFieldCache& getFlowFields();
+    // the player & NPCs by position, for proximity queries
+    EntityIndex& getEntityIndex();
+
     // Draws every Chunk that falls within the bounding box
     // described by the min and max coords, using the provided
     // ShaderProgram
-    void draw(int minX, int maxX, int minZ, int maxZ, ShaderProgram *shaderProgram, TerrainDrawType drawType);
+    // If a frustum is given, the 16 x 16 x 16 sections outside of it are skipped
+    // If an occlusion culler is given, the sections it found hidden in the last frame are skipped too
+    void draw(int minX, int maxX, int minZ, int maxZ, ShaderProgram *shaderProgram, TerrainDrawType drawType,
+              const Frustum *frustum = nullptr, const OcclusionCuller *occlusion = nullptr);
     // custom draw to
     // draw the chunks around the player at (playerX, playerZ)
     // with a defined halfGridSize
     // the side of the grid is (1 + 2 * halfGridSize) chunks
-    void draw(float playerX, float playerZ, int halfGridSize, ShaderProgram *shaderProgram, TerrainDrawType drawType);
+    void draw(float playerX, float playerZ, int halfGridSize, ShaderProgram *shaderProgram, TerrainDrawType drawType,
+              const Frustum *frustum = nullptr, const OcclusionCuller *occlusion = nullptr);
+    // draw the same index ranges as the last draw() call (if it was of drawType) with another shader
+    void redrawLastBatch(ShaderProgram *shaderProgram, TerrainDrawType drawType);
+    const std::vector<glm::ivec3>& getOcclusionCandidates() const;
+
+    // the number of chunks drawn / skipped by frustum culling in the last draw() call
+    int getDrawnChunkCount() const;
+    int getCulledChunkCount() const;
+    // the number of draw calls issued by the last draw() call
+    int getDrawCallCount() const;
+    // the number of non-empty sections in the frustum & how many of them were skipped as occluded
+    int getSectionsInFrustumCount() const;
+    int getOccludedSectionCount() const;
+    // the number of sections in the frustum skipped because the camera can't see into them
+    int getUnreachableSectionCount() const;
+
+    // skip the sections not reachable from the camera's section (on by default)
+    void setCaveCulling(bool caveCulling);
+    bool isCaveCulling() const;
+    // the camera position used by draw() for the reachability search & the chunk order
+    void setViewPosition(const glm::vec3 &viewPos);
+
+    // draw the opaque chunks front-to-back & the transparent ones back-to-front (on by default)
+    void setChunkSorting(bool sortChunks);
+    bool isChunkSorting() const;
+
+    void setMultiDraw(bool multiDraw);
+    bool isMultiDraw() const;
+
+    // the number of idle buffers kept by the arenas' BufferPool
+    int getPooledBufferCount() const;
 
     // Initializes the Chunks that store the 64 x 256 x 64 block scene you
     // see when the base code is run.
@@ -128,8 +247,17 @@ public:
     void loadInitialTerrain(float playerX, float playerZ, int halfGridSize);
 
     // check thread result
-    // send the result from FillBlocksWorkers to VBOWorkers
+    // send the result from FillBlocksWorkers & the edited chunks to VBOWorkers
+    // Note: the world lock must be held, the workers copy the blocks
+    void spawnPendingVBOWorkers();
+    // send the finished VBOs to the gpu (GUI thread)
     void checkThreadResults();
+    // wait for every FillBlocksWorker & VBOWorker, and send all their results,
+    // so a replay sees the same terrain whatever the thread timing (GUI thread)
+    void finishPendingWork();
+
+    // a hash of the blocks of every chunk, in the order of the chunk keys
+    unsigned int getBlocksChecksum() const;
 
 
 
@@ -177,6 +305,8 @@ class VBOWorker : public QRunnable
 {
 private:
     Chunk *chunkWithoutVBO;
+    // copied when the worker is spawned, the chunk itself is never read
+    uPtr<ChunkBlocks> blocks;
     std::vector<ChunkVBOdata> *completedChunkVBOs;
     QMutex *completedChunkVBOsLock;
 
@@ -184,6 +314,7 @@ public:
     // constructor
     // Note: completedChunksVBOs == m_chunksWithVBOs (in terrain);
     VBOWorker(Chunk *chunkWithoutVBO,
+              uPtr<ChunkBlocks> blocks,
               std::vector<ChunkVBOdata> *completedChunkVBOs,
               QMutex *completedChunkVBOsLock);
 
@@ -1,11 +1,17 @@
 #include "text.h"
 
 Text::Text(OpenGLContext *context, float width, float height)
-    : Drawable(context), width_height_len(glm::vec2(12.f/256.f, 16.f/256.f)), width_height_screen_ratio(width/height)
+    : Drawable(context), width_height_len(glm::vec2(12.f/256.f, 16.f/256.f)), width_height_screen_ratio(width/height),
+      TextCollection()
 {}
 
 Text::~Text() {};
 
+// the index of c in TextCollection
+static inline int glyphIndex(char c) {
+    return static_cast<unsigned char>(c) & 0x7F;
+}
+
 void Text::insertNewInfo(std::string currText, glm::vec2 currCoord) {
     if (currText == "textWidthHeight") {
         width_height_len = currCoord;
@@ -14,10 +20,11 @@ void Text::insertNewInfo(std::string currText, glm::vec2 currCoord) {
 
     // order of uv: bottom-left, bottom-right, top-right, top-left
     glm::vec2 bottom_left_pos(currCoord);
-    TextCollection[currText[0]][0] = bottom_left_pos;
-    TextCollection[currText[0]][1] = bottom_left_pos + glm::vec2(width_height_len[0], 0.f);
-    TextCollection[currText[0]][2] = bottom_left_pos + width_height_len;
-    TextCollection[currText[0]][3] = bottom_left_pos + glm::vec2(0, width_height_len[1]);
+    std::array<glm::vec2, 4> &uvs = TextCollection[glyphIndex(currText[0])];
+    uvs[0] = bottom_left_pos;
+    uvs[1] = bottom_left_pos + glm::vec2(width_height_len[0], 0.f);
+    uvs[2] = bottom_left_pos + width_height_len;
+    uvs[3] = bottom_left_pos + glm::vec2(0, width_height_len[1]);
     return;
 }
 
@@ -86,6 +93,7 @@ bool Text::addText(std::string text, glm::vec2 pos, float height) {
     int shiftX = 0;
 
     for (char c : text) {
+        const std::array<glm::vec2, 4> &uvs = TextCollection[glyphIndex(c)];
         std::array<TextData, 4> textData;
         std::array<glm::vec2, 4> positions;
         glm::vec2 top_left_pos(pos + glm::vec2(shiftX * width, 0));
@@ -95,7 +103,7 @@ bool Text::addText(std::string text, glm::vec2 pos, float height) {
         positions[3] = top_left_pos;
 
         for (int i=0; i<4; ++i) {
-            TextData charData(positions[i], TextCollection[c][i]);
+            TextData charData(positions[i], uvs[i]);
             textData[i] = charData;
         }
         texts.push_back(textData);
@@ -116,43 +124,41 @@ bool Text::addText(std::string text, glm::vec2 pos, float height) {
     return true;
 }
 
+/**
+ * @brief Text::tessellate
+ *  inherited from HUDElement
+ * @param verts
+ */
+void Text::tessellate(std::vector<HUDVertex> &verts) {
+    for (auto& text : texts) {
+        for (int i=0; i<4; ++i) {
+            verts.push_back(HUDVertex(text[i].pos, text[i].uv));
+        }
+    }
+
+    texts.clear();
+}
+
 void Text::createVBOdata() {
 
+    std::vector<HUDVertex> verts;
     std::vector<GLuint> indices;
-    std::vector<GLuint> faceIndices = {0, 1, 2, 0, 2, 3};
     std::vector<float> buffer_pos;
     std::vector<float> buffer_uv;
-    int nVert = 0;
-
-    for (auto& text : texts) {
-
-        for (int i=0; i<4; ++i) {
-            pushVec4ToBuffer(buffer_pos, text[i].pos);
-            pushVec2ToBuffer(buffer_uv, text[i].uv);
-        }
 
-        // add indices for each face (4 vertices)
-        for (int index : faceIndices) {
-            indices.push_back(nVert + index);
-        }
-        // move the offset for indices
-        nVert += 4;
-    }
+    tessellate(verts);
+    splitQuads(verts, indices, buffer_pos, buffer_uv);
 
     m_count = indices.size();
 
     generateIdx();
-    bindIdx();
-    mp_context->glBufferData(GL_ELEMENT_ARRAY_BUFFER, m_count * sizeof(GLuint), indices.data(), GL_STATIC_DRAW);
+    bufferData(GL_ELEMENT_ARRAY_BUFFER, m_bufIdx, m_count * sizeof(GLuint), indices.data());
 
     generatePos();
-    bindPos();
-    mp_context->glBufferData(GL_ARRAY_BUFFER, buffer_pos.size() * sizeof(float), buffer_pos.data(), GL_STATIC_DRAW);
+    bufferData(GL_ARRAY_BUFFER, m_bufPos, buffer_pos.size() * sizeof(float), buffer_pos.data());
 
     generateUV();
-    mp_context->glBindBuffer(GL_ARRAY_BUFFER, m_bufUV);
-    mp_context->glBufferData(GL_ARRAY_BUFFER, buffer_uv.size() * sizeof(float), buffer_uv.data(), GL_STATIC_DRAW);
+    bufferData(GL_ARRAY_BUFFER, m_bufUV, buffer_uv.size() * sizeof(float), buffer_uv.data());
 
-    texts.clear();
     return;
 }
@@ -1,6 +1,7 @@
 #pragma once
 #include "drawable.h"
-#include <unordered_map>
+#include "hudelement.h"
+#include <array>
 #include <QApplication>
 #include <QFile>
 #include <iostream>
@@ -22,7 +23,7 @@ struct TextData
 
 };
 
-class Text : public Drawable
+class Text : public Drawable, public HUDElement
 {
 protected:
     // for computing width pos based on the height
@@ -40,9 +41,9 @@ public:
     Text(OpenGLContext* context, float width, float height);
     ~Text();
 
-    // a collection of all the uvs of all types of texts
+    // a collection of all the uvs of all types of texts, indexed by the (ASCII) character
     // order of uv: bottom-left, bottom-right, top-right, top-left
-    std::unordered_map<char, std::array<glm::vec2, 4>> TextCollection;
+    std::array<std::array<glm::vec2, 4>, 128> TextCollection;
 
     // load uv coordinate of all texts from text file
     bool loadUVCoordFromText(const char* text_path);
@@ -54,6 +55,9 @@ public:
 
     void resizeDimension(float width, float height);
 
+    // the quads of all the added texts
+    virtual void tessellate(std::vector<HUDVertex> &verts);
+
     virtual void createVBOdata();
 };
 
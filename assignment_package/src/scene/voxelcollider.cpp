@@ -0,0 +1,147 @@
+#include "voxelcollider.h"
+#include "terrain.h"
+
+
+// a box touching a face (up to float error) doesn't overlap the block behind it
+static const float EPS = 1e-4f;
+// stored for the columns without a chunk, solid & never placed by the player
+static const BlockType UNLOADED = BEDROCK;
+
+VoxelCollider::VoxelCollider(bool liquidsSolid)
+    : m_min(0), m_size(0), m_blocks(), m_liquidsSolid(liquidsSolid)
+{}
+
+/**
+ * @brief VoxelCollider::gather
+ *  Copy the blocks overlapping the box, the box moved by disp & everything in between
+ *  (plus the blocks right behind its faces)
+ * @param terrain
+ * @param box
+ * @param disp
+ */
+void VoxelCollider::gather(const Terrain &terrain, const AABB &box, glm::vec3 disp)
+{
+    glm::ivec3 lo = glm::ivec3(glm::floor(glm::min(box.min, box.min + disp) - EPS));
+    glm::ivec3 hi = glm::ivec3(glm::floor(glm::max(box.max, box.max + disp) + EPS));
+    m_min = lo;
+    m_size = hi - lo + 1;
+    // reuses the capacity of the previous ticks
+    m_blocks.assign(m_size.x * m_size.y * m_size.z, EMPTY);
+
+    for (int z = lo.z; z <= hi.z; z++) {
+        for (int x = lo.x; x <= hi.x; x++) {
+            const Chunk *chunk = terrain.findChunkAt(x, z);
+            int localX = x - static_cast<int>(glm::floor(x / 16.f)) * 16;
+            int localZ = z - static_cast<int>(glm::floor(z / 16.f)) * 16;
+            for (int y = lo.y; y <= hi.y; y++) {
+                BlockType type = EMPTY;
+                if (chunk == nullptr || y < 0) {
+                    type = UNLOADED;
+                } else if (y < 256) {
+                    type = chunk->getBlockAt(static_cast<unsigned int>(localX), static_cast<unsigned int>(y),
+                                             static_cast<unsigned int>(localZ));
+                }
+                m_blocks[((y - lo.y) * m_size.z + (z - lo.z)) * m_size.x + (x - lo.x)] = type;
+            }
+        }
+    }
+}
+
+BlockType VoxelCollider::getBlockAt(glm::ivec3 p) const
+{
+    glm::ivec3 local = p - m_min;
+    if (local.x < 0 || local.y < 0 || local.z < 0
+            || local.x >= m_size.x || local.y >= m_size.y || local.z >= m_size.z) {
+        return EMPTY;
+    }
+    return m_blocks[(local.y * m_size.z + local.z) * m_size.x + local.x];
+}
+
+bool VoxelCollider::isSolid(int x, int y, int z) const
+{
+    BlockType type = getBlockAt(glm::ivec3(x, y, z));
+    return type != EMPTY && (m_liquidsSolid || !Block::isLiquid(type));
+}
+
+/**
+ * @brief VoxelCollider::sweepAxis
+ *  Visit the slabs of blocks the box would enter along axis, nearest first;
+ *  the first slab with a solid block under the box's face stops it at that face.
+ *  Blocks the box already overlaps are skipped, so a box that ended up
+ *  inside a block (e.g. a block placed on it) can still move out.
+ * @param box
+ * @param axis
+ * @param d
+ * @param out_hit
+ * @return
+ */
+float VoxelCollider::sweepAxis(const AABB &box, int axis, float d, bool *out_hit) const
+{
+    *out_hit = false;
+    if (d == 0.f) {
+        return 0.f;
+    }
+
+    // the blocks under the face, on the two other axes
+    int a1 = (axis + 1) % 3;
+    int a2 = (axis + 2) % 3;
+    int lo1 = static_cast<int>(glm::floor(box.min[a1] + EPS));
+    int hi1 = static_cast<int>(glm::floor(box.max[a1] - EPS));
+    int lo2 = static_cast<int>(glm::floor(box.min[a2] + EPS));
+    int hi2 = static_cast<int>(glm::floor(box.max[a2] - EPS));
+
+    int first, last, step;
+    if (d > 0.f) {
+        first = static_cast<int>(glm::ceil(box.max[axis] - EPS));
+        last = static_cast<int>(glm::ceil(box.max[axis] + d - EPS)) - 1;
+        step = 1;
+    } else {
+        first = static_cast<int>(glm::floor(box.min[axis] + EPS)) - 1;
+        last = static_cast<int>(glm::floor(box.min[axis] + d + EPS));
+        step = -1;
+    }
+
+    for (int slab = first; step * (last - slab) >= 0; slab += step) {
+        glm::ivec3 cell;
+        cell[axis] = slab;
+        for (cell[a1] = lo1; cell[a1] <= hi1; cell[a1]++) {
+            for (cell[a2] = lo2; cell[a2] <= hi2; cell[a2]++) {
+                if (!isSolid(cell.x, cell.y, cell.z)) {
+                    continue;
+                }
+                *out_hit = true;
+                // never pushed backwards, even if float error left the box a bit inside
+                if (d > 0.f) {
+                    return glm::max(static_cast<float>(slab) - box.max[axis], 0.f);
+                }
+                return glm::min(static_cast<float>(slab + 1) - box.min[axis], 0.f);
+            }
+        }
+    }
+    return d;
+}
+
+/**
+ * @brief VoxelCollider::move
+ *  y first, so a box on the ground slides over it on x & z
+ * @param box
+ * @param disp
+ * @param out_hit
+ * @return
+ */
+glm::vec3 VoxelCollider::move(const AABB &box, glm::vec3 disp, glm::bvec3 *out_hit) const
+{
+    static const int AXIS_ORDER[3] = {1, 0, 2};
+
+    AABB moved = box;
+    glm::vec3 allowed(0.f);
+    for (int axis : AXIS_ORDER) {
+        bool hit = false;
+        float d = sweepAxis(moved, axis, disp[axis], &hit);
+        moved.min[axis] += d;
+        moved.max[axis] += d;
+        allowed[axis] = d;
+        (*out_hit)[axis] = hit;
+    }
+    return allowed;
+}
@@ -0,0 +1,51 @@
+#pragma once
+#include "glm_includes.h"
+#include "block.h"
+#include <vector>
+
+class Terrain;
+
+// An axis-aligned box in world space
+struct AABB
+{
+    glm::vec3 min, max;
+
+    AABB(glm::vec3 min, glm::vec3 max)
+        : min(min), max(max)
+    {}
+};
+
+// Moves a box through the blocks of the terrain (swept AABB against voxels),
+// shared by the Player & every NPC.
+// gather() copies the blocks around one move into a dense local grid,
+// one chunk lookup per column, then move() resolves the displacement
+// one axis at a time (y, x, z) & stops each axis exactly at the first
+// block face it would cross.
+// Columns without a chunk are solid, nothing walks off the loaded world.
+class VoxelCollider
+{
+private:
+    // the blocks in [m_min, m_min + m_size), x fastest, then z, then y
+    glm::ivec3 m_min;
+    glm::ivec3 m_size;
+    std::vector<BlockType> m_blocks;
+    // NPCs stand on water & lava, the player swims through them
+    bool m_liquidsSolid;
+
+    bool isSolid(int x, int y, int z) const;
+    // how far the box can go along axis (at most d), *out_hit if a block stopped it
+    float sweepAxis(const AABB &box, int axis, float d, bool *out_hit) const;
+
+public:
+    explicit VoxelCollider(bool liquidsSolid);
+
+    // the blocks the box can touch while moving by disp
+    void gather(const Terrain &terrain, const AABB &box, glm::vec3 disp);
+
+    // the part of disp the box can move, (*out_hit)[i]: axis i was stopped
+    // Note: gather() must have been called with the same box & disp
+    glm::vec3 move(const AABB &box, glm::vec3 disp, glm::bvec3 *out_hit) const;
+
+    // EMPTY outside of the gathered blocks
+    BlockType getBlockAt(glm::ivec3 p) const;
+};
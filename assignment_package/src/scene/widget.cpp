@@ -246,28 +246,12 @@ void Widget::setWidgetInfo() {
 }
 
 /**
- * @brief Widget::createVBOdata
- *  inherited from Drawable
- *  store the data into vbo
+ * @brief Widget::tessellate
+ *  inherited from HUDElement
+ *  the quad of the widget, followed by the quads of the collected items
+ * @param verts
  */
-void Widget::createVBOdata(){
-
-    int loadWidgetCount = 1 + drawItems.size();
-
-    std::vector<GLuint> indices;
-    std::vector<GLuint> faceIndices = {0, 1, 2, 0, 2, 3};
-    std::vector<float> buffer_pos;
-    std::vector<float> buffer_uv;
-    int nVert = 0;
-
-    for (int i = 0; i < loadWidgetCount; ++i) {
-        // add indices for each face (4 vertices)
-        for (int index : faceIndices) {
-            indices.push_back(nVert + index);
-        }
-        // move the offset for indices
-        nVert += 4;
-    }
+void Widget::tessellate(std::vector<HUDVertex> &verts) {
 
     // position of widget
     glm::vec2 topLeftPos = widgetInfoMap["widgetScreen"].first[0];
@@ -275,43 +259,50 @@ void Widget::createVBOdata(){
     glm::vec2 topRightPos(bottomRightPos.x, topLeftPos.y);
     glm::vec2 bottomLeftPos(topLeftPos.x, bottomRightPos.y);
 
-    pushVec4ToBuffer(buffer_pos, glm::vec4(bottomLeftPos, 0.999999f, 1.f));
-    pushVec4ToBuffer(buffer_pos, glm::vec4(bottomRightPos, 0.999999f, 1.f));
-    pushVec4ToBuffer(buffer_pos, glm::vec4(topRightPos, 0.999999f, 1.f));
-    pushVec4ToBuffer(buffer_pos, glm::vec4(topLeftPos, 0.999999f, 1.f));
-
     // uv of widget
     glm::vec2 topLeftUV = widgetInfoMap["widgetUV"].first[0];
     glm::vec2 bottomRightUV = widgetInfoMap["widgetUV"].first[1];
     glm::vec2 topRightUV(bottomRightUV.x, topLeftUV.y);
     glm::vec2 bottomLeftUV(topLeftUV.x, bottomRightUV.y);
 
-    pushVec2ToBuffer(buffer_uv, bottomLeftUV);
-    pushVec2ToBuffer(buffer_uv, bottomRightUV);
-    pushVec2ToBuffer(buffer_uv, topRightUV);
-    pushVec2ToBuffer(buffer_uv, topLeftUV);
+    verts.push_back(HUDVertex(bottomLeftPos, bottomLeftUV));
+    verts.push_back(HUDVertex(bottomRightPos, bottomRightUV));
+    verts.push_back(HUDVertex(topRightPos, topRightUV));
+    verts.push_back(HUDVertex(topLeftPos, topLeftUV));
 
     for (auto& drawItem : drawItems) {
         for (int i=0; i<4; ++i) {
-           pushVec4ToBuffer(buffer_pos, glm::vec4(drawItem[i], 0.999999f, 1.f));
-           pushVec2ToBuffer(buffer_uv, drawItem[i+4]);
+            verts.push_back(HUDVertex(drawItem[i], drawItem[i+4]));
         }
     }
 
+    drawItems.clear();
+}
+
+/**
+ * @brief Widget::createVBOdata
+ *  inherited from Drawable
+ *  store the data into vbo
+ *  (the HUD draws the widgets from its own buffer, see HUD::update)
+ */
+void Widget::createVBOdata(){
+
+    std::vector<HUDVertex> verts;
+    std::vector<GLuint> indices;
+    std::vector<float> buffer_pos;
+    std::vector<float> buffer_uv;
+
+    tessellate(verts);
+    splitQuads(verts, indices, buffer_pos, buffer_uv);
+
     m_count = indices.size();
 
     generateIdx();
-    bindIdx();
-    mp_context->glBufferData(GL_ELEMENT_ARRAY_BUFFER, m_count * sizeof(GLuint), indices.data(), GL_STATIC_DRAW);
+    bufferData(GL_ELEMENT_ARRAY_BUFFER, m_bufIdx, m_count * sizeof(GLuint), indices.data());
 
     generatePos();
-    bindPos();
-    mp_context->glBufferData(GL_ARRAY_BUFFER, buffer_pos.size() * sizeof(float), buffer_pos.data(), GL_STATIC_DRAW);
+    bufferData(GL_ARRAY_BUFFER, m_bufPos, buffer_pos.size() * sizeof(float), buffer_pos.data());
 
     generateUV();
-    mp_context->glBindBuffer(GL_ARRAY_BUFFER, m_bufUV);
-    mp_context->glBufferData(GL_ARRAY_BUFFER, buffer_uv.size() * sizeof(float), buffer_uv.data(), GL_STATIC_DRAW);
-
-
-    drawItems.clear();
+    bufferData(GL_ARRAY_BUFFER, m_bufUV, buffer_uv.size() * sizeof(float), buffer_uv.data());
 }
@@ -1,6 +1,7 @@
 #pragma once
 #include <unordered_map>
 #include "drawable.h"
+#include "hudelement.h"
 #include "utils.h"
 #include <QOpenGLContext>
 #include <QOpenGLBuffer>
@@ -51,7 +52,7 @@ struct RecRegion
 
 };
 
-class Widget : public Drawable
+class Widget : public Drawable, public HUDElement
 {
 protected:
     // top-left and bottom-right uv coordinate of widget
@@ -113,6 +114,9 @@ public:
 
     void findOverallIdxFromScreenPos(float screenPosX, float screenPosY, int* overallIdx);
 
+    // the widget itself & the collected items
+    virtual void tessellate(std::vector<HUDVertex> &verts);
+
     virtual void createVBOdata();
 };
 
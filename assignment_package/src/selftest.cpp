@@ -0,0 +1,921 @@
+#include "selftest.h"
+#include "scene/sectiongraph.h"
+#include "scene/terrain.h"
+#include "scene/voxelcollider.h"
+#include "scene/pathfinder.h"
+#include "scene/flowfield.h"
+#include "scene/entityindex.h"
+#include "scene/seededrandom.h"
+#include <QFile>
+#include <QStringList>
+#include <QTextStream>
+#include <algorithm>
+#include <array>
+#include <map>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+
+// a section of opaque blocks, indexed as in SectionConnectivity::compute
+typedef std::array<bool, SectionConnectivity::CELL_COUNT> SectionBlocks;
+
+static SectionBlocks solidSection()
+{
+    SectionBlocks blocks;
+    blocks.fill(true);
+    return blocks;
+}
+
+// empty the blocks (x, y, z) to (x, y, z) + (length - 1) * step
+static void carve(SectionBlocks &blocks, glm::ivec3 start, glm::ivec3 step, int length)
+{
+    for (int i = 0; i < length; i++) {
+        glm::ivec3 p = start + i * step;
+        blocks[p.x + 16 * (p.y + 16 * p.z)] = false;
+    }
+}
+
+// the connectivity with exactly the pairs of faces given
+static SectionConnectivity linking(std::initializer_list<std::pair<Direction, Direction>> pairs)
+{
+    SectionConnectivity c;
+    for (const std::pair<Direction, Direction> &pair : pairs) {
+        c.connect(pair.first, pair.second);
+    }
+    return c;
+}
+
+// a box of the player's size (0.5 x 1.5 x 0.5) with its bottom at the center of (x, y, z)
+static AABB bodyAt(float x, float y, float z)
+{
+    return AABB(glm::vec3(x - 0.25f, y, z - 0.25f), glm::vec3(x + 0.25f, y + 1.5f, z + 0.25f));
+}
+
+// the path finder's world: 6 x 6 chunks [-48, 48) x [-48, 48) of rolling hills
+// with bumps & pits (jumps), water (not walkable) & tree trunks,
+// the chunk at (16, -16) is missing (nothing to stand on)
+static const int PATH_WORLD_MIN = -48;
+static const int PATH_WORLD_SIZE = 96;
+
+// a fixed pseudo-random number per column, integers only (the same world on every platform)
+static unsigned int columnHash(int x, int z)
+{
+    unsigned int h = static_cast<unsigned int>(x) * 73856093u ^ static_cast<unsigned int>(z) * 19349663u;
+    h ^= h >> 13;
+    h *= 0x5bd1e995u;
+    h ^= h >> 15;
+    return h;
+}
+
+// |v mod (2 * period) - period|, in [0, period]
+static int triangleWave(int v, int period)
+{
+    int m = ((v % (2 * period)) + 2 * period) % (2 * period);
+    return std::abs(m - period);
+}
+
+static void buildPathWorld(Terrain &terrain)
+{
+    std::vector<Chunk*> chunks;
+    for (int cx = PATH_WORLD_MIN; cx < PATH_WORLD_MIN + PATH_WORLD_SIZE; cx += 16) {
+        for (int cz = PATH_WORLD_MIN; cz < PATH_WORLD_MIN + PATH_WORLD_SIZE; cz += 16) {
+            if (cx == 16 && cz == -16) {
+                continue;
+            }
+            chunks.push_back(terrain.instantiateChunkAt(cx, cz));
+        }
+    }
+
+    for (Chunk *chunk : chunks) {
+        glm::ivec2 origin = chunk->getOrigin();
+        for (int x = origin.x; x < origin.x + 16; x++) {
+            for (int z = origin.y; z < origin.y + 16; z++) {
+                unsigned int h = columnHash(x, z);
+                int height = 130 + triangleWave(x, 12) / 3 + triangleWave(z, 9) / 2;
+                if (h % 7 == 0) {
+                    height += 1 + (h >> 8) % 3;
+                } else if (h % 11 == 0) {
+                    height -= 2 + (h >> 8) % 3;
+                }
+                BlockType top = height > 135 ? SNOW : (h >> 12) % 5 == 0 ? DIRT : GRASS;
+                if ((h >> 4) % 23 == 0) {
+                    top = WATER;
+                }
+
+                for (int y = 0; y < height; y++) {
+                    terrain.setBlockAt(x, y, z, STONE);
+                }
+                terrain.setBlockAt(x, height, z, top);
+                if ((h >> 16) % 37 == 0 && top != WATER) {
+                    terrain.setBlockAt(x, height + 1, z, WOOD);
+                    terrain.setBlockAt(x, height + 2, z, WOOD);
+                    terrain.setBlockAt(x, height + 3, z, LEAF);
+                }
+            }
+        }
+    }
+
+    // the navigation layers the VBOWorkers would build
+    for (Chunk *chunk : chunks) {
+        chunk->setNavGrid(chunk->generateNavGrid());
+    }
+}
+
+// the chunks [min, max) on x & z with a STONE floor at y = 128 (stood on from y = 129),
+// the blocks put on it are then given to the navigation layers by setNavGrids
+static std::vector<Chunk*> buildFloorWorld(Terrain &terrain, glm::ivec2 min, glm::ivec2 max)
+{
+    std::vector<Chunk*> chunks;
+    for (int cx = min.x; cx < max.x; cx += 16) {
+        for (int cz = min.y; cz < max.y; cz += 16) {
+            chunks.push_back(terrain.instantiateChunkAt(cx, cz));
+        }
+    }
+    for (int x = min.x; x < max.x; x++) {
+        for (int z = min.y; z < max.y; z++) {
+            terrain.setBlockAt(x, 128, z, STONE);
+        }
+    }
+    return chunks;
+}
+
+// the navigation layers the VBOWorkers would build
+static void setNavGrids(const std::vector<Chunk*> &chunks)
+{
+    for (Chunk *chunk : chunks) {
+        chunk->setNavGrid(chunk->generateNavGrid());
+    }
+}
+
+// one line of the path finder corpus
+struct PathQuery
+{
+    glm::vec3 start, target;
+    std::vector<NPCAction> plan;
+};
+
+// the queries of tests/pathfinder_corpus.txt & the radius they were searched with,
+// false if the file can't be read
+static bool readPathCorpus(int *out_radius, std::vector<PathQuery> *out_queries)
+{
+    QFile file(":/tests/pathfinder_corpus.txt");
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        return false;
+    }
+    QTextStream in(&file);
+    while (!in.atEnd()) {
+        QString line = in.readLine().trimmed();
+        if (line.isEmpty() || line.startsWith("#")) {
+            continue;
+        }
+        QStringList fields = line.split(' ', Qt::SkipEmptyParts);
+        if (fields[0] == "radius") {
+            *out_radius = fields[1].toInt();
+            continue;
+        }
+        // start & target, ":", then 4 numbers per step
+        if (fields.size() < 7 || fields[6] != ":" || (fields.size() - 7) % 4 != 0) {
+            return false;
+        }
+        PathQuery query;
+        query.start = glm::vec3(fields[0].toFloat(), fields[1].toFloat(), fields[2].toFloat());
+        query.target = glm::vec3(fields[3].toFloat(), fields[4].toFloat(), fields[5].toFloat());
+        for (int i = 7; i < fields.size(); i += 4) {
+            query.plan.push_back(NPCAction(glm::vec3(fields[i + 1].toFloat(), fields[i + 2].toFloat(), fields[i + 3].toFloat()),
+                                           static_cast<Action>(fields[i].toInt())));
+        }
+        out_queries->push_back(query);
+    }
+    return true;
+}
+
+
+SelfTest::SelfTest(OpenGLContext *context)
+    : mp_context(context), m_filter(), m_test(), m_failedChecks(0), m_passedTests(0), m_failedTests(0)
+{}
+
+/**
+ * @brief SelfTest::test
+ * @param name
+ * @param body : calls expect for every check
+ */
+void SelfTest::test(const std::string &name, const std::function<void()> &body)
+{
+    if (!m_filter.empty() && name.find(m_filter) == std::string::npos) {
+        return;
+    }
+
+    m_test = name;
+    m_failedChecks = 0;
+    body();
+    if (m_failedChecks == 0) {
+        m_passedTests++;
+        std::printf("PASS %s\n", name.c_str());
+    } else {
+        m_failedTests++;
+        std::printf("FAIL %s (%d checks)\n", name.c_str(), m_failedChecks);
+    }
+    std::fflush(stdout);
+}
+
+/**
+ * @brief SelfTest::selects
+ *  The tests sharing a world only build it if one of them runs
+ * @param names
+ * @return whether the filter lets one of the tests run
+ */
+bool SelfTest::selects(std::initializer_list<const char*> names) const
+{
+    if (m_filter.empty()) {
+        return true;
+    }
+    for (const char *name : names) {
+        if (std::string(name).find(m_filter) != std::string::npos) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void SelfTest::expect(bool condition, const std::string &what)
+{
+    if (!condition) {
+        m_failedChecks++;
+        std::printf("  %s: %s\n", m_test.c_str(), what.c_str());
+    }
+}
+
+/**
+ * @brief SelfTest::run
+ * @param filter : only run the tests whose name contains it
+ * @return the number of failed tests
+ */
+int SelfTest::run(const QString &filter)
+{
+    m_filter = filter.toStdString();
+    m_passedTests = 0;
+    m_failedTests = 0;
+
+    testSectionGraph();
+    testVoxelCollider();
+    testPathFinder();
+    testPortalGraph();
+    testFlowField();
+    testEntityIndex();
+
+    std::printf("%d passed, %d failed\n", m_passedTests, m_failedTests);
+    return m_failedTests;
+}
+
+/**
+ * @brief SelfTest::testSectionGraph
+ *  SectionConnectivity on generated sections, then the visibility search
+ *  in a strip of 3 chunks: stone up to section 11, air above, & a cave through section 4
+ */
+void SelfTest::testSectionGraph()
+{
+    test("sectiongraph.allStone", [this]() {
+        expect(SectionConnectivity::compute(solidSection()) == SectionConnectivity(), "faces linked through stone");
+    });
+
+    test("sectiongraph.allAir", [this]() {
+        SectionBlocks air;
+        air.fill(false);
+        expect(SectionConnectivity::compute(air) == SectionConnectivity::all(), "faces not linked through air");
+    });
+
+    // straight through on x, one block wide
+    SectionBlocks tunnel = solidSection();
+    carve(tunnel, glm::ivec3(0, 8, 8), glm::ivec3(1, 0, 0), 16);
+    test("sectiongraph.tunnel", [this, &tunnel]() {
+        SectionConnectivity c = SectionConnectivity::compute(tunnel);
+        expect(c == linking({{XPOS, XNEG}}), "not only XPOS - XNEG linked");
+        expect(c.isConnected(XNEG, XPOS), "the link isn't symmetric");
+    });
+
+    // in from XNEG, turns to ZPOS in the middle
+    SectionBlocks lCave = solidSection();
+    carve(lCave, glm::ivec3(0, 8, 8), glm::ivec3(1, 0, 0), 9);
+    carve(lCave, glm::ivec3(8, 8, 8), glm::ivec3(0, 0, 1), 8);
+    test("sectiongraph.lCave", [this, &lCave]() {
+        SectionConnectivity c = SectionConnectivity::compute(lCave);
+        expect(c == linking({{XNEG, ZPOS}}), "not only XNEG - ZPOS linked");
+        expect(!c.isConnected(XNEG, XPOS), "XNEG - XPOS linked past the turn");
+    });
+
+    // two caves that don't meet link their own faces only
+    SectionBlocks twoCaves = solidSection();
+    carve(twoCaves, glm::ivec3(0, 2, 2), glm::ivec3(1, 0, 0), 16);
+    carve(twoCaves, glm::ivec3(12, 0, 12), glm::ivec3(0, 1, 0), 16);
+    test("sectiongraph.twoCaves", [this, &twoCaves]() {
+        expect(SectionConnectivity::compute(twoCaves) == linking({{XPOS, XNEG}, {YPOS, YNEG}}),
+               "not only XPOS - XNEG & YPOS - YNEG linked");
+    });
+
+    // chunk 0: a tunnel on x in section 4
+    // chunk 1: the same tunnel (the camera is in it)
+    // chunk 2: the tunnel turns up in section 4, goes straight up section 5 & ends under stone
+    SectionBlocks upTurn = solidSection();
+    carve(upTurn, glm::ivec3(0, 8, 8), glm::ivec3(1, 0, 0), 9);
+    carve(upTurn, glm::ivec3(8, 8, 8), glm::ivec3(0, 1, 0), 8);
+    SectionBlocks shaft = solidSection();
+    carve(shaft, glm::ivec3(8, 0, 8), glm::ivec3(0, 1, 0), 16);
+
+    SectionVisibilityGraph graph;
+    graph.reset(3, 1);
+    for (int cx = 0; cx < 3; cx++) {
+        for (int s = 0; s < 16; s++) {
+            graph.setSection(cx, 0, s, s >= 12 ? SectionConnectivity::all() : SectionConnectivity(), true);
+        }
+    }
+    graph.setSection(0, 0, 4, SectionConnectivity::compute(tunnel), true);
+    graph.setSection(1, 0, 4, SectionConnectivity::compute(tunnel), true);
+    graph.setSection(2, 0, 4, SectionConnectivity::compute(upTurn), true);
+    graph.setSection(2, 0, 5, SectionConnectivity::compute(shaft), true);
+
+    test("sectiongraph.searchFromCave", [this, &graph]() {
+        graph.search(1, 0, 4);
+        // the cave, its end under stone & the stone right around the camera's section
+        std::array<glm::ivec2, 7> expected = {
+            glm::ivec2(1, 4), glm::ivec2(0, 4), glm::ivec2(2, 4), glm::ivec2(2, 5), glm::ivec2(2, 6),
+            glm::ivec2(1, 3), glm::ivec2(1, 5)
+        };
+        for (glm::ivec2 section : expected) {
+            expect(graph.isVisible(section.x, 0, section.y),
+                   "section " + std::to_string(section.y) + " of chunk " + std::to_string(section.x) + " not reached");
+        }
+        expect(graph.getVisibleCount() == static_cast<int>(expected.size()),
+               "reached " + std::to_string(graph.getVisibleCount()) + " sections, not " + std::to_string(expected.size()));
+        for (int cx = 0; cx < 3; cx++) {
+            expect(!graph.isVisible(cx, 0, 12), "the surface seen from the cave");
+        }
+    });
+
+    test("sectiongraph.searchFromSurface", [this, &graph]() {
+        graph.search(1, 0, 13);
+        // the air & the top of the stone under it, none of the cave
+        for (int cx = 0; cx < 3; cx++) {
+            for (int s = 11; s < 16; s++) {
+                expect(graph.isVisible(cx, 0, s),
+                       "section " + std::to_string(s) + " of chunk " + std::to_string(cx) + " not reached");
+            }
+            expect(!graph.isVisible(cx, 0, 4), "the cave seen from the surface");
+        }
+        expect(graph.getVisibleCount() == 15,
+               "reached " + std::to_string(graph.getVisibleCount()) + " sections, not 15");
+    });
+
+    test("sectiongraph.outsideGrid", [this, &graph]() {
+        graph.search(-1, 0, 4);
+        expect(graph.getVisibleCount() == 3 * 16, "not every section visible from outside the grid");
+    });
+
+    test("sectiongraph.frustum", [this, &graph, &upTurn]() {
+        // the cave out of the frustum past the camera's chunk
+        graph.setSection(2, 0, 4, SectionConnectivity::compute(upTurn), false);
+        graph.search(1, 0, 4);
+        expect(!graph.isVisible(2, 0, 4) && !graph.isVisible(2, 0, 5), "went through a section out of the frustum");
+        expect(graph.getVisibleCount() == 4,
+               "reached " + std::to_string(graph.getVisibleCount()) + " sections, not 4");
+        graph.setSection(2, 0, 4, SectionConnectivity::compute(upTurn), true);
+    });
+}
+
+/**
+ * @brief SelfTest::testVoxelCollider
+ *  Boxes moved through a few blocks placed by hand in the 2 x 2 chunks [0, 32) x [0, 32)
+ *  (nothing else loaded), every allowed displacement is exact in floats
+ */
+void SelfTest::testVoxelCollider()
+{
+    Terrain terrain(mp_context);
+    for (int x = 0; x < 32; x += 16) {
+        for (int z = 0; z < 32; z += 16) {
+            terrain.instantiateChunkAt(x, z);
+        }
+    }
+    // a wall on x, 2 blocks high
+    terrain.setBlockAt(4, 130, 2, STONE);
+    terrain.setBlockAt(4, 131, 2, STONE);
+    terrain.setBlockAt(0, 130, 2, STONE);
+    // a single block on the diagonal
+    terrain.setBlockAt(11, 130, 11, STONE);
+    // a pillar whose face is flush with the box
+    terrain.setBlockAt(19, 130, 4, STONE);
+    terrain.setBlockAt(19, 131, 4, STONE);
+    // a floor with its top at y = 130
+    for (int x = 18; x < 22; x++) {
+        for (int z = 18; z < 22; z++) {
+            terrain.setBlockAt(x, 129, z, STONE);
+        }
+    }
+    // 2 blocks around the box & a wall past them
+    terrain.setBlockAt(26, 130, 26, STONE);
+    terrain.setBlockAt(26, 131, 26, STONE);
+    terrain.setBlockAt(28, 130, 26, STONE);
+    // water to stand on
+    terrain.setBlockAt(4, 129, 26, WATER);
+
+    // expect box to move by exactly allowed & be stopped on the axes of hit
+    auto expectMove = [this, &terrain](const AABB &box, glm::vec3 disp, bool liquidsSolid,
+                                       glm::vec3 allowed, glm::bvec3 hit) {
+        VoxelCollider collider(liquidsSolid);
+        collider.gather(terrain, box, disp);
+        glm::bvec3 movedHit(false);
+        glm::vec3 moved = collider.move(box, disp, &movedHit);
+        expect(moved == allowed, "moved by " + glm::to_string(moved) + ", not " + glm::to_string(allowed));
+        expect(movedHit == hit, "hit " + glm::to_string(movedHit) + ", not " + glm::to_string(hit));
+    };
+
+    test("collider.stopAtFace", [&expectMove]() {
+        // 1.25 to the wall's face at x = 4, both ways
+        expectMove(bodyAt(2.5f, 130.f, 2.5f), glm::vec3(2.f, 0.f, 0.f), true,
+                   glm::vec3(1.25f, 0.f, 0.f), glm::bvec3(true, false, false));
+        expectMove(bodyAt(2.5f, 130.f, 2.5f), glm::vec3(-3.f, 0.f, 0.f), true,
+                   glm::vec3(-1.25f, 0.f, 0.f), glm::bvec3(true, false, false));
+        // touching the face, it doesn't move any further
+        expectMove(bodyAt(3.75f, 130.f, 2.5f), glm::vec3(0.5f, 0.f, 0.f), true,
+                   glm::vec3(0.f), glm::bvec3(true, false, false));
+        // the short move stops short of the wall
+        expectMove(bodyAt(2.5f, 130.f, 2.5f), glm::vec3(1.f, 0.f, 0.f), true,
+                   glm::vec3(1.f, 0.f, 0.f), glm::bvec3(false));
+    });
+
+    test("collider.slidePastCorner", [&expectMove]() {
+        // x first, then z runs into the block's corner
+        expectMove(bodyAt(10.5f, 130.f, 10.5f), glm::vec3(1.f, 0.f, 1.f), true,
+                   glm::vec3(1.f, 0.f, 0.25f), glm::bvec3(false, false, true));
+        // flush with the pillar's face, it slides along it
+        expectMove(AABB(glm::vec3(18.5f, 130.f, 2.25f), glm::vec3(19.f, 131.5f, 2.75f)), glm::vec3(0.f, 0.f, 3.f), true,
+                   glm::vec3(0.f, 0.f, 3.f), glm::bvec3(false));
+    });
+
+    test("collider.standOnGround", [&expectMove]() {
+        // gravity is cancelled, the walk isn't
+        expectMove(bodyAt(19.5f, 130.f, 19.5f), glm::vec3(0.5f, -0.5f, 0.25f), true,
+                   glm::vec3(0.5f, 0.f, 0.25f), glm::bvec3(false, true, false));
+        // a fall lands on the top face
+        expectMove(bodyAt(19.5f, 130.75f, 19.5f), glm::vec3(0.f, -1.f, 0.f), true,
+                   glm::vec3(0.f, -0.75f, 0.f), glm::bvec3(false, true, false));
+    });
+
+    test("collider.startInsideBlock", [&expectMove]() {
+        // the blocks it overlaps don't hold it
+        expectMove(bodyAt(26.5f, 130.f, 26.5f), glm::vec3(0.5f, 0.f, 0.f), true,
+                   glm::vec3(0.5f, 0.f, 0.f), glm::bvec3(false));
+        expectMove(bodyAt(26.5f, 130.f, 26.5f), glm::vec3(-1.f, 0.f, 0.f), true,
+                   glm::vec3(-1.f, 0.f, 0.f), glm::bvec3(false));
+        // the next one does
+        expectMove(bodyAt(26.5f, 130.f, 26.5f), glm::vec3(2.f, 0.f, 0.f), true,
+                   glm::vec3(1.25f, 0.f, 0.f), glm::bvec3(true, false, false));
+    });
+
+    test("collider.liquids", [&expectMove]() {
+        // NPCs stand on water, the player sinks in
+        expectMove(bodyAt(4.5f, 130.f, 26.5f), glm::vec3(0.f, -0.5f, 0.f), true,
+                   glm::vec3(0.f), glm::bvec3(false, true, false));
+        expectMove(bodyAt(4.5f, 130.f, 26.5f), glm::vec3(0.f, -0.5f, 0.f), false,
+                   glm::vec3(0.f, -0.5f, 0.f), glm::bvec3(false));
+    });
+
+    test("collider.unloaded", [&expectMove]() {
+        // no chunk at x = 32, the column is solid
+        expectMove(bodyAt(31.5f, 130.f, 12.5f), glm::vec3(1.f, 0.f, 0.f), false,
+                   glm::vec3(0.25f, 0.f, 0.f), glm::bvec3(true, false, false));
+    });
+}
+
+/**
+ * @brief SelfTest::testPathFinder
+ *  The corpus holds the plans of the node arena search on the world of buildPathWorld,
+ *  a change of the search must make exactly the same plans (or regenerate it on purpose).
+ *  SeededRandom is seeded with the query's number (from 1) before each search,
+ *  it picks the plan when the target isn't reached.
+ */
+void SelfTest::testPathFinder()
+{
+    if (!selects({"pathfinder.corpus"})) {
+        return;
+    }
+
+    Terrain terrain(mp_context);
+    buildPathWorld(terrain);
+
+    test("pathfinder.corpus", [this, &terrain]() {
+        int radius = 0;
+        std::vector<PathQuery> queries;
+        expect(readPathCorpus(&radius, &queries) && radius > 0 && !queries.empty(),
+               "can't read :/tests/pathfinder_corpus.txt");
+
+        PathFinder pathFinder(radius, terrain);
+        int mismatches = 0;
+        for (unsigned int i = 0; i < queries.size(); i++) {
+            const PathQuery &query = queries[i];
+            SeededRandom::seed(i + 1);
+            std::queue<NPCAction> plan = pathFinder.searchPathToward(query.start, query.target);
+
+            bool same = plan.size() == query.plan.size();
+            for (unsigned int j = 0; same && j < query.plan.size(); j++) {
+                same = plan.front().action == query.plan[j].action && plan.front().dest == query.plan[j].dest;
+                plan.pop();
+            }
+            if (!same) {
+                mismatches++;
+            }
+            // the first few are enough to see what changed
+            if (!same && mismatches <= 5) {
+                expect(false, "query " + std::to_string(i + 1) + " from " + glm::to_string(query.start)
+                       + " to " + glm::to_string(query.target) + " planned differently");
+            }
+        }
+        expect(mismatches == 0, std::to_string(mismatches) + " of " + std::to_string(queries.size())
+               + " plans differ");
+    });
+}
+
+/**
+ * @brief SelfTest::testPortalGraph
+ *  Routes over the 3 x 3 chunks [0, 48) x [0, 48) with a 3 blocks high wall
+ *  on the first row of the chunks at z = 16: the border between z = 15 & 16
+ *  can only be crossed through a gap of 2 blocks in it, moved by editing the blocks
+ */
+void SelfTest::testPortalGraph()
+{
+    if (!selects({"portalgraph.throughGap", "portalgraph.rebuiltAfterEdit"})) {
+        return;
+    }
+
+    Terrain terrain(mp_context);
+    std::vector<Chunk*> chunks = buildFloorWorld(terrain, glm::ivec2(0, 0), glm::ivec2(48, 48));
+    auto setWall = [&terrain](int xMin, int xMax, BlockType t) {
+        for (int x = xMin; x < xMax; x++) {
+            for (int y = 129; y <= 131; y++) {
+                terrain.setBlockAt(x, y, 16, t);
+            }
+        }
+    };
+    setWall(0, 48, STONE);
+    setWall(40, 42, EMPTY);
+    setNavGrids(chunks);
+
+    PortalGraph graph(terrain);
+    glm::ivec3 start(4, 128, 4);
+    glm::ivec3 goal(4, 128, 40);
+    // the route is found & crosses the wall (on either side of the border) only in [gapMin, gapMax]
+    auto expectRouteThrough = [this, &graph, start, goal](int gapMin, int gapMax) {
+        std::vector<glm::ivec3> route;
+        expect(graph.findRoute(start, goal, &route), "no route found");
+        expect(!route.empty() && route.back() == goal, "the route doesn't end at the goal");
+        int crossings = 0;
+        for (const glm::ivec3 &cell : route) {
+            if (cell.z != 15 && cell.z != 16) {
+                continue;
+            }
+            crossings++;
+            expect(cell.x >= gapMin && cell.x <= gapMax && cell.y == 128,
+                   "the route crosses the wall at " + glm::to_string(cell));
+        }
+        expect(crossings > 0, "the route doesn't cross the wall");
+    };
+
+    test("portalgraph.throughGap", [&expectRouteThrough]() {
+        expectRouteThrough(40, 41);
+    });
+
+    test("portalgraph.rebuiltAfterEdit", [this, &graph, &setWall, &expectRouteThrough, start, goal]() {
+        // the portals of the chunks along the wall were cached by the last route
+        setWall(40, 42, STONE);
+        setWall(8, 10, EMPTY);
+        expectRouteThrough(8, 9);
+
+        setWall(8, 10, STONE);
+        std::vector<glm::ivec3> route;
+        expect(!graph.findRoute(start, goal, &route), "a route is found through the closed wall");
+    });
+}
+
+/**
+ * @brief SelfTest::testFlowField
+ *  Fields over the 2 x 2 chunks [0, 32) x [0, 32): a step up to a platform, a ledge too high
+ *  to walk onto (but not to drop from), a pit too deep to climb out of,
+ *  a wall (z = 16) with a gap at x >= 28 & a pool of water. The costs are
+ *  checked against a brute force relaxation over the standable cells, read from the blocks
+ */
+void SelfTest::testFlowField()
+{
+    if (!selects({"flowfield.costs", "flowfield.nextCells", "flowfield.isCurrent", "flowfield.eviction"})) {
+        return;
+    }
+
+    Terrain terrain(mp_context);
+    std::vector<Chunk*> chunks = buildFloorWorld(terrain, glm::ivec2(0, 0), glm::ivec2(32, 32));
+    for (int x = 20; x < 28; x++) {
+        for (int z = 4; z < 12; z++) {
+            // a platform 1 block up, then a ledge 2 more blocks up
+            terrain.setBlockAt(x, 129, z, STONE);
+            if (x >= 24) {
+                terrain.setBlockAt(x, 130, z, STONE);
+                terrain.setBlockAt(x, 131, z, STONE);
+            }
+        }
+    }
+    for (int x = 0; x < 28; x++) {
+        terrain.setBlockAt(x, 129, 16, STONE);
+        terrain.setBlockAt(x, 130, 16, STONE);
+    }
+    for (int x = 12; x < 14; x++) {
+        for (int z = 4; z < 6; z++) {
+            terrain.setBlockAt(x, 128, z, EMPTY);
+            terrain.setBlockAt(x, 125, z, STONE);
+        }
+    }
+    for (int x = 4; x < 8; x++) {
+        for (int z = 20; z < 24; z++) {
+            terrain.setBlockAt(x, 128, z, WATER);
+        }
+    }
+    setNavGrids(chunks);
+
+    // an NPC standing on the floor at (2, 128, 2)
+    glm::vec3 goal(2.5f, 129.f, 2.5f);
+    glm::ivec3 goalCell(2, 129, 2);
+    FlowField field;
+    field.build(terrain, goalCell);
+
+    // the cells of the field's box on the chunks (y in goal +- HALF_HEIGHT)
+    const int yMin = goalCell.y - FlowField::HALF_HEIGHT;
+    const int height = 2 * FlowField::HALF_HEIGHT + 1;
+    auto toIndex = [yMin](glm::ivec3 c) { return ((c.y - yMin) * 32 + c.x) * 32 + c.z; };
+    auto isStandable = [&terrain, yMin, height](glm::ivec3 c) {
+        if (c.x < 0 || c.x >= 32 || c.z < 0 || c.z >= 32 || c.y < yMin || c.y >= yMin + height) {
+            return false;
+        }
+        return NavGrid::isWalkable(terrain.getBlockAt(c.x, c.y, c.z)) && terrain.getBlockAt(c.x, c.y + 1, c.z) == EMPTY;
+    };
+    // the cost of a step of a walk, -1 if it isn't one: to a neighbor column, down 2 to up 1
+    auto getStepCost = [](glm::ivec3 step) {
+        if (glm::abs(step.x) > 1 || glm::abs(step.z) > 1 || (step.x == 0 && step.z == 0) || step.y < -2 || step.y > 1) {
+            return -1;
+        }
+        return (step.x != 0 && step.z != 0 ? 3 : 2) + (step.y > 0 ? 1 : 0);
+    };
+
+    std::vector<glm::ivec3> standable;
+    for (int y = yMin; y < yMin + height; y++) {
+        for (int x = 0; x < 32; x++) {
+            for (int z = 0; z < 32; z++) {
+                if (isStandable(glm::ivec3(x, y, z))) {
+                    standable.push_back(glm::ivec3(x, y, z));
+                }
+            }
+        }
+    }
+    // 0 on the cells around the goal (3 x 3 columns, up to 3 blocks below it),
+    // then lower each cost through its cheapest step until none changes
+    std::vector<int> expected(32 * 32 * height, FlowField::UNREACHED);
+    for (const glm::ivec3 &c : standable) {
+        glm::ivec3 d = c - goalCell;
+        if (glm::abs(d.x) <= 1 && glm::abs(d.z) <= 1 && d.y >= -3 && d.y <= 0) {
+            expected[toIndex(c)] = 0;
+        }
+    }
+    for (bool changed = true; changed; ) {
+        changed = false;
+        for (const glm::ivec3 &c : standable) {
+            for (int dx = -1; dx <= 1; dx++) {
+                for (int dz = -1; dz <= 1; dz++) {
+                    for (int dy = -2; dy <= 1; dy++) {
+                        glm::ivec3 next = c + glm::ivec3(dx, dy, dz);
+                        int stepCost = getStepCost(next - c);
+                        if (stepCost < 0 || !isStandable(next) || expected[toIndex(next)] == FlowField::UNREACHED) {
+                            continue;
+                        }
+                        if (expected[toIndex(next)] + stepCost < expected[toIndex(c)]) {
+                            expected[toIndex(c)] = expected[toIndex(next)] + stepCost;
+                            changed = true;
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    test("flowfield.costs", [this, &field, &expected, yMin, height]() {
+        int mismatches = 0;
+        for (int y = yMin; y < yMin + height; y++) {
+            for (int x = 0; x < 32; x++) {
+                for (int z = 0; z < 32; z++) {
+                    glm::ivec3 c(x, y, z);
+                    int cost = field.getCost(c);
+                    int want = expected[((y - yMin) * 32 + x) * 32 + z];
+                    if (cost != want && ++mismatches <= 5) {
+                        expect(false, glm::to_string(c) + " costs " + std::to_string(cost) + ", not " + std::to_string(want));
+                    }
+                }
+            }
+        }
+        expect(mismatches == 0, std::to_string(mismatches) + " costs differ");
+        // the canned obstacles
+        expect(field.getCost(glm::ivec3(22, 129, 8)) != FlowField::UNREACHED, "the platform isn't reached");
+        expect(field.getCost(glm::ivec3(26, 131, 8)) != FlowField::UNREACHED, "the ledge isn't reached");
+        expect(field.getCost(glm::ivec3(12, 125, 4)) == FlowField::UNREACHED, "the pit is reached");
+        expect(field.getCost(glm::ivec3(5, 128, 21)) == FlowField::UNREACHED, "the water is reached");
+    });
+
+    test("flowfield.nextCells", [this, &field, &standable, &getStepCost]() {
+        int bad = 0;
+        for (const glm::ivec3 &c : standable) {
+            int cost = field.getCost(c);
+            glm::ivec3 next;
+            bool hasNext = field.getNextCell(c, &next);
+            if (cost == FlowField::UNREACHED || cost == 0) {
+                if (hasNext && ++bad <= 5) {
+                    expect(false, glm::to_string(c) + " has a next cell at cost " + std::to_string(cost));
+                }
+                continue;
+            }
+            // one step of a walk, exactly its cost closer to the goal
+            int stepCost = getStepCost(next - c);
+            if ((!hasNext || stepCost < 0 || field.getCost(next) + stepCost != cost) && ++bad <= 5) {
+                expect(false, "the step from " + glm::to_string(c) + " doesn't lead down its cost");
+            }
+        }
+        expect(bad == 0, std::to_string(bad) + " cells step wrong");
+
+        // from behind the wall, through its gap
+        glm::ivec3 cell(4, 128, 28);
+        bool throughGap = false;
+        int steps = 0;
+        for (glm::ivec3 next; field.getNextCell(cell, &next) && steps < 200; steps++) {
+            throughGap = throughGap || (next.z == 16 && next.x >= 28);
+            cell = next;
+        }
+        expect(field.getCost(cell) == 0, "the chain from (4, 128, 28) stops at " + glm::to_string(cell));
+        expect(throughGap, "the chain from (4, 128, 28) doesn't go through the gap");
+    });
+
+    test("flowfield.isCurrent", [this, &terrain, goal, goalCell]() {
+        FlowFieldCache cache(terrain);
+        const FlowField *cached = cache.getField(goal);
+        expect(cached->getGoal() == goalCell, "the field is built toward " + glm::to_string(cached->getGoal()));
+        expect(cached->isCurrent(terrain), "a new field isn't current");
+
+        // the same block again changes nothing
+        terrain.setBlockAt(10, 128, 10, STONE);
+        expect(cached->isCurrent(terrain), "rewriting a block makes the field stale");
+
+        terrain.setBlockAt(10, 129, 10, STONE);
+        expect(!cached->isCurrent(terrain), "the field is current after a block edit");
+        cached = cache.getField(goal);
+        expect(cached->isCurrent(terrain), "the cache returns a stale field");
+        expect(cached->getCost(glm::ivec3(10, 129, 10)) != FlowField::UNREACHED
+               && cached->getCost(glm::ivec3(10, 128, 10)) == FlowField::UNREACHED,
+               "the rebuilt field misses the edit");
+        terrain.setBlockAt(10, 129, 10, EMPTY);
+    });
+
+    test("flowfield.eviction", [this, &terrain]() {
+        FlowFieldCache cache(terrain);
+        std::vector<const FlowField*> fields;
+        auto goalAt = [](int i) { return glm::vec3(2.5f + 2 * i, 129.f, 2.5f); };
+        for (int i = 0; i < FlowFieldCache::MAX_FIELDS; i++) {
+            fields.push_back(cache.getField(goalAt(i)));
+        }
+        for (int i = 0; i < FlowFieldCache::MAX_FIELDS; i++) {
+            expect(cache.getField(goalAt(i)) == fields[i], "field " + std::to_string(i) + " isn't kept");
+        }
+
+        // field 0 was just used again, field 1 is the least recently used
+        expect(cache.getField(goalAt(0)) == fields[0], "field 0 isn't kept");
+        const FlowField *extra = cache.getField(goalAt(FlowFieldCache::MAX_FIELDS));
+        expect(extra == fields[1], "the least recently used field isn't the one replaced");
+        expect(extra->getGoal() == glm::ivec3(glm::floor(goalAt(FlowFieldCache::MAX_FIELDS))),
+               "the replaced field isn't rebuilt toward the new goal");
+        expect(fields[0]->getGoal() == glm::ivec3(glm::floor(goalAt(0))), "field 0 is replaced");
+
+        // & field 1 is then built again in place of field 2
+        expect(cache.getField(goalAt(1)) == fields[2], "the evicted field isn't built again");
+    });
+}
+
+/**
+ * @brief SelfTest::testEntityIndex
+ *  Every radius query is compared with a linear scan of the boxes inserted,
+ *  on boxes around the origin (negative cells on each axis) moved across cells
+ */
+void SelfTest::testEntityIndex()
+{
+    // the boxes the index should hold, by handle
+    std::map<int, AABB> boxes;
+    // the handles of the boxes at most radius from center, sorted
+    auto scan = [&boxes](glm::vec3 center, float radius) {
+        std::vector<int> handles;
+        for (const std::pair<const int, AABB> &p : boxes) {
+            glm::vec3 out = glm::max(glm::max(p.second.min - center, center - p.second.max), glm::vec3(0.f));
+            if (glm::length(out) <= radius) {
+                handles.push_back(p.first);
+            }
+        }
+        return handles;
+    };
+    auto expectQuery = [this, &scan](const EntityIndex &index, glm::vec3 center, float radius) {
+        std::vector<int> handles;
+        index.queryRadius(center, radius, &handles);
+        std::sort(handles.begin(), handles.end());
+        std::vector<int> want = scan(center, radius);
+        expect(handles == want, "around " + glm::to_string(center) + " within " + std::to_string(radius)
+               + ": " + std::to_string(handles.size()) + " handles, not " + std::to_string(want.size()));
+    };
+
+    test("entityindex.cellBoundaries", [this, &boxes, &expectQuery]() {
+        EntityIndex index;
+        boxes.clear();
+        // straddling x = -8 (cells -2 & -1), then y = 0 & z = 0 (cells -1 & 0)
+        AABB a(glm::vec3(-8.25f, 1.f, 3.75f), glm::vec3(-7.75f, 2.f, 4.25f));
+        AABB b(glm::vec3(12.f, -0.5f, -0.25f), glm::vec3(13.f, 1.f, 0.25f));
+        boxes.emplace(index.insert(nullptr, a), a);
+        boxes.emplace(index.insert(nullptr, b), b);
+
+        // a sphere in cell 0 reaching a's face at x = -7.75 in cell -1
+        expectQuery(index, glm::vec3(-0.5f, 1.5f, 4.f), 7.3f);
+        expectQuery(index, glm::vec3(-0.5f, 1.5f, 4.f), 7.2f);
+        // from below & behind the origin
+        expectQuery(index, glm::vec3(12.5f, -8.5f, -7.f), 10.6f);
+        expectQuery(index, glm::vec3(12.5f, -8.5f, -7.f), 10.4f);
+        expectQuery(index, glm::vec3(-16.5f, -16.5f, -16.5f), 20.f);
+        std::vector<int> handles;
+        index.queryRadius(glm::vec3(-0.5f, 1.5f, 4.f), 7.3f, &handles);
+        expect(handles.size() == 1, "the box across x = -8 isn't found from cell 0");
+    });
+
+    test("entityindex.insertUpdateRemove", [this, &boxes, &expectQuery]() {
+        EntityIndex index;
+        boxes.clear();
+        SeededRandom::seed(48);
+        // multiples of 1 / 4 in [lo, hi]
+        auto quarter = [](float lo, float hi) {
+            int steps = static_cast<int>((hi - lo) * 4.f);
+            return lo + static_cast<float>(SeededRandom::next() % (steps + 1)) / 4.f;
+        };
+        auto randomBox = [&quarter]() {
+            glm::vec3 min(quarter(-40.f, 40.f), quarter(-12.f, 12.f), quarter(-40.f, 40.f));
+            glm::vec3 size(quarter(0.25f, 3.f), quarter(0.25f, 3.f), quarter(0.25f, 3.f));
+            return AABB(min, min + size);
+        };
+        // the radius is a quarter plus 0.1, never one of the distances of the boxes
+        auto expectQueries = [&expectQuery, &index, &quarter]() {
+            for (int i = 0; i < 60; i++) {
+                glm::vec3 center(quarter(-44.f, 44.f), quarter(-16.f, 16.f), quarter(-44.f, 44.f));
+                expectQuery(index, center, quarter(0.f, 16.f) + 0.1f);
+            }
+        };
+
+        for (int i = 0; i < 150; i++) {
+            AABB box = randomBox();
+            boxes.emplace(index.insert(nullptr, box), box);
+        }
+        expect(index.size() == 150, "size " + std::to_string(index.size()) + " after 150 inserts");
+        expectQueries();
+
+        // half of them move, by up to 10 blocks (across cells) or within a block
+        for (std::pair<const int, AABB> &p : boxes) {
+            if (SeededRandom::next() % 2 == 0) {
+                continue;
+            }
+            float reach = SeededRandom::next() % 2 == 0 ? 10.f : 0.5f;
+            glm::vec3 offset(quarter(-reach, reach), quarter(-reach, reach), quarter(-reach, reach));
+            p.second = AABB(p.second.min + offset, p.second.max + offset);
+            index.update(p.first, p.second);
+        }
+        for (const std::pair<const int, AABB> &p : boxes) {
+            expect(index.getBox(p.first).min == p.second.min && index.getBox(p.first).max == p.second.max,
+                   "the box of " + std::to_string(p.first) + " isn't updated");
+        }
+        expectQueries();
+
+        // a third is removed, then new boxes take their handles
+        std::vector<int> removed;
+        for (const std::pair<const int, AABB> &p : boxes) {
+            if (p.first % 3 == 0) {
+                removed.push_back(p.first);
+            }
+        }
+        for (int handle : removed) {
+            index.remove(handle);
+            boxes.erase(handle);
+        }
+        expect(index.size() == static_cast<int>(boxes.size()), "size " + std::to_string(index.size())
+               + " after removing " + std::to_string(removed.size()));
+        expectQueries();
+
+        for (int i = 0; i < 30; i++) {
+            AABB box = randomBox();
+            int handle = index.insert(nullptr, box);
+            expect(boxes.find(handle) == boxes.end(), "handle " + std::to_string(handle) + " given twice");
+            expect(handle < 150, "handle " + std::to_string(handle) + " isn't reused");
+            boxes.emplace(handle, box);
+        }
+        expectQueries();
+    });
+}
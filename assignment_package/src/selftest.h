@@ -0,0 +1,49 @@
+#ifndef SELFTEST_H
+#define SELFTEST_H
+
+#pragma once
+
+#include "openglcontext.h"
+#include <QString>
+#include <functional>
+#include <initializer_list>
+#include <string>
+
+// Deterministic checks of the engine's headless parts on hand-built inputs:
+// each test builds its own blocks (or sections), runs the code & compares with
+// the exact expected result. Nothing is drawn, no window is opened.
+class SelfTest
+{
+private:
+    OpenGLContext *mp_context;
+    // only run the tests whose name contains it
+    std::string m_filter;
+    // the running test & how many of its checks failed
+    std::string m_test;
+    int m_failedChecks;
+    int m_passedTests;
+    int m_failedTests;
+
+    // run body as the test name & print whether every check in it passed
+    void test(const std::string &name, const std::function<void()> &body);
+    // a check of the running test, what is printed if it fails
+    void expect(bool condition, const std::string &what);
+    // whether the filter lets one of the tests named run
+    bool selects(std::initializer_list<const char*> names) const;
+
+    // the tests of each module
+    void testSectionGraph();
+    void testVoxelCollider();
+    void testPathFinder();
+    void testPortalGraph();
+    void testFlowField();
+    void testEntityIndex();
+
+public:
+    SelfTest(OpenGLContext *context);
+
+    // print each failed check & a line per test, return the number of failed tests
+    int run(const QString &filter = QString());
+};
+
+#endif // SELFTEST_H
@@ -11,9 +11,30 @@ ShaderProgram::ShaderProgram(OpenGLContext *context)
     : vertShader(), fragShader(), prog(),
       attrPos(-1), attrNor(-1), attrCol(-1), attrUV(-1), attrAnimatableFlag(-1),
       unifModel(-1), unifModelInvTr(-1), unifViewProj(-1), unifColor(-1), unifTexture(-1),
-      unifTime(-1), unifDimensions(-1), context(context)
+      unifTime(-1), unifDimensions(-1), unifNoise(-1), unifBakedNoise(-1),
+      m_modelShadow(), m_viewProjShadow(), m_colorShadow(),
+      m_textureShadow(), m_timeShadow(), m_dimensionsShadow(),
+      m_noiseShadow(), m_bakedNoiseShadow(),
+      context(context)
 {}
 
+/**
+ * @brief isTranslation
+ * @param m
+ * @return true if m only translates (the upper 3 x 3 is the identity)
+ */
+static bool isTranslation(const glm::mat4 &m)
+{
+    for (int col = 0; col < 3; col++) {
+        for (int row = 0; row < 4; row++) {
+            if (m[col][row] != (col == row ? 1.f : 0.f)) {
+                return false;
+            }
+        }
+    }
+    return m[3][3] == 1.f;
+}
+
 void ShaderProgram::create(const char *vertfile, const char *fragfile)
 {
     // Allocate space on our GPU for a vertex shader and a fragment shader and a shader program to manage the two
@@ -77,6 +98,18 @@ void ShaderProgram::create(const char *vertfile, const char *fragfile)
     unifTexture    = context->glGetUniformLocation(prog, "u_Texture");
     unifTime       = context->glGetUniformLocation(prog, "u_Time");
     unifDimensions = context->glGetUniformLocation(prog, "u_Dimensions");
+    unifNoise      = context->glGetUniformLocation(prog, "u_Noise");
+    unifBakedNoise = context->glGetUniformLocation(prog, "u_BakedNoise");
+
+    // a newly linked program has all its uniforms reset
+    m_modelShadow = UniformShadow<glm::mat4>();
+    m_viewProjShadow = UniformShadow<glm::mat4>();
+    m_colorShadow = UniformShadow<glm::vec4>();
+    m_textureShadow = UniformShadow<int>();
+    m_timeShadow = UniformShadow<int>();
+    m_dimensionsShadow = UniformShadow<glm::ivec2>();
+    m_noiseShadow = UniformShadow<int>();
+    m_bakedNoiseShadow = UniformShadow<int>();
 }
 
 void ShaderProgram::useMe()
@@ -84,8 +117,22 @@ void ShaderProgram::useMe()
     context->glUseProgram(prog);
 }
 
+/**
+ * @brief ShaderProgram::setModelMatrix
+ *  Skipped if the model matrix is unchanged.
+ *  For a translation T, inverse(transpose(T)) is the identity with -t in the bottom row,
+ *  so the chunks / blocks that are only translated don't need a full inverse.
+ * @param model
+ */
 void ShaderProgram::setModelMatrix(const glm::mat4 &model)
 {
+    if (unifModel == -1 && unifModelInvTr == -1) {
+        return;
+    }
+    if (!checkUniformUpload(m_modelShadow, model)) {
+        return;
+    }
+
     useMe();
 
     if (unifModel != -1) {
@@ -101,7 +148,15 @@ void ShaderProgram::setModelMatrix(const glm::mat4 &model)
     }
 
     if (unifModelInvTr != -1) {
-        glm::mat4 modelinvtr = glm::inverse(glm::transpose(model));
+        glm::mat4 modelinvtr;
+        if (isTranslation(model)) {
+            modelinvtr = glm::mat4(1.f);
+            modelinvtr[0][3] = -model[3][0];
+            modelinvtr[1][3] = -model[3][1];
+            modelinvtr[2][3] = -model[3][2];
+        } else {
+            modelinvtr = glm::inverse(glm::transpose(model));
+        }
         // Pass a 4x4 matrix into a uniform variable in our shader
                         // Handle to the matrix variable on the GPU
         context->glUniformMatrix4fv(unifModelInvTr,
@@ -116,10 +171,10 @@ void ShaderProgram::setModelMatrix(const glm::mat4 &model)
 
 void ShaderProgram::setViewProjMatrix(const glm::mat4 &vp)
 {
+    if(unifViewProj != -1 && checkUniformUpload(m_viewProjShadow, vp)) {
     // Tell OpenGL to use this shader program for subsequent function calls
     useMe();
 
-    if(unifViewProj != -1) {
     // Pass a 4x4 matrix into a uniform variable in our shader
                     // Handle to the matrix variable on the GPU
     context->glUniformMatrix4fv(unifViewProj,
@@ -134,10 +189,9 @@ void ShaderProgram::setViewProjMatrix(const glm::mat4 &vp)
 
 void ShaderProgram::setGeometryColor(glm::vec4 color)
 {
-    useMe();
-
-    if(unifColor != -1)
+    if(unifColor != -1 && checkUniformUpload(m_colorShadow, color))
     {
+        useMe();
         context->glUniform4fv(unifColor, 1, &color[0]);
     }
 }
@@ -146,6 +200,9 @@ void ShaderProgram::setGeometryColor(glm::vec4 color)
 void ShaderProgram::draw(Drawable &d)
 {
     useMe();
+    // the attribute arrays used by this draw (bit i for attribute i),
+    // the context enables exactly these right before the draw
+    GLuint attribs = 0;
 
     if(d.elemCount() < 0) {
         throw std::out_of_range("Attempting to draw a drawable with m_count of " + std::to_string(d.elemCount()) + "!");
@@ -161,41 +218,38 @@ void ShaderProgram::draw(Drawable &d)
     // meaning that glVertexAttribPointer associates vs_Pos
     // (referred to by attrPos) with that VBO
     if (attrPos != -1 && d.bindPos()) {
-        context->glEnableVertexAttribArray(attrPos);
+        attribs |= 1u << attrPos;
         context->glVertexAttribPointer(attrPos, 4, GL_FLOAT, false, 0, NULL);
     }
 
     if (attrNor != -1 && d.bindNor()) {
-        context->glEnableVertexAttribArray(attrNor);
+        attribs |= 1u << attrNor;
         context->glVertexAttribPointer(attrNor, 4, GL_FLOAT, false, 0, NULL);
     }
 
     if (attrCol != -1 && d.bindCol()) {
-        context->glEnableVertexAttribArray(attrCol);
+        attribs |= 1u << attrCol;
         context->glVertexAttribPointer(attrCol, 4, GL_FLOAT, false, 0, NULL);
     }
 
     if (attrUV  != -1 && d.bindUV())  {
-        context->glEnableVertexAttribArray(attrUV);
+        attribs |= 1u << attrUV;
         context->glVertexAttribPointer(attrUV, 2, GL_FLOAT, false, 0, NULL);
     }
 
     // Bind the index buffer and then draw shapes from it.
     // This invokes the shader program, which accesses the vertex buffers.
     d.bindIdx();
+    context->setVertexAttribArrays(attribs);
     context->glDrawElements(d.drawMode(), d.elemCount(), GL_UNSIGNED_INT, 0);
 
-    if (attrPos != -1) context->glDisableVertexAttribArray(attrPos);
-    if (attrNor != -1) context->glDisableVertexAttribArray(attrNor);
-    if (attrCol != -1) context->glDisableVertexAttribArray(attrCol);
-    if (attrUV != -1) context->glDisableVertexAttribArray(attrUV);
-
     context->printGLErrorLog();
 }
 
 void ShaderProgram::drawInterleaved(Drawable &d)
 {
     useMe();
+    GLuint attribs = 0;
 
     if(d.elemCount() < 0) {
         throw std::out_of_range("Attempting to draw a drawable with m_count of " + std::to_string(d.elemCount()) + "!");
@@ -214,42 +268,54 @@ void ShaderProgram::drawInterleaved(Drawable &d)
     int size = 2 * sizeof(glm::vec4) + 2 * sizeof(glm::vec2);
 
     if (attrPos != -1 && d.bindPos()) {
-        context->glEnableVertexAttribArray(attrPos);
+        attribs |= 1u << attrPos;
         context->glVertexAttribPointer(attrPos, 4, GL_FLOAT, false, size, (void*)0);
     }
 
     if (attrNor != -1 && d.bindPos()) {
-        context->glEnableVertexAttribArray(attrNor);
+        attribs |= 1u << attrNor;
         context->glVertexAttribPointer(attrNor, 4, GL_FLOAT, false, size, (void*)sizeof(glm::vec4));
     }
 
 
     if (attrUV  != -1 && d.bindPos())  {
-        context->glEnableVertexAttribArray(attrUV);
+        attribs |= 1u << attrUV;
         context->glVertexAttribPointer(attrUV, 2, GL_FLOAT, false, size, (void*)(2 * sizeof(glm::vec4)));
     }
 
     if (attrAnimatableFlag != -1 && d.bindPos()) {
-        context->glEnableVertexAttribArray(attrAnimatableFlag);
+        attribs |= 1u << attrAnimatableFlag;
         context->glVertexAttribPointer(attrAnimatableFlag, 2, GL_FLOAT, false, size, (void*)(2 * sizeof(glm::vec4) + sizeof(glm::vec2)));
     }
 
     // Bind the index buffer and then draw shapes from it.
     // This invokes the shader program, which accesses the vertex buffers.
     d.bindIdx();
+    context->setVertexAttribArrays(attribs);
     context->glDrawElements(d.drawMode(), d.elemCount(), GL_UNSIGNED_INT, 0);
 
-    if (attrPos != -1) context->glDisableVertexAttribArray(attrPos);
-    if (attrNor != -1) context->glDisableVertexAttribArray(attrNor);
-    if (attrUV != -1) context->glDisableVertexAttribArray(attrUV);
-    if (attrAnimatableFlag != -1) context->glDisableVertexAttribArray(attrAnimatableFlag);
-
     context->printGLErrorLog();
 }
 
 void ShaderProgram::drawInterleavedTerrainDrawType(Drawable &d, TerrainDrawType drawType)
+{
+    int elemCount = drawType == TerrainDrawType::opaque ? d.elemCount() : d.transparentElemCount();
+    drawInterleavedTerrainDrawType(d, drawType, 0, elemCount);
+}
+
+/**
+ * @brief ShaderProgram::drawInterleavedTerrainDrawType
+ *  Draw a range of the index buffer, used to skip the sections of a chunk
+ *  outside the view frustum.
+ * @param d
+ * @param drawType
+ * @param firstIdx : int, the first index to draw
+ * @param idxCount : int, the number of indices to draw
+ */
+void ShaderProgram::drawInterleavedTerrainDrawType(Drawable &d, TerrainDrawType drawType, int firstIdx, int idxCount)
 {
     useMe();
+    GLuint attribs = 0;
 
     int elemCount;
     bool bindData;
@@ -269,6 +335,12 @@ void ShaderProgram::drawInterleavedTerrainDrawType(Drawable &d, TerrainDrawType
         throw std::out_of_range("Attempting to draw a drawable with m_count of " + std::to_string(elemCount) + "!");
     }
 
+    if (firstIdx < 0 || idxCount < 0 || firstIdx + idxCount > elemCount) {
+        throw std::out_of_range("Attempting to draw indices [" + std::to_string(firstIdx) + ", "
+                                + std::to_string(firstIdx + idxCount) + ") of a drawable with m_count of "
+                                + std::to_string(elemCount) + "!");
+    }
+
     // Each of the following blocks checks that:
     //   * This shader has this attribute, and
     //   * This Drawable has a vertex buffer for this attribute.
@@ -282,22 +354,22 @@ void ShaderProgram::drawInterleavedTerrainDrawType(Drawable &d, TerrainDrawType
     int size = 2 * sizeof(glm::vec4) + 2 * sizeof(glm::vec2);
 
     if (attrPos != -1 && bindData) {
-        context->glEnableVertexAttribArray(attrPos);
+        attribs |= 1u << attrPos;
         context->glVertexAttribPointer(attrPos, 4, GL_FLOAT, false, size, (void*)0);
     }
 
     if (attrNor != -1 && bindData) {
-        context->glEnableVertexAttribArray(attrNor);
+        attribs |= 1u << attrNor;
         context->glVertexAttribPointer(attrNor, 4, GL_FLOAT, false, size, (void*)sizeof(glm::vec4));
     }
 
     if (attrUV  != -1 && bindData)  {
-        context->glEnableVertexAttribArray(attrUV);
+        attribs |= 1u << attrUV;
         context->glVertexAttribPointer(attrUV, 2, GL_FLOAT, false, size, (void*)(2 * sizeof(glm::vec4)));
     }
 
     if (attrAnimatableFlag != -1 && bindData) {
-        context->glEnableVertexAttribArray(attrAnimatableFlag);
+        attribs |= 1u << attrAnimatableFlag;
         context->glVertexAttribPointer(attrAnimatableFlag, 2, GL_FLOAT, false, size, (void*)(2 * sizeof(glm::vec4) + sizeof(glm::vec2)));
     }
 
@@ -312,12 +384,60 @@ void ShaderProgram::drawInterleavedTerrainDrawType(Drawable &d, TerrainDrawType
         break;
     }
 
-    context->glDrawElements(d.drawMode(), elemCount, GL_UNSIGNED_INT, 0);
+    context->setVertexAttribArrays(attribs);
+    context->glDrawElements(d.drawMode(), idxCount, GL_UNSIGNED_INT, (void*)(firstIdx * sizeof(GLuint)));
+
+    context->printGLErrorLog();
+}
+
+/**
+ * @brief ShaderProgram::drawChunkArena
+ *  Draw the chunks stored in a ChunkArena.
+ *  The attributes are set up once, then every chunk is one entry of the
+ *  glMultiDrawElementsBaseVertex arrays.
+ * @param arena
+ * @param idxCounts : the number of indices of each draw
+ * @param idxOffsets : the byte offset of the first index of each draw
+ * @param baseVertices : the first vertex of each draw, added to its indices
+ * @param drawCount
+ */
+void ShaderProgram::drawChunkArena(ChunkArena &arena, const GLsizei *idxCounts, const void *const *idxOffsets,
+                                   const GLint *baseVertices, int drawCount)
+{
+    useMe();
+    GLuint attribs = 0;
+
+    bool bindData = arena.bindVertices();
+    int size = ChunkArena::VERTEX_SIZE;
+
+    if (attrPos != -1 && bindData) {
+        attribs |= 1u << attrPos;
+        context->glVertexAttribPointer(attrPos, 4, GL_FLOAT, false, size, (void*)0);
+    }
+
+    if (attrNor != -1 && bindData) {
+        attribs |= 1u << attrNor;
+        context->glVertexAttribPointer(attrNor, 4, GL_FLOAT, false, size, (void*)sizeof(glm::vec4));
+    }
+
+    if (attrUV  != -1 && bindData)  {
+        attribs |= 1u << attrUV;
+        context->glVertexAttribPointer(attrUV, 2, GL_FLOAT, false, size, (void*)(2 * sizeof(glm::vec4)));
+    }
+
+    if (attrAnimatableFlag != -1 && bindData) {
+        attribs |= 1u << attrAnimatableFlag;
+        context->glVertexAttribPointer(attrAnimatableFlag, 2, GL_FLOAT, false, size, (void*)(2 * sizeof(glm::vec4) + sizeof(glm::vec2)));
+    }
 
-    if (attrPos != -1) context->glDisableVertexAttribArray(attrPos);
-    if (attrNor != -1) context->glDisableVertexAttribArray(attrNor);
-    if (attrUV != -1) context->glDisableVertexAttribArray(attrUV);
-    if (attrAnimatableFlag != -1) context->glDisableVertexAttribArray(attrAnimatableFlag);
+    context->setVertexAttribArrays(attribs);
+    if (arena.bindIndices()) {
+        if (drawCount == 1) {
+            context->drawElementsBaseVertex(GL_TRIANGLES, idxCounts[0], GL_UNSIGNED_INT, idxOffsets[0], baseVertices[0]);
+        } else {
+            context->multiDrawElementsBaseVertex(GL_TRIANGLES, idxCounts, GL_UNSIGNED_INT, idxOffsets, drawCount, baseVertices);
+        }
+    }
 
     context->printGLErrorLog();
 }
@@ -325,6 +445,7 @@ void ShaderProgram::drawInterleavedTerrainDrawType(Drawable &d, TerrainDrawType
 void ShaderProgram::drawInstanced(InstancedDrawable &d)
 {
     useMe();
+    GLuint attribs = 0;
 
     if(d.elemCount() < 0) {
         throw std::out_of_range("Attempting to draw a drawable with m_count of " + std::to_string(d.elemCount()) + "!");
@@ -340,25 +461,25 @@ void ShaderProgram::drawInstanced(InstancedDrawable &d)
     // meaning that glVertexAttribPointer associates vs_Pos
     // (referred to by attrPos) with that VBO
     if (attrPos != -1 && d.bindPos()) {
-        context->glEnableVertexAttribArray(attrPos);
+        attribs |= 1u << attrPos;
         context->glVertexAttribPointer(attrPos, 4, GL_FLOAT, false, 0, NULL);
         context->glVertexAttribDivisor(attrPos, 0);
     }
 
     if (attrNor != -1 && d.bindNor()) {
-        context->glEnableVertexAttribArray(attrNor);
+        attribs |= 1u << attrNor;
         context->glVertexAttribPointer(attrNor, 4, GL_FLOAT, false, 0, NULL);
         context->glVertexAttribDivisor(attrNor, 0);
     }
 
     if (attrCol != -1 && d.bindCol()) {
-        context->glEnableVertexAttribArray(attrCol);
+        attribs |= 1u << attrCol;
         context->glVertexAttribPointer(attrCol, 3, GL_FLOAT, false, 0, NULL);
         context->glVertexAttribDivisor(attrCol, 1);
     }
 
     if (attrPosOffset != -1 && d.bindOffsetBuf()) {
-        context->glEnableVertexAttribArray(attrPosOffset);
+        attribs |= 1u << attrPosOffset;
         context->glVertexAttribPointer(attrPosOffset, 3, GL_FLOAT, false, 0, NULL);
         context->glVertexAttribDivisor(attrPosOffset, 1);
     }
@@ -366,18 +487,14 @@ void ShaderProgram::drawInstanced(InstancedDrawable &d)
     // Bind the index buffer and then draw shapes from it.
     // This invokes the shader program, which accesses the vertex buffers.
     d.bindIdx();
+    context->setVertexAttribArrays(attribs);
     context->glDrawElementsInstanced(d.drawMode(), d.elemCount(), GL_UNSIGNED_INT, 0, d.instanceCount());
     context->printGLErrorLog();
-
-    if (attrPos != -1) context->glDisableVertexAttribArray(attrPos);
-    if (attrNor != -1) context->glDisableVertexAttribArray(attrNor);
-    if (attrCol != -1) context->glDisableVertexAttribArray(attrCol);
-    if (attrPosOffset != -1) context->glDisableVertexAttribArray(attrPosOffset);
-
 }
 
 void ShaderProgram::drawOverlay(Drawable &d) {
     useMe();
+    GLuint attribs = 0;
 
     if(d.elemCount() < 0) {
         throw std::out_of_range("Attempting to draw a drawable with m_count of " + std::to_string(d.elemCount()) + "!");
@@ -392,28 +509,26 @@ void ShaderProgram::drawOverlay(Drawable &d) {
     // meaning that glVertexAttribPointer associates vs_Pos
     // (referred to by attrPos) with that VBO
     if (attrPos != -1 && d.bindPos()) {
-        context->glEnableVertexAttribArray(attrPos);
+        attribs |= 1u << attrPos;
         context->glVertexAttribPointer(attrPos, 4, GL_FLOAT, false, 0, NULL);
     }
 
     if (attrNor != -1 && d.bindNor()) {
-        context->glEnableVertexAttribArray(attrNor);
+        attribs |= 1u << attrNor;
         context->glVertexAttribPointer(attrNor, 4, GL_FLOAT, false, 0, NULL);
     }
 
     if (attrUV != -1 && d.bindUV()) {
-        context->glEnableVertexAttribArray(attrUV);
+        attribs |= 1u << attrUV;
         context->glVertexAttribPointer(attrUV, 2, GL_FLOAT, false, 0, NULL);
     }
 
     // Bind the index buffer and then draw shapes from it.
     // This invokes the shader program, which accesses the vertex buffers.
     d.bindIdx();
+    context->setVertexAttribArrays(attribs);
     context->glDrawElements(d.drawMode(), d.elemCount(), GL_UNSIGNED_INT, 0);
 
-    if (attrPos != -1) context->glDisableVertexAttribArray(attrPos);
-    if (attrNor != -1) context->glDisableVertexAttribArray(attrNor);
-
     context->printGLErrorLog();
 }
 
@@ -421,33 +536,70 @@ void ShaderProgram::drawOverlay(Drawable &d) {
 // passing variable: pos, uv, u_Texture
 void ShaderProgram::drawTexture(Drawable &d) {
     useMe();
+    GLuint attribs = 0;
 
     if(d.elemCount() < 0) {
         throw std::out_of_range("Attempting to draw a drawable with m_count of " + std::to_string(d.elemCount()) + "!");
     }
 
     if (attrPos != -1 && d.bindPos()) {
-        context->glEnableVertexAttribArray(attrPos);
+        attribs |= 1u << attrPos;
         context->glVertexAttribPointer(attrPos, 4, GL_FLOAT, false, 0, NULL);
     }
 
     if (attrUV != -1 && d.bindUV()) {
-        context->glEnableVertexAttribArray(attrUV);
+        attribs |= 1u << attrUV;
         context->glVertexAttribPointer(attrUV, 2, GL_FLOAT, false, 0, NULL);
     }
 
     // Bind the index buffer and then draw shapes from it.
     // This invokes the shader program, which accesses the vertex buffers.
     d.bindIdx();
+    context->setVertexAttribArrays(attribs);
     context->glDrawElements(d.drawMode(), d.elemCount(), GL_UNSIGNED_INT, 0);
 
-    if (attrPos != -1) context->glDisableVertexAttribArray(attrPos);
-    if (attrUV != -1) context->glDisableVertexAttribArray(attrUV);
-
     context->printGLErrorLog();
 
 }
 
+/**
+ * @brief ShaderProgram::drawInterleavedTexture
+ *  Draw a range of a Drawable whose position buffer holds
+ *  interleaved pos (vec4) & uv (vec2), see HUD
+ * @param d
+ * @param firstIdx : int, the first index to draw
+ * @param idxCount : int, the number of indices to draw
+ */
+void ShaderProgram::drawInterleavedTexture(Drawable &d, int firstIdx, int idxCount) {
+    useMe();
+    GLuint attribs = 0;
+
+    if (firstIdx < 0 || idxCount < 0 || firstIdx + idxCount > d.elemCount()) {
+        throw std::out_of_range("Attempting to draw indices [" + std::to_string(firstIdx) + ", "
+                                + std::to_string(firstIdx + idxCount) + ") of a drawable with m_count of "
+                                + std::to_string(d.elemCount()) + "!");
+    }
+
+    int size = sizeof(glm::vec4) + sizeof(glm::vec2);
+    bool bindData = d.bindPos();
+
+    if (attrPos != -1 && bindData) {
+        attribs |= 1u << attrPos;
+        context->glVertexAttribPointer(attrPos, 4, GL_FLOAT, false, size, (void*)0);
+    }
+
+    if (attrUV != -1 && bindData) {
+        attribs |= 1u << attrUV;
+        context->glVertexAttribPointer(attrUV, 2, GL_FLOAT, false, size, (void*)sizeof(glm::vec4));
+    }
+
+    d.bindIdx();
+    context->setVertexAttribArrays(attribs);
+    context->glDrawElements(d.drawMode(), idxCount, GL_UNSIGNED_INT, (void*)(firstIdx * sizeof(GLuint)));
+
+    context->printGLErrorLog();
+}
+
 char* ShaderProgram::textFileRead(const char* fileName) {
     char* text;
 
@@ -525,28 +677,45 @@ void ShaderProgram::printLinkInfoLog(int prog)
 }
 
 void ShaderProgram::setTexture(int textureSlot) {
-    useMe();
-
-    if (unifTexture != -1) {
+    if (unifTexture != -1 && checkUniformUpload(m_textureShadow, textureSlot)) {
+        useMe();
         context->glUniform1i(unifTexture, textureSlot);
     }
 }
 
 void ShaderProgram::setTime(int time) {
-    useMe();
-
-    if(unifTime != -1)
+    if(unifTime != -1 && checkUniformUpload(m_timeShadow, time))
     {
+        useMe();
         context->glUniform1i(unifTime, time);
     }
 }
 
 
 void ShaderProgram::setDimensions(glm::ivec2 dims) {
-    useMe();
-
-    if(unifDimensions != -1)
+    if(unifDimensions != -1 && checkUniformUpload(m_dimensionsShadow, dims))
     {
+        useMe();
         context->glUniform2i(unifDimensions, dims.x, dims.y);
     }
 }
+
+/**
+ * @brief ShaderProgram::setNoiseTexture
+ *  Note: set this even before the noise is baked, u_Noise (sampler3D) must not
+ *  share the texture slot 0 with u_Texture (sampler2D)
+ * @param textureSlot
+ */
+void ShaderProgram::setNoiseTexture(int textureSlot) {
+    if (unifNoise != -1 && checkUniformUpload(m_noiseShadow, textureSlot)) {
+        useMe();
+        context->glUniform1i(unifNoise, textureSlot);
+    }
+}
+
+void ShaderProgram::setBakedNoise(bool baked) {
+    if (unifBakedNoise != -1 && checkUniformUpload(m_bakedNoiseShadow, baked ? 1 : 0)) {
+        useMe();
+        context->glUniform1i(unifBakedNoise, baked ? 1 : 0);
+    }
+}
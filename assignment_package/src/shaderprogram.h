@@ -7,8 +7,33 @@
 
 #include "drawable.h"
 #include "utils.h"
+#include "scene/chunkarena.h"
 
 
+// The last value uploaded to a uniform of one program.
+// Uniform values are program state, so an upload of the same value can be skipped.
+template <typename T>
+struct UniformShadow
+{
+    T value;
+    bool uploaded;
+
+    UniformShadow()
+        : value(), uploaded(false)
+    {}
+
+    // true (and remember v) if v differs from the uploaded value
+    bool needsUpload(const T &v)
+    {
+        if (uploaded && value == v) {
+            return false;
+        }
+        value = v;
+        uploaded = true;
+        return true;
+    }
+};
+
 class ShaderProgram
 {
 public:
@@ -30,6 +55,8 @@ public:
     int unifTexture; // A handle for the "uniform" sampler2D that will be used to read the texture containing the scene render
     int unifTime; // A handle for the "uniform" int representing current time (actually is number of frames)
     int unifDimensions; // A handle for the "uniform" vec2 u_Dimensions
+    int unifNoise; // A handle for the "uniform" sampler3D u_Noise, the baked fbm (see NoiseTexture)
+    int unifBakedNoise; // A handle for the "uniform" int u_BakedNoise, sample u_Noise instead of computing the fbm
 
 public:
     ShaderProgram(OpenGLContext* context);
@@ -51,6 +78,10 @@ public:
     void setGeometryColor(glm::vec4 color);
     // Set dimension
     void setDimensions(glm::ivec2 dims);
+    // Set the texture slot of the baked noise
+    void setNoiseTexture(int textureSlot);
+    // Sample the baked noise (true) or compute the fbm per fragment (false)
+    void setBakedNoise(bool baked);
     // Draw the given object to our screen using this ShaderProgram's shaders
     void draw(Drawable &d);
     // Draw the given object to our screen multiple times using instanced rendering
@@ -59,10 +90,18 @@ public:
     void drawInterleaved(Drawable &d);
     // Draw the given object with interleaved buffer data based on TerrainDrawType
     void drawInterleavedTerrainDrawType(Drawable &d, TerrainDrawType drawType);
+    // Same as above, but only draw idxCount indices starting from firstIdx
+    void drawInterleavedTerrainDrawType(Drawable &d, TerrainDrawType drawType, int firstIdx, int idxCount);
+    // Draw drawCount index ranges of a ChunkArena with one glMultiDrawElementsBaseVertex
+    void drawChunkArena(ChunkArena &arena, const GLsizei *idxCounts, const void *const *idxOffsets,
+                        const GLint *baseVertices, int drawCount);
     // Draw Overlay
     void drawOverlay(Drawable &d);
     // Draw Texture
     void drawTexture(Drawable &d);
+    // Draw idxCount indices starting from firstIdx of a Drawable with interleaved pos (vec4) & uv (vec2),
+    // used by the HUD
+    void drawInterleavedTexture(Drawable &d, int firstIdx, int idxCount);
     // Utility function used in create()
     char* textFileRead(const char*);
     // Utility function that prints any shader compilation errors to the console
@@ -73,6 +112,24 @@ public:
     QString qTextFileRead(const char*);
 
 private:
+    UniformShadow<glm::mat4> m_modelShadow;
+    UniformShadow<glm::mat4> m_viewProjShadow;
+    UniformShadow<glm::vec4> m_colorShadow;
+    UniformShadow<int> m_textureShadow;
+    UniformShadow<int> m_timeShadow;
+    UniformShadow<glm::ivec2> m_dimensionsShadow;
+    UniformShadow<int> m_noiseShadow;
+    UniformShadow<int> m_bakedNoiseShadow;
+
+    // update the shadow & the context's uniform counter, true if v has to be uploaded
+    template <typename T>
+    bool checkUniformUpload(UniformShadow<T> &shadow, const T &v)
+    {
+        bool upload = shadow.needsUpload(v);
+        context->countUniformUpload(!upload);
+        return upload;
+    }
+
     OpenGLContext* context;   // Since Qt's OpenGL support is done through classes like QOpenGLFunctions_3_2_Core,
                             // we need to pass our OpenGL context to the Drawable in order to call GL functions
                             // from within this class.
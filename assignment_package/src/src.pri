@@ -18,7 +18,26 @@ SOURCES += \
     $$PWD/scene/npcs/steve.cpp \
     $$PWD/scene/npcs/zombiedragon.cpp \
     $$PWD/scene/pathfinder.cpp \
+    $$PWD/scene/pathservice.cpp \
     $$PWD/scene/quad.cpp \
+    $$PWD/scene/simulation.cpp \
+    $$PWD/scene/frustum.cpp \
+    $$PWD/scene/chunkarena.cpp \
+    $$PWD/scene/bufferpool.cpp \
+    $$PWD/scene/hudelement.cpp \
+    $$PWD/scene/hud.cpp \
+    $$PWD/scene/occlusionculler.cpp \
+    $$PWD/scene/sectiongraph.cpp \
+    $$PWD/scene/seededrandom.cpp \
+    $$PWD/scene/inputlog.cpp \
+    $$PWD/scene/voxelcollider.cpp \
+    $$PWD/scene/raycast.cpp \
+    $$PWD/scene/navgrid.cpp \
+    $$PWD/scene/portalgraph.cpp \
+    $$PWD/scene/flowfield.cpp \
+    $$PWD/scene/entityindex.cpp \
+    $$PWD/scene/npcupdater.cpp \
+    $$PWD/scene/npcstore.cpp \
     $$PWD/scene/text.cpp \
     $$PWD/scene/widget.cpp \
     $$PWD/shaderprogram.cpp \
@@ -33,7 +52,13 @@ SOURCES += \
     $$PWD/scene/camera.cpp \
     $$PWD/playerinfo.cpp \
     $$PWD/scene/chunk.cpp \
-    $$PWD/texture.cpp
+    $$PWD/texture.cpp \
+    $$PWD/noisetexture.cpp \
+    $$PWD/profiler.cpp \
+    $$PWD/tracer.cpp \
+    $$PWD/metrics.cpp \
+    $$PWD/benchmark.cpp \
+    $$PWD/selftest.cpp
 
 HEADERS += \
     $$PWD/framebuffer.h \
@@ -52,7 +77,26 @@ HEADERS += \
     $$PWD/scene/npcs/steve.h \
     $$PWD/scene/npcs/zombiedragon.h \
     $$PWD/scene/pathfinder.h \
+    $$PWD/scene/pathservice.h \
     $$PWD/scene/quad.h \
+    $$PWD/scene/simulation.h \
+    $$PWD/scene/frustum.h \
+    $$PWD/scene/chunkarena.h \
+    $$PWD/scene/bufferpool.h \
+    $$PWD/scene/hudelement.h \
+    $$PWD/scene/hud.h \
+    $$PWD/scene/occlusionculler.h \
+    $$PWD/scene/sectiongraph.h \
+    $$PWD/scene/seededrandom.h \
+    $$PWD/scene/inputlog.h \
+    $$PWD/scene/voxelcollider.h \
+    $$PWD/scene/raycast.h \
+    $$PWD/scene/navgrid.h \
+    $$PWD/scene/portalgraph.h \
+    $$PWD/scene/flowfield.h \
+    $$PWD/scene/entityindex.h \
+    $$PWD/scene/npcupdater.h \
+    $$PWD/scene/npcstore.h \
     $$PWD/scene/text.h \
     $$PWD/scene/widget.h \
     $$PWD/shaderprogram.h \
@@ -70,6 +114,12 @@ HEADERS += \
     $$PWD/playerinfo.h \
     $$PWD/scene/chunk.h \
     $$PWD/texture.h \
+    $$PWD/noisetexture.h \
+    $$PWD/profiler.h \
+    $$PWD/tracer.h \
+    $$PWD/metrics.h \
+    $$PWD/benchmark.h \
+    $$PWD/selftest.h \
     $$PWD/utils.h
 
 RESOURCES +=
@@ -0,0 +1,138 @@
+#include "tracer.h"
+#include <QFile>
+#include <QMutex>
+#include <QTextStream>
+#include <chrono>
+
+
+std::atomic<bool> Tracer::s_enabled(false);
+std::atomic<int> Tracer::s_generation(0);
+
+// every thread's buffer, guarded by s_buffersLock
+static std::vector<std::unique_ptr<TraceBuffer>> s_buffers;
+static QMutex s_buffersLock;
+
+static thread_local TraceBuffer *t_buffer = nullptr;
+static thread_local const char *t_threadName = nullptr;
+
+
+TraceBuffer::TraceBuffer(int tid, const std::string &threadName)
+    : events(Tracer::BUFFER_CAPACITY), count(0), dropped(0), generation(-1),
+      tid(tid), threadName(threadName)
+{}
+
+/**
+ * @brief Tracer::threadBuffer
+ *  The buffer of the calling thread, created on its first event
+ * @return
+ */
+TraceBuffer* Tracer::threadBuffer()
+{
+    if (t_buffer == nullptr) {
+        QMutexLocker locker(&s_buffersLock);
+        int tid = static_cast<int>(s_buffers.size()) + 1;
+        std::string name = t_threadName != nullptr ? t_threadName : "worker " + std::to_string(tid);
+        s_buffers.push_back(std::unique_ptr<TraceBuffer>(new TraceBuffer(tid, name)));
+        t_buffer = s_buffers.back().get();
+    }
+    return t_buffer;
+}
+
+/**
+ * @brief Tracer::start
+ *  Each thread empties its buffer on its first event of the new trace,
+ *  the lock keeps a writeJSON from reading the buffers meanwhile
+ */
+void Tracer::start()
+{
+    QMutexLocker locker(&s_buffersLock);
+    s_generation.fetch_add(1, std::memory_order_release);
+    s_enabled = true;
+}
+
+void Tracer::stop()
+{
+    s_enabled = false;
+}
+
+void Tracer::setThreadName(const char *name)
+{
+    t_threadName = name;
+    if (t_buffer != nullptr) {
+        QMutexLocker locker(&s_buffersLock);
+        t_buffer->threadName = name;
+    }
+}
+
+long long Tracer::now()
+{
+    static const std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - epoch).count();
+}
+
+void Tracer::record(const char *name, const char *category, long long start, long long end, int x, int z)
+{
+    TraceBuffer *buffer = threadBuffer();
+    int generation = s_generation.load(std::memory_order_acquire);
+    if (buffer->generation.load(std::memory_order_relaxed) != generation) {
+        // the first event of a new trace, the old events aren't written anymore
+        buffer->count.store(0, std::memory_order_relaxed);
+        buffer->dropped.store(0, std::memory_order_relaxed);
+        buffer->generation.store(generation, std::memory_order_release);
+    }
+    int i = buffer->count.load(std::memory_order_relaxed);
+    if (i >= BUFFER_CAPACITY) {
+        buffer->dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    buffer->events[i] = TraceEvent{name, category, start, end - start, x, z};
+    // publish the event to writeJSON
+    buffer->count.store(i + 1, std::memory_order_release);
+}
+
+/**
+ * @brief Tracer::writeJSON
+ *  Write the Chrome trace-event format: one complete ("X") event per span,
+ *  plus the thread names as metadata ("M") events.
+ *  The threads may keep recording meanwhile, only the events published before are written.
+ * @param path
+ * @return false if the file can't be opened
+ */
+bool Tracer::writeJSON(const QString &path)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Text)) {
+        return false;
+    }
+    QTextStream out(&file);
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+
+    QMutexLocker locker(&s_buffersLock);
+    int generation = s_generation.load(std::memory_order_acquire);
+    bool first = true;
+    for (const std::unique_ptr<TraceBuffer> &buffer : s_buffers) {
+        // a buffer still on an older trace has no event of this one
+        bool current = buffer->generation.load(std::memory_order_acquire) == generation;
+        if (!first) {
+            out << ",\n";
+        }
+        first = false;
+        out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->tid
+            << ",\"args\":{\"name\":\"" << QString::fromStdString(buffer->threadName)
+            << "\",\"dropped_events\":" << (current ? buffer->dropped.load() : 0) << "}}";
+
+        int count = current ? buffer->count.load(std::memory_order_acquire) : 0;
+        for (int i = 0; i < count; i++) {
+            const TraceEvent &e = buffer->events[i];
+            out << ",\n{\"name\":\"" << e.name << "\",\"cat\":\"" << e.category
+                << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->tid
+                << ",\"ts\":" << e.start << ",\"dur\":" << e.duration;
+            if (e.x != NO_COORD) {
+                out << ",\"args\":{\"x\":" << e.x << ",\"z\":" << e.z << "}";
+            }
+            out << "}";
+        }
+    }
+    out << "\n]}\n";
+    return true;
+}
@@ -0,0 +1,114 @@
+#ifndef TRACER_H
+#define TRACER_H
+
+#pragma once
+
+#include <QString>
+#include <atomic>
+#include <climits>
+#include <memory>
+#include <string>
+#include <vector>
+
+// One span on a thread's timeline, in microseconds
+struct TraceEvent
+{
+    const char *name;     // a string literal, only the pointer is kept
+    const char *category;
+    long long start;
+    long long duration;
+    int x, z;             // chunk / zone coordinates, Tracer::NO_COORD if none
+};
+
+// The events of one thread in one trace. Only that thread writes them,
+// the count is published with release semantics so Tracer::writeJSON
+// can read the events below it without a lock.
+// The thread starts the buffer over on its first event of a new trace
+// (when Tracer::start moved the generation on).
+struct TraceBuffer
+{
+    std::vector<TraceEvent> events;
+    std::atomic<int> count;
+    std::atomic<int> dropped;
+    // the trace the events belong to, published after count is reset
+    std::atomic<int> generation;
+    int tid;
+    std::string threadName;
+
+    TraceBuffer(int tid, const std::string &threadName);
+};
+
+// Opt-in timeline tracing of the worker threads, the GUI thread & the simulation,
+// written as a Chrome trace-event JSON file (open it in chrome://tracing or Perfetto).
+// Each thread records into its own TraceBuffer, allocated on its first event.
+// While tracing is off a TraceSpan costs one relaxed atomic load.
+class Tracer
+{
+public:
+    static const int NO_COORD = INT_MIN;
+    // events per thread & trace, later events of a full buffer are dropped (& counted)
+    static const int BUFFER_CAPACITY = 1 << 16;
+
+    static bool isEnabled()
+    {
+        return s_enabled.load(std::memory_order_relaxed);
+    }
+
+    // start a new trace, the events recorded before are not written
+    static void start();
+    static void stop();
+
+    // the name of the calling thread in the trace, e.g. "GUI"
+    // name must be a string literal
+    static void setThreadName(const char *name);
+
+    // microseconds since the first call
+    static long long now();
+    static void record(const char *name, const char *category, long long start, long long end, int x, int z);
+
+    // write the events of the current trace of every thread
+    static bool writeJSON(const QString &path);
+
+private:
+    static std::atomic<bool> s_enabled;
+    // the current trace, moved on by start
+    static std::atomic<int> s_generation;
+    static TraceBuffer* threadBuffer();
+};
+
+// Records the span from its construction to the end of the C++ scope, if tracing is on
+class TraceSpan
+{
+private:
+    const char *m_name;
+    const char *m_category;
+    int m_x, m_z;
+    long long m_start;
+    bool m_active;
+
+public:
+    TraceSpan(const char *name, const char *category, int x = Tracer::NO_COORD, int z = Tracer::NO_COORD)
+        : m_name(name), m_category(category), m_x(x), m_z(z), m_start(0), m_active(Tracer::isEnabled())
+    {
+        if (m_active) {
+            m_start = Tracer::now();
+        }
+    }
+
+    ~TraceSpan()
+    {
+        end();
+    }
+
+    // record the span up to now instead of the end of the scope (e.g. a lock wait)
+    void end()
+    {
+        if (m_active) {
+            Tracer::record(m_name, m_category, m_start, Tracer::now(), m_x, m_z);
+            m_active = false;
+        }
+    }
+};
+
+
+#endif // TRACER_H